@@ -0,0 +1,189 @@
+// Measures the per-delta cost of the streaming path, from the bytes of a
+// server-sent event stream to the caller, without the network.
+//
+//   stream_benchmark [--deltas 200000] [--read-bytes 1400] [--runs 5]
+//
+// "legacy" is the path before SseDecoder: every event parsed into a JSON
+// document and each delta copied into a std::string for the std::function
+// callbacks of HttpClient, GroqService and the caller. "callback" is the
+// StreamCallback API on top of SseDecoder, which still copies each delta
+// for the callbacks. "template" is the post_stream_to/stream_to path:
+// views into a reused buffer, called without type erasure.
+
+#include <CLI/CLI.hpp>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+
+#include "http/sse_decoder.hpp"
+
+namespace {
+
+using StreamCallback =
+    std::function<void(const std::string &chunk, bool is_done)>;
+
+// Token-sized pieces of text, a few with characters that need escaping.
+const char *const DELTAS[] = {
+    "The",    " quick",       " brown", " fox",      " jumps", " over",
+    " the",   " lazy",        " dog",   ".",         "\\n\\n", "```",
+    "cpp",    "\\n",          "for",    " (",        "size",   "_t",
+    " i",     " =",           " 0",     ";",         " \\\"",  "caf\\u00e9",
+    " tests", " internation", "al",     "ization",   "!",      " ",
+};
+
+std::string build_stream(size_t deltas) {
+  std::string stream;
+  for (size_t i = 0; i < deltas; ++i) {
+    stream += "data: {\"id\":\"chatcmpl-123\",\"object\":\"chat.completion."
+              "chunk\",\"created\":1700000000,\"model\":\"llama-3.3-70b-"
+              "versatile\",\"choices\":[{\"index\":0,\"delta\":{\"content\":"
+              "\"";
+    stream += DELTAS[i % std::size(DELTAS)];
+    stream += "\"},\"logprobs\":null,\"finish_reason\":null}]}\n\n";
+  }
+  stream += "data: [DONE]\n\n";
+  return stream;
+}
+
+// HttpClient::parse_sse_stream as it was.
+bool legacy_parse(std::string_view data, const StreamCallback &callback) {
+  size_t pos = 0;
+  for (size_t end; (end = data.find('\n', pos)) != std::string_view::npos;
+       pos = end + 1) {
+    std::string_view line = data.substr(pos, end - pos);
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    if (!line.starts_with("data: ")) {
+      continue;
+    }
+    std::string_view event_data = line.substr(6);
+    if (event_data == "[DONE]") {
+      callback("", true);
+      return true;
+    }
+    try {
+      auto json_data = nlohmann::json::parse(event_data);
+      if (json_data.contains("choices") &&
+          json_data["choices"][0].contains("delta") &&
+          json_data["choices"][0]["delta"].contains("content") &&
+          json_data["choices"][0]["delta"]["content"].is_string()) {
+        callback(json_data["choices"][0]["delta"]["content"].get<std::string>(),
+                 false);
+      }
+    } catch (const nlohmann::json::exception &) {
+    }
+  }
+  return false;
+}
+
+// Calls `receive` with the stream in pieces of `read_bytes`, as socket
+// reads would.
+template <typename Fn>
+void read_stream(std::string_view stream, size_t read_bytes, Fn &&receive) {
+  for (size_t pos = 0; pos < stream.size(); pos += read_bytes) {
+    receive(stream.substr(pos, read_bytes));
+  }
+}
+
+template <typename Fn> double measure_ns(size_t deltas, int runs, Fn fn) {
+  double best = 0.0;
+  for (int run = 0; run < runs; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    const double per_delta = elapsed.count() / static_cast<double>(deltas);
+    best = run == 0 ? per_delta : std::min(best, per_delta);
+  }
+  return best;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  CLI::App app{"Streaming path per-delta overhead benchmark"};
+
+  size_t deltas = 200000;
+  size_t read_bytes = 1400;
+  int runs = 5;
+  app.add_option("--deltas", deltas, "Deltas in the stream")
+      ->default_val(200000);
+  app.add_option("--read-bytes", read_bytes, "Bytes per simulated read")
+      ->default_val(1400);
+  app.add_option("--runs", runs, "Runs per measurement (best is reported)")
+      ->default_val(5);
+  CLI11_PARSE(app, argc, argv);
+  read_bytes = std::max<size_t>(read_bytes, 1);
+
+  const std::string stream = build_stream(deltas);
+  size_t checksum = 0;
+
+  const double legacy = measure_ns(deltas, runs, [&] {
+    std::string reply;
+    std::string cached;
+    StreamCallback caller = [&reply](const std::string &chunk, bool) {
+      reply += chunk;
+    };
+    StreamCallback service = [&cached, &caller](const std::string &chunk,
+                                                bool is_done) {
+      cached += chunk;
+      caller(chunk, is_done);
+    };
+    std::string pending;
+    bool done = false;
+    read_stream(stream, read_bytes, [&](std::string_view bytes) {
+      pending.append(bytes);
+      if (done) {
+        return;
+      }
+      size_t end = pending.rfind('\n');
+      if (end != std::string::npos) {
+        done = legacy_parse(std::string_view(pending).substr(0, end + 1),
+                            service);
+        pending.erase(0, end + 1);
+      }
+    });
+    checksum += reply.size() + cached.size();
+  });
+
+  const double callback = measure_ns(deltas, runs, [&] {
+    std::string reply;
+    std::string accumulated;
+    StreamCallback caller = [&reply](const std::string &chunk, bool) {
+      reply += chunk;
+    };
+    llm::SseDecoder decoder;
+    read_stream(stream, read_bytes, [&](std::string_view bytes) {
+      decoder.feed(bytes, [&](std::string_view delta) {
+        accumulated += delta;
+        caller(std::string(delta), false);
+      });
+    });
+    checksum += reply.size() + accumulated.size();
+  });
+
+  // The caller's buffer outlives the runs, as a reused one would.
+  std::string reply;
+  const double templated = measure_ns(deltas, runs, [&] {
+    reply.clear();
+    llm::SseDecoder decoder;
+    read_stream(stream, read_bytes, [&](std::string_view bytes) {
+      decoder.feed(bytes,
+                   [&reply](std::string_view delta) { reply += delta; });
+    });
+    checksum += reply.size();
+  });
+
+  std::cout << "stream:   " << deltas << " deltas, " << stream.size() / 1024
+            << " KiB in reads of " << read_bytes << " bytes\n";
+  std::cout << "legacy:   " << legacy << " ns/delta\n";
+  std::cout << "callback: " << callback << " ns/delta\n";
+  std::cout << "template: " << templated << " ns/delta\n";
+  std::cout << "(checksum " << checksum << ")\n";
+  return 0;
+}
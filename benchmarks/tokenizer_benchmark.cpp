@@ -0,0 +1,170 @@
+// Measures tokenizer throughput in MB/s over a mixed corpus of prose, code,
+// JSON and CJK text.
+//
+//   tokenizer_benchmark [--vocab llama3.tiktoken] [--size-mb 8] [--runs 5]
+//
+// Without --vocab a synthetic rank table (all bytes, common letter pairs and
+// the corpus words) is generated so the merge path is still exercised.
+
+#include <CLI/CLI.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "tokenizer/bpe_tokenizer.hpp"
+#include "tokenizer/pre_tokenizer.hpp"
+#include "tokenizer/tokenizer.hpp"
+
+namespace {
+
+const char *const SAMPLES[] = {
+    "The quick brown fox jumps over the lazy dog while the committee "
+    "reviews internationalization requirements for the next release. ",
+    "for (size_t i = 0; i < messages_.size(); ++i) {\n"
+    "    tokens += tokenizer_->count_tokens(messages_[i].content);\n}\n",
+    "{\"role\": \"assistant\", \"content\": \"Sure, here is the answer.\", "
+    "\"tokens\": [1, 22, 333, 4444]}\n",
+    "\xe4\xbd\xa0\xe5\xa5\xbd\xef\xbc\x8c\xe4\xb8\x96\xe7\x95\x8c\xe3\x80\x82"
+    "\xe8\xbf\x99\xe6\x98\xaf\xe4\xb8\x80\xe4\xb8\xaa\xe6\xb5\x8b\xe8\xaf\x95"
+    "\xe3\x80\x82 ",
+};
+
+std::string build_corpus(size_t bytes) {
+  std::string corpus;
+  corpus.reserve(bytes + 256);
+  size_t i = 0;
+  while (corpus.size() < bytes) {
+    corpus += SAMPLES[i++ % std::size(SAMPLES)];
+  }
+  return corpus;
+}
+
+std::string base64_encode(std::string_view in) {
+  static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  uint32_t buffer = 0;
+  int bits = 0;
+  for (unsigned char c : in) {
+    buffer = (buffer << 8) | c;
+    bits += 8;
+    while (bits >= 6) {
+      bits -= 6;
+      out.push_back(alphabet[(buffer >> bits) & 0x3F]);
+    }
+  }
+  if (bits > 0) {
+    out.push_back(alphabet[(buffer << (6 - bits)) & 0x3F]);
+  }
+  while (out.size() % 4 != 0) {
+    out.push_back('=');
+  }
+  return out;
+}
+
+std::string synthetic_ranks() {
+  std::vector<std::string> tokens;
+  for (int b = 0; b < 256; ++b) {
+    tokens.emplace_back(1, static_cast<char>(b));
+  }
+  for (char a = 'a'; a <= 'z'; ++a) {
+    for (char b = 'a'; b <= 'z'; ++b) {
+      tokens.push_back(std::string{a, b});
+    }
+  }
+
+  std::set<std::string> words;
+  for (const char *sample : SAMPLES) {
+    llm::PreTokenizer::split(sample, [&words](std::string_view piece) {
+      words.emplace(piece);
+    });
+  }
+  // Leave some words out so they have to be merged from pairs.
+  size_t i = 0;
+  for (const auto &word : words) {
+    if (i++ % 3 != 0) {
+      tokens.push_back(word);
+    }
+  }
+
+  std::string ranks;
+  for (size_t rank = 0; rank < tokens.size(); ++rank) {
+    ranks += base64_encode(tokens[rank]) + " " + std::to_string(rank) + "\n";
+  }
+  return ranks;
+}
+
+template <typename Fn> double measure_mb_per_s(size_t bytes, int runs, Fn fn) {
+  double best = 0.0;
+  for (int run = 0; run < runs; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::max(best, static_cast<double>(bytes) / (1024.0 * 1024.0) /
+                              elapsed.count());
+  }
+  return best;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  CLI::App app{"Tokenizer throughput benchmark"};
+
+  std::string vocab_path;
+  size_t size_mb = 8;
+  int runs = 5;
+  app.add_option("--vocab", vocab_path, "tiktoken rank file");
+  app.add_option("--size-mb", size_mb, "Corpus size in MiB")->default_val(8);
+  app.add_option("--runs", runs, "Runs per measurement (best is reported)")
+      ->default_val(5);
+  CLI11_PARSE(app, argc, argv);
+
+  std::shared_ptr<llm::BpeTokenizer> bpe =
+      vocab_path.empty() ? llm::BpeTokenizer::from_ranks(synthetic_ranks(),
+                                                         "synthetic")
+                         : llm::BpeTokenizer::load(vocab_path, "file");
+  if (!bpe) {
+    std::cerr << "Failed to load vocabulary: " << vocab_path << std::endl;
+    return 1;
+  }
+
+  const std::string corpus = build_corpus(size_mb * 1024 * 1024);
+  const std::string small(corpus.substr(0, llm::BpeTokenizer::PARALLEL_THRESHOLD / 2));
+  llm::ApproximateTokenizer approx;
+
+  size_t sink = 0;
+  double pre = measure_mb_per_s(corpus.size(), runs, [&] {
+    llm::PreTokenizer::split(corpus, [&sink](std::string_view piece) {
+      sink += piece.size();
+    });
+  });
+  double approx_rate = measure_mb_per_s(
+      corpus.size(), runs, [&] { sink += approx.count_tokens(corpus); });
+
+  // Feed the corpus in sub-threshold chunks to measure the serial path.
+  double serial = measure_mb_per_s(corpus.size(), runs, [&] {
+    for (size_t off = 0; off < corpus.size(); off += small.size()) {
+      sink += bpe->count_tokens(
+          std::string_view(corpus).substr(off, small.size()));
+    }
+  });
+  double parallel = measure_mb_per_s(
+      corpus.size(), runs, [&] { sink += bpe->encode(corpus).size(); });
+
+  size_t tokens = bpe->encode(corpus).size();
+
+  std::cout << "corpus:            " << corpus.size() / (1024 * 1024)
+            << " MiB, " << tokens << " tokens (vocab " << bpe->vocab_size()
+            << ")\n";
+  std::cout << "pre-tokenizer:     " << pre << " MB/s\n";
+  std::cout << "approximate count: " << approx_rate << " MB/s\n";
+  std::cout << "bpe serial:        " << serial << " MB/s\n";
+  std::cout << "bpe parallel:      " << parallel << " MB/s\n";
+  std::cout << "(checksum " << sink << ")\n";
+  return 0;
+}
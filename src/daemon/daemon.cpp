@@ -0,0 +1,190 @@
+#include "daemon/daemon.hpp"
+
+#include <cstdio>
+#include <thread>
+
+#include "daemon/unix_socket.hpp"
+#include "llm/groq_service.hpp"
+#include "utils/logger.hpp"
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+namespace llm {
+
+Daemon::Daemon(std::unique_ptr<Config> config)
+    : config_(std::move(config)),
+      tokenizers_(
+          config_->expand_path(config_->get_repl_config().tokenizer_dir)) {
+  const auto &repl_config = config_->get_repl_config();
+  auto provider_config = config_->get_provider_config(config_->get_provider());
+  pool_ = std::make_shared<HttpClientPool>(provider_config.api_url,
+                                           config_->get_api_key());
+  if (repl_config.response_cache_entries > 0) {
+    cache_ = std::make_shared<ResponseCache>(repl_config.response_cache_entries);
+  }
+  if (repl_config.requests_per_minute > 0) {
+    limiter_ = std::make_shared<RateLimiter>(repl_config.requests_per_minute,
+                                             repl_config.requests_per_minute);
+  }
+}
+
+Daemon::~Daemon() {
+  close_socket(listen_fd_);
+  if (!path_.empty()) {
+    std::remove(path_.c_str());
+  }
+}
+
+bool Daemon::listen(const std::string &path) {
+  listen_fd_ = listen_unix(path);
+  if (listen_fd_ < 0) {
+    return false;
+  }
+  path_ = path;
+  spdlog::info("Daemon listening on {}", path);
+  return true;
+}
+
+void Daemon::run() {
+#ifndef _WIN32
+  pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {stopping_.fd(), POLLIN, 0}};
+  while (!stopping_.cancelled()) {
+    if (::poll(fds, 2, -1) < 0 || !(fds[0].revents & POLLIN)) {
+      continue;
+    }
+    int fd = accept_client(listen_fd_);
+    if (fd < 0) {
+      continue;
+    }
+    clients_.fetch_add(1);
+    std::thread([this, fd] {
+      serve(fd);
+      close_socket(fd);
+      if (clients_.fetch_sub(1) == 1) {
+        clients_.notify_all();
+      }
+    }).detach();
+  }
+#endif
+
+  size_t active;
+  while ((active = clients_.load()) > 0) {
+    clients_.wait(active);
+  }
+  spdlog::info("Daemon stopped");
+}
+
+void Daemon::serve(int fd) {
+  FrameReader reader;
+  char buffer[4096];
+  std::optional<Frame> frame;
+  while (!(frame = reader.next()) && !reader.failed()) {
+    long received = receive_some(fd, buffer, sizeof(buffer));
+    if (received <= 0) {
+      return;
+    }
+    reader.feed(std::string_view(buffer, static_cast<size_t>(received)));
+  }
+
+  std::optional<AskRequest> request;
+  if (frame && frame->type == FrameType::Ask) {
+    request = decode_ask(frame->payload);
+  }
+  if (!request) {
+    std::string out;
+    append_frame(out, FrameType::Error,
+                 "Malformed request or protocol version mismatch");
+    send_all(fd, out);
+    return;
+  }
+  answer(fd, *request);
+}
+
+void Daemon::answer(int fd, const AskRequest &request) {
+  const auto &repl_config = config_->get_repl_config();
+  auto provider_config = config_->get_provider_config(config_->get_provider());
+
+  GroqService service(pool_, cache_, limiter_);
+  service.set_model(request.model.empty() ? provider_config.model
+                                          : request.model);
+  service.set_temperature(provider_config.temperature);
+  service.set_max_tokens(provider_config.max_tokens);
+
+  // The model's window less room for the reply, as in the REPL.
+  ModelInfo model{service.get_current_model(), "", 0, true};
+  for (const auto &known : service.get_available_models()) {
+    if (known.id == model.id) {
+      model = known;
+    }
+  }
+  std::optional<size_t> budget;
+  if (model.context_length > provider_config.max_tokens) {
+    budget = model.context_length - provider_config.max_tokens;
+  }
+
+  Session *session = nullptr;
+  std::unique_lock<std::mutex> session_lock;
+  if (!request.session.empty()) {
+    std::lock_guard lock(sessions_mutex_);
+    auto [it, added] = sessions_.try_emplace(request.session);
+    session = &it->second;
+    if (added) {
+      session->conversation.set_system_prompt(repl_config.system_prompt);
+    }
+  }
+  if (session) {
+    session_lock = std::unique_lock(session->mutex);
+  }
+
+  // The session only gets the prompt together with its reply, so a failed
+  // request leaves it as it was. Copies share the session's messages.
+  Conversation context;
+  if (session) {
+    session->conversation.set_tokenizer(tokenizers_.for_model(model));
+    context = session->conversation;
+  } else {
+    context.set_system_prompt(repl_config.system_prompt);
+    context.set_tokenizer(tokenizers_.for_model(model));
+  }
+  context.add_user(request.prompt);
+  if (budget && context.estimate_tokens() > *budget) {
+    context = context.select_context(*budget);
+  }
+
+  // Stops the request when the client goes away or the daemon stops.
+  CancellationToken cancel;
+  CancelWatch on_stop(stopping_, [&cancel] { cancel.cancel(); });
+  std::string reply;
+  std::string out;
+  const bool finished = service.stream_to(
+      context,
+      [&](std::string_view delta) {
+        if (cancel.cancelled()) {
+          return;
+        }
+        out.clear();
+        append_frame(out, FrameType::Delta, delta);
+        if (!send_all(fd, out)) {
+          cancel.cancel();
+        }
+      },
+      reply, &cancel);
+
+  out.clear();
+  if (finished) {
+    append_frame(out, FrameType::Done, "");
+  } else {
+    append_frame(out, FrameType::Error,
+                 cancel.cancelled() ? "Request cancelled" : "Request failed");
+  }
+  send_all(fd, out);
+
+  if (session && finished && !reply.empty()) {
+    session->conversation.add_user(request.prompt);
+    session->conversation.add_assistant(reply);
+  }
+}
+
+} // namespace llm
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "daemon/protocol.hpp"
+#include "http/http_client_pool.hpp"
+#include "llm/rate_limiter.hpp"
+#include "llm/response_cache.hpp"
+#include "models/conversation.hpp"
+#include "tokenizer/tokenizer_registry.hpp"
+#include "utils/cancellation.hpp"
+#include "utils/config.hpp"
+
+namespace llm {
+
+// Long-lived process behind `llm-repl --daemon` that answers `llm-repl
+// --ask` over a Unix socket. It keeps warm what each invocation would
+// otherwise set up again: provider connections (and their TLS sessions),
+// the response cache and rate limiter, the tokenizer tables, and named
+// conversations that later invocations continue.
+class Daemon {
+public:
+  explicit Daemon(std::unique_ptr<Config> config);
+  ~Daemon();
+
+  Daemon(const Daemon &) = delete;
+  Daemon &operator=(const Daemon &) = delete;
+
+  // Listens at `path`. False if another daemon already does, or the
+  // socket cannot be created.
+  bool listen(const std::string &path);
+
+  // Serves clients, each on a thread of its own, until stop(); then
+  // cancels the requests in flight and waits for them.
+  void run();
+
+  // Async-signal-safe.
+  void stop() noexcept { stopping_.cancel(); }
+
+private:
+  std::unique_ptr<Config> config_;
+  std::shared_ptr<HttpClientPool> pool_;
+  std::shared_ptr<ResponseCache> cache_;
+  std::shared_ptr<RateLimiter> limiter_;
+  TokenizerRegistry tokenizers_;
+  std::string path_;
+  int listen_fd_ = -1;
+  CancellationToken stopping_;
+  std::atomic<size_t> clients_{0};
+
+  // A named conversation. Its mutex is held for a whole request, so
+  // requests to one session are answered one after another, each seeing
+  // the turns of those before it.
+  struct Session {
+    std::mutex mutex;
+    Conversation conversation;
+  };
+  std::mutex sessions_mutex_;
+  std::map<std::string, Session> sessions_;
+
+  void serve(int fd);
+  // Answers `request`, writing frames to `fd`.
+  void answer(int fd, const AskRequest &request);
+};
+
+} // namespace llm
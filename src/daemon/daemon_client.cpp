@@ -0,0 +1,60 @@
+#include "daemon/daemon_client.hpp"
+
+#include "daemon/unix_socket.hpp"
+
+namespace llm {
+
+std::unique_ptr<DaemonClient> DaemonClient::connect(const std::string &path) {
+  int fd = connect_unix(path);
+  if (fd < 0) {
+    return nullptr;
+  }
+  return std::unique_ptr<DaemonClient>(new DaemonClient(fd));
+}
+
+DaemonClient::~DaemonClient() { close_socket(fd_); }
+
+CompletionResponse
+DaemonClient::ask(const AskRequest &request,
+                  const std::function<void(std::string_view)> &on_delta) {
+  CompletionResponse response{"", false, "", 0, request.model};
+  std::string out;
+  append_frame(out, FrameType::Ask, encode_ask(request));
+  if (!send_all(fd_, out)) {
+    response.error = "Daemon closed the connection";
+    return response;
+  }
+
+  FrameReader reader;
+  char buffer[16384];
+  while (true) {
+    while (auto frame = reader.next()) {
+      switch (frame->type) {
+      case FrameType::Delta:
+        on_delta(frame->payload);
+        response.content += frame->payload;
+        break;
+      case FrameType::Done:
+        response.success = true;
+        return response;
+      case FrameType::Error:
+        response.error = std::move(frame->payload);
+        return response;
+      case FrameType::Ask:
+        break;
+      }
+    }
+    if (reader.failed()) {
+      response.error = "Malformed reply from the daemon";
+      return response;
+    }
+    long received = receive_some(fd_, buffer, sizeof(buffer));
+    if (received <= 0) {
+      response.error = "Connection to the daemon was lost";
+      return response;
+    }
+    reader.feed(std::string_view(buffer, static_cast<size_t>(received)));
+  }
+}
+
+} // namespace llm
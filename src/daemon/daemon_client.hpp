@@ -0,0 +1,35 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "daemon/protocol.hpp"
+#include "llm/llm_service.hpp"
+
+namespace llm {
+
+// The `llm-repl --ask` side of the daemon socket: one connection per
+// request.
+class DaemonClient {
+public:
+  // A connection to the daemon at `path`, or null if none is running.
+  static std::unique_ptr<DaemonClient> connect(const std::string &path);
+  ~DaemonClient();
+
+  DaemonClient(const DaemonClient &) = delete;
+  DaemonClient &operator=(const DaemonClient &) = delete;
+
+  // Sends `request` and passes each piece of the reply to `on_delta` as it
+  // arrives. The response holds the whole reply, or the daemon's error.
+  CompletionResponse ask(const AskRequest &request,
+                         const std::function<void(std::string_view)> &on_delta);
+
+private:
+  explicit DaemonClient(int fd) : fd_(fd) {}
+
+  int fd_;
+};
+
+} // namespace llm
@@ -0,0 +1,105 @@
+#include "daemon/protocol.hpp"
+
+namespace llm {
+
+namespace {
+
+constexpr size_t HEADER_BYTES = 5;
+
+void append_u32(std::string &out, uint32_t value) {
+  for (int shift = 0; shift < 32; shift += 8) {
+    out += static_cast<char>((value >> shift) & 0xff);
+  }
+}
+
+uint32_t read_u32(std::string_view bytes) {
+  uint32_t value = 0;
+  for (int i = 3; i >= 0; --i) {
+    value = (value << 8) | static_cast<uint8_t>(bytes[i]);
+  }
+  return value;
+}
+
+void append_field(std::string &out, std::string_view field) {
+  append_u32(out, static_cast<uint32_t>(field.size()));
+  out.append(field);
+}
+
+bool read_field(std::string_view &in, std::string &field) {
+  if (in.size() < 4) {
+    return false;
+  }
+  uint32_t size = read_u32(in);
+  in.remove_prefix(4);
+  if (in.size() < size) {
+    return false;
+  }
+  field.assign(in.substr(0, size));
+  in.remove_prefix(size);
+  return true;
+}
+
+bool known_type(uint8_t type) {
+  return type >= static_cast<uint8_t>(FrameType::Ask) &&
+         type <= static_cast<uint8_t>(FrameType::Error);
+}
+
+} // namespace
+
+void append_frame(std::string &out, FrameType type, std::string_view payload) {
+  out += static_cast<char>(type);
+  append_u32(out, static_cast<uint32_t>(payload.size()));
+  out.append(payload);
+}
+
+std::string encode_ask(const AskRequest &request) {
+  std::string payload;
+  payload += static_cast<char>(PROTOCOL_VERSION);
+  append_field(payload, request.session);
+  append_field(payload, request.model);
+  append_field(payload, request.prompt);
+  return payload;
+}
+
+std::optional<AskRequest> decode_ask(std::string_view payload) {
+  if (payload.empty() ||
+      static_cast<uint8_t>(payload[0]) != PROTOCOL_VERSION) {
+    return std::nullopt;
+  }
+  payload.remove_prefix(1);
+  AskRequest request;
+  if (!read_field(payload, request.session) ||
+      !read_field(payload, request.model) ||
+      !read_field(payload, request.prompt) || !payload.empty()) {
+    return std::nullopt;
+  }
+  return request;
+}
+
+std::optional<Frame> FrameReader::next() {
+  std::string_view pending = std::string_view(buffer_).substr(offset_);
+  if (failed_ || pending.size() < HEADER_BYTES) {
+    return std::nullopt;
+  }
+  const auto type = static_cast<uint8_t>(pending[0]);
+  const uint32_t size = read_u32(pending.substr(1));
+  if (!known_type(type) || size > MAX_FRAME_PAYLOAD) {
+    failed_ = true;
+    return std::nullopt;
+  }
+  if (pending.size() < HEADER_BYTES + size) {
+    return std::nullopt;
+  }
+
+  Frame frame{static_cast<FrameType>(type),
+              std::string(pending.substr(HEADER_BYTES, size))};
+  offset_ += HEADER_BYTES + size;
+  // Drop consumed bytes once they are the bulk of the buffer.
+  if (offset_ > buffer_.size() / 2) {
+    buffer_.erase(0, offset_);
+    offset_ = 0;
+  }
+  return frame;
+}
+
+} // namespace llm
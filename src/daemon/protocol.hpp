@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace llm {
+
+// Framing between `llm-repl --ask` and the daemon on its Unix socket. A
+// frame is a type byte, the payload length as 4 little-endian bytes, and
+// the payload. A client sends one Ask frame; the daemon answers with
+// Delta frames as the reply streams in, then Done or Error, and closes.
+enum class FrameType : uint8_t {
+  Ask = 1,
+  Delta = 2, // payload: the text
+  Done = 3,  // payload: empty
+  Error = 4, // payload: the message
+};
+
+struct Frame {
+  FrameType type;
+  std::string payload;
+};
+
+// Bumped on any incompatible change; a daemon answers an Ask of another
+// version with an Error.
+inline constexpr uint8_t PROTOCOL_VERSION = 1;
+
+// Frames larger than this are refused rather than buffered.
+inline constexpr uint32_t MAX_FRAME_PAYLOAD = 64u << 20;
+
+struct AskRequest {
+  // Empty for a one-off question; otherwise the daemon keeps the
+  // conversation under this name for later requests to continue.
+  std::string session;
+  // Empty for the configured model.
+  std::string model;
+  std::string prompt;
+};
+
+void append_frame(std::string &out, FrameType type, std::string_view payload);
+
+// The payload of an Ask frame: the protocol version byte, then each field
+// as a 4-byte little-endian length and its bytes.
+std::string encode_ask(const AskRequest &request);
+// Null if the payload is malformed or of another protocol version.
+std::optional<AskRequest> decode_ask(std::string_view payload);
+
+// Splits a byte stream into frames, however the bytes were chunked.
+class FrameReader {
+public:
+  void feed(std::string_view bytes) { buffer_.append(bytes); }
+
+  // The next complete frame, if one has arrived. Once failed(), the stream
+  // is out of sync and nothing more is returned.
+  std::optional<Frame> next();
+
+  bool failed() const { return failed_; }
+
+private:
+  std::string buffer_;
+  size_t offset_ = 0;
+  bool failed_ = false;
+};
+
+} // namespace llm
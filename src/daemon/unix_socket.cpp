@@ -0,0 +1,137 @@
+#include "daemon/unix_socket.hpp"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace llm {
+
+#ifdef _WIN32
+int listen_unix(const std::string &) { return -1; }
+int accept_client(int) { return -1; }
+int connect_unix(const std::string &) { return -1; }
+bool send_all(int, std::string_view) { return false; }
+long receive_some(int, char *, size_t) { return -1; }
+void close_socket(int) {}
+#else
+namespace {
+
+bool make_address(const std::string &path, sockaddr_un &address) {
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+int open_socket() {
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+#ifdef SO_NOSIGPIPE
+  if (fd >= 0) {
+    int on = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+  }
+#endif
+  return fd;
+}
+
+} // namespace
+
+int listen_unix(const std::string &path) {
+  sockaddr_un address;
+  if (!make_address(path, address)) {
+    return -1;
+  }
+  if (int live = connect_unix(path); live >= 0) {
+    ::close(live);
+    return -1;
+  }
+  ::unlink(path.c_str());
+
+  int fd = open_socket();
+  if (fd < 0) {
+    return -1;
+  }
+  // Only the owner may talk to the daemon, which holds their API key.
+  const mode_t saved = ::umask(0077);
+  const bool bound =
+      ::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+  ::umask(saved);
+  if (!bound || ::listen(fd, 64) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int accept_client(int listen_fd) {
+  int fd;
+  while ((fd = ::accept(listen_fd, nullptr, nullptr)) < 0 && errno == EINTR) {
+  }
+  if (fd >= 0) {
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+  return fd;
+}
+
+int connect_unix(const std::string &path) {
+  sockaddr_un address;
+  if (!make_address(path, address)) {
+    return -1;
+  }
+  int fd = open_socket();
+  if (fd < 0) {
+    return -1;
+  }
+  while (::connect(fd, reinterpret_cast<sockaddr *>(&address),
+                   sizeof(address)) != 0) {
+    if (errno != EINTR) {
+      ::close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+bool send_all(int fd, std::string_view data) {
+#ifdef MSG_NOSIGNAL
+  constexpr int flags = MSG_NOSIGNAL;
+#else
+  constexpr int flags = 0;
+#endif
+  while (!data.empty()) {
+    ssize_t sent = ::send(fd, data.data(), data.size(), flags);
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data.remove_prefix(static_cast<size_t>(sent));
+  }
+  return true;
+}
+
+long receive_some(int fd, char *buffer, size_t size) {
+  ssize_t received;
+  while ((received = ::recv(fd, buffer, size, 0)) < 0 && errno == EINTR) {
+  }
+  return static_cast<long>(received);
+}
+
+void close_socket(int fd) {
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+#endif
+
+} // namespace llm
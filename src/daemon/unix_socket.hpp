@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace llm {
+
+// Minimal Unix domain stream sockets for the daemon and its clients. All
+// return -1 or false on failure, and always fail on Windows.
+
+// A socket listening at `path`. A leftover socket file nobody listens on
+// is replaced; one with a live listener is left alone.
+int listen_unix(const std::string &path);
+
+// The next connection to `listen_fd`, or -1.
+int accept_client(int listen_fd);
+
+// A socket connected to `path`, or -1 if nothing listens there.
+int connect_unix(const std::string &path);
+
+// Writes all of `data`; false once the peer has gone. Never raises SIGPIPE.
+bool send_all(int fd, std::string_view data);
+
+// Reads what is available, blocking until something is; 0 at end of
+// stream, -1 on error.
+long receive_some(int fd, char *buffer, size_t size);
+
+void close_socket(int fd);
+
+} // namespace llm
@@ -0,0 +1,515 @@
+#include "gateway/gateway.hpp"
+
+#include <thread>
+#include <vector>
+
+#include "gateway/openai_format.hpp"
+#include "llm/groq_service.hpp"
+#include "utils/logger.hpp"
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace llm {
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0;
+#endif
+
+constexpr std::string_view JSON = "application/json";
+
+std::string_view status_text(int status) {
+  switch (status) {
+  case 200:
+    return "OK";
+  case 400:
+    return "Bad Request";
+  case 404:
+    return "Not Found";
+  case 405:
+    return "Method Not Allowed";
+  case 413:
+    return "Payload Too Large";
+  default:
+    return "Bad Gateway";
+  }
+}
+
+#ifndef _WIN32
+void set_nonblocking(int fd) {
+  ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+  ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+#endif
+
+} // namespace
+
+Gateway::Gateway(std::unique_ptr<Config> config) : config_(std::move(config)) {
+  const auto &repl_config = config_->get_repl_config();
+  auto provider_config = config_->get_provider_config(config_->get_provider());
+  pool_ = std::make_shared<HttpClientPool>(provider_config.api_url,
+                                           config_->get_api_key());
+  if (repl_config.response_cache_entries > 0) {
+    cache_ = std::make_shared<ResponseCache>(repl_config.response_cache_entries);
+  }
+  if (repl_config.requests_per_minute > 0) {
+    limiter_ = std::make_shared<RateLimiter>(repl_config.requests_per_minute,
+                                             repl_config.requests_per_minute);
+  }
+#ifndef _WIN32
+  if (::pipe(wake_) == 0) {
+    set_nonblocking(wake_[0]);
+    set_nonblocking(wake_[1]);
+  }
+#endif
+}
+
+Gateway::~Gateway() {
+#ifndef _WIN32
+  for (int fd : {listen_fd_, wake_[0], wake_[1]}) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+#endif
+}
+
+#ifdef _WIN32
+bool Gateway::listen(uint16_t) { return false; }
+void Gateway::run() {}
+void Gateway::accept_clients() {}
+bool Gateway::read_request(const std::shared_ptr<Connection> &) {
+  return false;
+}
+bool Gateway::write_outbox(Connection &) { return false; }
+void Gateway::close_connection(Connection &) {}
+void Gateway::wake() {}
+#else
+bool Gateway::listen(uint16_t port) {
+  listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd_ < 0 || wake_[0] < 0) {
+    return false;
+  }
+  set_nonblocking(listen_fd_);
+  int on = 1;
+  ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  // Loopback only: the gateway spends the user's API key for anyone who
+  // can reach it.
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  socklen_t size = sizeof(address);
+  if (::bind(listen_fd_, reinterpret_cast<sockaddr *>(&address), size) != 0 ||
+      ::listen(listen_fd_, SOMAXCONN) != 0 ||
+      ::getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&address),
+                    &size) != 0) {
+    return false;
+  }
+  port_ = ntohs(address.sin_port);
+  spdlog::debug("Gateway listening on http://127.0.0.1:{}/v1", port_);
+  return true;
+}
+
+void Gateway::run() {
+  std::vector<pollfd> fds;
+  std::vector<std::shared_ptr<Connection>> polled;
+  while (!stopping_.cancelled()) {
+    fds.clear();
+    polled.clear();
+    fds.push_back({listen_fd_, POLLIN, 0});
+    fds.push_back({stopping_.fd(), POLLIN, 0});
+    fds.push_back({wake_[0], POLLIN, 0});
+    for (const auto &[fd, connection] : connections_) {
+      // Before dispatch POLLIN brings the request; after, only the end of
+      // the stream when the client goes away.
+      short events = POLLIN;
+      {
+        std::lock_guard lock(connection->mutex);
+        if (!connection->outbox.empty()) {
+          events |= POLLOUT;
+        }
+      }
+      fds.push_back({fd, events, 0});
+      polled.push_back(connection);
+    }
+
+    if (::poll(fds.data(), fds.size(), -1) < 0) {
+      continue;
+    }
+    if (fds[2].revents & POLLIN) {
+      char buffer[256];
+      while (::read(wake_[0], buffer, sizeof(buffer)) > 0) {
+      }
+    }
+    if (fds[0].revents & POLLIN) {
+      accept_clients();
+    }
+
+    for (size_t i = 0; i < polled.size(); ++i) {
+      auto &connection = polled[i];
+      const short revents = fds[i + 3].revents;
+      bool open = true;
+      if (revents & (POLLIN | POLLHUP | POLLERR)) {
+        open = read_request(connection);
+      }
+      if (open && (revents & POLLOUT)) {
+        open = write_outbox(*connection);
+      }
+      if (open) {
+        std::lock_guard lock(connection->mutex);
+        open = !(connection->finished && connection->outbox.empty());
+      }
+      if (!open) {
+        close_connection(*connection);
+      }
+    }
+  }
+
+  // Stop what is in flight, then wait for the request threads to let go.
+  for (const auto &[fd, connection] : connections_) {
+    std::lock_guard lock(connection->mutex);
+    connection->gone = true;
+    connection->drained.notify_all();
+  }
+  {
+    std::lock_guard lock(upstreams_mutex_);
+    for (const auto &[key, upstream] : upstreams_) {
+      upstream->cancel.cancel();
+    }
+  }
+  size_t active;
+  while ((active = requests_.load()) > 0) {
+    requests_.wait(active);
+  }
+  for (const auto &[fd, connection] : connections_) {
+    ::close(fd);
+  }
+  connections_.clear();
+  spdlog::info("Gateway stopped");
+}
+
+void Gateway::accept_clients() {
+  while (true) {
+    int fd = ::accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EMFILE || errno == ENFILE) {
+        // Leave the rest in the backlog until connections close, rather
+        // than waking up for them again at once.
+        spdlog::warn("Gateway out of file descriptors with {} clients",
+                     connections_.size());
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+      return;
+    }
+    set_nonblocking(fd);
+    int on = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    auto connection = std::make_shared<Connection>();
+    connection->fd = fd;
+    connections_.emplace(fd, std::move(connection));
+  }
+}
+
+bool Gateway::read_request(const std::shared_ptr<Connection> &connection) {
+  char buffer[16384];
+  while (true) {
+    ssize_t received = ::recv(connection->fd, buffer, sizeof(buffer), 0);
+    if (received == 0) {
+      return false;
+    }
+    if (received < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    if (connection->dispatched) {
+      continue;
+    }
+
+    switch (connection->request.feed(
+        std::string_view(buffer, static_cast<size_t>(received)))) {
+    case HttpRequestParser::State::Incomplete:
+      break;
+    case HttpRequestParser::State::Complete:
+      dispatch(connection);
+      break;
+    case HttpRequestParser::State::Invalid:
+      connection->dispatched = true;
+      send_response(*connection, 400, JSON,
+                    error_body("Malformed HTTP request",
+                               "invalid_request_error"));
+      finish(*connection);
+      break;
+    case HttpRequestParser::State::TooLarge:
+      connection->dispatched = true;
+      send_response(*connection, 413, JSON,
+                    error_body("Request too large", "invalid_request_error"));
+      finish(*connection);
+      break;
+    }
+  }
+}
+
+bool Gateway::write_outbox(Connection &connection) {
+  std::lock_guard lock(connection.mutex);
+  size_t sent = 0;
+  while (sent < connection.outbox.size()) {
+    ssize_t written =
+        ::send(connection.fd, connection.outbox.data() + sent,
+               connection.outbox.size() - sent, SEND_FLAGS);
+    if (written > 0) {
+      sent += static_cast<size_t>(written);
+    } else if (written < 0 && errno == EINTR) {
+      continue;
+    } else if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    } else {
+      return false;
+    }
+  }
+  connection.outbox.erase(0, sent);
+  connection.drained.notify_all();
+  return true;
+}
+
+void Gateway::close_connection(Connection &connection) {
+  {
+    std::lock_guard lock(connection.mutex);
+    connection.gone = true;
+    connection.drained.notify_all();
+  }
+  ::close(connection.fd);
+  connections_.erase(connection.fd);
+}
+
+void Gateway::wake() {
+  const char byte = 1;
+  // A full pipe already guarantees a wake-up.
+  while (::write(wake_[1], &byte, 1) < 0 && errno == EINTR) {
+  }
+}
+#endif
+
+void Gateway::dispatch(std::shared_ptr<Connection> connection) {
+  connection->dispatched = true;
+  const uint64_t id = ++next_id_;
+  requests_.fetch_add(1);
+  std::thread([this, connection = std::move(connection), id] {
+    try {
+      handle(*connection, id);
+    } catch (const std::exception &e) {
+      spdlog::error("Gateway request failed: {}", e.what());
+    }
+    finish(*connection);
+    if (requests_.fetch_sub(1) == 1) {
+      requests_.notify_all();
+    }
+  }).detach();
+}
+
+void Gateway::handle(Connection &connection, uint64_t id) {
+  const auto &request = connection.request;
+  spdlog::debug("Gateway: {} {}", request.method(), request.path());
+  if (request.path() == "/v1/chat/completions") {
+    if (request.method() != "POST") {
+      send_response(connection, 405, JSON,
+                    error_body("Use POST", "invalid_request_error"));
+      return;
+    }
+    handle_chat(connection, id);
+  } else if (request.path() == "/v1/models") {
+    if (request.method() != "GET") {
+      send_response(connection, 405, JSON,
+                    error_body("Use GET", "invalid_request_error"));
+      return;
+    }
+    GroqService service(pool_);
+    send_response(connection, 200, JSON,
+                  models_body(service.get_available_models()));
+  } else {
+    send_response(connection, 404, JSON,
+                  error_body("Unknown endpoint " + request.path(),
+                             "invalid_request_error"));
+  }
+}
+
+void Gateway::handle_chat(Connection &connection, uint64_t id) {
+  std::string error;
+  auto chat = parse_chat_request(connection.request.body(), error);
+  if (!chat) {
+    send_response(connection, 400, JSON,
+                  error_body(error, "invalid_request_error"));
+    return;
+  }
+
+  auto provider_config = config_->get_provider_config(config_->get_provider());
+  auto service = std::make_shared<GroqService>(pool_, cache_, limiter_);
+  service->set_model(chat->model.empty() ? provider_config.model : chat->model);
+  service->set_temperature(
+      chat->temperature.value_or(provider_config.temperature));
+  service->set_max_tokens(
+      chat->max_tokens.value_or(provider_config.max_tokens));
+  const CompletionId completion{"chatcmpl-" + std::to_string(id),
+                                service->get_current_model(),
+                                std::time(nullptr)};
+
+  if (!chat->stream) {
+    auto response = service->complete(chat->conversation);
+    if (response.success) {
+      send_response(connection, 200, JSON, completion_body(completion, response));
+    } else {
+      send_response(connection, 502, JSON,
+                    error_body(response.error, "upstream_error"));
+    }
+    return;
+  }
+
+  if (!send(connection, "HTTP/1.1 200 OK\r\n"
+                        "Content-Type: text/event-stream\r\n"
+                        "Cache-Control: no-cache\r\n"
+                        "Connection: close\r\n\r\n")) {
+    return;
+  }
+  // Only a temperature 0 reply is the same for every client that asks; at
+  // any other temperature each request gets its own sample, under a key no
+  // other request can match.
+  const std::string key =
+      chat->temperature.value_or(provider_config.temperature) == 0.0f
+          ? service->request_key(chat->conversation)
+          : "#" + std::to_string(id);
+  auto upstream = join_upstream(key, std::move(service), chat->conversation);
+
+  // Whatever arrived while this client was not reading goes out as one
+  // event.
+  StreamBroadcast::Reader reader(upstream->broadcast);
+  bool sent = true;
+  for (auto run = reader.read(); sent && !run.empty(); run = reader.read()) {
+    sent = send(connection, chunk_event(completion, run));
+  }
+  leave_upstream(key, *upstream);
+  if (!sent) {
+    return;
+  }
+  if (upstream->finished) {
+    send(connection,
+         chunk_event(completion, std::nullopt) + std::string(DONE_EVENT));
+  } else {
+    send(connection, "data: " +
+                         error_body("Upstream request failed",
+                                    "upstream_error") +
+                         "\n\n");
+  }
+}
+
+std::shared_ptr<Gateway::Upstream>
+Gateway::join_upstream(const std::string &key,
+                       std::shared_ptr<GroqService> service,
+                       const Conversation &conversation) {
+  std::shared_ptr<Upstream> upstream;
+  {
+    std::lock_guard lock(upstreams_mutex_);
+    auto &slot = upstreams_[key];
+    if (slot) {
+      ++slot->readers;
+      return slot;
+    }
+    slot = upstream = std::make_shared<Upstream>();
+    upstream->readers = 1;
+  }
+
+  requests_.fetch_add(1);
+  std::thread([this, key, upstream, service = std::move(service),
+               conversation = Conversation(conversation)] {
+    try {
+      std::string reply;
+      upstream->finished = service->stream_to(
+          conversation,
+          [&upstream](std::string_view delta) {
+            upstream->broadcast.publish(delta);
+          },
+          reply, &upstream->cancel);
+    } catch (const std::exception &e) {
+      spdlog::error("Gateway upstream request failed: {}", e.what());
+    }
+    upstream->broadcast.close();
+    {
+      std::lock_guard lock(upstreams_mutex_);
+      auto it = upstreams_.find(key);
+      if (it != upstreams_.end() && it->second == upstream) {
+        upstreams_.erase(it);
+      }
+    }
+    if (requests_.fetch_sub(1) == 1) {
+      requests_.notify_all();
+    }
+  }).detach();
+  return upstream;
+}
+
+void Gateway::leave_upstream(const std::string &key, Upstream &upstream) {
+  std::lock_guard lock(upstreams_mutex_);
+  if (--upstream.readers > 0 || upstream.broadcast.closed()) {
+    return;
+  }
+  // Nobody is left to read the reply, and nobody can join it now.
+  upstream.cancel.cancel();
+  auto it = upstreams_.find(key);
+  if (it != upstreams_.end() && it->second.get() == &upstream) {
+    upstreams_.erase(it);
+  }
+}
+
+bool Gateway::send(Connection &connection, std::string_view data) {
+  {
+    std::unique_lock lock(connection.mutex);
+    connection.drained.wait(lock, [&connection] {
+      return connection.gone || connection.outbox.size() < OUTBOX_LIMIT;
+    });
+    if (connection.gone) {
+      return false;
+    }
+    connection.outbox.append(data);
+  }
+  wake();
+  return true;
+}
+
+bool Gateway::send_response(Connection &connection, int status,
+                            std::string_view content_type,
+                            std::string_view body) {
+  std::string response = "HTTP/1.1 " + std::to_string(status) + " " +
+                         std::string(status_text(status)) + "\r\n";
+  response += "Content-Type: " + std::string(content_type) + "\r\n";
+  response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+  response += "Connection: close\r\n\r\n";
+  response += body;
+  return send(connection, response);
+}
+
+void Gateway::finish(Connection &connection) {
+  {
+    std::lock_guard lock(connection.mutex);
+    connection.finished = true;
+  }
+  wake();
+}
+
+} // namespace llm
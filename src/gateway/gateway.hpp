@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "gateway/http_request_parser.hpp"
+#include "http/http_client_pool.hpp"
+#include "llm/groq_service.hpp"
+#include "llm/rate_limiter.hpp"
+#include "llm/response_cache.hpp"
+#include "utils/cancellation.hpp"
+#include "utils/config.hpp"
+#include "utils/stream_broadcast.hpp"
+
+namespace llm {
+
+// OpenAI-compatible endpoint behind `llm-repl --serve`: POST
+// /v1/chat/completions, streamed or not, and GET /v1/models on a local
+// port. Every request goes out through one connection pool, response
+// cache and rate limiter, so local tools share a single egress.
+//
+// One thread runs an event loop over all client sockets, reading requests
+// and writing replies without blocking. Each request runs on a thread of
+// its own and queues its output in the client's outbox, waiting while the
+// outbox holds OUTBOX_LIMIT bytes. A streamed reply is read from the
+// provider on yet another thread into a StreamBroadcast, which clients
+// sending the same request at the same time share; a slow client only
+// falls behind in it, without holding up the provider, the loop or other
+// clients. One request per connection.
+class Gateway {
+public:
+  // Bytes queued for a client before its upstream request waits.
+  static constexpr size_t OUTBOX_LIMIT = 256 << 10;
+
+  explicit Gateway(std::unique_ptr<Config> config);
+  ~Gateway();
+
+  Gateway(const Gateway &) = delete;
+  Gateway &operator=(const Gateway &) = delete;
+
+  // Listens on 127.0.0.1:`port`; 0 picks a free port. False on failure.
+  bool listen(uint16_t port);
+  uint16_t port() const { return port_; }
+
+  // Serves until stop(); then cancels the requests in flight and waits
+  // for them.
+  void run();
+
+  // Async-signal-safe.
+  void stop() noexcept { stopping_.cancel(); }
+
+private:
+  struct Connection {
+    int fd;
+    HttpRequestParser request;
+    // Set once the request has been handed to its thread.
+    bool dispatched = false;
+
+    // Shared with the request's thread.
+    std::mutex mutex;
+    std::condition_variable drained;
+    std::string outbox;
+    // The reply is complete; close once the outbox is sent.
+    bool finished = false;
+    // The client is gone; the request's thread stops writing.
+    bool gone = false;
+  };
+
+  // A streamed upstream request. Clients that send the same request at
+  // temperature 0 while it runs read the one reply, each at its own pace,
+  // from the start.
+  struct Upstream {
+    StreamBroadcast broadcast;
+    // Fired when the last reader leaves or the gateway stops.
+    CancellationToken cancel;
+    // Set before the broadcast is closed if the reply was complete.
+    std::atomic<bool> finished{false};
+    // Guarded by upstreams_mutex_.
+    size_t readers = 0;
+  };
+
+  std::unique_ptr<Config> config_;
+  std::shared_ptr<HttpClientPool> pool_;
+  std::shared_ptr<ResponseCache> cache_;
+  std::shared_ptr<RateLimiter> limiter_;
+  int listen_fd_ = -1;
+  uint16_t port_ = 0;
+  CancellationToken stopping_;
+  // Readable when a request's thread has queued output.
+  int wake_[2] = {-1, -1};
+  std::unordered_map<int, std::shared_ptr<Connection>> connections_;
+  // Threads still running, of requests and of upstream streams.
+  std::atomic<size_t> requests_{0};
+  std::mutex upstreams_mutex_;
+  // Streams in flight, by model, settings and messages at temperature 0 and
+  // by request id otherwise.
+  std::unordered_map<std::string, std::shared_ptr<Upstream>> upstreams_;
+  uint64_t next_id_ = 0;
+
+  void accept_clients();
+  // Returns false once the connection should be closed.
+  bool read_request(const std::shared_ptr<Connection> &connection);
+  bool write_outbox(Connection &connection);
+  void close_connection(Connection &connection);
+  void dispatch(std::shared_ptr<Connection> connection);
+
+  // Runs on the request's thread.
+  void handle(Connection &connection, uint64_t id);
+  void handle_chat(Connection &connection, uint64_t id);
+  // The stream in flight for `key`, or a new one sending `conversation`
+  // through `service`; either way the caller becomes one of its readers.
+  std::shared_ptr<Upstream> join_upstream(const std::string &key,
+                                          std::shared_ptr<GroqService> service,
+                                          const Conversation &conversation);
+  void leave_upstream(const std::string &key, Upstream &upstream);
+  // Queues `data` for the client, waiting while its outbox is full. False
+  // if the client is gone.
+  bool send(Connection &connection, std::string_view data);
+  bool send_response(Connection &connection, int status,
+                     std::string_view content_type, std::string_view body);
+  void finish(Connection &connection);
+  void wake();
+};
+
+} // namespace llm
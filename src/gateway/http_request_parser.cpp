@@ -0,0 +1,118 @@
+#include "gateway/http_request_parser.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+namespace llm {
+
+namespace {
+
+std::string lowercase(std::string_view text) {
+  std::string out(text);
+  std::transform(out.begin(), out.end(), out.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return out;
+}
+
+std::string_view trim(std::string_view text) {
+  while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+} // namespace
+
+HttpRequestParser::State HttpRequestParser::feed(std::string_view bytes) {
+  if (state_ != State::Incomplete) {
+    return state_;
+  }
+
+  if (!head_done_) {
+    buffer_.append(bytes);
+    size_t end = buffer_.find("\r\n\r\n");
+    if (end == std::string::npos) {
+      if (buffer_.size() > MAX_HEAD_BYTES) {
+        state_ = State::TooLarge;
+      }
+      return state_;
+    }
+    if (end > MAX_HEAD_BYTES) {
+      return state_ = State::TooLarge;
+    }
+    if (!parse_head(std::string_view(buffer_).substr(0, end))) {
+      return state_ = State::Invalid;
+    }
+    if (body_size_ > MAX_BODY_BYTES) {
+      return state_ = State::TooLarge;
+    }
+    head_done_ = true;
+    body_.reserve(body_size_);
+    bytes = std::string_view(buffer_).substr(end + 4);
+    body_.append(bytes.substr(0, body_size_ - body_.size()));
+    buffer_.clear();
+  } else {
+    body_.append(bytes.substr(0, body_size_ - body_.size()));
+  }
+
+  if (body_.size() == body_size_) {
+    state_ = State::Complete;
+  }
+  return state_;
+}
+
+std::string HttpRequestParser::header(std::string_view name) const {
+  auto it = headers_.find(lowercase(name));
+  return it == headers_.end() ? "" : it->second;
+}
+
+bool HttpRequestParser::parse_head(std::string_view head) {
+  size_t line_end = head.find("\r\n");
+  std::string_view line = head.substr(0, line_end);
+
+  // METHOD SP TARGET SP VERSION
+  size_t first = line.find(' ');
+  size_t second = line.find(' ', first + 1);
+  if (first == std::string_view::npos || second == std::string_view::npos ||
+      !line.substr(second + 1).starts_with("HTTP/1.")) {
+    return false;
+  }
+  method_ = line.substr(0, first);
+  std::string_view target = line.substr(first + 1, second - first - 1);
+  path_ = target.substr(0, target.find('?'));
+  if (method_.empty() || path_.empty() || path_[0] != '/') {
+    return false;
+  }
+
+  while (line_end != std::string_view::npos) {
+    head.remove_prefix(line_end + 2);
+    line_end = head.find("\r\n");
+    line = head.substr(0, line_end);
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos || colon == 0) {
+      return false;
+    }
+    headers_[lowercase(line.substr(0, colon))] =
+        std::string(trim(line.substr(colon + 1)));
+  }
+
+  if (!header("transfer-encoding").empty()) {
+    return false;
+  }
+  std::string length = header("content-length");
+  if (!length.empty()) {
+    auto [end, ec] =
+        std::from_chars(length.data(), length.data() + length.size(),
+                        body_size_);
+    if (ec != std::errc() || end != length.data() + length.size()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace llm
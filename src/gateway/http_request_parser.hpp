@@ -0,0 +1,44 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace llm {
+
+// Incremental parser of one HTTP/1.1 request: the request line, headers
+// and a Content-Length body. Bytes are fed as they arrive on a
+// non-blocking socket; chunked request bodies are not supported.
+class HttpRequestParser {
+public:
+  enum class State { Incomplete, Complete, Invalid, TooLarge };
+
+  // Requests with a larger head or body are refused.
+  static constexpr size_t MAX_HEAD_BYTES = 64 << 10;
+  static constexpr size_t MAX_BODY_BYTES = 16 << 20;
+
+  State feed(std::string_view bytes);
+  State state() const { return state_; }
+
+  const std::string &method() const { return method_; }
+  // Without the query string.
+  const std::string &path() const { return path_; }
+  const std::string &body() const { return body_; }
+  // The value of header `name` (case-insensitive), or empty.
+  std::string header(std::string_view name) const;
+
+private:
+  State state_ = State::Incomplete;
+  std::string buffer_;
+  bool head_done_ = false;
+  size_t body_size_ = 0;
+  std::string method_;
+  std::string path_;
+  // Keys are lowercase.
+  std::map<std::string, std::string> headers_;
+  std::string body_;
+
+  bool parse_head(std::string_view head);
+};
+
+} // namespace llm
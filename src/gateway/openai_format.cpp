@@ -0,0 +1,135 @@
+#include "gateway/openai_format.hpp"
+
+namespace llm {
+
+namespace {
+
+// Message content is either a string or an array of parts, of which only
+// text parts are supported.
+bool content_text(const nlohmann::json &content, std::string &text) {
+  if (content.is_string()) {
+    text = content.get<std::string>();
+    return true;
+  }
+  if (!content.is_array()) {
+    return false;
+  }
+  text.clear();
+  for (const auto &part : content) {
+    if (!part.is_object() || part.value("type", "") != "text" ||
+        !part.contains("text") || !part["text"].is_string()) {
+      return false;
+    }
+    text += part["text"].get<std::string>();
+  }
+  return true;
+}
+
+} // namespace
+
+std::optional<ChatRequest> parse_chat_request(std::string_view body,
+                                              std::string &error) {
+  auto json = nlohmann::json::parse(body, nullptr, false);
+  if (json.is_discarded() || !json.is_object()) {
+    error = "Request body is not a JSON object";
+    return std::nullopt;
+  }
+  if (!json.contains("messages") || !json["messages"].is_array() ||
+      json["messages"].empty()) {
+    error = "'messages' must be a non-empty array";
+    return std::nullopt;
+  }
+
+  ChatRequest request;
+  std::string text;
+  for (const auto &message : json["messages"]) {
+    if (!message.is_object() || !message.contains("role") ||
+        !message["role"].is_string() || !message.contains("content") ||
+        !content_text(message["content"], text)) {
+      error = "Each message needs a 'role' and text 'content'";
+      return std::nullopt;
+    }
+    const auto &role = message["role"].get_ref<const std::string &>();
+    if (role == "system" || role == "developer") {
+      request.conversation.add_system(text);
+    } else if (role == "assistant") {
+      request.conversation.add_assistant(text);
+    } else if (role == "user") {
+      request.conversation.add_user(text);
+    } else {
+      error = "Unsupported message role '" + role + "'";
+      return std::nullopt;
+    }
+  }
+
+  try {
+    if (json.contains("model")) {
+      request.model = json["model"].get<std::string>();
+    }
+    if (json.contains("temperature") && !json["temperature"].is_null()) {
+      request.temperature = json["temperature"].get<float>();
+    }
+    for (const char *key : {"max_completion_tokens", "max_tokens"}) {
+      if (json.contains(key) && !json[key].is_null()) {
+        request.max_tokens = json[key].get<size_t>();
+        break;
+      }
+    }
+    request.stream = json.value("stream", false);
+  } catch (const nlohmann::json::exception &) {
+    error = "'model', 'temperature', 'max_tokens' or 'stream' has the "
+            "wrong type";
+    return std::nullopt;
+  }
+  return request;
+}
+
+std::string chunk_event(const CompletionId &id,
+                        std::optional<std::string_view> content) {
+  nlohmann::json choice = {{"index", 0}};
+  if (content) {
+    choice["delta"] = {{"content", *content}};
+    choice["finish_reason"] = nullptr;
+  } else {
+    choice["delta"] = nlohmann::json::object();
+    choice["finish_reason"] = "stop";
+  }
+  nlohmann::json chunk = {{"id", id.id},
+                          {"object", "chat.completion.chunk"},
+                          {"created", id.created},
+                          {"model", id.model},
+                          {"choices", {choice}}};
+  return "data: " + chunk.dump() + "\n\n";
+}
+
+std::string completion_body(const CompletionId &id,
+                            const CompletionResponse &response) {
+  nlohmann::json body = {
+      {"id", id.id},
+      {"object", "chat.completion"},
+      {"created", id.created},
+      {"model", id.model},
+      {"choices",
+       {{{"index", 0},
+         {"message", {{"role", "assistant"}, {"content", response.content}}},
+         {"finish_reason", "stop"}}}}};
+  if (response.tokens_used > 0) {
+    body["usage"] = {{"total_tokens", response.tokens_used}};
+  }
+  return body.dump();
+}
+
+std::string models_body(const std::vector<ModelInfo> &models) {
+  nlohmann::json data = nlohmann::json::array();
+  for (const auto &model : models) {
+    data.push_back({{"id", model.id}, {"object", "model"}, {"owned_by", "groq"}});
+  }
+  return nlohmann::json{{"object", "list"}, {"data", data}}.dump();
+}
+
+std::string error_body(std::string_view message, std::string_view type) {
+  return nlohmann::json{{"error", {{"message", message}, {"type", type}}}}
+      .dump();
+}
+
+} // namespace llm
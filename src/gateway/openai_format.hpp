@@ -0,0 +1,54 @@
+#pragma once
+
+#include <ctime>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "llm/llm_service.hpp"
+#include "models/conversation.hpp"
+
+namespace llm {
+
+// Translation between OpenAI chat completion requests and responses and
+// the LLMService stack, for the gateway.
+struct ChatRequest {
+  Conversation conversation;
+  // Empty when the client left it to the gateway.
+  std::string model;
+  std::optional<float> temperature;
+  std::optional<size_t> max_tokens;
+  bool stream = false;
+};
+
+// Parses a /v1/chat/completions body. On failure returns null and sets
+// `error` to a message for the client.
+std::optional<ChatRequest> parse_chat_request(std::string_view body,
+                                              std::string &error);
+
+// Identifies one completion in its chunks or response.
+struct CompletionId {
+  std::string id;
+  std::string model;
+  std::time_t created;
+};
+
+// One server-sent event of a streamed completion: a content delta, or the
+// final chunk with finish_reason "stop" when `content` is null.
+std::string chunk_event(const CompletionId &id,
+                        std::optional<std::string_view> content);
+
+inline constexpr std::string_view DONE_EVENT = "data: [DONE]\n\n";
+
+std::string completion_body(const CompletionId &id,
+                            const CompletionResponse &response);
+
+std::string models_body(const std::vector<ModelInfo> &models);
+
+// An OpenAI-style error body.
+std::string error_body(std::string_view message, std::string_view type);
+
+} // namespace llm
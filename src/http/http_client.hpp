@@ -7,6 +7,11 @@
 #include <nlohmann/json.hpp>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
+
+#include "http/sse_decoder.hpp"
+#include "utils/cancellation.hpp"
 
 #if !defined(_WIN32) && !defined(_WIN64)
 #include <httplib.h>
@@ -14,6 +19,11 @@
 
 namespace llm {
 
+// A request body that is already serialized JSON, sent as is.
+struct JsonText {
+  std::string text;
+};
+
 class HttpClient {
 public:
   struct Response {
@@ -33,6 +43,8 @@ public:
 
   Response post(const std::string &endpoint, const nlohmann::json &data,
                 const Headers &headers = {});
+  Response post(const std::string &endpoint, const JsonText &body,
+                const Headers &headers = {});
 
   Response get(const std::string &endpoint, const Headers &headers = {});
 
@@ -40,8 +52,45 @@ public:
                                    const nlohmann::json &data,
                                    const Headers &headers = {});
 
+  // Calls `callback` with each content delta of a server-sent event
+  // stream as it arrives, and with is_done once the stream ends. If
+  // `cancel` fires, the connection is shut down at once and the call
+  // returns without is_done.
   void post_stream(const std::string &endpoint, const nlohmann::json &data,
-                   StreamCallback callback, const Headers &headers = {});
+                   StreamCallback callback, const Headers &headers = {},
+                   const CancellationToken *cancel = nullptr);
+
+  // Like post_stream(), but hands each delta to `sink` as a view, with no
+  // copy or type erasure per delta. Returns true if the stream ended, as
+  // post_stream() reports with is_done.
+  template <DeltaSink Sink>
+  bool post_stream_to(const std::string &endpoint, const nlohmann::json &data,
+                      Sink &&sink, const Headers &headers = {},
+                      const CancellationToken *cancel = nullptr) {
+    return post_stream_to(endpoint, JsonText{data.dump()},
+                          std::forward<Sink>(sink), headers, cancel);
+  }
+
+  template <DeltaSink Sink>
+  bool post_stream_to(const std::string &endpoint, const JsonText &body,
+                      Sink &&sink, const Headers &headers = {},
+                      const CancellationToken *cancel = nullptr) {
+    SseDecoder decoder;
+    const bool ended = send_stream(
+        endpoint, body, headers, cancel,
+        [&decoder, &sink](std::string_view bytes) {
+          return decoder.feed(bytes, sink);
+        });
+    if (decoder.done()) {
+      return true;
+    }
+    if (!ended) {
+      return false;
+    }
+    // A server that closes the stream without "[DONE]" has still ended it.
+    decoder.finish(sink);
+    return true;
+  }
 
   void set_bearer_token(const std::string &token);
   void set_timeout(size_t seconds);
@@ -61,7 +110,13 @@ private:
 
   Headers prepare_headers(const Headers &custom_headers) const;
   Response make_request_with_retry(std::function<Response()> request_fn);
-  void parse_sse_stream(const std::string &data, StreamCallback callback);
+  // Sends a streaming request and passes the body of a successful
+  // response to `receive` as it arrives, until `receive` returns true.
+  // Returns false if the request failed or was cancelled before that or
+  // before the end of the body.
+  bool send_stream(const std::string &endpoint, const JsonText &body,
+                   const Headers &headers, const CancellationToken *cancel,
+                   const std::function<bool(std::string_view)> &receive);
 };
 
 } // namespace llm
\ No newline at end of file
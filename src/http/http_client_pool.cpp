@@ -0,0 +1,41 @@
+#include "http/http_client_pool.hpp"
+
+namespace llm {
+
+HttpClientPool::HttpClientPool(std::string base_url, std::string bearer_token)
+    : base_url_(std::move(base_url)), bearer_token_(std::move(bearer_token)) {}
+
+HttpClientPool::Lease::~Lease() {
+  if (client_) {
+    pool_.release(std::move(client_));
+  }
+}
+
+HttpClientPool::Lease HttpClientPool::acquire() {
+  {
+    std::lock_guard lock(mutex_);
+    if (!idle_.empty()) {
+      auto client = std::move(idle_.back());
+      idle_.pop_back();
+      return Lease(*this, std::move(client));
+    }
+  }
+  // Connecting happens on first use, outside the lock.
+  auto client = std::make_unique<HttpClient>(base_url_);
+  client->set_bearer_token(bearer_token_);
+  return Lease(*this, std::move(client));
+}
+
+size_t HttpClientPool::idle() const {
+  std::lock_guard lock(mutex_);
+  return idle_.size();
+}
+
+void HttpClientPool::release(std::unique_ptr<HttpClient> client) {
+  std::lock_guard lock(mutex_);
+  if (idle_.size() < MAX_IDLE) {
+    idle_.push_back(std::move(client));
+  }
+}
+
+} // namespace llm
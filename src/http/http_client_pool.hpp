@@ -0,0 +1,55 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "http/http_client.hpp"
+
+namespace llm {
+
+// HttpClients for one server, shared by services that may send requests at
+// the same time. An HttpClient runs one request at a time over a kept-alive
+// connection, so each request leases an idle client, or a new one when all
+// are busy, and hands it back when done for the next request to reuse.
+class HttpClientPool {
+public:
+  // Idle clients kept beyond this many are closed.
+  static constexpr size_t MAX_IDLE = 4;
+
+  HttpClientPool(std::string base_url, std::string bearer_token);
+
+  // Exclusive use of a client until destroyed.
+  class Lease {
+  public:
+    Lease(Lease &&) = default;
+    Lease &operator=(Lease &&) = delete;
+    ~Lease();
+
+    HttpClient *operator->() const { return client_.get(); }
+    HttpClient &operator*() const { return *client_; }
+
+  private:
+    friend class HttpClientPool;
+    Lease(HttpClientPool &pool, std::unique_ptr<HttpClient> client)
+        : pool_(pool), client_(std::move(client)) {}
+
+    HttpClientPool &pool_;
+    std::unique_ptr<HttpClient> client_;
+  };
+
+  Lease acquire();
+
+  size_t idle() const;
+
+private:
+  std::string base_url_;
+  std::string bearer_token_;
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<HttpClient>> idle_;
+
+  void release(std::unique_ptr<HttpClient> client);
+};
+
+} // namespace llm
@@ -0,0 +1,301 @@
+#include "http/sse_decoder.hpp"
+
+#include <cstdint>
+
+namespace llm {
+
+namespace {
+
+// Just enough of a JSON reader to walk down to one string in an event:
+// it reads the keys on the way and skips every other value without
+// building anything. Each function takes the position of the value's
+// first byte and leaves `pos` after it; false means malformed input.
+class JsonScanner {
+public:
+  explicit JsonScanner(std::string_view text) : text_(text) {}
+
+  // Positions at the value of `key` in the object that starts here.
+  bool find_key(std::string_view key) {
+    if (!consume('{')) {
+      return false;
+    }
+    skip_space();
+    if (peek() == '}') {
+      return false;
+    }
+    while (true) {
+      std::string_view name;
+      if (!raw_string(name) || !consume(':')) {
+        return false;
+      }
+      skip_space();
+      if (name == key) {
+        return true;
+      }
+      if (!skip_value() || !next_member()) {
+        return false;
+      }
+    }
+  }
+
+  // Positions at the first element of the array that starts here.
+  bool first_element() {
+    if (!consume('[')) {
+      return false;
+    }
+    skip_space();
+    return peek() != ']';
+  }
+
+  // Unescapes the string that starts here into `out`. False if the value
+  // is not a string.
+  bool string(std::string &out) {
+    if (peek() != '"') {
+      return false;
+    }
+    ++pos_;
+    out.clear();
+    while (pos_ < text_.size()) {
+      // Copy plain runs in one go.
+      size_t end = pos_;
+      while (end < text_.size() && text_[end] != '"' && text_[end] != '\\') {
+        ++end;
+      }
+      out.append(text_.substr(pos_, end - pos_));
+      pos_ = end;
+      if (pos_ == text_.size()) {
+        return false;
+      }
+      if (text_[pos_++] == '"') {
+        return true;
+      }
+      if (!escape(out)) {
+        return false;
+      }
+    }
+    return false;
+  }
+
+private:
+  std::string_view text_;
+  size_t pos_ = 0;
+
+  static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  }
+
+  char peek() const { return pos_ < text_.size() ? text_[pos_] : '\0'; }
+
+  void skip_space() {
+    while (pos_ < text_.size() && is_space(text_[pos_])) {
+      ++pos_;
+    }
+  }
+
+  bool consume(char c) {
+    skip_space();
+    if (peek() != c) {
+      return false;
+    }
+    ++pos_;
+    return true;
+  }
+
+  // After a member or element: true at ',', false at the end or on error.
+  bool next_member() {
+    skip_space();
+    if (peek() != ',') {
+      return false;
+    }
+    ++pos_;
+    skip_space();
+    return true;
+  }
+
+  // A string without unescaping; keys that need it never match.
+  bool raw_string(std::string_view &out) {
+    skip_space();
+    if (peek() != '"') {
+      return false;
+    }
+    const size_t start = ++pos_;
+    // A quote ends the string unless an odd number of backslashes
+    // precede it.
+    size_t end = text_.find('"', start);
+    while (end != std::string_view::npos) {
+      size_t slashes = 0;
+      while (end - slashes > start && text_[end - slashes - 1] == '\\') {
+        ++slashes;
+      }
+      if (slashes % 2 == 0) {
+        break;
+      }
+      end = text_.find('"', end + 1);
+    }
+    if (end == std::string_view::npos) {
+      return false;
+    }
+    out = text_.substr(start, end - start);
+    pos_ = end + 1;
+    return true;
+  }
+
+  bool skip_value(int depth = 0) {
+    skip_space();
+    std::string_view ignored;
+    switch (peek()) {
+    case '"':
+      return raw_string(ignored);
+    case '{':
+    case '[': {
+      if (depth == 64) {
+        return false;
+      }
+      const char close = peek() == '{' ? '}' : ']';
+      ++pos_;
+      skip_space();
+      if (peek() == close) {
+        ++pos_;
+        return true;
+      }
+      while (true) {
+        if (close == '}' && (!raw_string(ignored) || !consume(':'))) {
+          return false;
+        }
+        if (!skip_value(depth + 1)) {
+          return false;
+        }
+        if (!next_member()) {
+          return consume(close);
+        }
+      }
+    }
+    default: {
+      // A number or literal.
+      const size_t start = pos_;
+      while (pos_ < text_.size() && text_[pos_] != ',' && text_[pos_] != '}' &&
+             text_[pos_] != ']' && !is_space(text_[pos_])) {
+        ++pos_;
+      }
+      return pos_ > start;
+    }
+    }
+  }
+
+  bool hex4(uint32_t &value) {
+    if (text_.size() - pos_ < 4) {
+      return false;
+    }
+    value = 0;
+    for (int i = 0; i < 4; ++i) {
+      const char c = text_[pos_++];
+      value <<= 4;
+      if (c >= '0' && c <= '9') {
+        value |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        value |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        value |= c - 'A' + 10;
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // After a backslash.
+  bool escape(std::string &out) {
+    if (pos_ == text_.size()) {
+      return false;
+    }
+    switch (text_[pos_++]) {
+    case '"':
+      out += '"';
+      return true;
+    case '\\':
+      out += '\\';
+      return true;
+    case '/':
+      out += '/';
+      return true;
+    case 'b':
+      out += '\b';
+      return true;
+    case 'f':
+      out += '\f';
+      return true;
+    case 'n':
+      out += '\n';
+      return true;
+    case 'r':
+      out += '\r';
+      return true;
+    case 't':
+      out += '\t';
+      return true;
+    case 'u':
+      break;
+    default:
+      return false;
+    }
+
+    uint32_t code;
+    if (!hex4(code)) {
+      return false;
+    }
+    if (code >= 0xD800 && code < 0xDC00) {
+      uint32_t low;
+      if (text_.substr(pos_, 2) != "\\u" || (pos_ += 2, !hex4(low)) ||
+          low < 0xDC00 || low >= 0xE000) {
+        return false;
+      }
+      code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+    } else if (code >= 0xDC00 && code < 0xE000) {
+      return false;
+    }
+
+    if (code < 0x80) {
+      out += static_cast<char>(code);
+    } else if (code < 0x800) {
+      out += static_cast<char>(0xC0 | (code >> 6));
+      out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+      out += static_cast<char>(0xE0 | (code >> 12));
+      out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+      out += static_cast<char>(0xF0 | (code >> 18));
+      out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+      out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+    return true;
+  }
+};
+
+} // namespace
+
+SseDecoder::Event SseDecoder::decode(std::string_view text) {
+  if (!text.empty() && text.back() == '\r') {
+    text.remove_suffix(1);
+  }
+  if (!text.starts_with("data: ")) {
+    return Event::None;
+  }
+  text.remove_prefix(6);
+  if (text == "[DONE]") {
+    return Event::Done;
+  }
+
+  // Events without a text delta (a role, a finish reason, usage) and
+  // malformed ones are skipped.
+  JsonScanner scanner(text);
+  if (scanner.find_key("choices") && scanner.first_element() &&
+      scanner.find_key("delta") && scanner.find_key("content") &&
+      scanner.string(delta_)) {
+    return Event::Delta;
+  }
+  return Event::None;
+}
+
+} // namespace llm
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <concepts>
+#include <string>
+#include <string_view>
+
+namespace llm {
+
+// Receives each content delta of a stream. The view is only valid during
+// the call.
+template <typename F>
+concept DeltaSink = std::invocable<F &, std::string_view>;
+
+// Incremental decoder of an OpenAI-style server-sent event stream. Bytes
+// are fed as they arrive, in pieces of any size, and the sink is called
+// with the choices[0].delta.content of each event. Complete lines are
+// decoded where they lie in the input; only a line cut off at the end of a
+// piece is copied, and deltas are unescaped into a buffer that is reused,
+// so the steady state allocates nothing. The sink is a template parameter,
+// so it is called directly and can be inlined.
+class SseDecoder {
+public:
+  // Returns true once "[DONE]" has arrived; later input is ignored.
+  template <DeltaSink Sink> bool feed(std::string_view bytes, Sink &&sink) {
+    if (done_) {
+      return true;
+    }
+    size_t pos = 0;
+    if (!pending_.empty()) {
+      const size_t end = bytes.find('\n');
+      if (end == std::string_view::npos) {
+        pending_ += bytes;
+        return false;
+      }
+      pending_ += bytes.substr(0, end);
+      const bool done = line(pending_, sink);
+      pending_.clear();
+      if (done) {
+        return true;
+      }
+      pos = end + 1;
+    }
+    for (size_t end; (end = bytes.find('\n', pos)) != std::string_view::npos;
+         pos = end + 1) {
+      if (line(bytes.substr(pos, end - pos), sink)) {
+        return true;
+      }
+    }
+    pending_ += bytes.substr(pos);
+    return false;
+  }
+
+  // Ends the input: decodes a last line that had no newline. Returns
+  // done().
+  template <DeltaSink Sink> bool finish(Sink &&sink) {
+    if (!done_ && !pending_.empty()) {
+      line(pending_, sink);
+      pending_.clear();
+    }
+    return done_;
+  }
+
+  bool done() const { return done_; }
+
+private:
+  enum class Event { None, Delta, Done };
+
+  std::string pending_;
+  std::string delta_;
+  bool done_ = false;
+
+  template <typename Sink> bool line(std::string_view text, Sink &sink) {
+    switch (decode(text)) {
+    case Event::Delta:
+      sink(std::string_view(delta_));
+      return false;
+    case Event::Done:
+      done_ = true;
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  // Decodes one line; for a delta, its content is left in delta_.
+  Event decode(std::string_view text);
+};
+
+} // namespace llm
@@ -347,15 +347,21 @@ HttpClient::prepare_headers(const Headers& custom_headers) const {
 HttpClient::Response HttpClient::post(const std::string& endpoint,
                                       const nlohmann::json& data,
                                       const Headers& headers) {
+    return post(endpoint, JsonText{data.dump()}, headers);
+}
+
+HttpClient::Response HttpClient::post(const std::string& endpoint,
+                                      const JsonText& body,
+                                      const Headers& headers) {
 #ifdef _WIN32
-    auto request_fn = [this, &endpoint, &data]() -> Response {
+    auto request_fn = [this, &endpoint, &body]() -> Response {
         try {
             WinHttpClient client(base_url_);
             if (bearer_token_) {
                 client.set_bearer_token(*bearer_token_);
             }
 
-            auto response = client.post(endpoint, data.dump());
+            auto response = client.post(endpoint, body.text);
 
             if (!response.success) {
                 LOG_ERROR("HTTP Post failed with status: {}", response.status_code);
@@ -375,7 +381,7 @@ HttpClient::Response HttpClient::post(const std::string& endpoint,
 
     return make_request_with_retry(request_fn);
 #else
-    auto request_fn = [this, &endpoint, &data, &headers]() -> Response {
+    auto request_fn = [this, &endpoint, &body, &headers]() -> Response {
         auto prepared_headers = prepare_headers(headers);
         httplib::Headers httplib_headers;
         for (const auto& [key, value] : prepared_headers) {
@@ -383,9 +389,9 @@ HttpClient::Response HttpClient::post(const std::string& endpoint,
         }
 
         spdlog::debug("POST request to: {}{}", base_url_, endpoint);
-        spdlog::debug("Request body size: {} bytes", data.dump().length());
+        spdlog::debug("Request body size: {} bytes", body.text.length());
 
-        auto result = client_->Post(endpoint, httplib_headers, data.dump(),
+        auto result = client_->Post(endpoint, httplib_headers, body.text,
                                     "application/json");
 
         if (!result) {
@@ -495,63 +501,91 @@ HttpClient::post_async(const std::string& endpoint, const nlohmann::json& data,
 
 void HttpClient::post_stream(const std::string& endpoint,
                              const nlohmann::json& data,
-                             StreamCallback callback, const Headers& headers) {
+                             StreamCallback callback, const Headers& headers,
+                             const CancellationToken* cancel) {
+    const bool ended = post_stream_to(
+        endpoint, data,
+        [&callback](std::string_view delta) {
+            callback(std::string(delta), false);
+        },
+        headers, cancel);
+    if (ended) {
+        callback("", true);
+    }
+}
+
+bool HttpClient::send_stream(
+    const std::string& endpoint, const JsonText& body,
+    const Headers& headers, const CancellationToken* cancel,
+    const std::function<bool(std::string_view)>& receive) {
 #ifdef _WIN32
-    // Streaming not implemented for WinHTTP version
-    auto response = post(endpoint, data, headers);
-    if (response.success) {
-        callback(response.body, true);
+    // Streaming and cancellation not implemented for WinHTTP version
+    (void)cancel;
+    auto response = post(endpoint, body, headers);
+    if (!response.success) {
+        return false;
     }
+    receive(response.body);
+    return true;
 #else
     auto prepared_headers = prepare_headers(headers);
     prepared_headers["Accept"] = "text/event-stream";
 
-    httplib::Headers httplib_headers;
+    httplib::Request request;
+    request.method = "POST";
+    request.path = endpoint;
     for (const auto& [key, value] : prepared_headers) {
-        httplib_headers.emplace(key, value);
+        request.headers.emplace(key, value);
     }
+    request.body = body.text;
+
+    int status = 0;
+    std::string error_body;
+    bool done = false;
+    request.response_handler = [&status](const httplib::Response& response) {
+        status = response.status;
+        return true;
+    };
+    request.content_receiver = [&](const char* bytes, size_t size, uint64_t,
+                                   uint64_t) {
+        if (cancel && cancel->cancelled()) {
+            return false;
+        }
+        if (status < 200 || status >= 300) {
+            error_body.append(bytes, size);
+        } else if (!done) {
+            done = receive(std::string_view(bytes, size));
+        }
+        return true;
+    };
 
-    // Use the simple POST method without content receiver for now
-    auto result =
-        client_->Post(endpoint, httplib_headers, data.dump(), "application/json");
-    if (result) {
-        callback(result->body, true);
-    }
-#endif
-}
-
-#ifndef _WIN32
-void HttpClient::parse_sse_stream(const std::string& data,
-                                  StreamCallback callback) {
-    std::istringstream stream(data);
-    std::string line;
-    std::string event_data;
-
-    while (std::getline(stream, line)) {
-        if (line.starts_with("data: ")) {
-            event_data = line.substr(6);
-
-            if (event_data == "[DONE]") {
-                callback("", true);
-                return;
-            }
-
-            try {
-                auto json_data = nlohmann::json::parse(event_data);
-
-                if (json_data.contains("choices") &&
-                    json_data["choices"][0].contains("delta") &&
-                    json_data["choices"][0]["delta"].contains("content")) {
-                    std::string content = json_data["choices"][0]["delta"]["content"];
-                    callback(content, false);
-                }
-            } catch (const nlohmann::json::exception& e) {
-                spdlog::debug("Failed to parse SSE JSON: {}", e.what());
-            }
+    spdlog::debug("Streaming POST request to: {}{}", base_url_, endpoint);
+    auto result = [&] {
+        // The receiver only sees a cancel with the next chunk; shutting the
+        // socket down also ends a read that is waiting for one.
+        std::optional<CancelWatch> watch;
+        if (cancel) {
+            watch.emplace(*cancel, [this] { client_->stop(); });
         }
+        return client_->send(request);
+    }();
+
+    if (cancel && cancel->cancelled()) {
+        spdlog::debug("Streaming request to {}{} cancelled", base_url_, endpoint);
+        return done;
     }
-}
+    if (!result) {
+        spdlog::error("Connection failed to {}{}: {}", base_url_, endpoint,
+                      httplib::to_string(result.error()));
+        return done;
+    }
+    if (status < 200 || status >= 300) {
+        spdlog::error("HTTP {}: {}", status, error_body);
+        return false;
+    }
+    return true;
 #endif
+}
 
 HttpClient::Response
 HttpClient::make_request_with_retry(std::function<Response()> request_fn) {
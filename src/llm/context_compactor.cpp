@@ -0,0 +1,113 @@
+#include "llm/context_compactor.hpp"
+
+#include <chrono>
+#include <thread>
+
+#include "utils/logger.hpp"
+
+namespace llm {
+
+ContextCompactor::ContextCompactor(std::shared_ptr<LLMService> summarizer,
+                                   double threshold)
+    : summarizer_(std::move(summarizer)), threshold_(threshold) {
+  if (summarizer_) {
+    summarizer_->set_max_tokens(SUMMARY_MAX_TOKENS);
+  }
+}
+
+bool ContextCompactor::maybe_start(const Conversation &conversation,
+                                   size_t budget) {
+  if (!summarizer_ || threshold_ <= 0.0 || busy() ||
+      conversation.turn_count() < retry_at_turns_) {
+    return false;
+  }
+  if (static_cast<double>(conversation.estimate_tokens()) <
+      threshold_ * static_cast<double>(budget)) {
+    return false;
+  }
+
+  auto turns = static_cast<size_t>(
+      static_cast<double>(conversation.turn_count()) * SPAN_FRACTION);
+  if (turns < MIN_SPAN_TURNS) {
+    return false;
+  }
+
+  span_ = conversation.oldest_turns(turns);
+  spdlog::debug("Summarizing the oldest {} turns in the background", turns);
+
+  // Detached like Conversation's recount: shutting down must not wait for
+  // the summarizer's HTTP request. The task owns everything it touches.
+  std::packaged_task<CompletionResponse()> task(
+      [summarizer = summarizer_, request = summary_request(span_)]() {
+        try {
+          return summarizer->complete(request);
+        } catch (const std::exception &e) {
+          CompletionResponse failure;
+          failure.success = false;
+          failure.error = e.what();
+          return failure;
+        }
+      });
+  result_ = task.get_future();
+  std::thread(std::move(task)).detach();
+  return true;
+}
+
+bool ContextCompactor::apply_ready(Conversation &conversation) {
+  if (!busy() ||
+      result_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    return false;
+  }
+
+  auto response = result_.get();
+  if (!response.success || response.content.empty()) {
+    spdlog::warn("Context summarization failed: {}", response.error);
+    retry_at_turns_ = conversation.turn_count() + MIN_SPAN_TURNS;
+    return false;
+  }
+
+  if (!conversation.replace_with_summary(span_, response.content)) {
+    spdlog::debug("Dropping summary of turns no longer in the conversation");
+    return false;
+  }
+
+  spdlog::debug("Replaced {} turns with a summary; context now {} tokens",
+                span_.messages.size(), conversation.estimate_tokens());
+  span_ = {};
+  return true;
+}
+
+void ContextCompactor::wait() const {
+  if (busy()) {
+    result_.wait();
+  }
+}
+
+Conversation ContextCompactor::summary_request(const Conversation::Span &span) {
+  std::string transcript;
+  for (const auto &msg : span.messages) {
+    switch (msg.role) {
+    case MessageRole::System:
+      transcript += "[Context] ";
+      break;
+    case MessageRole::User:
+      transcript += "User: ";
+      break;
+    case MessageRole::Assistant:
+      transcript += "Assistant: ";
+      break;
+    }
+    transcript += msg.content + "\n\n";
+  }
+
+  Conversation request;
+  request.add_system(
+      "Summarize the following conversation excerpt so it can replace the "
+      "original in a chat history. Keep facts, decisions, names, numbers, "
+      "code identifiers and open questions; drop pleasantries. Reply with the "
+      "summary only.");
+  request.add_user(transcript);
+  return request;
+}
+
+} // namespace llm
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "llm/llm_service.hpp"
+#include "models/conversation.hpp"
+
+namespace llm {
+
+// Keeps long conversations inside the model's window by summarizing their
+// oldest turns with a separate (cheap) model on a worker thread. The REPL
+// polls it between requests: start() and apply_ready() never wait for the
+// summarizer, so compaction stays off the interactive path.
+class ContextCompactor {
+public:
+  // Share of the conversation's turns, oldest first, summarized at once.
+  static constexpr double SPAN_FRACTION = 0.5;
+  // Spans shorter than this are not worth a request.
+  static constexpr size_t MIN_SPAN_TURNS = 4;
+  static constexpr size_t SUMMARY_MAX_TOKENS = 512;
+
+  // `threshold` is the fraction of the token budget at which compaction
+  // starts; 0 disables it.
+  ContextCompactor(std::shared_ptr<LLMService> summarizer, double threshold);
+
+  // Starts summarizing if `conversation` uses more than the threshold of
+  // `budget` tokens and no summary is in flight. Returns true if started.
+  bool maybe_start(const Conversation &conversation, size_t budget);
+
+  // Applies a finished summary to `conversation`. Returns true if the
+  // summarized turns were replaced; a summary whose turns are gone (after
+  // /clear or /load) or a failed request is dropped.
+  bool apply_ready(Conversation &conversation);
+
+  bool busy() const { return result_.valid(); }
+
+  // Blocks until the summary in flight, if any, has finished.
+  void wait() const;
+
+  // Builds the request sent to the summarizer for `span`.
+  static Conversation summary_request(const Conversation::Span &span);
+
+private:
+  std::shared_ptr<LLMService> summarizer_;
+  double threshold_;
+  Conversation::Span span_;
+  std::future<CompletionResponse> result_;
+  // After a failure, wait for this many turns before retrying.
+  size_t retry_at_turns_ = 0;
+};
+
+} // namespace llm
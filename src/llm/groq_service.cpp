@@ -6,15 +6,15 @@
 namespace llm {
 
 const std::vector<ModelInfo> GroqService::AVAILABLE_MODELS = {
-    {"llama-3.3-70b-versatile", "Llama 3.3 70B", 131072, true},
-    {"llama-3.1-70b-versatile", "Llama 3.1 70B", 131072, true},
-    {"llama-3.1-8b-instant", "Llama 3.1 8B", 131072, true},
-    {"mixtral-8x7b-32768", "Mixtral 8x7B", 32768, true},
-    {"gemma2-9b-it", "Gemma 2 9B", 8192, true}};
+    {"llama-3.3-70b-versatile", "Llama 3.3 70B", 131072, true, "llama3"},
+    {"llama-3.1-70b-versatile", "Llama 3.1 70B", 131072, true, "llama3"},
+    {"llama-3.1-8b-instant", "Llama 3.1 8B", 131072, true, "llama3"},
+    {"mixtral-8x7b-32768", "Mixtral 8x7B", 32768, true, "mistral"},
+    {"gemma2-9b-it", "Gemma 2 9B", 8192, true, "gemma"}};
 
 GroqService::GroqService(const std::string &api_key,
                          const std::string &base_url)
-    : api_key_(api_key) {
+    : GroqService(std::make_shared<HttpClientPool>(base_url, api_key)) {
   spdlog::debug("Initializing GroqService...");
   spdlog::debug("API URL: {}", base_url);
   spdlog::debug("API Key: {} (length: {})",
@@ -23,9 +23,13 @@ GroqService::GroqService(const std::string &api_key,
   if (api_key.empty()) {
     spdlog::error("API Key is EMPTY!");
   }
+}
 
-  http_client_ = std::make_unique<HttpClient>(base_url);
-  http_client_->set_bearer_token(api_key_);
+GroqService::GroqService(std::shared_ptr<HttpClientPool> pool,
+                         std::shared_ptr<ResponseCache> cache,
+                         std::shared_ptr<RateLimiter> limiter)
+    : pool_(std::move(pool)), cache_(std::move(cache)),
+      limiter_(std::move(limiter)) {
   current_model_ = "llama-3.3-70b-versatile";
 
   spdlog::debug("Default model set to: {}", current_model_);
@@ -33,23 +37,42 @@ GroqService::GroqService(const std::string &api_key,
 
 std::future<CompletionResponse>
 GroqService::complete_async(const Conversation &conversation) {
+  // The copy is an O(1) snapshot that shares the messages, so the REPL can
+  // keep appending while the request is in flight.
   return std::async(std::launch::async,
                     [this, conversation]() { return complete(conversation); });
 }
 
 CompletionResponse GroqService::complete(const Conversation &conversation) {
   spdlog::debug("Preparing completion request...");
-  auto request_data = prepare_request(conversation);
+  ResponseCache *cache = this->cache();
+  std::string key;
+  auto request_data =
+      prepare_request(conversation, false, cache ? &key : nullptr);
+  if (cache) {
+    if (auto content = cache->find(key)) {
+      spdlog::debug("Answered from the response cache");
+      return CompletionResponse{std::move(*content), true, "", 0,
+                                current_model_};
+    }
+  }
+  if (limiter_) {
+    limiter_->acquire();
+  }
 
   spdlog::debug("Sending POST to /chat/completions...");
-  auto response = http_client_->post("/chat/completions", request_data);
+  auto response = pool_->acquire()->post("/chat/completions", request_data);
 
   spdlog::debug("Response received - Status: {}", response.status_code);
   if (!response.success) {
     spdlog::error("Request failed: {}", response.error);
   }
 
-  return parse_response(response);
+  auto result = parse_response(response);
+  if (cache && result.success) {
+    cache->insert(key, result.content);
+  }
+  return result;
 }
 
 CompletionResponse GroqService::complete(const std::string &prompt) {
@@ -63,12 +86,13 @@ CompletionResponse GroqService::complete(const std::string &prompt) {
 
 void GroqService::stream_complete(const Conversation &conversation,
                                   StreamCallback callback) {
-  auto request_data = prepare_request(conversation, true);
+  stream(conversation, std::move(callback), nullptr);
+}
 
-  http_client_->post_stream("/chat/completions", request_data,
-                            [callback](const std::string &chunk, bool is_done) {
-                              callback(chunk, is_done);
-                            });
+void GroqService::stream_complete(const Conversation &conversation,
+                                  StreamCallback callback,
+                                  const CancellationToken &cancel) {
+  stream(conversation, std::move(callback), &cancel);
 }
 
 void GroqService::stream_complete(const std::string &prompt,
@@ -81,6 +105,21 @@ void GroqService::stream_complete(const std::string &prompt,
   stream_complete(conv, callback);
 }
 
+void GroqService::stream(const Conversation &conversation,
+                         StreamCallback callback,
+                         const CancellationToken *cancel) {
+  std::string reply;
+  const bool finished = stream_to(
+      conversation,
+      [&callback](std::string_view delta) {
+        callback(std::string(delta), false);
+      },
+      reply, cancel);
+  if (finished) {
+    callback("", true);
+  }
+}
+
 std::vector<ModelInfo> GroqService::get_available_models() {
   return AVAILABLE_MODELS;
 }
@@ -113,15 +152,31 @@ bool GroqService::is_available() {
   return true;
 }
 
-nlohmann::json GroqService::prepare_request(const Conversation &conversation,
-                                            bool stream) {
-  nlohmann::json request;
-  request["model"] = current_model_;
-  request["messages"] = conversation.to_json();
-  request["temperature"] = temperature_;
-  request["max_tokens"] = max_tokens_;
-  request["stream"] = stream;
+std::string GroqService::request_key(const Conversation &conversation) const {
+  nlohmann::json settings;
+  settings["model"] = current_model_;
+  settings["temperature"] = temperature_;
+  settings["max_tokens"] = max_tokens_;
+
+  // The messages array is assembled from each message's cached fragment
+  // and spliced in as text, so a request only serializes turns that were
+  // added since the fragments were built.
+  std::string text = settings.dump();
+  text.pop_back();
+  text += R"(,"messages":)";
+  text += conversation.serialize_messages();
+  text += '}';
+  return text;
+}
 
+JsonText GroqService::prepare_request(const Conversation &conversation,
+                                      bool stream, std::string *key) {
+  JsonText request{request_key(conversation)};
+  if (key) {
+    *key = request.text;
+  }
+  request.text.pop_back();
+  request.text += stream ? R"(,"stream":true})" : R"(,"stream":false})";
   return request;
 }
 
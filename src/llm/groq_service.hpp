@@ -1,9 +1,14 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <string_view>
 
-#include "http/http_client.hpp"
+#include "http/http_client_pool.hpp"
 #include "llm/llm_service.hpp"
+#include "llm/rate_limiter.hpp"
+#include "llm/response_cache.hpp"
+#include "utils/logger.hpp"
 
 namespace llm {
 
@@ -13,6 +18,16 @@ public:
       const std::string &api_key,
       const std::string &base_url = "https://api.groq.com/openai/v1");
 
+  // Sends requests over connections from `pool`, answering repeated ones
+  // from `cache` and pacing the others through `limiter`. Services built
+  // on the same pool, cache and limiter share all three; either of the
+  // last two may be null. Only requests at temperature 0 use the cache:
+  // at any other temperature a reply is one sample of many, and asking
+  // again should draw another.
+  GroqService(std::shared_ptr<HttpClientPool> pool,
+              std::shared_ptr<ResponseCache> cache = nullptr,
+              std::shared_ptr<RateLimiter> limiter = nullptr);
+
   std::future<CompletionResponse>
   complete_async(const Conversation &conversation) override;
 
@@ -26,6 +41,18 @@ public:
   void stream_complete(const std::string &prompt,
                        StreamCallback callback) override;
 
+  void stream_complete(const Conversation &conversation,
+                       StreamCallback callback,
+                       const CancellationToken &cancel) override;
+
+  // The streaming path without type erasure: each delta goes to `sink`
+  // as a view, and the reply is accumulated in `reply`, which is cleared
+  // first and can be reused across requests to keep its capacity. Returns
+  // true if the reply streamed to the end; `cancel` may be null.
+  template <DeltaSink Sink>
+  bool stream_to(const Conversation &conversation, Sink &&sink,
+                 std::string &reply, const CancellationToken *cancel = nullptr);
+
   std::vector<ModelInfo> get_available_models() override;
 
   void set_model(const std::string &model_id) override;
@@ -37,15 +64,64 @@ public:
 
   bool is_available() override;
 
-private:
-  std::unique_ptr<HttpClient> http_client_;
-  std::string api_key_;
+  // Identifies a request for `conversation` with the current settings: its
+  // body without the stream flag, so streamed and plain requests share
+  // replies. The response cache and the gateway's shared streams key on it.
+  std::string request_key(const Conversation &conversation) const;
 
-  nlohmann::json prepare_request(const Conversation &conversation,
-                                 bool stream = false);
+private:
+  std::shared_ptr<HttpClientPool> pool_;
+  std::shared_ptr<ResponseCache> cache_;
+  std::shared_ptr<RateLimiter> limiter_;
+
+  void stream(const Conversation &conversation, StreamCallback callback,
+              const CancellationToken *cancel);
+  // The cache for requests with the current settings, or null.
+  ResponseCache *cache() const {
+    return temperature_ == 0.0f ? cache_.get() : nullptr;
+  }
+  // The request body for `conversation`. If `key` is not null it receives
+  // request_key(conversation).
+  JsonText prepare_request(const Conversation &conversation, bool stream,
+                           std::string *key = nullptr);
   CompletionResponse parse_response(const HttpClient::Response &response);
 
   static const std::vector<ModelInfo> AVAILABLE_MODELS;
 };
 
+template <DeltaSink Sink>
+bool GroqService::stream_to(const Conversation &conversation, Sink &&sink,
+                            std::string &reply,
+                            const CancellationToken *cancel) {
+  reply.clear();
+  ResponseCache *cache = this->cache();
+  std::string key;
+  auto request_data =
+      prepare_request(conversation, true, cache ? &key : nullptr);
+  if (cache) {
+    if (auto content = cache->find(key)) {
+      spdlog::debug("Answered from the response cache");
+      reply = std::move(*content);
+      sink(std::string_view(reply));
+      return true;
+    }
+  }
+  if (limiter_ && !limiter_->acquire(cancel)) {
+    return false;
+  }
+
+  const bool finished = pool_->acquire()->post_stream_to(
+      "/chat/completions", request_data,
+      [&reply, &sink](std::string_view delta) {
+        reply += delta;
+        sink(delta);
+      },
+      {}, cancel);
+  // Only a reply that streamed to the end is cached.
+  if (cache && finished && !reply.empty()) {
+    cache->insert(key, reply);
+  }
+  return finished;
+}
+
 } // namespace llm
\ No newline at end of file
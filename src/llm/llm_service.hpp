@@ -8,6 +8,7 @@
 
 #include "models/conversation.hpp"
 #include "models/message.hpp"
+#include "utils/cancellation.hpp"
 
 namespace llm {
 
@@ -24,6 +25,7 @@ struct ModelInfo {
   std::string name;
   size_t context_length;
   bool supports_streaming;
+  std::string tokenizer = "";
 };
 
 using StreamCallback =
@@ -46,6 +48,16 @@ public:
   virtual void stream_complete(const std::string &prompt,
                                StreamCallback callback) = 0;
 
+  // Like stream_complete(), but gives up as soon as `cancel` fires, keeping
+  // whatever was already passed to `callback`. Services that cannot abort
+  // a request run it to the end.
+  virtual void stream_complete(const Conversation &conversation,
+                               StreamCallback callback,
+                               const CancellationToken &cancel) {
+    (void)cancel;
+    stream_complete(conversation, std::move(callback));
+  }
+
   virtual std::vector<ModelInfo> get_available_models() = 0;
 
   virtual void set_model(const std::string &model_id) = 0;
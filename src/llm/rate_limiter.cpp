@@ -0,0 +1,40 @@
+#include "llm/rate_limiter.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace llm {
+
+RateLimiter::RateLimiter(unsigned per_minute, unsigned burst)
+    : interval_(std::chrono::duration_cast<Clock::duration>(
+          std::chrono::minutes(1)) /
+                std::max(per_minute, 1u)),
+      tolerance_(interval_ * (std::max(burst, 1u) - 1)),
+      next_(Clock::now()) {}
+
+bool RateLimiter::acquire(const CancellationToken *cancel) {
+  Clock::time_point start;
+  {
+    std::lock_guard lock(mutex_);
+    const auto now = Clock::now();
+    // Generic cell rate algorithm: each request moves the schedule one
+    // interval on, and may start once the schedule is no more than the
+    // tolerance ahead of the clock.
+    const auto scheduled = std::max(next_, now);
+    start = std::max(scheduled - tolerance_, now);
+    next_ = scheduled + interval_;
+  }
+
+  const auto wait = std::chrono::ceil<std::chrono::milliseconds>(
+      start - Clock::now());
+  if (wait.count() <= 0) {
+    return !cancel || !cancel->cancelled();
+  }
+  if (cancel) {
+    return !cancel->wait_for(wait);
+  }
+  std::this_thread::sleep_for(wait);
+  return true;
+}
+
+} // namespace llm
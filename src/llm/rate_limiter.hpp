@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+
+#include "utils/cancellation.hpp"
+
+namespace llm {
+
+// Spaces requests out to at most `per_minute` a minute, letting up to
+// `burst` through back to back after a quiet spell. One limiter is shared
+// by every service talking to the same API, so concurrent sessions stay
+// within the provider's quota together rather than each on its own.
+class RateLimiter {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  RateLimiter(unsigned per_minute, unsigned burst = 1);
+
+  // Waits until the next request may be sent. Returns false if `cancel`
+  // fires first; the slot is spent either way.
+  bool acquire(const CancellationToken *cancel = nullptr);
+
+private:
+  Clock::duration interval_;
+  // How far ahead of now the schedule may run before requests wait.
+  Clock::duration tolerance_;
+  std::mutex mutex_;
+  // When the slot after the last one handed out starts.
+  Clock::time_point next_;
+};
+
+} // namespace llm
@@ -0,0 +1,40 @@
+#include "llm/response_cache.hpp"
+
+namespace llm {
+
+std::optional<std::string> ResponseCache::find(std::string_view request) {
+  const auto key = ContentHash::of(request);
+  std::lock_guard lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    return std::nullopt;
+  }
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->second;
+}
+
+void ResponseCache::insert(std::string_view request, std::string reply) {
+  if (capacity_ == 0) {
+    return;
+  }
+  const auto key = ContentHash::of(request);
+  std::lock_guard lock(mutex_);
+  if (auto it = index_.find(key); it != index_.end()) {
+    it->second->second = std::move(reply);
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return;
+  }
+  if (entries_.size() == capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+  entries_.emplace_front(key, std::move(reply));
+  index_.emplace(key, entries_.begin());
+}
+
+size_t ResponseCache::size() const {
+  std::lock_guard lock(mutex_);
+  return entries_.size();
+}
+
+} // namespace llm
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "models/blob_store.hpp"
+
+namespace llm {
+
+// Replies to recent requests, keyed by a hash of the request body (model,
+// messages and sampling settings), so sending the same request again -
+// from another session, say - is answered without a round trip. Keeps at
+// most `capacity` replies, dropping the least recently used. Thread-safe.
+class ResponseCache {
+public:
+  explicit ResponseCache(size_t capacity) : capacity_(capacity) {}
+
+  std::optional<std::string> find(std::string_view request);
+  void insert(std::string_view request, std::string reply);
+
+  size_t size() const;
+
+private:
+  using Entry = std::pair<ContentHash, std::string>;
+
+  size_t capacity_;
+  mutable std::mutex mutex_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  std::unordered_map<ContentHash, std::list<Entry>::iterator,
+                     ContentHash::Hasher>
+      index_;
+};
+
+} // namespace llm
@@ -1,17 +1,63 @@
 #include "utils/logger.hpp"
 #include <CLI/CLI.hpp>
+#include <csignal>
 #include <iostream>
+#include <iterator>
 #include <memory>
 
+#include "daemon/daemon.hpp"
+#include "daemon/daemon_client.hpp"
+#include "gateway/gateway.hpp"
 #include "llm/groq_service.hpp"
 #include "repl/repl.hpp"
+#include "search/search_index.hpp"
 #include "utils/config.hpp"
 #include "utils/logger.hpp"
 
-int main(int argc, char *argv[]) {
-  // Initialize logger
-  llm::Logger::init();
+namespace {
+
+llm::Daemon *running_daemon = nullptr;
+
+void stop_daemon(int) {
+  if (running_daemon) {
+    running_daemon->stop();
+  }
+}
+
+llm::Gateway *running_gateway = nullptr;
+
+void stop_gateway(int) {
+  if (running_gateway) {
+    running_gateway->stop();
+  }
+}
+
+void print_delta(std::string_view delta) { std::cout << delta << std::flush; }
+
+// Answers a one-shot --ask without a daemon.
+int ask_in_process(const llm::Config &config, const llm::AskRequest &request) {
+  auto provider_config = config.get_provider_config(config.get_provider());
+  llm::GroqService service(config.get_api_key(), provider_config.api_url);
+  service.set_model(provider_config.model);
+  service.set_temperature(provider_config.temperature);
+  service.set_max_tokens(provider_config.max_tokens);
+
+  llm::Conversation conversation;
+  conversation.set_system_prompt(config.get_repl_config().system_prompt);
+  conversation.add_user(request.prompt);
+  std::string reply;
+  const bool finished = service.stream_to(conversation, print_delta, reply);
+  std::cout << std::endl;
+  if (!finished) {
+    std::cerr << "Error: request failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+} // namespace
 
+int main(int argc, char *argv[]) {
   CLI::App app{"LLM REPL - Interactive AI Chat Terminal"};
 
   std::string config_file = "config.json";
@@ -22,6 +68,12 @@ int main(int argc, char *argv[]) {
   size_t max_tokens = 0;
   bool verbose = false;
   bool version = false;
+  std::string search_query;
+  std::string ask_prompt;
+  std::string ask_session;
+  bool run_daemon = false;
+  bool serve = false;
+  int port = -1;
 
   app.add_option("-c,--config", config_file, "Configuration file path")
       ->default_val("config.json");
@@ -34,15 +86,26 @@ int main(int argc, char *argv[]) {
   app.add_option("--max-tokens", max_tokens, "Maximum tokens to generate");
   app.add_flag("-v,--verbose", verbose, "Enable verbose logging");
   app.add_flag("--version", version, "Show version information");
+  app.add_option("--search", search_query,
+                 "Search saved conversations and past sessions, then exit");
+  app.add_option("--ask", ask_prompt,
+                 "Print the reply to a prompt ('-' reads it from stdin), "
+                 "then exit");
+  app.add_option("--session", ask_session,
+                 "With --ask, continue this conversation kept by the daemon");
+  app.add_flag("--daemon", run_daemon,
+               "Serve --ask requests from a long-lived process");
+  app.add_flag("--serve", serve,
+               "Serve an OpenAI-compatible API on a local port");
+  app.add_option("--port", port, "With --serve, the port to listen on");
 
   CLI11_PARSE(app, argc, argv);
 
-  // Set log level based on verbose flag
+  // Initialize logger with color output to stdout
+  llm::Logger::init(verbose, verbose ? "llm-repl.log" : "");
+
   if (verbose) {
-    llm::Logger::set_level(spdlog::level::debug);
-    LOG_INFO("Verbose logging enabled");
-  } else {
-    llm::Logger::set_level(spdlog::level::info);
+    spdlog::debug("Verbose mode enabled");
   }
 
   if (version) {
@@ -52,13 +115,6 @@ int main(int argc, char *argv[]) {
     return 0;
   }
 
-  // Initialize logger with color output to stdout
-  llm::Logger::init(verbose, verbose ? "llm-repl.log" : "");
-
-  if (verbose) {
-    spdlog::debug("Verbose mode enabled");
-  }
-
   try {
     auto config = std::make_unique<llm::Config>(config_file);
 
@@ -74,6 +130,42 @@ int main(int argc, char *argv[]) {
 
     config->merge_command_line_args(cli_args);
 
+    if (!search_query.empty()) {
+      const std::string &index_path = config->get_repl_config().search_index;
+      llm::SearchIndex index;
+      if (index_path.empty() || !index.load(config->expand_path(index_path))) {
+        std::cerr << "No search index found." << std::endl;
+        return 1;
+      }
+      index.refresh();
+      for (const auto &hit : index.search(search_query)) {
+        std::cout << hit.location() << std::endl;
+        std::cout << "  " << hit.snippet << std::endl;
+      }
+      return 0;
+    }
+
+    const std::string &daemon_socket = config->get_repl_config().daemon_socket;
+    const std::string socket_path =
+        daemon_socket.empty() ? "" : config->expand_path(daemon_socket);
+
+    llm::AskRequest request{ask_session, model, ask_prompt};
+    if (request.prompt == "-") {
+      request.prompt.assign(std::istreambuf_iterator<char>(std::cin), {});
+    }
+    if (!request.prompt.empty() && !socket_path.empty()) {
+      // A running daemon has the key, a warm connection and the session.
+      if (auto client = llm::DaemonClient::connect(socket_path)) {
+        auto response = client->ask(request, print_delta);
+        std::cout << std::endl;
+        if (!response.success) {
+          std::cerr << "Error: " << response.error << std::endl;
+          return 1;
+        }
+        return 0;
+      }
+    }
+
     if (config->get_api_key().empty() && config->get_provider() != "ollama") {
       std::cerr << "Error: API key is required for " << config->get_provider()
                 << std::endl;
@@ -85,6 +177,56 @@ int main(int argc, char *argv[]) {
       return 1;
     }
 
+    if (run_daemon) {
+      if (socket_path.empty()) {
+        std::cerr << "Error: repl.daemon_socket is not set" << std::endl;
+        return 1;
+      }
+      llm::Daemon daemon(std::move(config));
+      if (!daemon.listen(socket_path)) {
+        std::cerr << "Error: cannot listen on " << socket_path
+                  << " (is a daemon already running?)" << std::endl;
+        return 1;
+      }
+      running_daemon = &daemon;
+      std::signal(SIGINT, stop_daemon);
+      std::signal(SIGTERM, stop_daemon);
+      daemon.run();
+      running_daemon = nullptr;
+      return 0;
+    }
+
+    if (serve) {
+      if (port < 0) {
+        port = config->get_repl_config().gateway_port;
+      }
+      if (port > 65535) {
+        std::cerr << "Error: invalid port " << port << std::endl;
+        return 1;
+      }
+      llm::Gateway gateway(std::move(config));
+      if (!gateway.listen(static_cast<uint16_t>(port))) {
+        std::cerr << "Error: cannot listen on 127.0.0.1:" << port << std::endl;
+        return 1;
+      }
+      std::cout << "Serving http://127.0.0.1:" << gateway.port() << "/v1"
+                << std::endl;
+      running_gateway = &gateway;
+      std::signal(SIGINT, stop_gateway);
+      std::signal(SIGTERM, stop_gateway);
+      gateway.run();
+      running_gateway = nullptr;
+      return 0;
+    }
+
+    if (!request.prompt.empty()) {
+      if (!request.session.empty()) {
+        std::cerr << "No daemon running; answering without session '"
+                  << request.session << "'." << std::endl;
+      }
+      return ask_in_process(*config, request);
+    }
+
     auto repl = std::make_unique<llm::REPL>(std::move(config));
 
     spdlog::info("Starting LLM REPL...");
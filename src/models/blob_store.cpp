@@ -0,0 +1,301 @@
+#include "models/blob_store.hpp"
+
+#include <cerrno>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "utils/durable_file.hpp"
+#include "utils/logger.hpp"
+
+namespace llm {
+
+namespace {
+
+constexpr uint64_t C1 = 0x87c37b91114253d5ULL;
+constexpr uint64_t C2 = 0x4cf5ad432745937fULL;
+
+#ifdef _WIN32
+int open_lock_file(const std::string &path) {
+  return ::_open(path.c_str(), _O_RDONLY | _O_CREAT | _O_BINARY,
+                 _S_IREAD | _S_IWRITE);
+}
+void close_lock_file(int fd) { ::_close(fd); }
+bool lock_file(int fd, bool exclusive) {
+  OVERLAPPED overlapped{};
+  return LockFileEx(reinterpret_cast<HANDLE>(::_get_osfhandle(fd)),
+                    exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, MAXDWORD,
+                    MAXDWORD, &overlapped) != 0;
+}
+#else
+int open_lock_file(const std::string &path) {
+  return ::open(path.c_str(), O_RDONLY | O_CREAT | O_CLOEXEC, 0600);
+}
+void close_lock_file(int fd) { ::close(fd); }
+bool lock_file(int fd, bool exclusive) {
+  int result;
+  do {
+    result = ::flock(fd, exclusive ? LOCK_EX : LOCK_SH);
+  } while (result != 0 && errno == EINTR);
+  return result == 0;
+}
+#endif
+
+uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+uint64_t fmix(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+uint64_t load_u64(const unsigned char *p) {
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; --i) {
+    value = (value << 8) | p[i];
+  }
+  return value;
+}
+
+int hex_digit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+} // namespace
+
+ContentHash ContentHash::of(std::string_view bytes) {
+  const auto *data = reinterpret_cast<const unsigned char *>(bytes.data());
+  const size_t size = bytes.size();
+  uint64_t h1 = 0;
+  uint64_t h2 = 0;
+
+  const size_t blocks = size / 16;
+  for (size_t i = 0; i < blocks; ++i) {
+    uint64_t k1 = load_u64(data + i * 16);
+    uint64_t k2 = load_u64(data + i * 16 + 8);
+
+    k1 *= C1;
+    k1 = rotl(k1, 31);
+    k1 *= C2;
+    h1 ^= k1;
+    h1 = rotl(h1, 27);
+    h1 += h2;
+    h1 = h1 * 5 + 0x52dce729;
+
+    k2 *= C2;
+    k2 = rotl(k2, 33);
+    k2 *= C1;
+    h2 ^= k2;
+    h2 = rotl(h2, 31);
+    h2 += h1;
+    h2 = h2 * 5 + 0x38495ab5;
+  }
+
+  const unsigned char *tail = data + blocks * 16;
+  const size_t rest = size & 15;
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+  for (size_t i = 0; i < rest; ++i) {
+    if (i < 8) {
+      k1 |= static_cast<uint64_t>(tail[i]) << (8 * i);
+    } else {
+      k2 |= static_cast<uint64_t>(tail[i]) << (8 * (i - 8));
+    }
+  }
+  if (rest > 8) {
+    k2 *= C2;
+    k2 = rotl(k2, 33);
+    k2 *= C1;
+    h2 ^= k2;
+  }
+  if (rest > 0) {
+    k1 *= C1;
+    k1 = rotl(k1, 31);
+    k1 *= C2;
+    h1 ^= k1;
+  }
+
+  h1 ^= size;
+  h2 ^= size;
+  h1 += h2;
+  h2 += h1;
+  h1 = fmix(h1);
+  h2 = fmix(h2);
+  h1 += h2;
+  h2 += h1;
+  return {h1, h2};
+}
+
+std::optional<ContentHash> ContentHash::from_hex(std::string_view hex) {
+  if (hex.size() != 32) {
+    return std::nullopt;
+  }
+  ContentHash hash;
+  for (size_t i = 0; i < 32; ++i) {
+    int digit = hex_digit(hex[i]);
+    if (digit < 0) {
+      return std::nullopt;
+    }
+    uint64_t &half = i < 16 ? hash.high : hash.low;
+    half = (half << 4) | static_cast<uint64_t>(digit);
+  }
+  return hash;
+}
+
+std::string ContentHash::hex() const {
+  static constexpr char DIGITS[] = "0123456789abcdef";
+  std::string out(32, '0');
+  for (int i = 0; i < 16; ++i) {
+    out[15 - i] = DIGITS[(high >> (4 * i)) & 0xF];
+    out[31 - i] = DIGITS[(low >> (4 * i)) & 0xF];
+  }
+  return out;
+}
+
+BlobStore::BlobStore(std::string root) : root_(std::move(root)) {}
+
+std::string BlobStore::path_of(const ContentHash &hash) const {
+  std::string hex = hash.hex();
+  return (std::filesystem::path(root_) / hex.substr(0, 2) / hex.substr(2))
+      .string();
+}
+
+int BlobStore::lock(bool exclusive) const {
+  std::error_code ec;
+  std::filesystem::create_directories(root_, ec);
+  int fd = open_lock_file(
+      (std::filesystem::path(root_) / LOCK_FILE).string());
+  if (fd < 0) {
+    return -1;
+  }
+  if (!lock_file(fd, exclusive)) {
+    close_lock_file(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool BlobStore::put(const ContentHash &hash, std::string_view bytes) {
+  // Checked on disk every time: another process may have collected it.
+  int fd = lock(false);
+  if (fd < 0) {
+    return false;
+  }
+  if (contains(hash)) {
+    close_lock_file(fd);
+    return true;
+  }
+
+  // Two writers racing on the same blob both succeed: each renames
+  // identical bytes into place.
+  std::string path = path_of(hash);
+  std::error_code ec;
+  std::filesystem::create_directories(std::filesystem::path(path).parent_path(),
+                                      ec);
+  bool ok = write_file_durably(path, bytes);
+  close_lock_file(fd);
+  if (!ok) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> guard(mutex_);
+  ++written_;
+  return true;
+}
+
+std::optional<ContentHash> BlobStore::put(std::string_view bytes) {
+  ContentHash hash = ContentHash::of(bytes);
+  if (!put(hash, bytes)) {
+    return std::nullopt;
+  }
+  return hash;
+}
+
+bool BlobStore::contains(const ContentHash &hash) const {
+  std::error_code ec;
+  return std::filesystem::exists(path_of(hash), ec);
+}
+
+std::optional<std::string> BlobStore::get(const ContentHash &hash) const {
+  std::ifstream file(path_of(hash), std::ios::binary);
+  if (!file) {
+    return std::nullopt;
+  }
+  std::string bytes((std::istreambuf_iterator<char>(file)),
+                    std::istreambuf_iterator<char>());
+  if (file.bad()) {
+    return std::nullopt;
+  }
+  return bytes;
+}
+
+bool BlobStore::erase(const ContentHash &hash) {
+  std::error_code ec;
+  return std::filesystem::remove(path_of(hash), ec);
+}
+
+size_t BlobStore::collect(
+    const std::function<bool(const ContentHash &)> &keep) {
+  // Waits for puts in progress in every process, and keeps new ones out.
+  int fd = lock(true);
+  if (fd < 0) {
+    spdlog::warn("Cannot lock blob store {}; not collecting", root_);
+    return 0;
+  }
+  size_t deleted = 0;
+  for (const auto &hash : list()) {
+    if (!keep(hash) && erase(hash)) {
+      ++deleted;
+    }
+  }
+  close_lock_file(fd);
+  return deleted;
+}
+
+std::vector<ContentHash> BlobStore::list() const {
+  std::vector<ContentHash> hashes;
+  std::error_code ec;
+  for (const auto &dir : std::filesystem::directory_iterator(root_, ec)) {
+    std::string prefix = dir.path().filename().string();
+    if (prefix.size() != 2 || !dir.is_directory(ec)) {
+      continue;
+    }
+    for (const auto &file : std::filesystem::directory_iterator(dir, ec)) {
+      // Leftover temporary files do not parse and are skipped.
+      if (auto hash =
+              ContentHash::from_hex(prefix + file.path().filename().string())) {
+        hashes.push_back(*hash);
+      }
+    }
+  }
+  return hashes;
+}
+
+uint64_t BlobStore::blobs_written() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return written_;
+}
+
+} // namespace llm
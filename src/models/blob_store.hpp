@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace llm {
+
+// 128-bit MurmurHash3 (x64 variant) of a blob's bytes. Its 32 hex digits
+// name the blob on disk.
+struct ContentHash {
+  uint64_t high = 0;
+  uint64_t low = 0;
+
+  static ContentHash of(std::string_view bytes);
+  static std::optional<ContentHash> from_hex(std::string_view hex);
+  std::string hex() const;
+
+  bool operator==(const ContentHash &other) const = default;
+
+  struct Hasher {
+    size_t operator()(const ContentHash &hash) const {
+      return static_cast<size_t>(hash.low);
+    }
+  };
+};
+
+// Content-addressed store of immutable blobs, one file per distinct content
+// under <root>/<first 2 hex digits>/<remaining 30>. Storing content that is
+// already present writes nothing, so conversations that share system
+// prompts, pasted documents or long answers share their files.
+//
+// Blobs are written durably (synced, then renamed into place) before put()
+// returns, so a record referencing one can be committed right after. The
+// store does not track who references a blob; see SessionStore.
+//
+// Thread-safe, and safe across processes sharing the root: put() holds
+// <root>/LOCK_FILE shared while it checks for a blob and writes it, and
+// collect() holds it exclusively while it deletes, so a blob that put()
+// found on disk is not deleted by another process's collection before put()
+// returns.
+class BlobStore {
+public:
+  // Contents shorter than this are cheaper to keep inline than as a file of
+  // their own; callers decide per message whether to reference a blob.
+  static constexpr size_t MIN_BLOB_BYTES = 1024;
+  static constexpr const char *LOCK_FILE = ".lock";
+
+  explicit BlobStore(std::string root);
+
+  const std::string &root() const { return root_; }
+
+  // Stores `bytes` under `hash` unless that blob exists. Returns false on
+  // I/O errors.
+  bool put(const ContentHash &hash, std::string_view bytes);
+  std::optional<ContentHash> put(std::string_view bytes);
+
+  bool contains(const ContentHash &hash) const;
+
+  // Contents of the blob, or nullopt if it is missing or unreadable.
+  std::optional<std::string> get(const ContentHash &hash) const;
+
+  bool erase(const ContentHash &hash);
+
+  // Deletes every blob on disk for which `keep` is false and returns how
+  // many were deleted.
+  size_t collect(const std::function<bool(const ContentHash &)> &keep);
+
+  // Every blob on disk.
+  std::vector<ContentHash> list() const;
+
+  // Blobs written by this instance; deduplicated puts do not count.
+  uint64_t blobs_written() const;
+
+  std::string path_of(const ContentHash &hash) const;
+
+private:
+  std::string root_;
+  mutable std::mutex mutex_;
+  uint64_t written_ = 0;
+
+  // Locks LOCK_FILE, creating it if missing. Returns -1 on failure;
+  // closing the descriptor releases the lock.
+  int lock(bool exclusive) const;
+};
+
+} // namespace llm
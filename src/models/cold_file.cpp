@@ -0,0 +1,154 @@
+#include "models/cold_file.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <filesystem>
+#include <random>
+#include <system_error>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "utils/logger.hpp"
+
+namespace llm {
+
+namespace {
+
+// Names tried before giving up, should others already exist.
+constexpr int CREATE_ATTEMPTS = 8;
+
+#ifdef _WIN32
+int create_exclusive(const std::string &path) {
+  return ::_open(path.c_str(),
+                 _O_RDWR | _O_CREAT | _O_EXCL | _O_BINARY | _O_NOINHERIT,
+                 _S_IREAD | _S_IWRITE);
+}
+void close_file(int fd) { ::_close(fd); }
+int write_some(int fd, const char *data, size_t size, uint64_t offset) {
+  if (::_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) {
+    return -1;
+  }
+  return ::_write(fd, data, static_cast<unsigned>(size));
+}
+#else
+int create_exclusive(const std::string &path) {
+  return ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+}
+void close_file(int fd) { ::close(fd); }
+ssize_t write_some(int fd, const char *data, size_t size, uint64_t offset) {
+  return ::pwrite(fd, data, size, static_cast<off_t>(offset));
+}
+#endif
+
+// Writes at `offset`, so that a failed write is overwritten by the next.
+bool write_all(int fd, std::string_view bytes, uint64_t offset) {
+  while (!bytes.empty()) {
+    auto written = write_some(fd, bytes.data(), bytes.size(), offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes.remove_prefix(static_cast<size_t>(written));
+    offset += static_cast<uint64_t>(written);
+  }
+  return true;
+}
+
+} // namespace
+
+std::shared_ptr<ColdFile> ColdFile::create(const std::string &dir) {
+  std::error_code ec;
+  std::filesystem::path base =
+      dir.empty() ? std::filesystem::temp_directory_path(ec)
+                  : std::filesystem::path(dir);
+  if (ec) {
+    spdlog::warn("No temporary directory for spilled messages: {}",
+                 ec.message());
+    return nullptr;
+  }
+  std::filesystem::create_directories(base, ec);
+
+  static std::atomic<uint64_t> counter{0};
+  std::random_device random;
+  std::string path;
+  int fd = -1;
+  for (int attempt = 0; attempt < CREATE_ATTEMPTS && fd < 0; ++attempt) {
+    std::string name = "llm-cold-" + std::to_string(random()) + "-" +
+                       std::to_string(counter++) + ".tmp";
+    path = (base / name).string();
+    // O_EXCL: never opens, or follows a link to, a file someone else made.
+    fd = create_exclusive(path);
+    if (fd < 0 && errno != EEXIST) {
+      break;
+    }
+  }
+  if (fd < 0) {
+    spdlog::warn("Failed to create cold file in {}", base.string());
+    return nullptr;
+  }
+#ifndef _WIN32
+  ::unlink(path.c_str());
+#endif
+  return std::shared_ptr<ColdFile>(new ColdFile(std::move(path), fd));
+}
+
+ColdFile::~ColdFile() {
+  map_.close();
+  close_file(fd_);
+#ifdef _WIN32
+  std::error_code ec;
+  std::filesystem::remove(path_, ec);
+#endif
+}
+
+uint64_t ColdFile::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+std::optional<uint64_t> ColdFile::append(std::string_view bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Written straight to the file: reads map it, so nothing may sit in a
+  // buffer.
+  if (!write_all(fd_, bytes, size_)) {
+    return std::nullopt;
+  }
+  uint64_t offset = size_;
+  size_ += bytes.size();
+  return offset;
+}
+
+bool ColdFile::read(uint64_t offset, size_t size,
+                    const std::function<void(std::string_view)> &fn) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (offset + size > size_) {
+    return false;
+  }
+  if (size == 0) {
+    fn({});
+    return true;
+  }
+#ifdef _WIN32
+  if (offset + size > map_.size() && !map_.open(path_)) {
+    return false;
+  }
+#else
+  if (offset + size > map_.size() && !map_.open(fd_)) {
+    return false;
+  }
+#endif
+  fn(std::string_view(map_.data() + offset, size));
+  return true;
+}
+
+} // namespace llm
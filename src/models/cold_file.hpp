@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "utils/mapped_file.hpp"
+
+namespace llm {
+
+// Where ContextStore reads the contents of turns it does not hold in memory
+// back from. Implementations are thread-safe.
+class ColdSource {
+public:
+  virtual ~ColdSource() = default;
+
+  // Names the source in error messages.
+  virtual const std::string &path() const = 0;
+
+  // Calls `fn` with the `size` bytes at `offset`. Returns false if they
+  // cannot be read. The view is only valid during the call.
+  virtual bool read(uint64_t offset, size_t size,
+                    const std::function<void(std::string_view)> &fn) = 0;
+};
+
+// Append-only scratch file for message contents spilled out of memory by
+// ContextStore. Reads go through a memory mapping that is extended when a
+// read reaches past it, so paged-in contents are copied straight out of the
+// page cache. The file is created exclusively, readable by its owner only,
+// and unlinked as soon as it is open, so no other process can open it and
+// it goes away with the last ColdFile reference even after a crash. (On
+// Windows it is deleted when the last reference goes.)
+//
+// Thread-safe: copies of a conversation share the file across threads.
+class ColdFile : public ColdSource {
+public:
+  // Creates an empty file in `dir`, or in the system temporary directory if
+  // `dir` is empty. Returns null if it cannot be created.
+  static std::shared_ptr<ColdFile> create(const std::string &dir);
+
+  ~ColdFile() override;
+
+  ColdFile(const ColdFile &) = delete;
+  ColdFile &operator=(const ColdFile &) = delete;
+
+  const std::string &path() const override { return path_; }
+  uint64_t size() const;
+
+  // Appends `bytes` and returns their offset, or nullopt on I/O errors.
+  std::optional<uint64_t> append(std::string_view bytes);
+
+  bool read(uint64_t offset, size_t size,
+            const std::function<void(std::string_view)> &fn) override;
+
+private:
+  ColdFile(std::string path, int fd) : path_(std::move(path)), fd_(fd) {}
+
+  std::string path_; // already unlinked, except on Windows
+  mutable std::mutex mutex_;
+  int fd_;
+  uint64_t size_ = 0;
+  MappedFile map_;
+};
+
+} // namespace llm
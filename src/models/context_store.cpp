@@ -0,0 +1,310 @@
+#include "models/context_store.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "utils/logger.hpp"
+
+namespace llm {
+
+void ContextStore::set_resident_budget(size_t bytes, std::string dir) {
+  resident_budget_ = bytes;
+  if (dir != cold_dir_) {
+    cold_dir_ = std::move(dir);
+    cold_file_.reset();
+  }
+  spill_over_budget();
+}
+
+size_t ContextStore::cold_turns() const {
+  size_t count = 0;
+  if (chunks_) {
+    for (size_t position = head_; position < tail_; ++position) {
+      size_t offset = position - base_;
+      count += (*chunks_)[offset / CHUNK_SIZE]->cold ? 1 : 0;
+    }
+  }
+  return count;
+}
+
+size_t ContextStore::append_cold(std::shared_ptr<ColdSource> source,
+                                 const std::vector<ColdTurn> &turns) {
+  size_t taken = 0;
+  auto &chunks = own_chunks();
+  while (turns.size() - taken >= CHUNK_SIZE) {
+    auto block = std::make_shared<ColdBlock>();
+    block->file = source;
+    uint64_t begin = turns[taken].offset;
+    uint64_t end = begin;
+    for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+      begin = std::min(begin, turns[taken + i].offset);
+      end = std::max(end, turns[taken + i].offset + turns[taken + i].size);
+    }
+    block->offset = begin;
+    block->size = static_cast<size_t>(end - begin);
+    for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+      const ColdTurn &turn = turns[taken + i];
+      block->slots[i] = {true, turn.role, turn.seq, turn.tokens,
+                         static_cast<size_t>(turn.offset - begin), turn.size};
+    }
+
+    auto cold = std::make_shared<Chunk>(nullptr);
+    cold->claimed.store(CHUNK_SIZE);
+    cold->cold = std::move(block);
+    chunks.push_back(std::move(cold));
+    tail_ += CHUNK_SIZE;
+    ++cold_chunks_;
+    taken += CHUNK_SIZE;
+  }
+  return taken;
+}
+
+void ContextStore::push_front(Entry entry) {
+  if (front_) {
+    // Only one entry fits in front of the log: fold the current one in.
+    rebuild();
+  }
+  front_ = pin(std::move(entry));
+  spill_over_budget();
+}
+
+std::shared_ptr<const ContextStore::Entry> ContextStore::pop_front() {
+  if (front_) {
+    return std::exchange(front_, nullptr);
+  }
+
+  size_t offset = head_ - base_;
+  std::shared_ptr<const Chunk> chunk = (*chunks_)[offset / CHUNK_SIZE];
+  if (chunk->cold) {
+    chunk = page_in(*chunk);
+  } else {
+    resident_bytes_ -= std::min(
+        resident_bytes_, footprint(*chunk->slots[offset % CHUNK_SIZE]));
+  }
+  std::shared_ptr<const Entry> oldest(chunk,
+                                      &*chunk->slots[offset % CHUNK_SIZE]);
+  ++head_;
+  if (head_ - base_ == CHUNK_SIZE) {
+    paged_.erase(chunks_->front().get());
+    own_chunks().pop_front();
+    base_ += CHUNK_SIZE;
+    cold_chunks_ -= std::min<size_t>(cold_chunks_, 1);
+  }
+  return oldest;
+}
+
+void ContextStore::pop_back() {
+  if (tail_ == head_) {
+    front_.reset();
+    return;
+  }
+
+  --tail_;
+  size_t offset = tail_ - base_;
+  const Chunk &last = *(*chunks_)[offset / CHUNK_SIZE];
+  if (!last.cold) {
+    resident_bytes_ -=
+        std::min(resident_bytes_, footprint(*last.slots[offset % CHUNK_SIZE]));
+  }
+  // Chunks wholly past the new end are only referenced by other stores.
+  size_t needed = (tail_ - base_ + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  if (chunks_->size() > needed) {
+    for (size_t i = needed; i < chunks_->size(); ++i) {
+      paged_.erase((*chunks_)[i].get());
+    }
+    own_chunks().resize(needed);
+    cold_chunks_ = std::min(cold_chunks_, needed);
+  }
+}
+
+void ContextStore::clear() {
+  system_.reset();
+  front_.reset();
+  chunks_.reset();
+  paged_.clear();
+  base_ = head_ = tail_ = 0;
+  resident_bytes_ = 0;
+  cold_chunks_ = 0;
+  // Copies still reading spilled entries keep the old file alive.
+  cold_file_.reset();
+  if (arena_ && arena_.use_count() == 1) {
+    arena_->release();
+  } else {
+    arena_.reset();
+  }
+}
+
+void ContextStore::diverge(size_t index, size_t filled) {
+  auto copy = std::make_shared<Chunk>(arena());
+  const Chunk *original = (*chunks_)[index].get();
+  // A spilled chunk is appended to again after pop_back(); its copy is
+  // resident.
+  const bool cold = original->cold != nullptr;
+  std::shared_ptr<const Chunk> source =
+      cold ? page_in(*original) : (*chunks_)[index];
+  // Slots before the oldest turn are never read again.
+  size_t first = index == 0 ? head_ - base_ : 0;
+  for (size_t i = first; i < filled; ++i) {
+    auto &entry = copy->slots[i].emplace(*source->slots[i], resource());
+    if (cold) {
+      resident_bytes_ += footprint(entry);
+    }
+  }
+  copy->claimed.store(filled + 1);
+  paged_.erase(original);
+  own_chunks()[index] = std::move(copy);
+  cold_chunks_ = std::min(cold_chunks_, index);
+}
+
+void ContextStore::make_unique() {
+  // Spilled entries are read back so that they can be modified.
+  bool shared = system_.use_count() > 1 || front_.use_count() > 1 ||
+                chunks_.use_count() > 1 || cold_chunks_ > 0;
+  if (chunks_) {
+    for (const auto &chunk : *chunks_) {
+      shared = shared || chunk.use_count() > 1 || chunk->cold;
+    }
+  }
+  if (!shared) {
+    return;
+  }
+
+  if (system_) {
+    system_ = pin(Entry(*system_, resource()));
+  }
+  rebuild();
+}
+
+void ContextStore::rebuild() {
+  auto front = std::exchange(front_, nullptr);
+  auto chunks = std::exchange(chunks_, nullptr);
+  size_t base = std::exchange(base_, 0);
+  size_t head = std::exchange(head_, 0);
+  size_t tail = std::exchange(tail_, 0);
+  resident_bytes_ = 0;
+  cold_chunks_ = 0;
+
+  if (front) {
+    append(static_cast<const Entry &>(*front));
+  }
+  for (size_t i = head; i < tail; ++i) {
+    size_t offset = i - base;
+    const auto &chunk = (*chunks)[offset / CHUNK_SIZE];
+    const Chunk &source = chunk->cold ? *page_in(*chunk) : *chunk;
+    append(static_cast<const Entry &>(*source.slots[offset % CHUNK_SIZE]));
+    if (offset % CHUNK_SIZE == CHUNK_SIZE - 1) {
+      // Done with it; only one spilled chunk is paged in at a time.
+      paged_.erase(chunk.get());
+    }
+  }
+  paged_.clear();
+}
+
+const std::shared_ptr<ContextStore::Chunk> &
+ContextStore::page_in(const Chunk &chunk) const {
+  auto &resident = paged_[&chunk];
+  if (resident) {
+    return resident;
+  }
+
+  // Contents are copied to the heap, not the arena, so that releasing the
+  // chunk returns their memory right away.
+  auto copy = std::make_shared<Chunk>(nullptr);
+  const ColdBlock &block = *chunk.cold;
+  bool ok = block.file->read(
+      block.offset, block.size, [&](std::string_view bytes) {
+        for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+          const ColdSlot &slot = block.slots[i];
+          if (!slot.present) {
+            continue;
+          }
+          copy->slots[i].emplace(
+              Message(slot.role, bytes.substr(slot.offset, slot.size)),
+              slot.seq, slot.tokens);
+        }
+      });
+  if (!ok) {
+    paged_.erase(&chunk);
+    throw std::runtime_error("Failed to read spilled messages from " +
+                             block.file->path());
+  }
+  copy->claimed.store(CHUNK_SIZE);
+  resident = std::move(copy);
+  return resident;
+}
+
+void ContextStore::spill_over_budget() {
+  paged_.clear();
+  if (resident_budget_ == 0 || resident_bytes_ <= resident_budget_ ||
+      !chunks_) {
+    return;
+  }
+  // The chunk holding the newest turn may still be appended to.
+  const size_t full = (tail_ - base_) / CHUNK_SIZE;
+  while (resident_bytes_ > resident_budget_ && cold_chunks_ < full) {
+    if (!spill(cold_chunks_)) {
+      spdlog::warn("Spilling messages failed; keeping them in memory");
+      resident_budget_ = 0;
+      return;
+    }
+    ++cold_chunks_;
+  }
+}
+
+bool ContextStore::spill(size_t index) {
+  if (!cold_file_) {
+    cold_file_ = ColdFile::create(cold_dir_);
+    if (!cold_file_) {
+      return false;
+    }
+  }
+
+  const Chunk &chunk = *(*chunks_)[index];
+  auto block = std::make_shared<ColdBlock>();
+  block->file = cold_file_;
+  std::string bytes;
+  size_t freed = 0;
+  // Slots before the oldest turn are never read again.
+  size_t first = index == 0 ? head_ - base_ : 0;
+  for (size_t i = first; i < CHUNK_SIZE; ++i) {
+    const Entry &entry = *chunk.slots[i];
+    block->slots[i] = {true, entry.message.role, entry.seq, entry.tokens,
+                       bytes.size(), entry.message.content.size()};
+    bytes.append(entry.message.content);
+    freed += footprint(entry);
+  }
+  auto offset = cold_file_->append(bytes);
+  if (!offset) {
+    return false;
+  }
+  block->offset = *offset;
+  block->size = bytes.size();
+
+  auto cold = std::make_shared<Chunk>(nullptr);
+  cold->claimed.store(CHUNK_SIZE);
+  cold->cold = std::move(block);
+  own_chunks()[index] = std::move(cold);
+  resident_bytes_ -= std::min(resident_bytes_, freed);
+  return true;
+}
+
+std::string ContextStore::serialize() const {
+  size_t length = 2;
+  for_each([&length](const Entry &entry) {
+    length += entry.serialized().size() + 1;
+  });
+
+  std::string out;
+  out.reserve(length);
+  out.push_back('[');
+  for_each([&out](const Entry &entry) {
+    if (out.size() > 1) {
+      out.push_back(',');
+    }
+    out.append(entry.serialized());
+  });
+  out.push_back(']');
+  return out;
+}
+
+} // namespace llm
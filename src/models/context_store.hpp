@@ -0,0 +1,451 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "models/cold_file.hpp"
+#include "models/message.hpp"
+#include "models/message_arena.hpp"
+
+namespace llm {
+
+// Message storage for Conversation: a pinned system slot followed by the
+// turns. Appending and evicting the oldest turn are O(1) and move the message
+// rather than copying it. Each entry carries its serialized JSON fragment, so
+// evicting old turns never invalidates the cached text of the turns that
+// remain.
+//
+// Turns live in fixed-size chunks that are shared, not copied, when the store
+// is copied, so a copy is O(1) and is a consistent snapshot: entries are
+// never modified in place once another store can see them. A copy that
+// appends after diverging continues in a private copy of the last chunk, and
+// update_each() first takes private copies of everything it shares. A store
+// is not thread-safe, but copies of it may be used from different threads.
+//
+// With a resident budget, turn contents beyond it are spilled: the oldest
+// full chunks are written to a ColdFile and replaced by cold chunks that
+// keep only each entry's role, sequence number and token count. Reading a
+// spilled entry pages its chunk back in until the next append to the
+// store, so references to spilled entries last until then. A store can
+// also start out with cold chunks whose contents are still in the file
+// they are being loaded from (see append_cold()), read the same way.
+class ContextStore {
+public:
+  static constexpr size_t CHUNK_SIZE = 32;
+
+  struct Entry {
+    Message message;
+    uint64_t seq = 0; // identifies the content `tokens` was computed from
+    // Caches derived from `message`.
+    size_t tokens = 0; // includes per-message overhead
+    // Serialized fragment, computed up front so that stores sharing the
+    // entry can read it from any thread. Request bodies are assembled from
+    // these (see serialize()).
+    Message::Content json;
+
+    Entry(Message m, uint64_t s, size_t t)
+        : message(std::move(m)), seq(s), tokens(t),
+          json(message.to_json().dump(), message.content.get_allocator()) {}
+
+    Entry(const Entry &) = default;
+    Entry(Entry &&) noexcept = default;
+
+    // Re-homes `other` in `resource`: a move if it is already allocated
+    // there, otherwise a copy.
+    Entry(Entry &&other, std::pmr::memory_resource *resource)
+        : message(std::move(other.message), resource), seq(other.seq),
+          tokens(other.tokens), json(std::move(other.json), resource) {}
+
+    Entry(const Entry &other, std::pmr::memory_resource *resource)
+        : message(other.message.role, other.message.content, resource),
+          seq(other.seq), tokens(other.tokens), json(other.json, resource) {}
+
+    const Message::Content &serialized() const { return json; }
+  };
+
+  class MessageIterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = Message;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Message *;
+    using reference = const Message &;
+
+    MessageIterator() = default;
+    MessageIterator(const ContextStore *store, size_t index)
+        : store_(store), index_(index) {}
+
+    reference operator*() const { return store_->entry(index_).message; }
+    pointer operator->() const { return &store_->entry(index_).message; }
+    reference operator[](difference_type n) const {
+      return store_->entry(index_ + n).message;
+    }
+
+    MessageIterator &operator++() {
+      ++index_;
+      return *this;
+    }
+    MessageIterator operator++(int) {
+      auto copy = *this;
+      ++index_;
+      return copy;
+    }
+    MessageIterator &operator--() {
+      --index_;
+      return *this;
+    }
+    MessageIterator operator--(int) {
+      auto copy = *this;
+      --index_;
+      return copy;
+    }
+    MessageIterator &operator+=(difference_type n) {
+      index_ += n;
+      return *this;
+    }
+    MessageIterator &operator-=(difference_type n) {
+      index_ -= n;
+      return *this;
+    }
+    friend MessageIterator operator+(MessageIterator it, difference_type n) {
+      return it += n;
+    }
+    friend MessageIterator operator+(difference_type n, MessageIterator it) {
+      return it += n;
+    }
+    friend MessageIterator operator-(MessageIterator it, difference_type n) {
+      return it -= n;
+    }
+    friend difference_type operator-(const MessageIterator &a,
+                                     const MessageIterator &b) {
+      return static_cast<difference_type>(a.index_) -
+             static_cast<difference_type>(b.index_);
+    }
+    friend bool operator==(const MessageIterator &a,
+                           const MessageIterator &b) {
+      return a.index_ == b.index_;
+    }
+    friend auto operator<=>(const MessageIterator &a,
+                            const MessageIterator &b) {
+      return a.index_ <=> b.index_;
+    }
+
+  private:
+    const ContextStore *store_ = nullptr;
+    size_t index_ = 0;
+  };
+
+  // Read-only, random-access view of the messages in order (system first).
+  // Iterators refer to the store, not the view, so they outlive it.
+  class View {
+  public:
+    using value_type = Message;
+    using const_iterator = MessageIterator;
+    using iterator = MessageIterator;
+
+    explicit View(const ContextStore &store) : store_(&store) {}
+
+    const Message &operator[](size_t index) const {
+      return store_->entry(index).message;
+    }
+    const Message &front() const { return (*this)[0]; }
+    const Message &back() const { return (*this)[size() - 1]; }
+    size_t size() const { return store_->size(); }
+    bool empty() const { return store_->empty(); }
+    const_iterator begin() const { return {store_, 0}; }
+    const_iterator end() const { return {store_, size()}; }
+
+  private:
+    const ContextStore *store_;
+  };
+
+  bool has_system() const { return system_ != nullptr; }
+  size_t size() const { return turn_count() + (system_ ? 1 : 0); }
+  size_t turn_count() const { return (front_ ? 1 : 0) + tail_ - head_; }
+  bool empty() const { return size() == 0; }
+
+  const Entry &entry(size_t index) const {
+    if (system_) {
+      if (index == 0) {
+        return *system_;
+      }
+      --index;
+    }
+    if (front_) {
+      if (index == 0) {
+        return *front_;
+      }
+      --index;
+    }
+    return *slot(head_ + index);
+  }
+
+  const Entry *system() const { return system_.get(); }
+
+  // Token count and sequence number of an entry, read without paging in a
+  // spilled one.
+  size_t tokens(size_t index) const {
+    const ColdSlot *cold = cold_slot(index);
+    return cold ? cold->tokens : entry(index).tokens;
+  }
+  uint64_t seq(size_t index) const {
+    const ColdSlot *cold = cold_slot(index);
+    return cold ? cold->seq : entry(index).seq;
+  }
+
+  // Spills turns once their contents and fragments take more than `bytes`
+  // of memory; 0 keeps everything resident. A spilled turn drops both. Cold
+  // files are created in `dir`, or the system temporary directory if
+  // empty. Copies of the store keep the setting.
+  void set_resident_budget(size_t bytes, std::string dir = {});
+  size_t resident_budget() const { return resident_budget_; }
+  const std::string &cold_dir() const { return cold_dir_; }
+
+  // Bytes of turn contents and fragments held in memory, not counting
+  // spilled chunks that are paged in.
+  size_t resident_bytes() const { return resident_bytes_; }
+
+  // Memory that new messages for this store should be allocated from.
+  std::pmr::memory_resource *resource() { return arena()->resource(); }
+
+  // Replaces the pinned system entry, returning the previous one if any.
+  std::shared_ptr<const Entry> set_system(Entry entry) {
+    return std::exchange(system_, pin(std::move(entry)));
+  }
+
+  void push_back(Entry &&entry) {
+    append(std::move(entry));
+    spill_over_budget();
+  }
+  void push_back(const Entry &entry) {
+    append(entry);
+    spill_over_budget();
+  }
+
+  // Puts `entry` before the oldest turn.
+  void push_front(Entry entry);
+
+  // Evicts the oldest turn (never the system entry) and hands it back. The
+  // entry stays shared with any copies of this store.
+  std::shared_ptr<const Entry> pop_front();
+
+  // Drops the newest turn (never the system entry). Its slot stays claimed,
+  // so a later append continues in a private copy of the chunk.
+  void pop_back();
+
+  const Entry &oldest_turn() const {
+    return front_ ? *front_ : *slot(head_);
+  }
+
+  // Turns whose contents are not held in memory.
+  size_t cold_turns() const;
+
+  // A turn whose content is `size` bytes at `offset` in a ColdSource.
+  struct ColdTurn {
+    MessageRole role = MessageRole::User;
+    uint64_t seq = 0;
+    size_t tokens = 0;
+    uint64_t offset = 0;
+    size_t size = 0;
+  };
+
+  // Appends the turns as cold chunks that read their contents from
+  // `source` when first used, so that nothing is copied up front. Only
+  // whole chunks are appended; the count of turns taken is returned. The
+  // store must not hold any turns yet.
+  size_t append_cold(std::shared_ptr<ColdSource> source,
+                     const std::vector<ColdTurn> &turns);
+
+  // Drops every entry. The arena is released in bulk unless copies of this
+  // store still use it, in which case later entries go to a fresh one.
+  void clear();
+
+  View view() const { return View(*this); }
+
+  template <typename Fn> void for_each(Fn &&fn) const {
+    if (system_)
+      fn(*system_);
+    if (front_)
+      fn(*front_);
+    for (size_t i = head_; i < tail_; ++i)
+      fn(*slot(i));
+  }
+
+  // Like for_each(), but for modifying the entries. Copies any entries still
+  // shared with other stores first, so it is O(n) after the store was copied.
+  template <typename Fn> void update_each(Fn &&fn) {
+    make_unique();
+    if (system_)
+      fn(*system_);
+    if (front_)
+      fn(*front_);
+    for (size_t i = head_; i < tail_; ++i)
+      fn(*slot(i));
+    spill_over_budget();
+  }
+
+  // JSON array text of all messages, assembled from the cached fragments.
+  std::string serialize() const;
+
+private:
+  struct ColdSlot {
+    bool present = false;
+    MessageRole role = MessageRole::User;
+    uint64_t seq = 0;
+    size_t tokens = 0;
+    size_t offset = 0; // of the content, from the start of the block
+    size_t size = 0;   // content bytes
+  };
+
+  // The span of a source holding the contents of a cold chunk, read back
+  // in one go.
+  struct ColdBlock {
+    std::shared_ptr<ColdSource> file;
+    uint64_t offset = 0;
+    size_t size = 0;
+    std::array<ColdSlot, CHUNK_SIZE> slots;
+  };
+
+  struct Chunk {
+    explicit Chunk(std::shared_ptr<MessageArena> a) : arena(std::move(a)) {}
+
+    // Declared first so that it outlives the entries below.
+    std::shared_ptr<MessageArena> arena;
+    // Slots below this have been filled by some store sharing the chunk and
+    // are immutable; the store that advances it owns the next slot.
+    std::atomic<size_t> claimed{0};
+    std::array<std::optional<Entry>, CHUNK_SIZE> slots;
+    // Set on spilled chunks, whose slots are empty.
+    std::shared_ptr<const ColdBlock> cold;
+  };
+
+  struct Pinned {
+    std::shared_ptr<MessageArena> arena;
+    Entry entry;
+  };
+
+  using Chunks = std::deque<std::shared_ptr<Chunk>>;
+
+  std::shared_ptr<MessageArena> arena_;
+  std::shared_ptr<Entry> system_;
+  // An entry pushed before the oldest turn; chunk slots are never rewritten.
+  std::shared_ptr<Entry> front_;
+  std::shared_ptr<Chunks> chunks_;
+  // Positions in this store's log of turns; chunks_->front() starts at base_.
+  size_t base_ = 0;
+  size_t head_ = 0;
+  size_t tail_ = 0;
+
+  size_t resident_budget_ = 0;
+  std::string cold_dir_;
+  std::shared_ptr<ColdFile> cold_file_; // created by the first spill
+  size_t resident_bytes_ = 0;
+  // Spilled chunks are the oldest: chunks_ starts with this many of them.
+  size_t cold_chunks_ = 0;
+  // Spilled chunks paged back in, released by the next append.
+  mutable std::unordered_map<const Chunk *, std::shared_ptr<Chunk>> paged_;
+
+  static size_t footprint(const Entry &entry) {
+    return entry.message.content.size() + entry.json.size();
+  }
+
+  const std::shared_ptr<MessageArena> &arena() {
+    if (!arena_) {
+      arena_ = std::make_shared<MessageArena>();
+    }
+    return arena_;
+  }
+
+  Entry *slot(size_t position) const {
+    size_t offset = position - base_;
+    const auto &chunk = (*chunks_)[offset / CHUNK_SIZE];
+    Chunk *resident = chunk->cold ? page_in(*chunk).get() : chunk.get();
+    return &*resident->slots[offset % CHUNK_SIZE];
+  }
+
+  // The metadata of entry `index` if it is spilled, otherwise null.
+  const ColdSlot *cold_slot(size_t index) const {
+    if (system_) {
+      if (index == 0) {
+        return nullptr;
+      }
+      --index;
+    }
+    if (front_) {
+      if (index == 0) {
+        return nullptr;
+      }
+      --index;
+    }
+    size_t offset = head_ + index - base_;
+    const auto &chunk = (*chunks_)[offset / CHUNK_SIZE];
+    return chunk->cold ? &chunk->cold->slots[offset % CHUNK_SIZE] : nullptr;
+  }
+
+  // A resident copy of spilled `chunk`, read back on first use. Throws
+  // std::runtime_error if the cold file cannot be read.
+  const std::shared_ptr<Chunk> &page_in(const Chunk &chunk) const;
+
+  // The chunk list, copied first if another store shares it.
+  Chunks &own_chunks() {
+    if (!chunks_) {
+      chunks_ = std::make_shared<Chunks>();
+    } else if (chunks_.use_count() > 1) {
+      chunks_ = std::make_shared<Chunks>(*chunks_);
+    }
+    return *chunks_;
+  }
+
+  std::shared_ptr<Entry> pin(Entry entry) {
+    auto pinned = std::make_shared<Pinned>(
+        Pinned{arena(), Entry(std::move(entry), resource())});
+    return std::shared_ptr<Entry>(pinned, &pinned->entry);
+  }
+
+  template <typename E> void append(E &&entry) {
+    size_t offset = tail_ - base_;
+    size_t index = offset / CHUNK_SIZE;
+    size_t position = offset % CHUNK_SIZE;
+    if (!chunks_ || index == chunks_->size()) {
+      own_chunks().push_back(std::make_shared<Chunk>(arena()));
+    }
+    size_t expected = position;
+    if (!(*chunks_)[index]->claimed.compare_exchange_strong(expected,
+                                                            position + 1)) {
+      // A copy of this store has already appended here.
+      diverge(index, position);
+    }
+    auto &placed = (*chunks_)[index]->slots[position].emplace(
+        std::forward<E>(entry), resource());
+    resident_bytes_ += footprint(placed);
+    ++tail_;
+  }
+
+  // Replaces chunk `index` with a private copy of its first `filled` slots
+  // and claims the next one.
+  void diverge(size_t index, size_t filled);
+
+  // Takes private copies of all shared entries.
+  void make_unique();
+
+  // Copies the turns, including the front entry, into fresh chunks.
+  void rebuild();
+
+  // Releases paged-in chunks, then spills the oldest resident chunks that
+  // are wholly filled until the turns fit the resident budget.
+  void spill_over_budget();
+
+  // Writes chunk `index` to the cold file and replaces it with a cold chunk.
+  bool spill(size_t index);
+};
+
+} // namespace llm
@@ -1,12 +1,343 @@
 #include "models/conversation.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <thread>
+
+#include "models/conversation_importer.hpp"
+#include "utils/mapped_file.hpp"
 
 namespace llm {
 
-void Conversation::save_to_file(const std::string &filename) const {
+void Conversation::set_tokenizer(std::shared_ptr<const Tokenizer> tokenizer) {
+  if (!tokenizer) {
+    tokenizer = ApproximateTokenizer::shared();
+  }
+  bool same_vocab = tokenizer->name() == tokenizer_->name();
+  tokenizer_ = std::move(tokenizer);
+  if (same_vocab) {
+    return;
+  }
+
+  // A newer switch supersedes any recount still in flight.
+  pending_recount_ = {};
+
+  size_t bytes = 0;
+  store_.for_each([&bytes](const ContextStore::Entry &entry) {
+    bytes += entry.message.content.size();
+  });
+
+  if (bytes < BACKGROUND_RECOUNT_BYTES) {
+    total_tokens_ = 0;
+    store_.update_each([this](ContextStore::Entry &entry) {
+      entry.tokens = count_message_tokens(entry.message);
+      total_tokens_ += entry.tokens;
+    });
+    return;
+  }
+
+  // Copying the text is far cheaper than tokenizing it, and lets the worker
+  // run while this conversation keeps changing.
+  std::vector<std::pair<uint64_t, std::string>> contents;
+  contents.reserve(store_.size());
+  store_.for_each([&contents](const ContextStore::Entry &entry) {
+    contents.emplace_back(entry.seq, entry.message.content);
+  });
+
+  // A detached packaged_task rather than std::async: dropping a superseded
+  // std::async future would block until the worker finished.
+  std::packaged_task<Recount()> task([tokenizer = tokenizer_,
+                                      contents = std::move(contents)]() {
+    Recount result{tokenizer->name(), {}};
+    result.counts.reserve(contents.size());
+    for (const auto &[seq, content] : contents) {
+      result.counts.push_back(
+          {seq, tokenizer->count_tokens(content) + MESSAGE_OVERHEAD_TOKENS});
+    }
+    std::sort(result.counts.begin(), result.counts.end(),
+              [](const TokenCount &a, const TokenCount &b) {
+                return a.seq < b.seq;
+              });
+    return result;
+  });
+  pending_recount_ = task.get_future().share();
+  std::thread(std::move(task)).detach();
+}
+
+void Conversation::apply_pending_recount(bool wait) const {
+  if (!pending_recount_.valid()) {
+    return;
+  }
+  if (!wait && pending_recount_.wait_for(std::chrono::seconds(0)) !=
+                   std::future_status::ready) {
+    return;
+  }
+
+  const Recount &recount = pending_recount_.get();
+  if (recount.tokenizer == tokenizer_->name()) {
+    // Messages added or replaced since the snapshot already carry counts
+    // from the current tokenizer and are absent from the result.
+    total_tokens_ = 0;
+    store_.update_each([this, &recount](ContextStore::Entry &entry) {
+      auto it = std::lower_bound(
+          recount.counts.begin(), recount.counts.end(), entry.seq,
+          [](const TokenCount &c, uint64_t seq) { return c.seq < seq; });
+      if (it != recount.counts.end() && it->seq == entry.seq) {
+        entry.tokens = it->tokens;
+      }
+      total_tokens_ += entry.tokens;
+    });
+  }
+  pending_recount_ = {};
+}
+
+void Conversation::truncate_to_token_limit(size_t max_tokens,
+                                           size_t keep_recent) {
+  if (estimate_tokens() <= max_tokens) {
+    return;
+  }
+
+  keep_recent = std::max<size_t>(keep_recent, 1);
+  while (store_.turn_count() > 1 &&
+         (store_.turn_count() > keep_recent || total_tokens_ > max_tokens)) {
+    auto evicted = store_.pop_front();
+    if (index_) {
+      index_->remove(evicted->seq);
+    }
+    total_tokens_ -= evicted->tokens;
+  }
+}
+
+Conversation Conversation::select_context(size_t max_tokens,
+                                          size_t keep_recent) const {
+  apply_pending_recount(false);
+
+  Conversation selected;
+  selected.tokenizer_ = tokenizer_;
+  selected.next_seq_ = next_seq_;
+  if (total_tokens_ <= max_tokens || store_.turn_count() == 0) {
+    selected.store_ = store_;
+    selected.total_tokens_ = total_tokens_;
+    return selected;
+  }
+
+  // Entries are copied with their cached counts and JSON fragments, and
+  // without indexing: the result only ever serves one request.
+  size_t budget = max_tokens;
+  auto spend = [&budget](size_t tokens) {
+    budget -= std::min(budget, tokens);
+  };
+  if (const auto *system = store_.system()) {
+    selected.store_.set_system(*system);
+    spend(system->tokens);
+  }
+
+  const size_t first = store_.has_system() ? 1 : 0;
+  const size_t turns = store_.turn_count();
+  keep_recent = std::clamp<size_t>(keep_recent, 1, turns);
+
+  // Only counts and sequence numbers are read while choosing, so turns
+  // spilled to disk are paged in only if they are sent.
+  std::vector<char> chosen(turns, 0);
+  for (size_t i = turns; i-- > turns - keep_recent;) {
+    size_t tokens = store_.tokens(first + i);
+    // The newest turn is sent even if it alone exceeds the budget.
+    if (tokens > budget && i != turns - 1) {
+      break;
+    }
+    chosen[i] = 1;
+    spend(tokens);
+  }
+
+  // Knapsack by value density: score per token, best first, skipping turns
+  // that no longer fit.
+  const auto &newest = store_.entry(first + turns - 1).message;
+  auto scores = relevance_index().score(newest.content);
+
+  struct Candidate {
+    size_t turn;
+    double density;
+  };
+  std::vector<Candidate> candidates;
+  candidates.reserve(turns);
+  for (size_t i = 0; i < turns; ++i) {
+    size_t tokens = store_.tokens(first + i);
+    if (chosen[i] || tokens > budget) {
+      continue;
+    }
+    double relevance = RECENCY_PRIOR;
+    if (auto it = scores.find(store_.seq(first + i)); it != scores.end()) {
+      relevance += it->second;
+    }
+    double age = static_cast<double>(turns - 1 - i);
+    double value = relevance * std::exp2(-age / RELEVANCE_HALF_LIFE_TURNS);
+    candidates.push_back(
+        {i, value / static_cast<double>(std::max<size_t>(tokens, 1))});
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate &a, const Candidate &b) {
+              return a.density > b.density;
+            });
+
+  for (const auto &candidate : candidates) {
+    size_t tokens = store_.tokens(first + candidate.turn);
+    if (tokens <= budget) {
+      chosen[candidate.turn] = 1;
+      spend(tokens);
+    }
+  }
+
+  for (size_t i = 0; i < turns; ++i) {
+    if (chosen[i]) {
+      const auto &entry = store_.entry(first + i);
+      selected.store_.push_back(entry);
+      selected.total_tokens_ += entry.tokens;
+    }
+  }
+  if (const auto *system = selected.store_.system()) {
+    selected.total_tokens_ += system->tokens;
+  }
+  return selected;
+}
+
+Conversation Conversation::fork(size_t turns) const {
+  apply_pending_recount(false);
+
+  Conversation branch = *this;
+  while (branch.store_.turn_count() > turns) {
+    const size_t newest = branch.store_.size() - 1;
+    branch.total_tokens_ -= branch.store_.tokens(newest);
+    if (branch.store_.seq(newest) == branch.summary_seq_) {
+      branch.summary_seq_.reset();
+    }
+    branch.store_.pop_back();
+  }
+  return branch;
+}
+
+Conversation::Span Conversation::oldest_turns(size_t count) const {
+  Span span;
+  const size_t first = store_.has_system() ? 1 : 0;
+  count = std::min(count, store_.turn_count());
+  span.messages.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    const auto &entry = store_.entry(first + i);
+    if (i == 0) {
+      span.first_seq = entry.seq;
+    }
+    span.last_seq = entry.seq;
+    span.messages.push_back(entry.message);
+  }
+  return span;
+}
+
+bool Conversation::replace_with_summary(const Span &span,
+                                        const std::string &summary) {
+  if (span.messages.empty() || store_.turn_count() < span.messages.size() ||
+      store_.oldest_turn().seq != span.first_seq) {
+    return false;
+  }
+  const size_t first = store_.has_system() ? 1 : 0;
+  if (store_.entry(first + span.messages.size() - 1).seq != span.last_seq) {
+    return false;
+  }
+
+  // Originals are only read back by /history, so with a resident budget
+  // every full chunk of them goes to a cold file right away.
+  archive_.set_resident_budget(store_.resident_budget() > 0 ? 1 : 0,
+                               store_.cold_dir());
+  for (size_t i = 0; i < span.messages.size(); ++i) {
+    auto evicted = store_.pop_front();
+    if (index_) {
+      index_->remove(evicted->seq);
+    }
+    total_tokens_ -= evicted->tokens;
+    // An earlier summary is superseded, not archived: its originals are
+    // already there.
+    if (evicted->seq != summary_seq_) {
+      archive_.push_back(ContextStore::Entry(*evicted, archive_.resource()));
+    }
+  }
+
+  Message message(MessageRole::System, SUMMARY_PREFIX + summary,
+                  store_.resource());
+  size_t tokens = count_message_tokens(message);
+  ContextStore::Entry entry(std::move(message), next_seq_++, tokens);
+  summary_seq_ = entry.seq;
+  if (index_) {
+    index_->add(entry.seq, entry.message.content);
+  }
+  store_.push_front(std::move(entry));
+  total_tokens_ += tokens;
+  return true;
+}
+
+const RelevanceIndex &Conversation::relevance_index() const {
+  if (!index_) {
+    auto index = std::make_unique<RelevanceIndex>();
+    const size_t first = store_.has_system() ? 1 : 0;
+    for (size_t i = first; i < store_.size(); ++i) {
+      const auto &entry = store_.entry(i);
+      index->add(entry.seq, entry.message.content);
+    }
+    index_.reset(std::move(index));
+  }
+  return *index_;
+}
+
+void Conversation::from_session(std::shared_ptr<SessionFile> file) {
+  clear();
+  const bool same_tokenizer = file->tokenizer() == tokenizer_->name();
+  auto tokens_of = [&](size_t i) {
+    return same_tokenizer ? file->tokens(i)
+                          : tokenizer_->count_tokens(file->content(i)) +
+                                MESSAGE_OVERHEAD_TOKENS;
+  };
+
+  size_t first = 0;
+  if (file->size() > 0 && file->role(0) == MessageRole::System) {
+    append(Message(MessageRole::System, file->content(0), store_.resource()),
+           tokens_of(0));
+    first = 1;
+  }
+
+  // Turns left in the file; appends continue in a resident chunk after
+  // them.
+  std::vector<ContextStore::ColdTurn> cold;
+  cold.reserve(file->size() - first);
+  for (size_t i = first; i < file->size(); ++i) {
+    size_t tokens = tokens_of(i);
+    cold.push_back({file->role(i), next_seq_ + (i - first), tokens,
+                    file->content_offset(i), file->content(i).size()});
+  }
+  const size_t taken = store_.append_cold(file, cold);
+  for (size_t i = 0; i < taken; ++i) {
+    total_tokens_ += cold[i].tokens;
+  }
+  next_seq_ += taken;
+
+  for (size_t i = first + taken; i < file->size(); ++i) {
+    append(Message(file->role(i), file->content(i), store_.resource()),
+           cold[i - first].tokens);
+  }
+}
+
+void Conversation::save_to_file(const std::string &filename,
+                                bool compress) const {
   try {
+    if (SessionFile::has_extension(filename)) {
+      if (!SessionFile::write(filename, *this, compress)) {
+        std::cout << "[ERROR] Failed to write session file: " << filename
+                  << "\n";
+        return;
+      }
+      std::cout << "[INFO] Conversation saved to " << filename << "\n";
+      return;
+    }
+
     std::ofstream file(filename);
     if (!file.is_open()) {
       std::cout << "[ERROR] Failed to open file for writing: " << filename
@@ -25,18 +356,33 @@ void Conversation::save_to_file(const std::string &filename) const {
 
 void Conversation::load_from_file(const std::string &filename) {
   try {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
+    if (SessionFile::is_session_file(filename)) {
+      auto session = std::make_shared<SessionFile>();
+      if (!session->open(filename)) {
+        std::cout << "[ERROR] Failed to read session file: " << filename
+                  << "\n";
+        return;
+      }
+      from_session(std::move(session));
+      std::cout << "[INFO] Conversation loaded from " << filename << "\n";
+      return;
+    }
+
+    MappedFile file;
+    if (!file.open(filename)) {
       std::cout << "[ERROR] Failed to open file for reading: " << filename
                 << "\n";
       return;
     }
 
-    nlohmann::json j;
-    file >> j;
-    file.close();
-
-    from_json(j);
+    // Imported into a copy so that a malformed file leaves this one as is.
+    Conversation imported;
+    imported.tokenizer_ = tokenizer_;
+    imported.set_resident_budget(store_.resident_budget(), store_.cold_dir());
+    ConversationImporter().import(file.view(), [&imported](Message &&message) {
+      imported.append(std::move(message));
+    });
+    *this = std::move(imported);
     std::cout << "[INFO] Conversation loaded from " << filename << "\n";
   } catch (const std::exception &e) {
     std::cout << "[ERROR] Error loading conversation: " << e.what() << "\n";
@@ -1,94 +1,206 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <memory>
 #include <nlohmann/json.hpp>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include "models/context_store.hpp"
 #include "models/message.hpp"
+#include "models/relevance_index.hpp"
+#include "models/session_file.hpp"
+#include "tokenizer/tokenizer.hpp"
 
 namespace llm {
 
+// Copying a conversation is O(1): the copy shares the messages with the
+// original and is unaffected by later changes to it, so async requests and
+// background work can hold a consistent snapshot while the REPL keeps
+// appending. Each copy is used from one thread at a time.
 class Conversation {
 public:
+  using MessageView = ContextStore::View;
+
   Conversation() = default;
 
-  void add_message(const Message &message) { messages_.push_back(message); }
+  void add_message(const Message &message) {
+    append(Message(message.role, message.content, store_.resource()));
+  }
+
+  void add_message(Message &&message) { append(std::move(message)); }
 
-  void add_system(const std::string &content) {
-    messages_.emplace_back(MessageRole::System, content);
+  void add_system(std::string_view content) {
+    append(Message(MessageRole::System, content, store_.resource()));
   }
 
-  void add_user(const std::string &content) {
-    messages_.emplace_back(MessageRole::User, content);
+  void add_user(std::string_view content) {
+    append(Message(MessageRole::User, content, store_.resource()));
   }
 
-  void add_assistant(const std::string &content) {
-    messages_.emplace_back(MessageRole::Assistant, content);
+  void add_assistant(std::string_view content) {
+    append(Message(MessageRole::Assistant, content, store_.resource()));
   }
 
-  void clear() { messages_.clear(); }
+  // Drops every message and returns their memory in one go, unless a
+  // snapshot still shares it.
+  void clear() {
+    store_.clear();
+    index_.reset();
+    archive_.clear();
+    summary_seq_.reset();
+    total_tokens_ = 0;
+  }
 
-  void set_system_prompt(const std::string &prompt) {
-    if (!messages_.empty() && messages_[0].role == MessageRole::System) {
-      messages_[0].content = prompt;
-    } else {
-      messages_.insert(messages_.begin(), Message(MessageRole::System, prompt));
+  void set_system_prompt(std::string_view prompt) {
+    Message system(MessageRole::System, prompt, store_.resource());
+    size_t tokens = count_message_tokens(system);
+    auto previous =
+        store_.set_system(ContextStore::Entry(std::move(system), next_seq_++, tokens));
+    if (previous) {
+      total_tokens_ -= previous->tokens;
     }
+    total_tokens_ += tokens;
   }
 
-  const std::vector<Message> &messages() const { return messages_; }
+  MessageView messages() const { return store_.view(); }
 
   nlohmann::json to_json() const {
     nlohmann::json j = nlohmann::json::array();
-    for (const auto &msg : messages_) {
+    for (const auto &msg : messages()) {
       j.push_back(msg.to_json());
     }
     return j;
   }
 
+  // JSON array text of the messages, reusing each message's cached
+  // serialization; equivalent to to_json().dump().
+  std::string serialize_messages() const { return store_.serialize(); }
+
   void from_json(const nlohmann::json &j) {
-    messages_.clear();
+    clear();
     for (const auto &msg_json : j) {
-      messages_.push_back(Message::from_json(msg_json));
+      append(Message::from_json(msg_json, store_.resource()));
     }
   }
 
-  size_t size() const { return messages_.size(); }
+  size_t size() const { return store_.size(); }
 
-  bool empty() const { return messages_.empty(); }
+  bool empty() const { return store_.empty(); }
+
+  // Tokens added per message by chat templates (role header and separators).
+  static constexpr size_t MESSAGE_OVERHEAD_TOKENS = 4;
+
+  // Conversations with less content than this are recounted synchronously
+  // when the tokenizer changes; larger ones are recounted on a worker thread
+  // while the previous counts keep serving estimate_tokens().
+  static constexpr size_t BACKGROUND_RECOUNT_BYTES = 256 * 1024;
+
+  // Switching to a tokenizer with a different name invalidates the cached
+  // per-message counts.
+  void set_tokenizer(std::shared_ptr<const Tokenizer> tokenizer);
+
+  const Tokenizer &tokenizer() const { return *tokenizer_; }
+
+  size_t count_message_tokens(const Message &msg) const {
+    return tokenizer_->count_tokens(msg.content) + MESSAGE_OVERHEAD_TOKENS;
+  }
 
+  // O(1): counts are maintained as messages are added and removed. After a
+  // tokenizer switch this may reflect the previous tokenizer until the
+  // background recount has been applied.
   size_t estimate_tokens() const {
-    size_t tokens = 0;
-    for (const auto &msg : messages_) {
-      tokens += msg.content.length() / 4;
-    }
-    return tokens;
+    apply_pending_recount(false);
+    return total_tokens_;
   }
 
-  void truncate_to_token_limit(size_t max_tokens, size_t keep_recent = 10) {
-    if (estimate_tokens() <= max_tokens) {
-      return;
-    }
+  size_t message_tokens(size_t index) const {
+    apply_pending_recount(false);
+    return store_.tokens(index);
+  }
 
-    std::vector<Message> new_messages;
+  bool token_counts_pending() const { return pending_recount_.valid(); }
 
-    if (!messages_.empty() && messages_[0].role == MessageRole::System) {
-      new_messages.push_back(messages_[0]);
-    }
+  // Blocks until a background recount, if any, has been applied.
+  void wait_for_token_counts() const { apply_pending_recount(true); }
 
-    size_t start_idx =
-        messages_.size() > keep_recent ? messages_.size() - keep_recent : 0;
+  // Caps the memory held by message contents at about `bytes`: older turns
+  // beyond it are spilled to a memory-mapped cold file in `dir` (the system
+  // temporary directory if empty) and read back when something such as
+  // /history needs them. 0 keeps everything in memory. Carried over by
+  // copies, clear() and load_from_file().
+  void set_resident_budget(size_t bytes, std::string dir = {}) {
+    store_.set_resident_budget(bytes, std::move(dir));
+  }
 
-    for (size_t i = start_idx; i < messages_.size(); ++i) {
-      new_messages.push_back(messages_[i]);
-    }
+  // Bytes of message contents currently held in memory.
+  size_t resident_bytes() const { return store_.resident_bytes(); }
 
-    messages_ = std::move(new_messages);
-  }
+  // Turns whose contents are on disk: spilled to the cold file, or not yet
+  // read from the session file they were loaded from.
+  size_t spilled_turns() const { return store_.cold_turns(); }
+  // Archived turns whose contents are in the cold file.
+  size_t spilled_archived_turns() const { return archive_.cold_turns(); }
+
+  // Evicts the oldest turns until at most `keep_recent` remain and they fit
+  // in `max_tokens` alongside the system prompt. The system prompt and the
+  // newest message are always kept. Amortized O(1) per evicted turn.
+  void truncate_to_token_limit(size_t max_tokens, size_t keep_recent = 10);
+
+  // Relevance of a turn halves every this many turns of age.
+  static constexpr double RELEVANCE_HALF_LIFE_TURNS = 64.0;
+  // Score every turn gets before relevance, so that among unrelated turns
+  // the recent ones still win.
+  static constexpr double RECENCY_PRIOR = 0.1;
+
+  // Builds the context for a request about the newest message without
+  // modifying this conversation: the system prompt, the newest
+  // `keep_recent` turns, then the older turns with the best BM25 relevance
+  // to the newest message (decayed by age) per token, packed greedily into
+  // `max_tokens`. Selected turns keep their original order.
+  Conversation select_context(size_t max_tokens, size_t keep_recent = 2) const;
+
+  // The oldest turns, identified by sequence number so that a summary of
+  // them can later be applied only if they are still in place.
+  struct Span {
+    std::vector<Message> messages;
+    uint64_t first_seq = 0;
+    uint64_t last_seq = 0;
+  };
+
+  size_t turn_count() const { return store_.turn_count(); }
 
-  std::string to_string() const {
+  // A copy holding the system prompt and the first `turns` turns. It shares
+  // them with this conversation, so forking costs O(1) plus the turns
+  // dropped, and the two diverge from there.
+  Conversation fork(size_t turns) const;
+
+  Span oldest_turns(size_t count) const;
+
+  // Replaces the turns of `span` with a single summary message placed before
+  // the remaining turns, moving the originals to the archive. Does nothing
+  // and returns false if the span is no longer the oldest run of turns
+  // (e.g. after /clear or /load).
+  bool replace_with_summary(const Span &span, const std::string &summary);
+
+  // Originals of summarized turns, oldest first. Not sent to the model.
+  // Unless the resident budget is 0 they are kept in a cold file and read
+  // back as they are accessed.
+  MessageView archived() const { return archive_.view(); }
+
+  static constexpr const char *SUMMARY_PREFIX =
+      "Summary of the earlier conversation:\n";
+
+  std::string to_string() const { return to_string(messages()); }
+
+  static std::string to_string(MessageView messages) {
     std::string result;
-    for (const auto &msg : messages_) {
+    for (const auto &msg : messages) {
       std::string role_str;
       switch (msg.role) {
       case MessageRole::System:
@@ -101,16 +213,104 @@ public:
         role_str = "[Assistant]";
         break;
       }
-      result += role_str + " " + msg.content + "\n\n";
+      result += role_str;
+      result += ' ';
+      result += msg.content;
+      result += "\n\n";
     }
     return result;
   }
 
-  void save_to_file(const std::string &filename) const;
+  // Files ending in SessionFile::EXTENSION are written in the binary
+  // session format, zstd-compressed if `compress` is set and the build
+  // supports it, anything else as JSON. Loading detects the format.
+  void save_to_file(const std::string &filename, bool compress = false) const;
   void load_from_file(const std::string &filename);
 
+  // Replaces the messages with those of `file`, reusing its token counts if
+  // they came from the current tokenizer. O(messages), not O(file): all but
+  // the newest turns stay in `file`, which is kept open, and are paged in
+  // when read. Counting under another tokenizer reads the contents but
+  // copies none of them.
+  void from_session(std::shared_ptr<SessionFile> file);
+
 private:
-  std::vector<Message> messages_;
+  struct TokenCount {
+    uint64_t seq;
+    size_t tokens;
+  };
+
+  struct Recount {
+    std::string tokenizer;
+    std::vector<TokenCount> counts; // sorted by seq
+  };
+
+  // Built for select_context() on first use and maintained from then on.
+  // Copies start without one rather than duplicating it.
+  class IndexSlot {
+  public:
+    IndexSlot() = default;
+    IndexSlot(const IndexSlot &) {}
+    IndexSlot &operator=(const IndexSlot &) {
+      index_.reset();
+      return *this;
+    }
+    IndexSlot(IndexSlot &&) = default;
+    IndexSlot &operator=(IndexSlot &&) = default;
+
+    RelevanceIndex &operator*() const { return *index_; }
+    RelevanceIndex *operator->() const { return index_.get(); }
+    explicit operator bool() const { return index_ != nullptr; }
+    void reset(std::unique_ptr<RelevanceIndex> index = nullptr) {
+      index_ = std::move(index);
+    }
+
+  private:
+    std::unique_ptr<RelevanceIndex> index_;
+  };
+
+  // Mutable so that a finished background recount can be folded in from
+  // const accessors.
+  mutable ContextStore store_;
+  // Turns (not the system prompt) indexed for select_context().
+  mutable IndexSlot index_;
+  // Originals of summarized turns; its chunks are shared with copies.
+  ContextStore archive_;
+  // The summary turn produced by the last compaction, if still present.
+  std::optional<uint64_t> summary_seq_;
+  // Running sum of the per-entry counts; a finished background recount is
+  // folded in from const accessors.
+  mutable size_t total_tokens_ = 0;
+  uint64_t next_seq_ = 0;
+  std::shared_ptr<const Tokenizer> tokenizer_ = ApproximateTokenizer::shared();
+
+  // Shared so that copies of a conversation (e.g. for async requests) can
+  // each pick up the result.
+  mutable std::shared_future<Recount> pending_recount_;
+
+  void append(Message message) {
+    size_t tokens = count_message_tokens(message);
+    append(std::move(message), tokens);
+  }
+
+  // A leading system message is pinned; everything else becomes a turn.
+  void append(Message message, size_t tokens) {
+    ContextStore::Entry entry(Message(std::move(message), store_.resource()),
+                              next_seq_++, tokens);
+    if (entry.message.role == MessageRole::System && store_.empty()) {
+      store_.set_system(std::move(entry));
+    } else {
+      if (index_) {
+        index_->add(entry.seq, entry.message.content);
+      }
+      store_.push_back(std::move(entry));
+    }
+    total_tokens_ += tokens;
+  }
+
+  void apply_pending_recount(bool wait) const;
+
+  const RelevanceIndex &relevance_index() const;
 };
 
-} // namespace llm
\ No newline at end of file
+} // namespace llm
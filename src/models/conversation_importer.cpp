@@ -0,0 +1,256 @@
+#include "models/conversation_importer.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace llm {
+
+namespace {
+
+bool is_content_key(std::string_view key) {
+  return key == "content" || key == "parts";
+}
+
+void append_text(std::optional<std::string> &target, std::string_view text) {
+  if (!target) {
+    target.emplace(text);
+    return;
+  }
+  if (!target->empty() && !text.empty()) {
+    target->push_back('\n');
+  }
+  target->append(text);
+}
+
+std::string_view trim(std::string_view text) {
+  const char *space = " \t\r\n";
+  auto first = text.find_first_not_of(space);
+  if (first == std::string_view::npos) {
+    return {};
+  }
+  return text.substr(first, text.find_last_not_of(space) - first + 1);
+}
+
+// SAX handler that keeps one frame per open object or array and turns
+// objects with a role and content into messages when they close.
+class MessageCollector : public nlohmann::json_sax<nlohmann::json> {
+public:
+  explicit MessageCollector(const ConversationImporter::Sink &sink)
+      : sink_(sink) {}
+
+  size_t count() const { return count_; }
+  const std::string &error() const { return error_; }
+
+  bool null() override { return true; }
+  bool boolean(bool) override { return true; }
+  bool number_integer(number_integer_t) override { return true; }
+  bool number_unsigned(number_unsigned_t) override { return true; }
+  bool number_float(number_float_t, const string_t &) override { return true; }
+  bool binary(binary_t &) override { return true; }
+
+  bool string(string_t &value) override {
+    if (frames_.empty()) {
+      return true;
+    }
+    Frame &top = frames_.back();
+    if (!top.object) {
+      if (is_content_key(top.key)) {
+        append_text(top.content, value);
+      }
+    } else if (top.field == "role" || top.field == "sender") {
+      top.role = std::move(value);
+    } else if (is_content_key(top.field)) {
+      append_text(top.content, value);
+    } else if (top.field == "text") {
+      top.text = std::move(value);
+    }
+    return true;
+  }
+
+  bool start_object(std::size_t) override {
+    push(true);
+    return true;
+  }
+
+  bool key(string_t &value) override {
+    frames_.back().field = std::move(value);
+    return true;
+  }
+
+  bool end_object() override {
+    Frame frame = std::move(frames_.back());
+    frames_.pop_back();
+
+    auto role =
+        frame.role ? ConversationImporter::parse_role(*frame.role) : std::nullopt;
+    if (role && (frame.content || frame.text)) {
+      sink_(Message(*role, frame.content ? *frame.content : *frame.text));
+      ++count_;
+      return true;
+    }
+    if (frames_.empty()) {
+      return true;
+    }
+
+    Frame &parent = frames_.back();
+    if (!parent.object) {
+      // A part such as {"type": "text", "text": "..."}.
+      if (is_content_key(parent.key) && (frame.text || frame.content)) {
+        append_text(parent.content, frame.text ? *frame.text : *frame.content);
+      }
+    } else if (frame.key == "author" && frame.role) {
+      parent.role = std::move(frame.role);
+    } else if (is_content_key(frame.key) && frame.content) {
+      // ChatGPT's {"content_type": "text", "parts": [...]}.
+      append_text(parent.content, *frame.content);
+    }
+    return true;
+  }
+
+  bool start_array(std::size_t) override {
+    push(false);
+    return true;
+  }
+
+  bool end_array() override {
+    Frame frame = std::move(frames_.back());
+    frames_.pop_back();
+    if (!frames_.empty() && frames_.back().object &&
+        is_content_key(frame.key)) {
+      append_text(frames_.back().content, frame.content.value_or(""));
+    }
+    return true;
+  }
+
+  bool parse_error(std::size_t, const std::string &,
+                   const nlohmann::detail::exception &e) override {
+    error_ = e.what();
+    return false;
+  }
+
+private:
+  struct Frame {
+    bool object;
+    std::string key;   // field of the parent object holding this value
+    std::string field; // current field, for objects
+    std::optional<std::string> role;
+    std::optional<std::string> content;
+    std::optional<std::string> text;
+  };
+
+  const ConversationImporter::Sink &sink_;
+  std::vector<Frame> frames_;
+  size_t count_ = 0;
+  std::string error_;
+
+  void push(bool object) {
+    Frame frame{object, {}, {}, {}, {}, {}};
+    if (!frames_.empty() && frames_.back().object) {
+      frame.key = frames_.back().field;
+    }
+    frames_.push_back(std::move(frame));
+  }
+};
+
+size_t parse(std::string_view text, const ConversationImporter::Sink &sink) {
+  MessageCollector collector(sink);
+  if (!nlohmann::json::sax_parse(text.begin(), text.end(), &collector)) {
+    throw std::runtime_error(collector.error());
+  }
+  return collector.count();
+}
+
+} // namespace
+
+ConversationImporter::ConversationImporter(size_t threads)
+    : threads_(threads ? threads
+                       : std::max<size_t>(1, std::thread::hardware_concurrency())) {}
+
+std::optional<MessageRole>
+ConversationImporter::parse_role(std::string_view name) {
+  if (name == "user" || name == "human") {
+    return MessageRole::User;
+  }
+  if (name == "assistant" || name == "ai" || name == "model" ||
+      name == "bot") {
+    return MessageRole::Assistant;
+  }
+  if (name == "system" || name == "developer") {
+    return MessageRole::System;
+  }
+  return std::nullopt;
+}
+
+bool ConversationImporter::is_json_lines(std::string_view text) {
+  text = trim(text);
+  auto newline = text.find('\n');
+  if (newline == std::string_view::npos) {
+    return false;
+  }
+  auto first = trim(text.substr(0, newline));
+  auto rest = trim(text.substr(newline));
+  return first.size() >= 2 && first.front() == '{' && first.back() == '}' &&
+         !rest.empty() && rest.front() == '{';
+}
+
+size_t ConversationImporter::import(std::string_view text,
+                                    const Sink &sink) const {
+  return is_json_lines(text) ? import_lines(text, sink) : parse(text, sink);
+}
+
+size_t ConversationImporter::import_lines(std::string_view text,
+                                          const Sink &sink) const {
+  auto parse_chunk = [](std::string_view chunk) {
+    std::vector<Message> messages;
+    Sink collect = [&messages](Message &&message) {
+      messages.push_back(std::move(message));
+    };
+    while (!chunk.empty()) {
+      auto newline = chunk.find('\n');
+      auto line = trim(chunk.substr(0, newline));
+      chunk.remove_prefix(newline == std::string_view::npos ? chunk.size()
+                                                            : newline + 1);
+      if (!line.empty()) {
+        parse(line, collect);
+      }
+    }
+    return messages;
+  };
+
+  // Chunks are handed to the sink in input order; reading ahead is capped
+  // at one chunk per thread.
+  std::deque<std::future<std::vector<Message>>> in_flight;
+  size_t count = 0;
+  auto drain_one = [&] {
+    for (auto &message : in_flight.front().get()) {
+      sink(std::move(message));
+      ++count;
+    }
+    in_flight.pop_front();
+  };
+
+  while (!text.empty()) {
+    size_t end = std::min(CHUNK_BYTES, text.size());
+    auto newline = text.find('\n', end);
+    end = newline == std::string_view::npos ? text.size() : newline + 1;
+
+    if (in_flight.size() >= threads_) {
+      drain_one();
+    }
+    in_flight.push_back(
+        std::async(std::launch::async, parse_chunk, text.substr(0, end)));
+    text.remove_prefix(end);
+  }
+  while (!in_flight.empty()) {
+    drain_one();
+  }
+  return count;
+}
+
+} // namespace llm
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string_view>
+
+#include "models/message.hpp"
+
+namespace llm {
+
+// Builds messages from JSON as it is parsed (SAX), without a DOM, so memory
+// stays at the messages themselves rather than several times the input.
+//
+// Any object with a role and content becomes a message, in document order,
+// which covers our own format (an array of {role, content}), OpenAI-style
+// {"messages": [...]} requests and fine-tuning JSONL, ChatGPT exports
+// (author.role and content.parts) and claude.ai exports (sender and
+// text/content parts). Objects with other roles (tools, functions) and
+// without content are skipped.
+//
+// JSON Lines input is split into chunks at line boundaries and parsed on
+// worker threads, with at most one chunk per thread in flight, so a
+// multi-GB archive imports in parallel without holding more than that many
+// chunks' messages at once. A single JSON document is parsed sequentially.
+class ConversationImporter {
+public:
+  using Sink = std::function<void(Message &&)>;
+
+  // JSON Lines input is parsed in chunks of about this size.
+  static constexpr size_t CHUNK_BYTES = 8 << 20;
+
+  // `threads` of 0 uses the hardware concurrency.
+  explicit ConversationImporter(size_t threads = 0);
+
+  // Passes every message in `text` to `sink` in order and returns how many
+  // there were. Throws std::runtime_error on malformed JSON.
+  size_t import(std::string_view text, const Sink &sink) const;
+
+  // True if `text` looks like one JSON object per line rather than a single
+  // document.
+  static bool is_json_lines(std::string_view text);
+
+  // Maps a role name used by any of the supported formats to ours.
+  static std::optional<MessageRole> parse_role(std::string_view name);
+
+private:
+  size_t threads_;
+
+  size_t import_lines(std::string_view text, const Sink &sink) const;
+};
+
+} // namespace llm
@@ -0,0 +1,54 @@
+#include "models/conversation_tree.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace llm {
+
+bool ConversationTree::fork(Conversation &active, const std::string &name,
+                            size_t turns) {
+  if (contains(name)) {
+    return false;
+  }
+
+  Conversation branch = active.fork(turns);
+  auto &stashed = branches_.at(current_);
+  stashed.conversation = std::move(active);
+  active = std::move(branch);
+
+  auto &created = branches_[name];
+  created.parent = std::exchange(current_, name);
+  created.fork_turn = std::min(turns, active.turn_count());
+  return true;
+}
+
+bool ConversationTree::checkout(Conversation &active, const std::string &name) {
+  auto it = branches_.find(name);
+  if (it == branches_.end()) {
+    return false;
+  }
+  if (name == current_) {
+    return true;
+  }
+
+  branches_.at(current_).conversation = std::move(active);
+  active = std::move(it->second.conversation);
+  it->second.conversation = Conversation();
+  current_ = name;
+  return true;
+}
+
+std::vector<ConversationTree::BranchInfo>
+ConversationTree::branches(const Conversation &active) const {
+  std::vector<BranchInfo> result;
+  result.reserve(branches_.size());
+  for (const auto &[name, branch] : branches_) {
+    bool current = name == current_;
+    const auto &conversation = current ? active : branch.conversation;
+    result.push_back(
+        {name, branch.parent, branch.fork_turn, conversation.size(), current});
+  }
+  return result;
+}
+
+} // namespace llm
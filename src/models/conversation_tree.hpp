@@ -0,0 +1,60 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "models/conversation.hpp"
+
+namespace llm {
+
+// Named branches of one conversation. The active branch is held by the
+// caller (the REPL keeps working on a plain Conversation); the others are
+// stashed here. Branches are Conversation copies, so a fork shares its
+// prefix, including the cached JSON of every turn in it, with the branch it
+// came from, and switching branches copies nothing. Requests on a branch
+// splice those cached fragments into the body, so only turns added on the
+// branch are serialized; the prefix text is still copied into each body.
+class ConversationTree {
+public:
+  static constexpr const char *ROOT_BRANCH = "main";
+
+  struct BranchInfo {
+    std::string name;
+    std::string parent; // empty for the root
+    size_t fork_turn = 0; // turns taken over from the parent
+    size_t messages = 0;
+    bool current = false;
+  };
+
+  ConversationTree() { branches_[ROOT_BRANCH]; }
+
+  const std::string &current() const { return current_; }
+  bool contains(const std::string &name) const {
+    return branches_.count(name) != 0;
+  }
+
+  // Creates branch `name` from the first `turns` turns of `active` and checks
+  // it out, stashing `active` under the current branch. Returns false if the
+  // name is taken.
+  bool fork(Conversation &active, const std::string &name, size_t turns);
+
+  // Stashes `active` under the current branch and replaces it with branch
+  // `name`. Returns false if there is no such branch.
+  bool checkout(Conversation &active, const std::string &name);
+
+  // All branches in name order; the current one is described by `active`.
+  std::vector<BranchInfo> branches(const Conversation &active) const;
+
+private:
+  struct Branch {
+    Conversation conversation; // stale while the branch is checked out
+    std::string parent;
+    size_t fork_turn = 0;
+  };
+
+  std::map<std::string, Branch> branches_;
+  std::string current_ = ROOT_BRANCH;
+};
+
+} // namespace llm
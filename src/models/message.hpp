@@ -1,31 +1,59 @@
 #pragma once
 
+#include <memory_resource>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <string_view>
+#include <utility>
 
 namespace llm {
 
 enum class MessageRole { System, User, Assistant };
 
 struct Message {
+  // Allocator-aware so that a Conversation can keep contents in its arena.
+  // Copies allocate from the default resource; moves keep the source's.
+  using Content = std::pmr::string;
+
   MessageRole role;
-  std::string content;
+  Content content;
+
+  Message(MessageRole r, std::string_view c,
+          std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+      : role(r), content(c, resource) {}
+
+  Message(MessageRole r, const char *c,
+          std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+      : role(r), content(c, resource) {}
+
+  Message(MessageRole r, Content &&c) : role(r), content(std::move(c)) {}
+
+  Message(const Message &) = default;
+  Message(Message &&) noexcept = default;
+  Message &operator=(const Message &) = default;
+  Message &operator=(Message &&) = default;
 
-  Message(MessageRole r, const std::string &c) : role(r), content(c) {}
+  // Re-homes `other` in `resource`: a move if it is already allocated there,
+  // otherwise a copy.
+  Message(Message &&other, std::pmr::memory_resource *resource)
+      : role(other.role), content(std::move(other.content), resource) {}
 
   nlohmann::json to_json() const {
     nlohmann::json j;
-    j["role"] = role_to_string(role);
-    j["content"] = content;
+    j["role"] = role_name(role);
+    j["content"] = std::string_view(content);
     return j;
   }
 
-  static Message from_json(const nlohmann::json &j) {
-    return Message(string_to_role(j["role"]), j["content"]);
+  static Message
+  from_json(const nlohmann::json &j,
+            std::pmr::memory_resource *resource = std::pmr::get_default_resource()) {
+    return Message(role_from_name(j.at("role").get_ref<const std::string &>()),
+                   std::string_view(j.at("content").get_ref<const std::string &>()),
+                   resource);
   }
 
-private:
-  static std::string role_to_string(MessageRole role) {
+  static constexpr std::string_view role_name(MessageRole role) {
     switch (role) {
     case MessageRole::System:
       return "system";
@@ -38,13 +66,13 @@ private:
     }
   }
 
-  static MessageRole string_to_role(const std::string &role_str) {
-    if (role_str == "system")
+  static MessageRole role_from_name(std::string_view name) {
+    if (name == "system")
       return MessageRole::System;
-    if (role_str == "assistant")
+    if (name == "assistant")
       return MessageRole::Assistant;
     return MessageRole::User;
   }
 };
 
-} // namespace llm
\ No newline at end of file
+} // namespace llm
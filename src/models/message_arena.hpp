@@ -0,0 +1,33 @@
+#pragma once
+
+#include <memory_resource>
+
+namespace llm {
+
+// Backing memory for the messages of one conversation. Contents are carved
+// out of large chunks instead of being allocated one by one, space freed by
+// evicted turns is reused, and release() hands every chunk back at once.
+//
+// Held by shared_ptr from the storage that allocates from it, so that it
+// outlives every message even when copies of a conversation are destroyed in
+// any order. Synchronized because those copies may free messages from other
+// threads.
+class MessageArena {
+public:
+  // Contents up to this size are pooled; larger ones go straight to the heap.
+  static constexpr size_t LARGEST_POOLED_BYTES = 64 * 1024;
+
+  MessageArena() : resource_(std::pmr::pool_options{0, LARGEST_POOLED_BYTES}) {}
+  MessageArena(const MessageArena &) = delete;
+  MessageArena &operator=(const MessageArena &) = delete;
+
+  std::pmr::memory_resource *resource() { return &resource_; }
+
+  // Frees all chunks. Every string allocated here must already be destroyed.
+  void release() { resource_.release(); }
+
+private:
+  std::pmr::synchronized_pool_resource resource_;
+};
+
+} // namespace llm
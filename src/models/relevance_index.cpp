@@ -0,0 +1,112 @@
+#include "models/relevance_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace llm {
+
+void RelevanceIndex::add(uint64_t seq, std::string_view text) {
+  if (contains(seq)) {
+    // Re-indexing in place: drop the old postings now so they are not
+    // mistaken for the new ones.
+    remove(seq);
+    compact();
+  }
+
+  std::unordered_map<std::string, uint32_t> frequencies;
+  uint32_t length = 0;
+  for_each_term(text, [&](std::string_view term) {
+    ++frequencies[std::string(term)];
+    ++length;
+  });
+
+  for (auto &[term, frequency] : frequencies) {
+    postings_[term].push_back({seq, frequency});
+  }
+  docs_.emplace(seq, Document{length, static_cast<uint32_t>(frequencies.size())});
+  total_length_ += length;
+  live_postings_ += frequencies.size();
+}
+
+void RelevanceIndex::remove(uint64_t seq) {
+  auto it = docs_.find(seq);
+  if (it == docs_.end()) {
+    return;
+  }
+
+  total_length_ -= it->second.length;
+  live_postings_ -= it->second.distinct;
+  stale_postings_ += it->second.distinct;
+  docs_.erase(it);
+
+  if (stale_postings_ > live_postings_) {
+    compact();
+  }
+}
+
+void RelevanceIndex::clear() {
+  postings_.clear();
+  docs_.clear();
+  total_length_ = 0;
+  live_postings_ = 0;
+  stale_postings_ = 0;
+}
+
+void RelevanceIndex::compact() {
+  for (auto it = postings_.begin(); it != postings_.end();) {
+    auto &list = it->second;
+    list.erase(std::remove_if(list.begin(), list.end(),
+                              [this](const Posting &p) { return !contains(p.seq); }),
+               list.end());
+    it = list.empty() ? postings_.erase(it) : std::next(it);
+  }
+  stale_postings_ = 0;
+}
+
+std::unordered_map<uint64_t, double>
+RelevanceIndex::score(std::string_view query) const {
+  std::unordered_map<uint64_t, double> scores;
+  if (docs_.empty()) {
+    return scores;
+  }
+
+  std::vector<std::string> terms;
+  for_each_term(query, [&terms](std::string_view term) {
+    if (std::find(terms.begin(), terms.end(), term) == terms.end()) {
+      terms.emplace_back(term);
+    }
+  });
+
+  const double n = static_cast<double>(docs_.size());
+  const double average_length =
+      std::max(1.0, static_cast<double>(total_length_) / n);
+
+  for (const auto &term : terms) {
+    auto it = postings_.find(term);
+    if (it == postings_.end()) {
+      continue;
+    }
+
+    size_t df = 0;
+    for (const auto &posting : it->second) {
+      df += contains(posting.seq) ? 1 : 0;
+    }
+    if (df == 0) {
+      continue;
+    }
+
+    double idf = std::log(1.0 + (n - df + 0.5) / (df + 0.5));
+    for (const auto &posting : it->second) {
+      auto doc = docs_.find(posting.seq);
+      if (doc == docs_.end()) {
+        continue;
+      }
+      double tf = posting.frequency;
+      double norm = K1 * (1.0 - B + B * doc->second.length / average_length);
+      scores[posting.seq] += idf * tf * (K1 + 1.0) / (tf + norm);
+    }
+  }
+  return scores;
+}
+
+} // namespace llm
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace llm {
+
+// Incremental BM25 index over conversation turns, keyed by the turn's
+// sequence number. Adding a turn touches only that turn's terms; removed
+// turns are skipped at query time and their postings are compacted once they
+// outnumber the live ones, so both operations are amortized O(terms).
+class RelevanceIndex {
+public:
+  static constexpr double K1 = 1.2;
+  static constexpr double B = 0.75;
+
+  void add(uint64_t seq, std::string_view text);
+  void remove(uint64_t seq);
+  void clear();
+
+  size_t size() const { return docs_.size(); }
+  bool contains(uint64_t seq) const { return docs_.count(seq) != 0; }
+
+  // BM25 score of every indexed turn sharing a term with `query`. Turns with
+  // no shared term are absent.
+  std::unordered_map<uint64_t, double> score(std::string_view query) const;
+
+  // Calls `emit` with each lower-cased term: runs of ASCII letters and digits
+  // or UTF-8 sequences, at least two bytes long.
+  template <typename Fn> static void for_each_term(std::string_view text, Fn &&emit) {
+    std::string term;
+    auto flush = [&]() {
+      if (term.size() >= 2) {
+        emit(std::string_view(term));
+      }
+      term.clear();
+    };
+    for (char ch : text) {
+      auto c = static_cast<unsigned char>(ch);
+      if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80) {
+        term.push_back(ch);
+      } else if (c >= 'A' && c <= 'Z') {
+        term.push_back(static_cast<char>(c - 'A' + 'a'));
+      } else {
+        flush();
+      }
+    }
+    flush();
+  }
+
+private:
+  struct Posting {
+    uint64_t seq;
+    uint32_t frequency;
+  };
+
+  struct Document {
+    uint32_t length;   // terms in the turn
+    uint32_t distinct; // postings it owns
+  };
+
+  std::unordered_map<std::string, std::vector<Posting>> postings_;
+  std::unordered_map<uint64_t, Document> docs_;
+  size_t total_length_ = 0;
+  size_t live_postings_ = 0;
+  size_t stale_postings_ = 0;
+
+  void compact();
+};
+
+} // namespace llm
@@ -0,0 +1,252 @@
+#include "models/session_file.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef LLM_REPL_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "models/conversation.hpp"
+#include "utils/durable_file.hpp"
+#include "utils/logger.hpp"
+
+namespace llm {
+
+namespace {
+
+void put_u16(std::string &out, uint16_t value) {
+  for (int i = 0; i < 2; ++i) {
+    out.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+void put_u32(std::string &out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+void put_u64(std::string &out, uint64_t value) {
+  for (int i = 0; i < 8; ++i) {
+    out.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+uint64_t get_le(const unsigned char *p, int bytes) {
+  uint64_t value = 0;
+  for (int i = bytes - 1; i >= 0; --i) {
+    value = (value << 8) | p[i];
+  }
+  return value;
+}
+
+void put_string(std::string &table, std::string_view text) {
+  put_u32(table, static_cast<uint32_t>(text.size()));
+  table.append(text);
+}
+
+} // namespace
+
+bool SessionFile::has_extension(const std::string &path) {
+  std::string_view extension = EXTENSION;
+  return path.size() >= extension.size() &&
+         path.compare(path.size() - extension.size(), extension.size(),
+                      extension) == 0;
+}
+
+bool SessionFile::is_session_file(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  char magic[sizeof(MAGIC)] = {};
+  return file.read(magic, sizeof(magic)) &&
+         std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool SessionFile::write(const std::string &path,
+                        const Conversation &conversation, bool compress) {
+  const size_t count = conversation.size();
+
+  std::string table;
+  put_string(table, conversation.tokenizer().name());
+  std::string index;
+  index.reserve(count * INDEX_ENTRY_SIZE);
+  for (size_t i = 0; i < count; ++i) {
+    const auto &message = conversation.messages()[i];
+    index.push_back(static_cast<char>(message.role));
+    index.append(3, '\0');
+    put_u32(index, static_cast<uint32_t>(conversation.message_tokens(i)));
+    put_u64(index, table.size());
+    put_string(table, message.content);
+  }
+
+  uint16_t flags = 0;
+  const uint64_t raw_size = table.size();
+#ifdef LLM_REPL_HAVE_ZSTD
+  if (compress) {
+    std::string packed(ZSTD_compressBound(table.size()), '\0');
+    size_t written = ZSTD_compress(packed.data(), packed.size(), table.data(),
+                                   table.size(), ZSTD_CLEVEL_DEFAULT);
+    if (!ZSTD_isError(written)) {
+      packed.resize(written);
+      table = std::move(packed);
+      flags |= FLAG_ZSTD;
+    }
+  }
+#else
+  if (compress) {
+    spdlog::debug("Built without zstd; writing {} uncompressed", path);
+  }
+#endif
+
+  std::string header(MAGIC, sizeof(MAGIC));
+  put_u16(header, VERSION);
+  put_u16(header, flags);
+  put_u32(header, static_cast<uint32_t>(count));
+  put_u32(header, 0);
+  put_u64(header, HEADER_SIZE);
+  put_u64(header, HEADER_SIZE + index.size());
+  put_u64(header, table.size());
+  put_u64(header, raw_size);
+  put_u64(header, 0); // the tokenizer name is the first string
+
+  // Replaced by rename: a conversation loaded from the old file may still
+  // be reading its contents through a mapping.
+  header.reserve(header.size() + index.size() + table.size());
+  header += index;
+  header += table;
+  return write_file_durably(path, header);
+}
+
+bool SessionFile::open(const std::string &path) {
+  inflated_.clear();
+  table_ = {};
+  index_ = nullptr;
+  message_count_ = 0;
+  tokenizer_.clear();
+  path_ = path;
+
+  if (!file_.open(path)) {
+    return false;
+  }
+  const auto *data = reinterpret_cast<const unsigned char *>(file_.data());
+  const size_t size = file_.size();
+  if (size < HEADER_SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+    spdlog::warn("Not a session file: {}", path);
+    return false;
+  }
+
+  auto version = static_cast<uint16_t>(get_le(data + 4, 2));
+  auto flags = static_cast<uint16_t>(get_le(data + 6, 2));
+  uint64_t count = get_le(data + 8, 4);
+  uint64_t index_offset = get_le(data + 16, 8);
+  uint64_t table_offset = get_le(data + 24, 8);
+  uint64_t table_size = get_le(data + 32, 8);
+  [[maybe_unused]] uint64_t raw_size = get_le(data + 40, 8);
+  uint64_t tokenizer_offset = get_le(data + 48, 8);
+
+  if (version > VERSION) {
+    spdlog::warn("Session file {} has unsupported version {}", path, version);
+    return false;
+  }
+  if (index_offset > size || count > (size - index_offset) / INDEX_ENTRY_SIZE ||
+      table_offset > size || table_size > size - table_offset) {
+    spdlog::warn("Truncated session file: {}", path);
+    return false;
+  }
+
+  const char *stored = file_.data() + table_offset;
+  if (flags & FLAG_ZSTD) {
+#ifdef LLM_REPL_HAVE_ZSTD
+    // The sizes come from the file; check them against the frame before
+    // allocating.
+    unsigned long long frame_size = ZSTD_getFrameContentSize(stored, table_size);
+    if (raw_size > MAX_INFLATED_BYTES || frame_size != raw_size) {
+      spdlog::warn("Corrupt compressed session file: {}", path);
+      return false;
+    }
+    inflated_.resize(raw_size);
+    size_t read =
+        ZSTD_decompress(inflated_.data(), inflated_.size(), stored, table_size);
+    if (ZSTD_isError(read) || read != raw_size) {
+      spdlog::warn("Corrupt compressed session file: {}", path);
+      return false;
+    }
+    table_ = inflated_;
+#else
+    spdlog::warn("Session file {} is zstd-compressed, but this build has no "
+                 "zstd support",
+                 path);
+    return false;
+#endif
+  } else {
+    table_ = std::string_view(stored, table_size);
+  }
+
+  index_ = data + index_offset;
+  message_count_ = count;
+
+  // Check every index entry now so that accessors can trust it; this reads
+  // only the index, not the contents.
+  bool ok = true;
+  tokenizer_ = std::string(string_at(tokenizer_offset, ok));
+  for (size_t i = 0; ok && i < message_count_; ++i) {
+    const unsigned char *entry = index_ + i * INDEX_ENTRY_SIZE;
+    ok = entry[0] <= static_cast<unsigned char>(MessageRole::Assistant);
+    uint64_t offset = get_le(entry + 8, 8);
+    ok = ok && offset <= table_.size() && table_.size() - offset >= 4;
+  }
+  if (!ok) {
+    spdlog::warn("Corrupt session file index: {}", path);
+    message_count_ = 0;
+    return false;
+  }
+  return true;
+}
+
+MessageRole SessionFile::role(size_t index) const {
+  return static_cast<MessageRole>(index_[index * INDEX_ENTRY_SIZE]);
+}
+
+size_t SessionFile::tokens(size_t index) const {
+  return get_le(index_ + index * INDEX_ENTRY_SIZE + 4, 4);
+}
+
+std::string_view SessionFile::content(size_t index) const {
+  bool ok = true;
+  auto text = string_at(get_le(index_ + index * INDEX_ENTRY_SIZE + 8, 8), ok);
+  if (!ok) {
+    throw std::runtime_error("Session file message " + std::to_string(index) +
+                             " runs past the end of the file");
+  }
+  return text;
+}
+
+uint64_t SessionFile::content_offset(size_t index) const {
+  return get_le(index_ + index * INDEX_ENTRY_SIZE + 8, 8) + 4;
+}
+
+bool SessionFile::read(uint64_t offset, size_t size,
+                       const std::function<void(std::string_view)> &fn) {
+  if (offset > table_.size() || size > table_.size() - offset) {
+    return false;
+  }
+  fn(table_.substr(offset, size));
+  return true;
+}
+
+std::string_view SessionFile::string_at(uint64_t offset, bool &ok) const {
+  if (offset > table_.size() || table_.size() - offset < 4) {
+    ok = false;
+    return {};
+  }
+  const auto *p = reinterpret_cast<const unsigned char *>(table_.data() + offset);
+  uint64_t length = get_le(p, 4);
+  if (length > table_.size() - offset - 4) {
+    ok = false;
+    return {};
+  }
+  return table_.substr(offset + 4, length);
+}
+
+} // namespace llm
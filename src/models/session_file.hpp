@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "models/cold_file.hpp"
+#include "models/message.hpp"
+#include "utils/mapped_file.hpp"
+
+namespace llm {
+
+class Conversation;
+
+// Versioned binary conversation file. All integers are little-endian.
+//
+//   header   magic "LLMS", u16 version, u16 flags, u32 message count,
+//            u32 reserved, u64 index offset, u64 table offset, u64 table
+//            size on disk, u64 table size uncompressed, u64 offset of the
+//            tokenizer name in the table
+//   index    per message: u8 role, 3 bytes padding, u32 token count,
+//            u64 offset of its content in the table
+//   table    strings, each a u32 length followed by the bytes; stored as
+//            one zstd frame when FLAG_ZSTD is set
+//
+// Token counts are those of the named tokenizer, so a conversation loaded
+// under the same tokenizer is not re-tokenized. Uncompressed files are read
+// through a memory mapping: opening one only validates the index, and a
+// message's content is paged in when it is first read. A conversation
+// loaded from the file keeps it open as the ColdSource of its older turns,
+// so files are replaced by rename, never rewritten in place.
+class SessionFile : public ColdSource {
+public:
+  static constexpr char MAGIC[4] = {'L', 'L', 'M', 'S'};
+  static constexpr uint16_t VERSION = 1;
+  static constexpr uint16_t FLAG_ZSTD = 1;
+  static constexpr size_t HEADER_SIZE = 56;
+  static constexpr size_t INDEX_ENTRY_SIZE = 16;
+  // Files saved with this extension use this format rather than JSON.
+  static constexpr const char *EXTENSION = ".session";
+  // Largest string table a compressed file may inflate to.
+  static constexpr uint64_t MAX_INFLATED_BYTES = uint64_t{1} << 32;
+
+  static bool has_extension(const std::string &path);
+
+  // True if `path` starts with the magic bytes.
+  static bool is_session_file(const std::string &path);
+
+  // Writes `conversation`, compressing the string table with zstd if
+  // requested and available. Returns false on I/O errors.
+  static bool write(const std::string &path, const Conversation &conversation,
+                    bool compress = false);
+
+  // Maps `path` and validates its header and index. Returns false, logging
+  // the reason, if the file is unreadable, malformed, from a newer version or
+  // compressed without zstd support.
+  bool open(const std::string &path);
+
+  size_t size() const { return message_count_; }
+  const std::string &tokenizer() const { return tokenizer_; }
+
+  MessageRole role(size_t index) const;
+  size_t tokens(size_t index) const;
+  std::string_view content(size_t index) const;
+  // Where content(index) starts, as an offset for read().
+  uint64_t content_offset(size_t index) const;
+
+  const std::string &path() const override { return path_; }
+  // Reads from the (inflated) string table.
+  bool read(uint64_t offset, size_t size,
+            const std::function<void(std::string_view)> &fn) override;
+
+private:
+  std::string path_;
+  MappedFile file_;
+  std::string inflated_; // decompressed table of a zstd file
+  std::string_view table_;
+  const unsigned char *index_ = nullptr;
+  size_t message_count_ = 0;
+  std::string tokenizer_;
+
+  // The string at `offset` in the table; clears `ok` if it runs past the
+  // end.
+  std::string_view string_at(uint64_t offset, bool &ok) const;
+};
+
+} // namespace llm
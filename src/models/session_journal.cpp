@@ -0,0 +1,596 @@
+#include "models/session_journal.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "utils/logger.hpp"
+#include "utils/mapped_file.hpp"
+
+namespace llm {
+
+namespace {
+
+// Encoded snapshot bytes are written out whenever this much has accumulated.
+constexpr size_t REWRITE_CHUNK_BYTES = 1 << 20;
+
+constexpr std::array<uint32_t, 256> CRC_TABLE = [] {
+  std::array<uint32_t, 256> table{};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; ++k) {
+      c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    }
+    table[i] = c;
+  }
+  return table;
+}();
+
+uint32_t crc32_update(uint32_t crc, std::string_view bytes) {
+  crc = ~crc;
+  for (unsigned char byte : bytes) {
+    crc = CRC_TABLE[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+void put_u16(std::string &out, uint16_t value) {
+  for (int i = 0; i < 2; ++i) {
+    out.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+void put_u32(std::string &out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+uint32_t get_u32(const char *p) {
+  uint32_t value = 0;
+  for (int i = 3; i >= 0; --i) {
+    value = (value << 8) | static_cast<unsigned char>(p[i]);
+  }
+  return value;
+}
+
+void put_u64(std::string &out, uint64_t value) {
+  for (int i = 0; i < 8; ++i) {
+    out.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+uint64_t get_u64(const char *p) {
+  return static_cast<uint64_t>(get_u32(p + 4)) << 32 | get_u32(p);
+}
+
+std::string encode_header() {
+  std::string header(SessionJournal::MAGIC, sizeof(SessionJournal::MAGIC));
+  put_u16(header, SessionJournal::VERSION);
+  put_u16(header, 0);
+  return header;
+}
+
+void encode_record(std::string &out, SessionJournal::Op op, MessageRole role,
+                   std::string_view content) {
+  const char prefix[2] = {static_cast<char>(op), static_cast<char>(role)};
+  uint32_t crc = crc32_update(0, std::string_view(prefix, 2));
+  crc = crc32_update(crc, content);
+  put_u32(out, static_cast<uint32_t>(content.size() + 2));
+  put_u32(out, crc);
+  out.append(prefix, 2);
+  out.append(content);
+}
+
+void encode_blob_record(std::string &out, MessageRole role,
+                        const ContentHash &hash) {
+  std::string reference;
+  put_u64(reference, hash.high);
+  put_u64(reference, hash.low);
+  encode_record(out, SessionJournal::Op::AppendBlob, role, reference);
+}
+
+std::optional<ContentHash> decode_blob_reference(std::string_view content) {
+  if (content.size() != 16) {
+    return std::nullopt;
+  }
+  return ContentHash{get_u64(content.data()), get_u64(content.data() + 8)};
+}
+
+// Whether `data` starts with a journal header this version can read.
+bool readable_header(std::string_view data, const std::string &path) {
+  if (data.size() < SessionJournal::HEADER_SIZE ||
+      std::memcmp(data.data(), SessionJournal::MAGIC,
+                  sizeof(SessionJournal::MAGIC)) != 0) {
+    spdlog::warn("Not a session journal: {}", path);
+    return false;
+  }
+  uint16_t version = static_cast<unsigned char>(data[4]) |
+                     static_cast<unsigned char>(data[5]) << 8;
+  if (version > SessionJournal::VERSION) {
+    spdlog::warn("Session journal {} has unsupported version {}", path,
+                 version);
+    return false;
+  }
+  return true;
+}
+
+// Calls `visit(op, role, content)` for each intact record after the header,
+// stopping at the first torn or corrupt one or when `visit` returns false.
+// Returns the offset just past the last record visited.
+template <typename Visit>
+size_t for_each_record(std::string_view data, Visit &&visit) {
+  size_t offset = SessionJournal::HEADER_SIZE;
+  while (data.size() - offset >= SessionJournal::RECORD_HEADER_SIZE) {
+    uint32_t length = get_u32(data.data() + offset);
+    uint32_t crc = get_u32(data.data() + offset + 4);
+    if (length < 2 ||
+        length > data.size() - offset - SessionJournal::RECORD_HEADER_SIZE) {
+      break;
+    }
+    std::string_view payload =
+        data.substr(offset + SessionJournal::RECORD_HEADER_SIZE, length);
+    auto op = static_cast<SessionJournal::Op>(payload[0]);
+    auto role = static_cast<unsigned char>(payload[1]);
+    if (crc32_update(0, payload) != crc ||
+        role > static_cast<unsigned char>(MessageRole::Assistant) ||
+        (op != SessionJournal::Op::SetSystem &&
+         op != SessionJournal::Op::Append &&
+         op != SessionJournal::Op::AppendBlob) ||
+        !visit(op, static_cast<MessageRole>(role), payload.substr(2))) {
+      break;
+    }
+    offset += SessionJournal::RECORD_HEADER_SIZE + length;
+  }
+  return offset;
+}
+
+#ifdef _WIN32
+int open_for_append(const std::string &path, bool truncate) {
+  int flags = _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY;
+  if (truncate) {
+    flags |= _O_TRUNC;
+  }
+  return ::_open(path.c_str(), flags, _S_IREAD | _S_IWRITE);
+}
+void close_file(int fd) { ::_close(fd); }
+bool sync_file(int fd) { return ::_commit(fd) == 0; }
+// Windows commits the rename with the file's metadata.
+void sync_parent_dir(const std::string &) {}
+long long file_size(int fd) { return ::_filelengthi64(fd); }
+int write_some(int fd, const char *data, size_t size) {
+  return ::_write(fd, data, static_cast<unsigned>(size));
+}
+bool try_lock(int fd) {
+  OVERLAPPED overlapped{};
+  return LockFileEx(reinterpret_cast<HANDLE>(::_get_osfhandle(fd)),
+                    LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0,
+                    MAXDWORD, MAXDWORD, &overlapped) != 0;
+}
+// Windows cannot rename over a file others have open, so a locked journal
+// is never replaced.
+bool still_current(int, const std::string &) { return true; }
+#else
+int open_for_append(const std::string &path, bool truncate) {
+  int flags = O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC;
+  if (truncate) {
+    flags |= O_TRUNC;
+  }
+  return ::open(path.c_str(), flags, 0600);
+}
+void close_file(int fd) { ::close(fd); }
+bool sync_file(int fd) { return ::fdatasync(fd) == 0; }
+void sync_parent_dir(const std::string &path) {
+  auto parent = std::filesystem::path(path).parent_path();
+  int dir = ::open(parent.empty() ? "." : parent.c_str(),
+                   O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir >= 0) {
+    ::fsync(dir);
+    ::close(dir);
+  }
+}
+long long file_size(int fd) { return ::lseek(fd, 0, SEEK_END); }
+ssize_t write_some(int fd, const char *data, size_t size) {
+  return ::write(fd, data, size);
+}
+bool try_lock(int fd) {
+  int result;
+  do {
+    result = ::flock(fd, LOCK_EX | LOCK_NB);
+  } while (result != 0 && errno == EINTR);
+  return result == 0;
+}
+// Whether `fd` is still the file at `path`, not one a checkpoint replaced
+// or remove() deleted.
+bool still_current(int fd, const std::string &path) {
+  struct stat opened {};
+  struct stat current {};
+  return ::fstat(fd, &opened) == 0 && ::stat(path.c_str(), &current) == 0 &&
+         opened.st_dev == current.st_dev && opened.st_ino == current.st_ino;
+}
+#endif
+
+// Attempts to open the journal that a checkpoint left in place.
+constexpr int OPEN_ATTEMPTS = 8;
+
+bool write_all(int fd, std::string_view bytes) {
+  while (!bytes.empty()) {
+    auto written = write_some(fd, bytes.data(), bytes.size());
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes.remove_prefix(static_cast<size_t>(written));
+  }
+  return true;
+}
+
+} // namespace
+
+SessionJournal::SessionJournal(std::string path, BlobStore *blobs)
+    : path_(std::move(path)), blobs_(blobs),
+      writer_([this] { run_writer(); }) {}
+
+SessionJournal::~SessionJournal() {
+  stop_writer();
+  if (fd_ >= 0) {
+    close_file(fd_);
+  }
+}
+
+bool SessionJournal::acquire() {
+  for (int attempt = 0; attempt < OPEN_ATTEMPTS; ++attempt) {
+    int fd = open_for_append(path_, false);
+    if (fd < 0) {
+      return false;
+    }
+    if (!try_lock(fd)) {
+      close_file(fd);
+      return false;
+    }
+    if (still_current(fd, path_)) {
+      if (fd_ >= 0) {
+        close_file(fd_);
+      }
+      fd_ = fd;
+      locked_ = true;
+      return true;
+    }
+    close_file(fd);
+  }
+  return false;
+}
+
+std::optional<size_t> SessionJournal::recover(Conversation &conversation) {
+  std::error_code ec;
+  if (!std::filesystem::exists(path_, ec) ||
+      std::filesystem::file_size(path_, ec) == 0) {
+    return std::nullopt;
+  }
+
+  MappedFile file;
+  if (!file.open(path_)) {
+    spdlog::warn("Failed to read session journal: {}", path_);
+    return std::nullopt;
+  }
+  const std::string_view data = file.view();
+  const size_t size = data.size();
+  if (!readable_header(data, path_)) {
+    return std::nullopt;
+  }
+
+  conversation.clear();
+  size_t records = 0;
+  const size_t offset = for_each_record(data, [&](Op op, MessageRole role,
+                                                  std::string_view content) {
+    if (op == Op::AppendBlob) {
+      std::optional<std::string> blob;
+      auto hash = decode_blob_reference(content);
+      if (hash && blobs_) {
+        blob = blobs_->get(*hash);
+      }
+      if (!blob) {
+        spdlog::warn("Session journal {} references a missing blob", path_);
+        return false;
+      }
+      conversation.add_message(Message(role, std::string_view(*blob)));
+    } else if (op == Op::SetSystem) {
+      conversation.set_system_prompt(content);
+    } else {
+      conversation.add_message(Message(role, content));
+    }
+    ++records;
+    return true;
+  });
+  file.close();
+
+  if (offset < size) {
+    spdlog::warn("Dropping {} bytes of torn or corrupt records from {}",
+                 size - offset, path_);
+    std::filesystem::resize_file(path_, offset, ec);
+    if (ec) {
+      spdlog::warn("Failed to truncate session journal {}: {}", path_,
+                   ec.message());
+    }
+  }
+  return records;
+}
+
+std::optional<std::vector<ContentHash>>
+SessionJournal::blob_references(const std::string &path) {
+  std::vector<ContentHash> hashes;
+  std::error_code ec;
+  if (!std::filesystem::exists(path, ec) ||
+      std::filesystem::file_size(path, ec) == 0) {
+    return ec ? std::nullopt : std::make_optional(std::move(hashes));
+  }
+  MappedFile file;
+  if (!file.open(path)) {
+    spdlog::warn("Failed to read session journal: {}", path);
+    return std::nullopt;
+  }
+  if (!readable_header(file.view(), path)) {
+    return std::nullopt;
+  }
+  for_each_record(file.view(), [&](Op op, MessageRole,
+                                   std::string_view content) {
+    if (op == Op::AppendBlob) {
+      if (auto hash = decode_blob_reference(content)) {
+        hashes.push_back(*hash);
+      }
+    }
+    return true;
+  });
+  return hashes;
+}
+
+std::vector<std::string> SessionJournal::candidates(const std::string &path) {
+  std::filesystem::path journal(path);
+  const std::string prefix = journal.stem().string() + ".";
+  const std::string extension = journal.extension().string();
+  std::vector<std::string> fallbacks;
+  std::error_code ec;
+  auto dir = journal.parent_path();
+  for (std::filesystem::directory_iterator it(dir.empty() ? "." : dir, ec), end;
+       !ec && it != end; it.increment(ec)) {
+    std::string name = it->path().filename().string();
+    if (name.size() <= prefix.size() + extension.size() ||
+        !name.starts_with(prefix) || !name.ends_with(extension)) {
+      continue;
+    }
+    std::string_view pid(name);
+    pid = pid.substr(prefix.size(),
+                     name.size() - prefix.size() - extension.size());
+    if (std::all_of(pid.begin(), pid.end(),
+                    [](char c) { return c >= '0' && c <= '9'; })) {
+      fallbacks.push_back(it->path().string());
+    }
+  }
+  std::sort(fallbacks.begin(), fallbacks.end());
+  fallbacks.insert(fallbacks.begin(), path);
+  return fallbacks;
+}
+
+void SessionJournal::record_system(std::string_view prompt) {
+  std::string record;
+  encode_record(record, Op::SetSystem, MessageRole::System, prompt);
+  enqueue(std::move(record));
+}
+
+void SessionJournal::record_message(MessageRole role,
+                                    std::string_view content) {
+  std::string record;
+  if (!uses_blob(content)) {
+    encode_record(record, Op::Append, role, content);
+    enqueue(std::move(record));
+    return;
+  }
+  ContentHash hash = ContentHash::of(content);
+  encode_blob_record(record, role, hash);
+  enqueue(std::move(record), std::make_pair(hash, std::string(content)));
+}
+
+void SessionJournal::enqueue(
+    std::string record,
+    std::optional<std::pair<ContentHash, std::string>> blob) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    pending_ += record;
+    if (blob) {
+      pending_blobs_.push_back(std::move(*blob));
+    }
+    ++requested_;
+  }
+  wake_.notify_one();
+}
+
+void SessionJournal::checkpoint(const Conversation &conversation) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    // The snapshot already holds whatever these records would add.
+    pending_.clear();
+    pending_blobs_.clear();
+    checkpoint_ = conversation;
+    ++requested_;
+  }
+  wake_.notify_one();
+}
+
+bool SessionJournal::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const uint64_t target = requested_;
+  committed_.wait(lock, [&] { return durable_ >= target || stopped_; });
+  return !failed_;
+}
+
+void SessionJournal::remove() {
+  stop_writer();
+  std::error_code ec;
+  std::filesystem::remove(path_, ec);
+  // Deleted while still locked, so no other process can have taken over
+  // the file in between.
+  if (fd_ >= 0) {
+    close_file(fd_);
+    fd_ = -1;
+  }
+}
+
+uint64_t SessionJournal::sync_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return syncs_;
+}
+
+void SessionJournal::stop_writer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+}
+
+void SessionJournal::run_writer() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [&] {
+      return stopping_ || !pending_.empty() || checkpoint_.has_value();
+    });
+    if (pending_.empty() && !checkpoint_) {
+      // Stopping with nothing left to commit.
+      stopped_ = true;
+      committed_.notify_all();
+      return;
+    }
+
+    // Everything queued while the previous batch was being synced goes out
+    // in this one write and sync.
+    std::optional<Conversation> snapshot = std::move(checkpoint_);
+    checkpoint_.reset();
+    std::string batch;
+    batch.swap(pending_);
+    std::vector<std::pair<ContentHash, std::string>> blobs;
+    blobs.swap(pending_blobs_);
+    const uint64_t ticket = requested_;
+    lock.unlock();
+
+    bool ok = store_blobs(blobs) &&
+              (snapshot ? rewrite(*snapshot, batch) : append_and_sync(batch));
+    snapshot.reset();
+    blobs.clear();
+
+    lock.lock();
+    if (!ok) {
+      spdlog::warn("Failed to write session journal: {}", path_);
+      failed_ = true;
+    }
+    ++syncs_;
+    durable_ = ticket;
+    committed_.notify_all();
+  }
+}
+
+bool SessionJournal::store_blobs(
+    const std::vector<std::pair<ContentHash, std::string>> &blobs) {
+  for (const auto &[hash, content] : blobs) {
+    if (!blobs_->put(hash, content)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SessionJournal::append_and_sync(const std::string &bytes) {
+  if (fd_ < 0) {
+    fd_ = open_for_append(path_, false);
+    if (fd_ < 0) {
+      return false;
+    }
+  }
+  // acquire() may have created the file without writing to it.
+  if (file_size(fd_) == 0) {
+    if (!write_all(fd_, encode_header())) {
+      return false;
+    }
+    sync_parent_dir(path_);
+  }
+  return write_all(fd_, bytes) && sync_file(fd_);
+}
+
+bool SessionJournal::rewrite(const Conversation &snapshot,
+                             const std::string &tail) {
+  const std::string temp = path_ + ".tmp";
+  int fd = open_for_append(temp, true);
+  if (fd < 0) {
+    return false;
+  }
+  // The lock moves to the new file before it takes the journal's name.
+  if (locked_ && !try_lock(fd)) {
+    close_file(fd);
+    return false;
+  }
+
+  std::string buffer = encode_header();
+  bool ok = true;
+  for (const auto &message : snapshot.messages()) {
+    std::string_view content = message.content;
+    if (!uses_blob(content)) {
+      encode_record(buffer, Op::Append, message.role, content);
+    } else {
+      ContentHash hash = ContentHash::of(content);
+      ok = ok && blobs_->put(hash, content);
+      encode_blob_record(buffer, message.role, hash);
+    }
+    if (buffer.size() >= REWRITE_CHUNK_BYTES) {
+      ok = ok && write_all(fd, buffer);
+      buffer.clear();
+    }
+  }
+  buffer += tail;
+  ok = ok && write_all(fd, buffer) && sync_file(fd);
+
+  std::error_code ec;
+  if (ok) {
+    std::filesystem::rename(temp, path_, ec);
+    ok = !ec;
+  }
+  if (!ok) {
+    close_file(fd);
+    std::filesystem::remove(temp, ec);
+    return false;
+  }
+  sync_parent_dir(path_);
+
+  // The temporary file is now the journal; keep appending to it.
+  if (fd_ >= 0) {
+    close_file(fd_);
+  }
+  fd_ = fd;
+  return true;
+}
+
+} // namespace llm
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "models/blob_store.hpp"
+#include "models/conversation.hpp"
+#include "models/message.hpp"
+
+namespace llm {
+
+// Append-only log of the live conversation, so that a crash loses at most
+// the records still in flight. All integers are little-endian.
+//
+//   header   magic "LLMJ", u16 version, u16 reserved
+//   record   u32 payload size, u32 CRC-32 of the payload, then the payload:
+//            u8 op, u8 role, content bytes
+//
+// Given a BlobStore, messages of at least BlobStore::MIN_BLOB_BYTES are
+// journaled as AppendBlob records holding the 16-byte ContentHash (high
+// then low) of their content instead, and the writer stores the blob before
+// committing the record. Content already in the store, such as a document
+// pasted again or part of a saved session, is then never written twice, and
+// checkpoints of long conversations stay small.
+//
+// Recording a message costs O(message): it is encoded into a pending buffer
+// and a writer thread commits it. Records that arrive while the writer is in
+// fsync are committed together by the next write, so fsyncs are batched
+// under bursts instead of paid per message.
+//
+// Changes that are not appends (clear, load, summaries, branch switches) are
+// journaled with checkpoint(), which rewrites the journal from a snapshot of
+// the conversation on the writer thread and atomically replaces the file.
+class SessionJournal {
+public:
+  static constexpr char MAGIC[4] = {'L', 'L', 'M', 'J'};
+  static constexpr uint16_t VERSION = 1;
+  static constexpr size_t HEADER_SIZE = 8;
+  static constexpr size_t RECORD_HEADER_SIZE = 8;
+
+  enum class Op : uint8_t {
+    SetSystem = 1,  // replaces the system prompt
+    Append = 2,     // appends a message with the given role
+    AppendBlob = 3, // appends a message whose content is a blob
+  };
+
+  // Starts the writer; the file is created by the first write or by
+  // acquire(). Call recover() before recording anything. `blobs`, if given,
+  // must outlive the journal.
+  explicit SessionJournal(std::string path, BlobStore *blobs = nullptr);
+  // Commits everything recorded and stops the writer.
+  ~SessionJournal();
+
+  SessionJournal(const SessionJournal &) = delete;
+  SessionJournal &operator=(const SessionJournal &) = delete;
+
+  const std::string &path() const { return path_; }
+
+  // Takes an exclusive lock on the journal, creating it if needed, and
+  // keeps it, across checkpoints, until the journal is destroyed or
+  // removed. Returns false without waiting if another process holds it:
+  // that journal belongs to a live REPL and must not be recovered, written
+  // or removed. Journals that are never acquired are not locked.
+  bool acquire();
+
+  // Replays an existing journal into `conversation` (after clearing it) and
+  // returns the number of records replayed, or nullopt if there is no
+  // journal, or only an empty one, to recover. A torn or corrupt tail, as left by a crash during a
+  // write, is dropped and truncated away, as is everything from the first
+  // record whose blob cannot be read.
+  std::optional<size_t> recover(Conversation &conversation);
+
+  // Blobs the intact records of the journal at `path` reference, read
+  // without locking it, so that the blobs of live REPLs' journals and of
+  // unrecovered ones can be kept from collection. Empty if there is no
+  // journal; nullopt if it exists but cannot be read.
+  static std::optional<std::vector<ContentHash>>
+  blob_references(const std::string &path);
+
+  // `path` followed by the per-process journals, <stem>.<pid><extension>,
+  // that REPLs have used alongside it, oldest name first.
+  static std::vector<std::string> candidates(const std::string &path);
+
+  void record_system(std::string_view prompt);
+  void record_message(MessageRole role, std::string_view content);
+
+  // Replaces the journal with the contents of `conversation`. The snapshot
+  // is O(1); encoding and the rewrite happen on the writer thread.
+  void checkpoint(const Conversation &conversation);
+
+  // Blocks until everything recorded so far is on stable storage. Returns
+  // false if a write failed.
+  bool flush();
+
+  // Commits pending records, stops the writer and deletes the journal, e.g.
+  // on a clean exit. Later records are ignored.
+  void remove();
+
+  // Number of fsyncs issued; records per sync is the batching achieved.
+  uint64_t sync_count() const;
+
+private:
+  std::string path_;
+  BlobStore *blobs_;
+  int fd_ = -1;
+  bool locked_ = false; // fd_ holds the lock taken by acquire()
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;      // work for the writer
+  std::condition_variable committed_; // progress for flush()
+  std::string pending_;               // encoded records not yet written
+  // Blobs the pending records reference, stored before they are written.
+  std::vector<std::pair<ContentHash, std::string>> pending_blobs_;
+  std::optional<Conversation> checkpoint_;
+  uint64_t requested_ = 0; // tickets handed out
+  uint64_t durable_ = 0;   // tickets on stable storage
+  uint64_t syncs_ = 0;
+  bool failed_ = false;
+  bool stopping_ = false;
+  bool stopped_ = false; // the writer has exited
+  std::thread writer_;
+
+  void run_writer();
+  void stop_writer();
+  // Writer thread only: stores the blobs pending records reference.
+  bool store_blobs(
+      const std::vector<std::pair<ContentHash, std::string>> &blobs);
+  // Writer thread only: appends `bytes` and syncs.
+  bool append_and_sync(const std::string &bytes);
+  // Writer thread only: writes `snapshot` then `tail` to a temporary file
+  // and renames it over the journal.
+  bool rewrite(const Conversation &snapshot, const std::string &tail);
+  void enqueue(std::string record,
+               std::optional<std::pair<ContentHash, std::string>> blob = {});
+  bool uses_blob(std::string_view content) const {
+    return blobs_ && content.size() >= BlobStore::MIN_BLOB_BYTES;
+  }
+};
+
+} // namespace llm
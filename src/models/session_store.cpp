@@ -0,0 +1,274 @@
+#include "models/session_store.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <unordered_set>
+
+#include "models/conversation.hpp"
+#include "utils/durable_file.hpp"
+#include "utils/logger.hpp"
+#include "utils/mapped_file.hpp"
+
+namespace llm {
+
+namespace {
+
+void put_u16(std::string &out, uint16_t value) {
+  for (int i = 0; i < 2; ++i) {
+    out.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+void put_u32(std::string &out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+void put_u64(std::string &out, uint64_t value) {
+  for (int i = 0; i < 8; ++i) {
+    out.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+uint64_t get_le(const char *p, int bytes) {
+  uint64_t value = 0;
+  for (int i = bytes - 1; i >= 0; --i) {
+    value = (value << 8) | static_cast<unsigned char>(p[i]);
+  }
+  return value;
+}
+
+} // namespace
+
+SessionStore::SessionStore(std::string dir)
+    : dir_(std::move(dir)),
+      blobs_((std::filesystem::path(dir_) / "blobs").string()) {
+  std::error_code ec;
+  std::filesystem::create_directories(blobs_.root(), ec);
+
+  for (const auto &name : names()) {
+    std::vector<Entry> entries;
+    if (!read_manifest(name, entries)) {
+      spdlog::warn("Skipping unreadable session manifest: {}",
+                   manifest_path(name));
+      continue;
+    }
+    std::vector<ContentHash> hashes;
+    for (const auto &entry : entries) {
+      if (entry.kind == Kind::Blob) {
+        hashes.push_back(entry.hash);
+      }
+    }
+    add_refs(name, std::move(hashes));
+  }
+}
+
+bool SessionStore::is_name(std::string_view name) {
+  return !name.empty() && std::all_of(name.begin(), name.end(), [](char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '-' || c == '_';
+  });
+}
+
+std::string SessionStore::manifest_path(const std::string &name) const {
+  return (std::filesystem::path(dir_) / (name + EXTENSION)).string();
+}
+
+bool SessionStore::contains(const std::string &name) const {
+  std::error_code ec;
+  return is_name(name) && std::filesystem::exists(manifest_path(name), ec);
+}
+
+std::vector<std::string> SessionStore::names() const {
+  std::vector<std::string> result;
+  std::error_code ec;
+  for (const auto &file : std::filesystem::directory_iterator(dir_, ec)) {
+    const auto &path = file.path();
+    if (path.extension() == EXTENSION && is_name(path.stem().string())) {
+      result.push_back(path.stem().string());
+    }
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+bool SessionStore::save(const std::string &name,
+                        const Conversation &conversation) {
+  if (!is_name(name)) {
+    return false;
+  }
+
+  auto messages = conversation.messages();
+  std::string manifest(MAGIC, sizeof(MAGIC));
+  put_u16(manifest, VERSION);
+  put_u16(manifest, 0);
+  put_u32(manifest, static_cast<uint32_t>(messages.size()));
+
+  std::vector<ContentHash> hashes;
+  for (const auto &message : messages) {
+    std::string_view content = message.content;
+    bool blob = content.size() >= BlobStore::MIN_BLOB_BYTES;
+    manifest.push_back(static_cast<char>(message.role));
+    manifest.push_back(static_cast<char>(blob ? Kind::Blob : Kind::Inline));
+    put_u32(manifest, static_cast<uint32_t>(content.size()));
+    if (!blob) {
+      manifest.append(content);
+      continue;
+    }
+    ContentHash hash = ContentHash::of(content);
+    if (!blobs_.put(hash, content)) {
+      spdlog::warn("Failed to write blob {} for session {}", hash.hex(), name);
+      return false;
+    }
+    put_u64(manifest, hash.high);
+    put_u64(manifest, hash.low);
+    hashes.push_back(hash);
+  }
+
+  // The blobs are durable before the manifest naming them replaces the
+  // previous one.
+  if (!write_file_durably(manifest_path(name), manifest)) {
+    spdlog::warn("Failed to write session manifest: {}", manifest_path(name));
+    return false;
+  }
+  drop_refs(name);
+  add_refs(name, std::move(hashes));
+  return true;
+}
+
+bool SessionStore::read_manifest(const std::string &name,
+                                 std::vector<Entry> &entries) const {
+  MappedFile file;
+  if (!file.open(manifest_path(name))) {
+    return false;
+  }
+  const char *data = file.data();
+  const size_t size = file.size();
+  if (size < HEADER_SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+    return false;
+  }
+  if (get_le(data + 4, 2) > VERSION) {
+    spdlog::warn("Session manifest {} has unsupported version {}",
+                 manifest_path(name), get_le(data + 4, 2));
+    return false;
+  }
+
+  const size_t count = get_le(data + 8, 4);
+  size_t offset = HEADER_SIZE;
+  entries.clear();
+  entries.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    if (size - offset < 6) {
+      return false;
+    }
+    auto role = static_cast<unsigned char>(data[offset]);
+    auto kind = static_cast<Kind>(data[offset + 1]);
+    size_t length = get_le(data + offset + 2, 4);
+    offset += 6;
+    if (role > static_cast<unsigned char>(MessageRole::Assistant)) {
+      return false;
+    }
+
+    Entry entry{static_cast<MessageRole>(role), kind, {}, {}};
+    if (kind == Kind::Inline) {
+      if (size - offset < length) {
+        return false;
+      }
+      entry.content.assign(data + offset, length);
+      offset += length;
+    } else if (kind == Kind::Blob) {
+      if (size - offset < 16) {
+        return false;
+      }
+      entry.hash = {get_le(data + offset, 8), get_le(data + offset + 8, 8)};
+      offset += 16;
+    } else {
+      return false;
+    }
+    entries.push_back(std::move(entry));
+  }
+  return true;
+}
+
+bool SessionStore::load(const std::string &name,
+                        Conversation &conversation) const {
+  std::vector<Entry> entries;
+  if (!is_name(name) || !read_manifest(name, entries)) {
+    spdlog::warn("Failed to read session manifest: {}", manifest_path(name));
+    return false;
+  }
+  // Every blob is read before the conversation is touched.
+  for (auto &entry : entries) {
+    if (entry.kind != Kind::Blob) {
+      continue;
+    }
+    auto content = blobs_.get(entry.hash);
+    if (!content) {
+      spdlog::warn("Session {} references missing blob {}", name,
+                   entry.hash.hex());
+      return false;
+    }
+    entry.content = std::move(*content);
+  }
+
+  conversation.clear();
+  for (auto &entry : entries) {
+    conversation.add_message(
+        Message(entry.role, std::string_view(entry.content)));
+  }
+  return true;
+}
+
+bool SessionStore::remove(const std::string &name) {
+  std::error_code ec;
+  if (!is_name(name) || !std::filesystem::remove(manifest_path(name), ec)) {
+    return false;
+  }
+  drop_refs(name);
+  return true;
+}
+
+size_t SessionStore::ref_count(const ContentHash &hash) const {
+  auto it = refs_.find(hash);
+  return it == refs_.end() ? 0 : it->second;
+}
+
+size_t SessionStore::collect_garbage(const std::vector<ContentHash> &pinned) {
+  std::unordered_set<ContentHash, ContentHash::Hasher> keep(pinned.begin(),
+                                                            pinned.end());
+  size_t deleted = blobs_.collect([&](const ContentHash &hash) {
+    return refs_.count(hash) || keep.count(hash);
+  });
+  if (deleted > 0) {
+    spdlog::debug("Deleted {} unreferenced blobs from {}", deleted,
+                  blobs_.root());
+  }
+  return deleted;
+}
+
+void SessionStore::add_refs(const std::string &name,
+                            std::vector<ContentHash> hashes) {
+  for (const auto &hash : hashes) {
+    ++refs_[hash];
+  }
+  manifests_[name] = std::move(hashes);
+}
+
+void SessionStore::drop_refs(const std::string &name) {
+  auto it = manifests_.find(name);
+  if (it == manifests_.end()) {
+    return;
+  }
+  for (const auto &hash : it->second) {
+    auto ref = refs_.find(hash);
+    if (ref != refs_.end() && --ref->second == 0) {
+      refs_.erase(ref);
+    }
+  }
+  manifests_.erase(it);
+}
+
+} // namespace llm
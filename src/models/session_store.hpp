@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "models/blob_store.hpp"
+#include "models/message.hpp"
+
+namespace llm {
+
+class Conversation;
+
+// Conversations saved by name under a sessions directory, deduplicated
+// through a BlobStore in its blobs/ subdirectory. Each session is a small
+// manifest, <name>.manifest, and all integers in it are little-endian:
+//
+//   header   magic "LLMM", u16 version, u16 reserved, u32 message count
+//   message  u8 role, u8 kind, u32 content size, then for kind 0 the
+//            content itself and for kind 1 the 16-byte ContentHash
+//            (high then low) of a blob holding it
+//
+// Contents of at least BlobStore::MIN_BLOB_BYTES are stored as blobs, so
+// saving a session writes only the blobs no other session has plus its
+// manifest.
+//
+// Blobs are reference counted by the manifests that name them. Counts are
+// rebuilt from the manifests on construction and kept up to date as
+// sessions are saved and removed; blobs whose count drops to zero stay on
+// disk until collect_garbage(), since other writers such as the session
+// journal may reference them too.
+class SessionStore {
+public:
+  static constexpr char MAGIC[4] = {'L', 'L', 'M', 'M'};
+  static constexpr uint16_t VERSION = 1;
+  static constexpr size_t HEADER_SIZE = 12;
+  static constexpr const char *EXTENSION = ".manifest";
+
+  enum class Kind : uint8_t {
+    Inline = 0,
+    Blob = 1,
+  };
+
+  explicit SessionStore(std::string dir);
+
+  const std::string &dir() const { return dir_; }
+  BlobStore &blobs() { return blobs_; }
+
+  // Session names are non-empty and use only letters, digits, '-' and '_',
+  // so they never collide with file paths.
+  static bool is_name(std::string_view name);
+
+  bool contains(const std::string &name) const;
+  std::vector<std::string> names() const;
+
+  // Saves `conversation` as `name`, replacing any session of that name.
+  // Returns false, leaving the previous session in place, on I/O errors.
+  bool save(const std::string &name, const Conversation &conversation);
+
+  // Replaces the messages of `conversation` with session `name`. Returns
+  // false, leaving it unchanged, if the session is missing or unreadable.
+  bool load(const std::string &name, Conversation &conversation) const;
+
+  bool remove(const std::string &name);
+
+  // Manifests referencing the blob, counted once per message.
+  size_t ref_count(const ContentHash &hash) const;
+
+  // Deletes blobs that no manifest references, except those in `pinned`,
+  // and returns how many were deleted.
+  size_t collect_garbage(const std::vector<ContentHash> &pinned = {});
+
+private:
+  struct Entry {
+    MessageRole role;
+    Kind kind;
+    std::string content;  // inline entries
+    ContentHash hash;     // blob entries
+  };
+
+  std::string dir_;
+  BlobStore blobs_;
+  // Blob references of each manifest, by session name.
+  std::unordered_map<std::string, std::vector<ContentHash>> manifests_;
+  std::unordered_map<ContentHash, size_t, ContentHash::Hasher> refs_;
+
+  std::string manifest_path(const std::string &name) const;
+  bool read_manifest(const std::string &name, std::vector<Entry> &entries) const;
+  void add_refs(const std::string &name, std::vector<ContentHash> hashes);
+  void drop_refs(const std::string &name);
+};
+
+} // namespace llm
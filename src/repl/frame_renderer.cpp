@@ -0,0 +1,32 @@
+#include "repl/frame_renderer.hpp"
+
+namespace llm {
+
+FrameRenderer::FrameRenderer(Writer writer, unsigned fps)
+    : writer_(std::move(writer)),
+      frame_(fps == 0 ? Clock::duration::zero()
+                      : std::chrono::duration_cast<Clock::duration>(
+                            std::chrono::seconds(1)) /
+                            fps) {}
+
+void FrameRenderer::append(std::string_view text) {
+  buffer_ += text;
+  line_finished_ = line_finished_ || text.find('\n') != std::string_view::npos;
+}
+
+bool FrameRenderer::due(Clock::time_point now) const {
+  return !buffer_.empty() && (line_finished_ || now >= deadline());
+}
+
+void FrameRenderer::flush(Clock::time_point now) {
+  if (buffer_.empty()) {
+    return;
+  }
+  writer_(buffer_);
+  // clear() keeps the capacity for the next frame.
+  buffer_.clear();
+  line_finished_ = false;
+  last_write_ = now;
+}
+
+} // namespace llm
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace llm {
+
+// Paces streamed text to the terminal. Text is collected in a buffer that
+// is reused from frame to frame and handed to the writer at most once per
+// frame, or as soon as it finishes a line. The first text after a quiet
+// frame goes out at once, so pacing only adds latency to fast streams.
+class FrameRenderer {
+public:
+  using Clock = std::chrono::steady_clock;
+  using Writer = std::function<void(std::string_view)>;
+
+  // `fps` 0 writes text as soon as it is appended.
+  FrameRenderer(Writer writer, unsigned fps);
+
+  void append(std::string_view text);
+  bool empty() const { return buffer_.empty(); }
+
+  // Whether the buffered text should be written at `now`.
+  bool due(Clock::time_point now = Clock::now()) const;
+  // When the current frame ends.
+  Clock::time_point deadline() const { return last_write_ + frame_; }
+
+  // Writes the buffered text, if any.
+  void flush(Clock::time_point now = Clock::now());
+
+private:
+  Writer writer_;
+  Clock::duration frame_;
+  std::string buffer_;
+  bool line_finished_ = false;
+  Clock::time_point last_write_{};
+};
+
+} // namespace llm
@@ -0,0 +1,156 @@
+#include "repl/history_index.hpp"
+
+#include <algorithm>
+
+namespace llm {
+
+size_t HistoryIndex::add(std::string entry) {
+  if (auto previous = find(entry)) {
+    remove(*previous);
+    if (stale_ > count()) {
+      compact();
+    }
+  }
+  append(std::move(entry));
+  return entries_.size() - 1;
+}
+
+std::optional<size_t> HistoryIndex::find(std::string_view entry) const {
+  auto [first, last] = ids_.equal_range(hash(entry));
+  for (auto it = first; it != last; ++it) {
+    if (entries_[it->second] == entry) {
+      return it->second;
+    }
+  }
+  return std::nullopt;
+}
+
+void HistoryIndex::clear() {
+  entries_.clear();
+  removed_.clear();
+  stale_ = 0;
+  ids_.clear();
+  postings_.clear();
+  unindexed_.clear();
+}
+
+void HistoryIndex::append(std::string entry) {
+  const auto id = static_cast<uint32_t>(entries_.size());
+  if (entry.size() > INDEXED_BYTES) {
+    unindexed_.push_back(id);
+  } else {
+    for (uint32_t key : trigrams(entry)) {
+      postings_[key].push_back(id);
+    }
+  }
+  ids_.emplace(hash(entry), id);
+  entries_.push_back(std::move(entry));
+  removed_.push_back(false);
+}
+
+void HistoryIndex::remove(size_t index) {
+  auto [first, last] = ids_.equal_range(hash(entries_[index]));
+  for (auto it = first; it != last; ++it) {
+    if (it->second == index) {
+      ids_.erase(it);
+      break;
+    }
+  }
+  // Postings keep the index until the next compaction.
+  std::string().swap(entries_[index]);
+  removed_[index] = true;
+  ++stale_;
+}
+
+void HistoryIndex::compact() {
+  std::vector<std::string> live;
+  live.reserve(count());
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    if (!removed_[i]) {
+      live.push_back(std::move(entries_[i]));
+    }
+  }
+  clear();
+  for (auto &entry : live) {
+    append(std::move(entry));
+  }
+}
+
+std::vector<uint32_t> HistoryIndex::trigrams(std::string_view text) {
+  std::vector<uint32_t> keys;
+  if (text.size() < 3) {
+    return keys;
+  }
+  keys.reserve(text.size() - 2);
+  for (size_t i = 0; i + 3 <= text.size(); ++i) {
+    keys.push_back(trigram(text, i));
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  return keys;
+}
+
+std::optional<size_t> HistoryIndex::search(std::string_view query,
+                                           size_t before) const {
+  before = std::min(before, entries_.size());
+  if (query.size() < 3) {
+    return scan(query, before);
+  }
+
+  // Rarest trigram first: its list bounds the candidates.
+  std::vector<const std::vector<uint32_t> *> lists;
+  bool indexed = true;
+  for (uint32_t key : trigrams(query)) {
+    auto it = postings_.find(key);
+    if (it == postings_.end()) {
+      indexed = false;
+      break;
+    }
+    lists.push_back(&it->second);
+  }
+  std::sort(lists.begin(), lists.end(),
+            [](const auto *a, const auto *b) { return a->size() < b->size(); });
+
+  std::optional<size_t> found;
+  if (indexed) {
+    const auto &rarest = *lists.front();
+    auto end = std::lower_bound(rarest.begin(), rarest.end(), before);
+    for (auto it = std::make_reverse_iterator(end); it != rarest.rend(); ++it) {
+      uint32_t id = *it;
+      bool in_all = std::all_of(lists.begin() + 1, lists.end(), [id](auto *l) {
+        return std::binary_search(l->begin(), l->end(), id);
+      });
+      // Sharing every trigram does not mean they appear in order; removed
+      // entries are empty and never match.
+      if (in_all && entries_[id].find(query) != std::string::npos) {
+        found = id;
+        break;
+      }
+    }
+  }
+
+  // Only unindexed entries newer than the indexed match can win.
+  auto end = std::lower_bound(unindexed_.begin(), unindexed_.end(), before);
+  for (auto it = std::make_reverse_iterator(end); it != unindexed_.rend();
+       ++it) {
+    if (found && *it < *found) {
+      break;
+    }
+    if (entries_[*it].find(query) != std::string::npos) {
+      return *it;
+    }
+  }
+  return found;
+}
+
+std::optional<size_t> HistoryIndex::scan(std::string_view query,
+                                         size_t before) const {
+  for (size_t i = before; i-- > 0;) {
+    if (!removed_[i] && entries_[i].find(query) != std::string::npos) {
+      return i;
+    }
+  }
+  return std::nullopt;
+}
+
+} // namespace llm
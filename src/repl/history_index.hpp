@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace llm {
+
+// Command history with substring search for the line editor's reverse
+// search.
+//
+// Every entry up to INDEXED_BYTES long is indexed by the distinct byte
+// trigrams it contains. A query of three bytes or more walks the shortest
+// postings list of its trigrams from the newest entry back, skips entries
+// missing from another list and confirms the survivors with a substring
+// test, so a search touches only entries sharing every trigram of the
+// query. Longer entries, usually pastes, are kept out of the postings and
+// scanned; shorter queries scan every entry.
+//
+// Each command is kept once: a hash index finds an earlier copy of a
+// command being added, which is tombstoned so the command moves to the
+// front. Tombstones are skipped by searches and by the editor, and the
+// entries are renumbered without them once they outnumber live ones.
+//
+// Not thread-safe.
+class HistoryIndex {
+public:
+  static constexpr size_t INDEXED_BYTES = 4096;
+
+  // Appends `entry`, removing an earlier copy of it, and returns its index.
+  // Indices of other entries change if that leaves more removed entries
+  // than live ones.
+  size_t add(std::string entry);
+
+  // The index of the entry equal to `entry`, if any.
+  std::optional<size_t> find(std::string_view entry) const;
+
+  // Index range including removed entries, which are empty.
+  const std::string &at(size_t index) const { return entries_[index]; }
+  bool removed(size_t index) const { return removed_[index]; }
+  size_t size() const { return entries_.size(); }
+
+  // Live entries.
+  size_t count() const { return entries_.size() - stale_; }
+  bool empty() const { return count() == 0; }
+  // The newest entry; the history must not be empty.
+  const std::string &back() const { return entries_.back(); }
+
+  void clear();
+
+  // Index of the newest entry before `before` that contains `query`, or
+  // nullopt if there is none. An empty query matches every entry.
+  std::optional<size_t> search(std::string_view query, size_t before) const;
+
+private:
+  std::vector<std::string> entries_;
+  std::vector<bool> removed_;
+  size_t stale_ = 0;
+  // Hash of a live entry -> its index.
+  std::unordered_multimap<size_t, uint32_t> ids_;
+  // Trigram -> ascending indices of the indexed entries containing it.
+  std::unordered_map<uint32_t, std::vector<uint32_t>> postings_;
+  // Ascending indices of the entries too long to index.
+  std::vector<uint32_t> unindexed_;
+
+  static uint32_t trigram(std::string_view text, size_t at) {
+    return static_cast<uint32_t>(static_cast<unsigned char>(text[at])) << 16 |
+           static_cast<uint32_t>(static_cast<unsigned char>(text[at + 1]))
+               << 8 |
+           static_cast<unsigned char>(text[at + 2]);
+  }
+
+  static size_t hash(std::string_view text) {
+    return std::hash<std::string_view>{}(text);
+  }
+
+  // Distinct trigrams of `text`, sorted.
+  static std::vector<uint32_t> trigrams(std::string_view text);
+
+  void append(std::string entry);
+  void remove(size_t index);
+  // Rebuilds the index from the live entries.
+  void compact();
+
+  std::optional<size_t> scan(std::string_view query, size_t before) const;
+};
+
+} // namespace llm
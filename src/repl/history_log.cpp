@@ -0,0 +1,309 @@
+#include "repl/history_log.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
+#include <system_error>
+#include <unordered_set>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "utils/durable_file.hpp"
+#include "utils/logger.hpp"
+#include "utils/mapped_file.hpp"
+
+namespace llm {
+
+namespace {
+
+// Files smaller than this are never compacted for staleness alone.
+constexpr size_t MIN_COMPACT_RECORDS = 64;
+// Attempts to open the file that the last compaction left in place.
+constexpr int OPEN_ATTEMPTS = 8;
+
+#ifdef _WIN32
+int open_log(const std::string &path, bool append) {
+  return ::_open(path.c_str(),
+                 (append ? _O_WRONLY | _O_APPEND | _O_CREAT : _O_RDONLY) |
+                     _O_BINARY,
+                 _S_IREAD | _S_IWRITE);
+}
+void close_log(int fd) { ::_close(fd); }
+int write_some(int fd, const char *data, size_t size) {
+  return ::_write(fd, data, static_cast<unsigned>(size));
+}
+bool lock(int fd, bool exclusive) {
+  OVERLAPPED overlapped{};
+  return LockFileEx(reinterpret_cast<HANDLE>(::_get_osfhandle(fd)),
+                    exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, MAXDWORD,
+                    MAXDWORD, &overlapped) != 0;
+}
+bool is_empty(int fd) { return ::_filelengthi64(fd) == 0; }
+// Windows cannot rename over a file others have open, so a locked file is
+// never replaced.
+bool still_current(int, const std::string &) { return true; }
+#else
+int open_log(const std::string &path, bool append) {
+  return ::open(path.c_str(),
+                (append ? O_WRONLY | O_APPEND | O_CREAT : O_RDONLY) | O_CLOEXEC,
+                0600);
+}
+void close_log(int fd) { ::close(fd); }
+ssize_t write_some(int fd, const char *data, size_t size) {
+  return ::write(fd, data, size);
+}
+bool lock(int fd, bool exclusive) {
+  int result;
+  do {
+    result = ::flock(fd, exclusive ? LOCK_EX : LOCK_SH);
+  } while (result != 0 && errno == EINTR);
+  return result == 0;
+}
+bool is_empty(int fd) {
+  struct stat info {};
+  return ::fstat(fd, &info) == 0 && info.st_size == 0;
+}
+// Whether `fd` is still the file at `path`, not one a compaction replaced.
+bool still_current(int fd, const std::string &path) {
+  struct stat opened {};
+  struct stat current {};
+  return ::fstat(fd, &opened) == 0 && ::stat(path.c_str(), &current) == 0 &&
+         opened.st_dev == current.st_dev && opened.st_ino == current.st_ino;
+}
+#endif
+
+// Opens the file at `path` and locks it, reopening if a compaction renames
+// a new file over it meanwhile. Returns -1 on failure; closing the
+// descriptor releases the lock.
+int open_locked(const std::string &path, bool append, bool exclusive) {
+  for (int attempt = 0; attempt < OPEN_ATTEMPTS; ++attempt) {
+    int fd = open_log(path, append);
+    if (fd < 0) {
+      return -1;
+    }
+    if (!lock(fd, exclusive)) {
+      close_log(fd);
+      return -1;
+    }
+    if (still_current(fd, path)) {
+      return fd;
+    }
+    close_log(fd);
+  }
+  return -1;
+}
+
+bool write_all(int fd, std::string_view bytes) {
+  while (!bytes.empty()) {
+    auto written = write_some(fd, bytes.data(), bytes.size());
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes.remove_prefix(static_cast<size_t>(written));
+  }
+  return true;
+}
+
+std::string escape(std::string_view command) {
+  std::string record;
+  record.reserve(command.size() + 1);
+  for (char c : command) {
+    switch (c) {
+    case '\\':
+      record += "\\\\";
+      break;
+    case '\n':
+      record += "\\n";
+      break;
+    case '\r':
+      record += "\\r";
+      break;
+    default:
+      record += c;
+    }
+  }
+  return record;
+}
+
+std::string unescape(std::string_view record) {
+  std::string command;
+  command.reserve(record.size());
+  for (size_t i = 0; i < record.size(); ++i) {
+    if (record[i] != '\\' || i + 1 == record.size()) {
+      command += record[i];
+      continue;
+    }
+    char next = record[++i];
+    command += next == 'n' ? '\n' : next == 'r' ? '\r' : next;
+  }
+  return command;
+}
+
+struct Records {
+  bool legacy = false;
+  // Complete lines in file order; a torn final line is left out.
+  std::vector<std::string_view> lines;
+  // The newest copy of each line, newest first, at most the limit.
+  std::vector<std::string_view> kept;
+  size_t live = 0; // distinct lines
+};
+
+Records read_records(std::string_view text, size_t limit) {
+  Records records;
+  records.legacy = !text.empty() && !text.starts_with(HistoryLog::HEADER);
+  const std::string_view header =
+      HistoryLog::HEADER.substr(0, HistoryLog::HEADER.size() - 1);
+
+  size_t pos = 0;
+  for (size_t end; (end = text.find('\n', pos)) != std::string_view::npos;
+       pos = end + 1) {
+    std::string_view line = text.substr(pos, end - pos);
+    if (records.legacy && !line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    // Processes creating the file at once may each write the header.
+    if (!line.empty() && (records.legacy || line != header)) {
+      records.lines.push_back(line);
+    }
+  }
+
+  std::unordered_set<std::string_view> seen;
+  seen.reserve(records.lines.size());
+  for (auto it = records.lines.rbegin(); it != records.lines.rend(); ++it) {
+    if (seen.insert(*it).second && records.kept.size() < limit) {
+      records.kept.push_back(*it);
+    }
+  }
+  records.live = seen.size();
+  return records;
+}
+
+} // namespace
+
+HistoryLog::HistoryLog(std::string path, size_t max_entries)
+    : path_(std::move(path)), max_entries_(std::max<size_t>(max_entries, 1)) {}
+
+HistoryLog::~HistoryLog() { wait(); }
+
+bool HistoryLog::load(HistoryIndex &history) {
+  wait();
+  history.clear();
+  records_ = 0;
+
+  std::error_code ec;
+  if (!std::filesystem::exists(path_, ec)) {
+    return true;
+  }
+  MappedFile file;
+  if (!file.open(path_)) {
+    return false;
+  }
+
+  Records records = read_records(file.view(), max_entries_);
+  for (auto it = records.kept.rbegin(); it != records.kept.rend(); ++it) {
+    history.add(records.legacy ? std::string(*it) : unescape(*it));
+  }
+  records_ = records.lines.size();
+  file.close();
+
+  if (records.legacy) {
+    // Converted right away: appends must not mix escaped records into a
+    // file that is read as plain lines.
+    if (!compact()) {
+      spdlog::warn("Failed to convert history file {}", path_);
+    }
+    return true;
+  }
+  maybe_compact(records.live);
+  return true;
+}
+
+bool HistoryLog::append(std::string_view command, size_t live) {
+  std::string record = escape(command);
+  record += '\n';
+
+  int fd = open_locked(path_, true, false);
+  if (fd < 0) {
+    return false;
+  }
+  // One write, so that records of other processes never land inside it.
+  if (is_empty(fd)) {
+    record.insert(0, HEADER);
+  }
+  bool ok = write_all(fd, record);
+  close_log(fd);
+
+  if (ok) {
+    ++records_;
+    maybe_compact(live);
+  }
+  return ok;
+}
+
+bool HistoryLog::compact() {
+  std::error_code ec;
+  if (!std::filesystem::exists(path_, ec)) {
+    return true;
+  }
+  // Waits for appends in progress and keeps new ones out until the
+  // rewrite is in place.
+  int fd = open_locked(path_, false, true);
+  if (fd < 0) {
+    return false;
+  }
+
+  bool ok = false;
+  MappedFile file;
+  if (file.open(path_)) {
+    Records records = read_records(file.view(), max_entries_);
+    std::string text(HEADER);
+    for (auto it = records.kept.rbegin(); it != records.kept.rend(); ++it) {
+      text += records.legacy ? escape(*it) : std::string(*it);
+      text += '\n';
+    }
+    file.close();
+    ok = write_file_durably(path_, text);
+    if (ok) {
+      records_ = records.kept.size();
+    }
+  }
+  close_log(fd);
+  return ok;
+}
+
+void HistoryLog::wait() {
+  if (compactor_.joinable()) {
+    compactor_.join();
+  }
+}
+
+void HistoryLog::maybe_compact(size_t live) {
+  const size_t kept = std::min(live, max_entries_);
+  if (records_ < MIN_COMPACT_RECORDS || records_ <= 2 * kept ||
+      compacting_.exchange(true)) {
+    return;
+  }
+  wait();
+  compactor_ = std::thread([this] {
+    if (!compact()) {
+      spdlog::debug("Failed to compact history file {}", path_);
+    }
+    compacting_ = false;
+  });
+}
+
+} // namespace llm
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "repl/history_index.hpp"
+
+namespace llm {
+
+// Append-only command history file shared by every REPL process.
+//
+// The file starts with HEADER and holds one record per line, newline and
+// backslash escaped, so multi-line commands survive. A command is appended
+// as it is entered with a single O_APPEND write under a shared lock, so
+// records of concurrent processes never interleave. A command used again
+// is appended again; the newest copy decides its place.
+//
+// load() maps the file, keeps the newest copy of each command through a
+// hash index and adds the survivors to a HistoryIndex, copying each once.
+// Once stale copies outnumber live commands, or there are more commands
+// than the limit, a background thread compacts the file: under an
+// exclusive lock, which waits for appends in progress, it rereads it and
+// renames a rewrite with the newest `max_entries` commands, once each,
+// over it. Appenders that were waiting see the file replaced and reopen
+// it. A file without HEADER, written before this format, is read as plain
+// lines and compacted into it.
+class HistoryLog {
+public:
+  static constexpr std::string_view HEADER = "#llm-repl-history 1\n";
+
+  HistoryLog(std::string path, size_t max_entries);
+  // Waits for a compaction in progress.
+  ~HistoryLog();
+
+  HistoryLog(const HistoryLog &) = delete;
+  HistoryLog &operator=(const HistoryLog &) = delete;
+
+  const std::string &path() const { return path_; }
+
+  // Replaces the contents of `history` with the commands in the file,
+  // oldest first, and compacts the file in the background if needed.
+  // Returns false if the file exists but cannot be read.
+  bool load(HistoryIndex &history);
+
+  // Appends `command`. `live` is the number of distinct commands after it,
+  // which decides when to compact. Returns false on I/O errors.
+  bool append(std::string_view command, size_t live);
+
+  // Rewrites the file now, in this thread.
+  bool compact();
+
+  // Blocks until a background compaction, if any, has finished.
+  void wait();
+
+private:
+  std::string path_;
+  size_t max_entries_;
+  // Records in the file as of the last load, append or compaction.
+  std::atomic<size_t> records_{0};
+  std::thread compactor_;
+  std::atomic<bool> compacting_{false};
+
+  void maybe_compact(size_t live);
+};
+
+} // namespace llm
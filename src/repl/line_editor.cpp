@@ -0,0 +1,749 @@
+#include "repl/line_editor.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+namespace llm {
+
+namespace {
+
+constexpr std::string_view PASTE_END = "\033[201~";
+constexpr size_t READ_CHUNK = 64 * 1024;
+
+constexpr int ctrl(char key) { return key & 0x1f; }
+
+bool is_continuation(unsigned char c) { return (c & 0xc0) == 0x80; }
+
+bool is_control(unsigned char c) { return c < 0x20 || c == 0x7f; }
+
+// Columns taken by the character starting at `c`; control characters are
+// shown as ^X.
+size_t char_width(unsigned char c) {
+  if (is_control(c)) {
+    return 2;
+  }
+  return is_continuation(c) ? 0 : 1;
+}
+
+size_t next_char(std::string_view text, size_t pos) {
+  do {
+    ++pos;
+  } while (pos < text.size() &&
+           is_continuation(static_cast<unsigned char>(text[pos])));
+  return pos;
+}
+
+size_t prev_char(std::string_view text, size_t pos) {
+  do {
+    --pos;
+  } while (pos > 0 && is_continuation(static_cast<unsigned char>(text[pos])));
+  return pos;
+}
+
+// Columns from `from` to `to`, counting no further than just past `limit`.
+size_t span_width(std::string_view text, size_t from, size_t to,
+                  size_t limit) {
+  size_t width = 0;
+  for (size_t i = from; i < to && width <= limit; i = next_char(text, i)) {
+    width += char_width(static_cast<unsigned char>(text[i]));
+  }
+  return width;
+}
+
+// Columns of `text` on screen, skipping escape sequences such as colours.
+size_t visible_width(std::string_view text) {
+  size_t width = 0;
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] == '\033') {
+      while (++i < text.size() && !(text[i] >= '@' && text[i] <= '~' &&
+                                    text[i] != '[')) {
+      }
+      continue;
+    }
+    width += is_continuation(static_cast<unsigned char>(text[i])) ? 0 : 1;
+  }
+  return width;
+}
+
+// Whether `text` ends with an incomplete UTF-8 sequence.
+bool ends_mid_char(std::string_view text) {
+  if (text.empty()) {
+    return false;
+  }
+  size_t lead = prev_char(text, text.size());
+  unsigned char first = static_cast<unsigned char>(text[lead]);
+  if (first < 0xc0) {
+    return false;
+  }
+  size_t length = first >= 0xf0 ? 4 : first >= 0xe0 ? 3 : 2;
+  return text.size() - lead < length;
+}
+
+bool is_word(char c) { return c != ' ' && c != '\t' && c != '\n'; }
+
+// Puts the terminal in raw mode with bracketed paste for its lifetime.
+// Output processing stays on so the rest of the REPL can keep writing
+// "\n". Does nothing if `in_fd` is not a terminal.
+class RawMode {
+public:
+#ifdef _WIN32
+  RawMode(int, int) {}
+#else
+  RawMode(int in_fd, int out_fd) : in_fd_(in_fd), out_fd_(out_fd) {
+    if (tcgetattr(in_fd_, &saved_) != 0) {
+      return;
+    }
+    termios raw = saved_;
+    raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_cflag |= CS8;
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    active_ = tcsetattr(in_fd_, TCSAFLUSH, &raw) == 0;
+    if (active_) {
+      write_all("\033[?2004h");
+    }
+  }
+
+  ~RawMode() {
+    if (active_) {
+      write_all("\033[?2004l");
+      tcsetattr(in_fd_, TCSAFLUSH, &saved_);
+    }
+  }
+
+private:
+  int in_fd_;
+  int out_fd_;
+  termios saved_{};
+  bool active_ = false;
+
+  void write_all(std::string_view bytes) const {
+    [[maybe_unused]] auto written = ::write(out_fd_, bytes.data(), bytes.size());
+  }
+#endif
+};
+
+} // namespace
+
+LineEditor::LineEditor(const HistoryIndex &history, int in_fd, int out_fd)
+    : history_(history), in_fd_(in_fd), out_fd_(out_fd),
+#ifdef _WIN32
+      interactive_(false) {
+}
+#else
+      interactive_(isatty(in_fd) && isatty(out_fd)) {
+}
+#endif
+
+std::optional<std::string> LineEditor::read_line(std::string_view prompt) {
+  if (!interactive_) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      write_out(prompt);
+    }
+    auto line = read_plain();
+    if (!line) {
+      print("\n");
+    }
+    return line;
+  }
+  RawMode raw(in_fd_, out_fd_);
+  return edit(prompt);
+}
+
+void LineEditor::print(std::string_view text) {
+  if (text.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  const bool erase = editing_ && !output_mid_line_;
+  output_mid_line_ = text.back() != '\n';
+  const std::string line = editing_ ? render_line() : std::string();
+  write_out(erase ? "\r\033[K" : "", text, line);
+}
+
+std::optional<std::string> LineEditor::read_plain() {
+  while (true) {
+    auto newline = pending_.find('\n', pending_pos_);
+    if (newline != std::string::npos) {
+      std::string line = pending_.substr(pending_pos_, newline - pending_pos_);
+      pending_pos_ = newline + 1;
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      return line;
+    }
+    if (!read_more(-1)) {
+      if (pending_pos_ == pending_.size()) {
+        return std::nullopt;
+      }
+      // A last line without a newline.
+      std::string line = pending_.substr(pending_pos_);
+      pending_pos_ = pending_.size();
+      return line;
+    }
+  }
+}
+
+std::optional<std::string> LineEditor::edit(std::string_view prompt) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    prompt_ = prompt;
+    prompt_width_ = visible_width(prompt_);
+    buffer_.clear();
+    cursor_ = scroll_ = 0;
+    history_pos_ = history_.size();
+    draft_.clear();
+    searching_ = false;
+    editing_ = true;
+    refresh();
+  }
+
+  while (true) {
+    const Key key = read_key();
+    const int c = key.byte;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (c < 0) {
+      return finish(buffer_.empty()
+                        ? std::nullopt
+                        : std::optional<std::string>(std::move(buffer_)),
+                    "\r\n");
+    }
+    if (searching_ && handle_search_key(key)) {
+      refresh();
+      continue;
+    }
+
+    switch (c) {
+    case '\r':
+    case '\n':
+      return finish(std::move(buffer_), "\r\n");
+    case ctrl('C'):
+      if (on_interrupt_) {
+        on_interrupt_();
+      }
+      return finish(std::string(), "^C\r\n");
+    case ctrl('D'):
+      if (buffer_.empty()) {
+        return finish(std::nullopt, "\r\n");
+      }
+      if (cursor_ < buffer_.size()) {
+        erase(cursor_, next_char(buffer_, cursor_));
+      }
+      break;
+    case 0x7f:
+    case ctrl('H'):
+      if (cursor_ > 0) {
+        erase(prev_char(buffer_, cursor_), cursor_);
+      }
+      break;
+    case ctrl('A'):
+      cursor_ = 0;
+      break;
+    case ctrl('E'):
+      cursor_ = buffer_.size();
+      break;
+    case ctrl('B'):
+      if (cursor_ > 0) {
+        cursor_ = prev_char(buffer_, cursor_);
+      }
+      break;
+    case ctrl('F'):
+      if (cursor_ < buffer_.size()) {
+        cursor_ = next_char(buffer_, cursor_);
+      }
+      break;
+    case ctrl('K'):
+      erase(cursor_, buffer_.size());
+      break;
+    case ctrl('U'):
+      erase(0, cursor_);
+      break;
+    case ctrl('W'): {
+      size_t end = cursor_;
+      move_word_left();
+      erase(cursor_, end);
+      break;
+    }
+    case ctrl('L'):
+      write_out("\033[H\033[2J");
+      break;
+    case ctrl('P'):
+      history_up();
+      break;
+    case ctrl('N'):
+      history_down();
+      break;
+    case ctrl('R'):
+      start_search();
+      break;
+    case '\033':
+      handle_escape(key);
+      break;
+    default:
+      if (c == '\t' || !is_control(static_cast<unsigned char>(c))) {
+        char byte = static_cast<char>(c);
+        insert(std::string_view(&byte, 1));
+      }
+      break;
+    }
+
+    // Keys typed or pasted faster than they are handled are drawn once.
+    if (pending_pos_ == pending_.size()) {
+      refresh();
+    }
+  }
+}
+
+std::optional<std::string>
+LineEditor::finish(std::optional<std::string> line, std::string_view end) {
+  // With output in the middle of a line the line being edited is hidden.
+  if (!output_mid_line_) {
+    write_out(end);
+  }
+  editing_ = false;
+  return line;
+}
+
+bool LineEditor::read_more(int timeout_ms) {
+#ifndef _WIN32
+  if (timeout_ms >= 0) {
+    pollfd ready{in_fd_, POLLIN, 0};
+    int count;
+    do {
+      count = poll(&ready, 1, timeout_ms);
+    } while (count < 0 && errno == EINTR);
+    if (count <= 0) {
+      return false;
+    }
+  }
+#endif
+
+  if (pending_pos_ == pending_.size()) {
+    pending_.clear();
+  } else if (pending_pos_ > 0) {
+    pending_.erase(0, pending_pos_);
+  }
+  pending_pos_ = 0;
+
+  size_t old_size = pending_.size();
+  pending_.resize(old_size + READ_CHUNK);
+  long count;
+  do {
+#ifdef _WIN32
+    count = _read(in_fd_, pending_.data() + old_size, READ_CHUNK);
+#else
+    count = ::read(in_fd_, pending_.data() + old_size, READ_CHUNK);
+#endif
+  } while (count < 0 && errno == EINTR);
+  pending_.resize(old_size + static_cast<size_t>(std::max(count, 0L)));
+  return count > 0;
+}
+
+int LineEditor::read_byte(int timeout_ms) {
+  if (pending_pos_ == pending_.size() && !read_more(timeout_ms)) {
+    return -1;
+  }
+  return static_cast<unsigned char>(pending_[pending_pos_++]);
+}
+
+std::string LineEditor::read_paste() {
+  std::string text;
+  while (true) {
+    auto end = pending_.find(PASTE_END, pending_pos_);
+    if (end != std::string::npos) {
+      text.append(pending_, pending_pos_, end - pending_pos_);
+      pending_pos_ = end + PASTE_END.size();
+      break;
+    }
+    // Hold back what may be the start of the marker.
+    size_t available = pending_.size() - pending_pos_;
+    size_t take = available - std::min(available, PASTE_END.size() - 1);
+    text.append(pending_, pending_pos_, take);
+    pending_pos_ += take;
+    if (!read_more(-1)) {
+      text.append(pending_, pending_pos_);
+      pending_pos_ = pending_.size();
+      break;
+    }
+  }
+
+  // Terminals send Enter as '\r'.
+  size_t out = 0;
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] == '\r') {
+      text[out++] = '\n';
+      if (i + 1 < text.size() && text[i + 1] == '\n') {
+        ++i;
+      }
+    } else {
+      text[out++] = text[i];
+    }
+  }
+  text.resize(out);
+  return text;
+}
+
+LineEditor::Key LineEditor::read_key() {
+  Key key;
+  key.byte = read_byte();
+  if (key.byte != '\033') {
+    return key;
+  }
+  key.next = read_byte(ESCAPE_TIMEOUT_MS);
+  if (key.next != '[' && key.next != 'O') {
+    return key;
+  }
+  while ((key.final_byte = read_byte(ESCAPE_TIMEOUT_MS)) >= 0 &&
+         !(key.final_byte >= '@' && key.final_byte <= '~')) {
+    key.params += static_cast<char>(key.final_byte);
+  }
+  if (key.final_byte == '~' && key.params == "200") {
+    key.paste = read_paste();
+  }
+  return key;
+}
+
+void LineEditor::handle_escape(const Key &key) {
+  if (key.next < 0) {
+    // A lone Esc.
+    return;
+  }
+  if (key.next == 'b') {
+    move_word_left();
+    return;
+  }
+  if (key.next == 'f') {
+    move_word_right();
+    return;
+  }
+  if ((key.next != '[' && key.next != 'O') || key.final_byte < 0) {
+    return;
+  }
+
+  const std::string &params = key.params;
+  switch (key.final_byte) {
+  case 'A':
+    history_up();
+    break;
+  case 'B':
+    history_down();
+    break;
+  case 'C':
+    if (cursor_ < buffer_.size()) {
+      cursor_ = next_char(buffer_, cursor_);
+    }
+    break;
+  case 'D':
+    if (cursor_ > 0) {
+      cursor_ = prev_char(buffer_, cursor_);
+    }
+    break;
+  case 'H':
+    cursor_ = 0;
+    break;
+  case 'F':
+    cursor_ = buffer_.size();
+    break;
+  case '~':
+    if (params == "1" || params == "7") {
+      cursor_ = 0;
+    } else if (params == "4" || params == "8") {
+      cursor_ = buffer_.size();
+    } else if (params == "3" && cursor_ < buffer_.size()) {
+      erase(cursor_, next_char(buffer_, cursor_));
+    } else if (params == "200") {
+      insert(key.paste);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+bool LineEditor::handle_search_key(const Key &key) {
+  const int c = key.byte;
+  if (c == ctrl('R')) {
+    if (query_.empty()) {
+      query_ = last_query_;
+    }
+    update_search(match_ ? *match_ : history_.size());
+    return true;
+  }
+  if (c == ctrl('G')) {
+    end_search(false);
+    return true;
+  }
+  if (c == 0x7f || c == ctrl('H')) {
+    if (!query_.empty()) {
+      query_.erase(prev_char(query_, query_.size()));
+    }
+    update_search(history_.size());
+    return true;
+  }
+  if (c == '\033') {
+    if (key.next < 0) {
+      end_search(false);
+      return true;
+    }
+    // The start of a key such as an arrow, which accepts the match.
+    end_search(true);
+    return false;
+  }
+  if (c == '\t' || !is_control(static_cast<unsigned char>(c))) {
+    query_ += static_cast<char>(c);
+    // The current match may still contain the longer query.
+    update_search(match_ ? *match_ + 1 : history_.size());
+    return true;
+  }
+  end_search(true);
+  return false;
+}
+
+void LineEditor::start_search() {
+  searching_ = true;
+  search_failed_ = false;
+  query_.clear();
+  match_.reset();
+  original_ = buffer_;
+  original_cursor_ = cursor_;
+}
+
+void LineEditor::update_search(size_t before) {
+  // A partly typed character matches nothing yet.
+  if (ends_mid_char(query_)) {
+    return;
+  }
+
+  auto found = history_.search(query_, before);
+  search_failed_ = !found && !query_.empty();
+  if (!found) {
+    return;
+  }
+  match_ = found;
+  buffer_ = history_.at(*found);
+  cursor_ = query_.empty() ? buffer_.size() : buffer_.find(query_);
+}
+
+void LineEditor::end_search(bool accept) {
+  searching_ = false;
+  if (!query_.empty()) {
+    last_query_ = query_;
+  }
+  if (accept && match_) {
+    history_pos_ = *match_;
+    draft_ = original_;
+  } else {
+    buffer_ = std::move(original_);
+    cursor_ = original_cursor_;
+  }
+  original_.clear();
+}
+
+void LineEditor::insert(std::string_view text) {
+  buffer_.insert(cursor_, text);
+  cursor_ += text.size();
+}
+
+void LineEditor::erase(size_t from, size_t to) {
+  buffer_.erase(from, to - from);
+  cursor_ = from;
+}
+
+void LineEditor::move_word_left() {
+  while (cursor_ > 0 && !is_word(buffer_[cursor_ - 1])) {
+    --cursor_;
+  }
+  while (cursor_ > 0 && is_word(buffer_[cursor_ - 1])) {
+    --cursor_;
+  }
+}
+
+void LineEditor::move_word_right() {
+  while (cursor_ < buffer_.size() && !is_word(buffer_[cursor_])) {
+    ++cursor_;
+  }
+  while (cursor_ < buffer_.size() && is_word(buffer_[cursor_])) {
+    ++cursor_;
+  }
+}
+
+void LineEditor::history_up() {
+  size_t pos = history_pos_;
+  do {
+    if (pos == 0) {
+      return;
+    }
+    --pos;
+  } while (history_.removed(pos));
+  show_history(pos);
+}
+
+void LineEditor::history_down() {
+  size_t pos = history_pos_;
+  do {
+    if (pos == history_.size()) {
+      return;
+    }
+    ++pos;
+  } while (pos < history_.size() && history_.removed(pos));
+  show_history(pos);
+}
+
+void LineEditor::show_history(size_t pos) {
+  if (history_pos_ == history_.size()) {
+    draft_ = std::move(buffer_);
+  }
+  history_pos_ = pos;
+  buffer_ = pos == history_.size() ? std::move(draft_) : history_.at(pos);
+  cursor_ = buffer_.size();
+}
+
+void LineEditor::refresh() { write_out(render_line()); }
+
+std::string LineEditor::render_line() {
+  if (output_mid_line_) {
+    return {};
+  }
+  std::string prefix = prompt_;
+  size_t prefix_width = prompt_width_;
+  if (searching_) {
+    prefix = std::string(search_failed_ ? "(failed reverse-i-search)`"
+                                        : "(reverse-i-search)`") +
+             query_ + "': ";
+    prefix_width = visible_width(prefix);
+  }
+
+  const size_t width = columns();
+  // One column is left free so the cursor never wraps past the edge.
+  const size_t room = width > prefix_width + 1 ? width - prefix_width - 1 : 1;
+
+  if (cursor_ < scroll_ || scroll_ > buffer_.size()) {
+    scroll_ = cursor_;
+  } else if (span_width(buffer_, scroll_, cursor_, room) > room) {
+    // Scroll right until the cursor sits at the right edge.
+    scroll_ = cursor_;
+    size_t used = 0;
+    while (scroll_ > 0) {
+      size_t before = prev_char(buffer_, scroll_);
+      size_t w = char_width(static_cast<unsigned char>(buffer_[before]));
+      if (used + w > room) {
+        break;
+      }
+      used += w;
+      scroll_ = before;
+    }
+  }
+
+  std::string out = "\r";
+  out += prefix;
+  size_t column = 0;
+  size_t cursor_column = 0;
+  size_t i = scroll_;
+  for (; i < buffer_.size(); i = next_char(buffer_, i)) {
+    if (i == cursor_) {
+      cursor_column = column;
+    }
+    unsigned char c = static_cast<unsigned char>(buffer_[i]);
+    size_t w = char_width(c);
+    if (column + w > room) {
+      break;
+    }
+    if (is_control(c)) {
+      out += '^';
+      out += static_cast<char>(c ^ 0x40);
+    } else {
+      out.append(buffer_, i, next_char(buffer_, i) - i);
+    }
+    column += w;
+  }
+  if (i == cursor_) {
+    cursor_column = column;
+  }
+
+  out += "\033[K\r";
+  if (prefix_width + cursor_column > 0) {
+    out += "\033[" + std::to_string(prefix_width + cursor_column) + "C";
+  }
+  return out;
+}
+
+void LineEditor::write_out(std::string_view bytes) const {
+  while (!bytes.empty()) {
+#ifdef _WIN32
+    long written = _write(out_fd_, bytes.data(),
+                          static_cast<unsigned int>(bytes.size()));
+#else
+    long written = ::write(out_fd_, bytes.data(), bytes.size());
+#endif
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return;
+    }
+    bytes.remove_prefix(static_cast<size_t>(written));
+  }
+}
+
+void LineEditor::write_out(std::string_view first, std::string_view second,
+                           std::string_view third) const {
+#ifdef _WIN32
+  std::string bytes;
+  bytes.reserve(first.size() + second.size() + third.size());
+  bytes.append(first).append(second).append(third);
+  write_out(bytes);
+#else
+  iovec parts[3];
+  int count = 0;
+  for (std::string_view part : {first, second, third}) {
+    if (!part.empty()) {
+      parts[count++] = {const_cast<char *>(part.data()), part.size()};
+    }
+  }
+  iovec *next = parts;
+  while (count > 0) {
+    ssize_t written = ::writev(out_fd_, next, count);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return;
+    }
+    // Skip what was written and retry the rest.
+    auto left = static_cast<size_t>(written);
+    while (count > 0 && left >= next->iov_len) {
+      left -= next->iov_len;
+      ++next;
+      --count;
+    }
+    if (count > 0) {
+      next->iov_base = static_cast<char *>(next->iov_base) + left;
+      next->iov_len -= left;
+    }
+  }
+#endif
+}
+
+size_t LineEditor::columns() const {
+#ifndef _WIN32
+  winsize size{};
+  if (ioctl(out_fd_, TIOCGWINSZ, &size) == 0 && size.ws_col > 0) {
+    return size.ws_col;
+  }
+#endif
+  return 80;
+}
+
+} // namespace llm
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "repl/history_index.hpp"
+
+namespace llm {
+
+// Line editor for the REPL prompt.
+//
+// When input and output are terminals, lines are edited in raw mode with
+// the usual Emacs keys, Up/Down walk the history, and Ctrl-R searches it
+// incrementally through HistoryIndex. Bracketed paste is enabled, so a
+// paste arrives as one insertion however many lines it spans, and newlines
+// inside it stay part of the line. Only the part of the line around the
+// cursor that fits the terminal is redrawn, so editing a multi-megabyte
+// paste costs the same as a short line. Otherwise lines are read as they
+// come, without echo or editing.
+//
+// Reads the file descriptors directly, so std::cout must be flushed before
+// read_line() and std::cin must not be used alongside it. Other threads
+// write through print() so that their output and the line being edited do
+// not overwrite each other.
+class LineEditor {
+public:
+  // Milliseconds to wait for the rest of an escape sequence before taking
+  // Esc as a key of its own.
+  static constexpr int ESCAPE_TIMEOUT_MS = 50;
+
+  explicit LineEditor(const HistoryIndex &history, int in_fd = 0,
+                      int out_fd = 1);
+
+  LineEditor(const LineEditor &) = delete;
+  LineEditor &operator=(const LineEditor &) = delete;
+
+  // Whether lines are edited; defaults to whether both descriptors are
+  // terminals.
+  bool interactive() const { return interactive_; }
+  void set_interactive(bool interactive) { interactive_ = interactive; }
+
+  // Shows `prompt`, which may contain colour escapes, and reads a line.
+  // Returns nullopt at end of input, or on Ctrl-D at an empty line. Ctrl-C
+  // calls the interrupt handler, then discards the line and returns an
+  // empty one.
+  std::optional<std::string> read_line(std::string_view prompt);
+
+  // Called on the reading thread when Ctrl-C is pressed, since raw mode
+  // keeps the terminal from raising SIGINT.
+  void set_interrupt_handler(std::function<void()> handler) {
+    on_interrupt_ = std::move(handler);
+  }
+
+  // Writes `text` from any thread. While a line is being edited, it is
+  // erased, `text` is written in its place and the line is drawn again
+  // below it, all in one write; while output stops in the middle of a
+  // line, the line being edited stays hidden and keys are still taken.
+  void print(std::string_view text);
+
+private:
+  const HistoryIndex &history_;
+  int in_fd_;
+  int out_fd_;
+  bool interactive_;
+  std::function<void()> on_interrupt_;
+
+  // Guards the line state and the output, which print() shares with the
+  // thread calling read_line().
+  std::mutex mutex_;
+  bool editing_ = false;
+  bool output_mid_line_ = false;
+
+  // Input read but not yet consumed, from pending_pos_ on. Only touched by
+  // the thread calling read_line(), without the lock.
+  std::string pending_;
+  size_t pending_pos_ = 0;
+
+  std::string prompt_;
+  size_t prompt_width_ = 0;
+  std::string buffer_;
+  size_t cursor_ = 0; // byte offset, always at a character boundary
+  size_t scroll_ = 0; // first byte shown
+  // History entry being shown, history_.size() for the line being typed,
+  // which is kept in draft_ meanwhile.
+  size_t history_pos_ = 0;
+  std::string draft_;
+
+  // Reverse search state; the buffer shows the match while searching.
+  bool searching_ = false;
+  bool search_failed_ = false;
+  std::string query_;
+  std::string last_query_;
+  std::optional<size_t> match_;
+  std::string original_;
+  size_t original_cursor_ = 0;
+
+  std::optional<std::string> read_plain();
+  std::optional<std::string> edit(std::string_view prompt);
+  // Ends edit() with `line`, writing `end` if the line is shown.
+  std::optional<std::string> finish(std::optional<std::string> line,
+                                    std::string_view end);
+
+  // A key with whatever belongs to it, read before the lock is taken so
+  // that print() is not held up while input trickles in.
+  struct Key {
+    int byte = -1; // -1 at end of input
+    // After Esc: the next byte, or -1 if none came in time.
+    int next = -1;
+    // Of an Esc [ or Esc O sequence; final_byte is -1 if it was cut short.
+    std::string params;
+    int final_byte = -1;
+    // The text of a bracketed paste.
+    std::string paste;
+  };
+  Key read_key();
+
+  // Reads whatever input is available into pending_, waiting up to
+  // `timeout_ms` (forever if negative). False at end of input or timeout.
+  bool read_more(int timeout_ms);
+  // The next input byte, or -1 at end of input or timeout.
+  int read_byte(int timeout_ms = -1);
+  // The pasted text up to the end-of-paste marker, line endings as '\n'.
+  std::string read_paste();
+
+  // Handles the key sequence after Esc.
+  void handle_escape(const Key &key);
+  // Handles a key while searching; false if it ends the search and should
+  // be handled as an ordinary key.
+  bool handle_search_key(const Key &key);
+  void start_search();
+  void update_search(size_t before);
+  void end_search(bool accept);
+
+  void insert(std::string_view text);
+  void erase(size_t from, size_t to);
+  void move_word_left();
+  void move_word_right();
+  // Move to the next older or newer entry, skipping removed ones.
+  void history_up();
+  void history_down();
+  void show_history(size_t pos);
+
+  // Redraws the line being edited.
+  void refresh();
+  // The bytes that redraw it; empty while output stops mid-line.
+  std::string render_line();
+  void write_out(std::string_view bytes) const;
+  // Writes the parts with a single writev(), so a frame of output never
+  // reaches the terminal half drawn.
+  void write_out(std::string_view first, std::string_view second,
+                 std::string_view third) const;
+  size_t columns() const;
+};
+
+} // namespace llm
@@ -0,0 +1,492 @@
+#include "repl/markdown_renderer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <iterator>
+
+namespace llm {
+
+namespace {
+
+constexpr std::string_view RESET = "\033[0m";
+constexpr std::string_view BOLD = "\033[1m";
+constexpr std::string_view DIM = "\033[2m";
+constexpr std::string_view ITALIC = "\033[3m";
+constexpr std::string_view HEADING = "\033[1;36m";
+constexpr std::string_view CODE_SPAN = "\033[33m";
+constexpr std::string_view KEYWORD = "\033[35m";
+constexpr std::string_view STRING = "\033[32m";
+constexpr std::string_view NUMBER = "\033[36m";
+constexpr std::string_view COMMENT = "\033[2;3m";
+
+// Box-drawing characters, UTF-8 encoded.
+constexpr std::string_view BULLET = "\xe2\x80\xa2";
+constexpr std::string_view H_LINE = "\xe2\x94\x80";
+constexpr std::string_view V_LINE = "\xe2\x94\x82";
+constexpr std::string_view CROSS = "\xe2\x94\xbc";
+constexpr std::string_view LEFT_TEE = "\xe2\x94\x9c";
+constexpr std::string_view RIGHT_TEE = "\xe2\x94\xa4";
+constexpr size_t RULE_WIDTH = 40;
+
+// Keywords of the common languages, highlighted in any code block.
+constexpr std::string_view KEYWORDS[] = {
+    "False",    "None",      "True",      "and",      "as",       "async",
+    "auto",     "await",     "break",     "case",     "catch",    "class",
+    "const",    "continue",  "def",       "default",  "delete",   "do",
+    "elif",     "else",      "enum",      "except",   "export",   "extends",
+    "false",    "fn",        "for",       "from",     "func",     "function",
+    "if",       "impl",      "import",    "in",       "include",  "interface",
+    "is",       "lambda",    "let",       "match",    "mut",      "namespace",
+    "new",      "nil",       "not",       "null",     "nullptr",  "or",
+    "package",  "pass",      "private",   "protected", "public",  "raise",
+    "return",   "self",      "static",    "struct",   "switch",   "template",
+    "this",     "throw",     "true",      "try",      "type",     "typename",
+    "use",      "using",     "var",       "void",     "while",    "with",
+    "yield"};
+static_assert(std::is_sorted(std::begin(KEYWORDS), std::end(KEYWORDS)));
+
+// Languages whose comments start with '#'; others use "//".
+constexpr std::array<std::string_view, 16> HASH_COMMENT_LANGUAGES = {
+    "bash", "cmake", "dockerfile", "make", "perl", "py",    "python", "r",
+    "rb",   "ruby",  "sh",         "shell", "toml", "yaml", "yml",    "zsh"};
+
+bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n'; }
+
+// Letters, digits and any byte of a multi-byte character.
+bool is_word(char c) {
+  auto u = static_cast<unsigned char>(c);
+  return std::isalnum(u) || c == '_' || u >= 0x80;
+}
+
+bool is_ident(char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// A thematic break: three or more of the same '-', '*' or '_'.
+bool is_rule(std::string_view line) {
+  size_t indent = line.find_first_not_of(' ');
+  if (indent == std::string_view::npos) {
+    return false;
+  }
+  line.remove_prefix(indent);
+  return line.size() >= 3 &&
+         std::string_view("-*_").find(line[0]) != std::string_view::npos &&
+         line.find_first_not_of(line[0]) == std::string_view::npos;
+}
+
+} // namespace
+
+void MarkdownRenderer::feed(std::string_view delta, std::string &out) {
+  for (char c : delta) {
+    put(c, out);
+  }
+}
+
+void MarkdownRenderer::finish(std::string &out) {
+  if (line_ == Line::Start) {
+    replay_head(out);
+  } else if (line_ == Line::Table) {
+    render_table_row(out);
+  }
+  if (line_ == Line::Text) {
+    resolve_run(0, out);
+  } else if (line_ == Line::Code) {
+    flush_slash(out);
+    flush_word(out);
+  }
+  if (styled_) {
+    out += RESET;
+  }
+  *this = MarkdownRenderer();
+}
+
+void MarkdownRenderer::put(char c, std::string &out) {
+  if (c == '\r') {
+    return;
+  }
+  switch (line_) {
+  case Line::Start:
+    start_char(c, out);
+    return;
+  case Line::Text:
+    if (c == '\n') {
+      resolve_run(c, out);
+      end_line(out);
+    } else {
+      text_char(c, out);
+    }
+    return;
+  case Line::Table:
+    if (c == '\n') {
+      render_table_row(out);
+      resolve_run(c, out);
+      end_line(out);
+    } else {
+      head_ += c;
+    }
+    return;
+  case Line::FenceOpen:
+    if (c == '\n') {
+      std::string language;
+      for (char ch : head_) {
+        if (!is_space(ch)) {
+          language += static_cast<char>(
+              std::tolower(static_cast<unsigned char>(ch)));
+        } else if (!language.empty()) {
+          break;
+        }
+      }
+      hash_comments_ =
+          std::find(HASH_COMMENT_LANGUAGES.begin(),
+                    HASH_COMMENT_LANGUAGES.end(),
+                    language) != HASH_COMMENT_LANGUAGES.end();
+      in_code_ = true;
+      end_line(out);
+    } else {
+      head_ += c;
+      out += c;
+    }
+    return;
+  case Line::FenceClose:
+    if (c == '\n') {
+      in_code_ = false;
+      end_line(out);
+    } else {
+      out += c;
+    }
+    return;
+  case Line::Code:
+    if (c == '\n') {
+      flush_slash(out);
+      flush_word(out);
+      end_line(out);
+    } else {
+      code_char(c, out);
+    }
+    return;
+  }
+}
+
+void MarkdownRenderer::start_char(char c, std::string &out) {
+  if (c == '\n') {
+    if (!in_code_ && is_rule(head_)) {
+      out += DIM;
+      for (size_t i = 0; i < RULE_WIDTH; ++i) {
+        out += H_LINE;
+      }
+      styled_ = true;
+      end_line(out);
+    } else {
+      replay_head(out);
+      put(c, out);
+    }
+    return;
+  }
+
+  head_ += c;
+  std::string_view rest = head_;
+  const size_t indent = rest.find_first_not_of(' ');
+  if (indent == std::string_view::npos) {
+    return;
+  }
+  rest.remove_prefix(indent);
+
+  if (in_code_) {
+    if (rest.starts_with("```")) {
+      out += DIM;
+      out += head_;
+      styled_ = true;
+      head_.clear();
+      line_ = Line::FenceClose;
+      return;
+    }
+    if (std::string_view("```").starts_with(rest)) {
+      return;
+    }
+    replay_head(out);
+    return;
+  }
+
+  const char marker = rest[0];
+  switch (marker) {
+  case '#': {
+    const size_t hashes = rest.find_first_not_of('#');
+    if (hashes == std::string_view::npos) {
+      if (rest.size() <= 6) {
+        return;
+      }
+    } else if (hashes <= 6 && rest[hashes] == ' ') {
+      head_.clear();
+      line_ = Line::Text;
+      heading_ = true;
+      apply_style(out);
+      return;
+    }
+    break;
+  }
+  case '`':
+    if (rest.starts_with("```")) {
+      out += DIM;
+      out += head_;
+      styled_ = true;
+      head_.clear();
+      line_ = Line::FenceOpen;
+      return;
+    }
+    if (rest.find_first_not_of('`') == std::string_view::npos) {
+      return;
+    }
+    break;
+  case '-':
+  case '*':
+  case '+':
+  case '_':
+    if (rest.size() == 1) {
+      return;
+    }
+    if (rest[1] == ' ' && marker != '_') {
+      out.append(head_, 0, indent);
+      out += BULLET;
+      out += ' ';
+      head_.clear();
+      line_ = Line::Text;
+      prev_ = ' ';
+      return;
+    }
+    // Possibly a rule, known at the end of the line.
+    if (marker != '+' &&
+        rest.find_first_not_of(marker) == std::string_view::npos) {
+      return;
+    }
+    break;
+  case '>':
+    out.append(head_, 0, indent);
+    out += DIM;
+    out += V_LINE;
+    out += RESET;
+    head_.clear();
+    line_ = Line::Text;
+    prev_ = ' ';
+    return;
+  case '|':
+    line_ = Line::Table;
+    return;
+  }
+  replay_head(out);
+}
+
+void MarkdownRenderer::replay_head(std::string &out) {
+  std::string head = std::move(head_);
+  head_.clear();
+  line_ = in_code_ ? Line::Code : Line::Text;
+  for (char c : head) {
+    put(c, out);
+  }
+}
+
+void MarkdownRenderer::end_line(std::string &out) {
+  if (styled_) {
+    out += RESET;
+    styled_ = false;
+  }
+  heading_ = bold_ = italic_ = code_span_ = false;
+  string_quote_ = 0;
+  comment_ = false;
+  out += '\n';
+  head_.clear();
+  line_ = Line::Start;
+  prev_ = '\n';
+}
+
+void MarkdownRenderer::text_char(char c, std::string &out) {
+  if (!run_.empty() && c != run_[0]) {
+    resolve_run(c, out);
+  }
+  if (code_span_) {
+    if (c == '`') {
+      code_span_ = false;
+      apply_style(out);
+    } else {
+      out += c;
+    }
+    prev_ = c;
+    return;
+  }
+  if (c == '*' || c == '_') {
+    run_ += c;
+    return;
+  }
+  if (c == '`') {
+    code_span_ = true;
+    apply_style(out);
+    prev_ = c;
+    return;
+  }
+  out += c;
+  prev_ = c;
+}
+
+void MarkdownRenderer::resolve_run(char next, std::string &out) {
+  if (run_.empty()) {
+    return;
+  }
+  const char marker = run_[0];
+  const size_t count = run_.size();
+  // '_' inside a word, as in snake_case, is never emphasis.
+  const bool intraword = marker == '_' && is_word(prev_) && is_word(next);
+  if (count <= 3 && !intraword) {
+    const bool bold = count >= 2;
+    const bool italic = count != 2;
+    // Closing needs text right before the markers, opening right after.
+    const bool can_close = !is_space(prev_);
+    const bool can_open = next != 0 && !is_space(next);
+    if ((!bold || (bold_ ? can_close : can_open)) &&
+        (!italic || (italic_ ? can_close : can_open))) {
+      bold_ = bold ? !bold_ : bold_;
+      italic_ = italic ? !italic_ : italic_;
+      run_.clear();
+      apply_style(out);
+      return;
+    }
+  }
+  out += run_;
+  prev_ = marker;
+  run_.clear();
+}
+
+void MarkdownRenderer::apply_style(std::string &out) {
+  out += RESET;
+  if (heading_) {
+    out += HEADING;
+  }
+  if (bold_) {
+    out += BOLD;
+  }
+  if (italic_) {
+    out += ITALIC;
+  }
+  if (code_span_) {
+    out += CODE_SPAN;
+  }
+  styled_ = heading_ || bold_ || italic_ || code_span_;
+}
+
+void MarkdownRenderer::code_char(char c, std::string &out) {
+  if (comment_) {
+    out += c;
+    return;
+  }
+  if (string_quote_ != 0) {
+    out += c;
+    if (c == string_quote_ && prev_ != '\\') {
+      out += RESET;
+      styled_ = false;
+      string_quote_ = 0;
+    }
+    // An escaped backslash escapes nothing after it.
+    prev_ = prev_ == '\\' && c == '\\' ? 0 : c;
+    return;
+  }
+  if (is_ident(c)) {
+    flush_slash(out);
+    word_ += c;
+    return;
+  }
+  flush_word(out);
+
+  if (c == '/' && !hash_comments_) {
+    if (!slash_) {
+      slash_ = true;
+      return;
+    }
+    slash_ = false;
+    out += COMMENT;
+    out += "//";
+    comment_ = styled_ = true;
+    return;
+  }
+  flush_slash(out);
+  if (c == '#' && hash_comments_) {
+    out += COMMENT;
+    out += c;
+    comment_ = styled_ = true;
+    return;
+  }
+  if (c == '"' || c == '\'') {
+    out += STRING;
+    out += c;
+    string_quote_ = c;
+    styled_ = true;
+    prev_ = c;
+    return;
+  }
+  out += c;
+}
+
+void MarkdownRenderer::flush_word(std::string &out) {
+  if (word_.empty()) {
+    return;
+  }
+  std::string_view style;
+  if (std::isdigit(static_cast<unsigned char>(word_[0]))) {
+    style = NUMBER;
+  } else if (std::binary_search(std::begin(KEYWORDS), std::end(KEYWORDS),
+                                std::string_view(word_))) {
+    style = KEYWORD;
+  }
+  if (style.empty()) {
+    out += word_;
+  } else {
+    out += style;
+    out += word_;
+    out += RESET;
+  }
+  word_.clear();
+}
+
+void MarkdownRenderer::flush_slash(std::string &out) {
+  if (slash_) {
+    out += '/';
+    slash_ = false;
+  }
+}
+
+void MarkdownRenderer::render_table_row(std::string &out) {
+  std::string row = std::move(head_);
+  head_.clear();
+  line_ = Line::Text;
+
+  const size_t first = row.find('|');
+  const size_t last = row.rfind('|');
+  const bool separator = row.find_first_not_of("|-: ") == std::string::npos &&
+                         row.find('-') != std::string::npos;
+  if (separator) {
+    out += DIM;
+    for (size_t i = 0; i < row.size(); ++i) {
+      if (row[i] == '|') {
+        out += i == first ? LEFT_TEE : i == last ? RIGHT_TEE : CROSS;
+      } else if (i < first || i > last) {
+        out += row[i];
+      } else {
+        out += H_LINE;
+      }
+    }
+    styled_ = true;
+    return;
+  }
+
+  for (char c : row) {
+    if (c == '|' && !code_span_) {
+      resolve_run(c, out);
+      out += DIM;
+      out += V_LINE;
+      apply_style(out);
+      prev_ = ' ';
+    } else {
+      text_char(c, out);
+    }
+  }
+}
+
+} // namespace llm
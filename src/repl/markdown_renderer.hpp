@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace llm {
+
+// Renders Markdown to ANSI-styled text as it streams in. Input is consumed
+// a character at a time by a state machine, and each character is written
+// once: only the characters whose meaning depends on what follows - the
+// start of a line until its block type is known, a run of emphasis
+// markers, a word inside a code block, a table row - are held back until
+// the next character settles them. The cost per delta is therefore
+// proportional to the delta, never to the message.
+//
+// Handles ATX headings, bullet and quote lines, horizontal rules, `code`,
+// *italic*, **bold**, fenced code blocks with keyword, string, number and
+// comment highlighting, and pipe tables. Anything else passes through.
+class MarkdownRenderer {
+public:
+  // Appends the rendering of `delta` to `out`.
+  void feed(std::string_view delta, std::string &out);
+
+  // Ends the message: appends whatever was held back and a style reset if
+  // needed, and gets ready for the next message.
+  void finish(std::string &out);
+
+private:
+  enum class Line {
+    Start,     // block type not known yet; the line so far is in head_
+    Text,      // paragraph, heading, bullet or quote content
+    Table,     // a pipe table row, collected in head_
+    FenceOpen, // an opening fence; the info string is collected in head_
+    FenceClose,
+    Code,
+  };
+
+  Line line_ = Line::Start;
+  std::string head_;
+  // The last character written, for word-boundary checks.
+  char prev_ = '\n';
+  // Whether styles were emitted since the last reset.
+  bool styled_ = false;
+
+  // Inline state of Line::Text.
+  bool heading_ = false;
+  bool bold_ = false;
+  bool italic_ = false;
+  bool code_span_ = false;
+  std::string run_; // '*' or '_' markers not yet resolved
+
+  // State of code blocks.
+  bool in_code_ = false;
+  bool hash_comments_ = false;
+  std::string word_;
+  char string_quote_ = 0;
+  bool comment_ = false;
+  bool slash_ = false;
+
+  void put(char c, std::string &out);
+  void start_char(char c, std::string &out);
+  void replay_head(std::string &out);
+  void end_line(std::string &out);
+
+  void text_char(char c, std::string &out);
+  void resolve_run(char next, std::string &out);
+  void apply_style(std::string &out);
+
+  void code_char(char c, std::string &out);
+  void flush_word(std::string &out);
+  void flush_slash(std::string &out);
+
+  void render_table_row(std::string &out);
+};
+
+} // namespace llm
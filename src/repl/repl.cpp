@@ -3,13 +3,17 @@
 #include <algorithm>
 #include <chrono>
 #include <csignal>
+#include <ctime>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <limits>
 #include <sstream>
+#include <streambuf>
 #include <thread>
+#include <utility>
 
 #include "llm/groq_service.hpp"
+#include "repl/frame_renderer.hpp"
 #include "utils/logger.hpp"
 
 #ifdef _WIN32
@@ -22,19 +26,93 @@
 
 namespace llm {
 
+namespace {
+
+#ifndef _WIN32
+constexpr std::string_view ANSI_RESET = "\033[0m";
+constexpr std::pair<std::string_view, std::string_view> ANSI_COLORS[] = {
+    {"red", "\033[31m"},   {"green", "\033[32m"},   {"yellow", "\033[33m"},
+    {"blue", "\033[34m"},  {"magenta", "\033[35m"}, {"cyan", "\033[36m"},
+    {"white", "\033[37m"}, {"reset", ANSI_RESET}};
+#endif
+
+// The journal a REPL uses when another one holds `path`: the same name with
+// the process id before the extension.
+std::string process_journal_path(const std::string &path) {
+#ifdef _WIN32
+  const unsigned long pid = GetCurrentProcessId();
+#else
+  const long pid = static_cast<long>(::getpid());
+#endif
+  std::filesystem::path journal(path);
+  journal.replace_filename(journal.stem().string() + "." +
+                           std::to_string(pid) +
+                           journal.extension().string());
+  return journal.string();
+}
+
+// Passes what is written to std::cout or std::cerr to the line editor a
+// line at a time, so the worker's output never lands inside the line being
+// typed.
+class EditorOutput : public std::streambuf {
+public:
+  explicit EditorOutput(LineEditor &editor) : editor_(editor) {}
+
+protected:
+  int_type overflow(int_type c) override {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      buffer_ += traits_type::to_char_type(c);
+      if (c == '\n') {
+        sync();
+      }
+    }
+    return traits_type::not_eof(c);
+  }
+
+  std::streamsize xsputn(const char *s, std::streamsize n) override {
+    buffer_.append(s, static_cast<size_t>(n));
+    if (std::string_view(s, static_cast<size_t>(n)).find('\n') !=
+        std::string_view::npos) {
+      sync();
+    }
+    return n;
+  }
+
+  int sync() override {
+    if (!buffer_.empty()) {
+      editor_.print(buffer_);
+      buffer_.clear();
+    }
+    return 0;
+  }
+
+private:
+  LineEditor &editor_;
+  std::string buffer_;
+};
+
+} // namespace
+
 REPL *REPL::instance_ = nullptr;
 
-REPL::REPL(std::unique_ptr<Config> config) : config_(std::move(config)) {
+REPL::REPL(std::unique_ptr<Config> config)
+    : config_(std::move(config)),
+      tokenizers_(config_->expand_path(config_->get_repl_config().tokenizer_dir)) {
   instance_ = this;
   setup_signal_handlers();
+  editor_.set_interrupt_handler([this] {
+    if (auto *target = interrupt_target_.load()) {
+      target->cancel();
+    }
+  });
 
   spdlog::debug("REPL initialization starting...");
   spdlog::debug("Provider: {}", config_->get_provider());
 
-  auto provider_config = config_->get_provider_config(config_->get_provider());
-  conversation_.set_system_prompt(config_->get_repl_config().system_prompt);
-
   if (config_->get_provider() == "groq") {
+    auto provider_config =
+        config_->get_provider_config(config_->get_provider());
+    const auto &repl_config = config_->get_repl_config();
     std::string api_key = config_->get_api_key();
     spdlog::debug("Creating GroqService with:");
     spdlog::debug("  API URL: {}", provider_config.api_url);
@@ -43,29 +121,47 @@ REPL::REPL(std::unique_ptr<Config> config) : config_(std::move(config)) {
     spdlog::debug("  Max tokens: {}", provider_config.max_tokens);
     spdlog::debug("  API Key loaded: {}", api_key.empty() ? "NO (EMPTY!)" : "YES");
 
-    llm_service_ = std::make_unique<GroqService>(api_key, provider_config.api_url);
-    llm_service_->set_model(provider_config.model);
-    llm_service_->set_temperature(provider_config.temperature);
-    llm_service_->set_max_tokens(provider_config.max_tokens);
+    http_pool_ =
+        std::make_shared<HttpClientPool>(provider_config.api_url, api_key);
+    if (repl_config.response_cache_entries > 0) {
+      response_cache_ =
+          std::make_shared<ResponseCache>(repl_config.response_cache_entries);
+    }
+    if (repl_config.requests_per_minute > 0) {
+      // The whole minute's quota may go at once, as the provider allows.
+      rate_limiter_ = std::make_shared<RateLimiter>(
+          repl_config.requests_per_minute, repl_config.requests_per_minute);
+    }
   }
 
+  auto session = make_session("default");
+  active_ = session.get();
+  active_->attached = true;
+  interrupt_target_ = &active_->cancel;
+  live_sessions_.emplace(session->name, std::move(session));
+
+  open_search_index();
+  open_session_store();
+  open_journal();
+  collect_garbage();
   load_history();
 }
 
 REPL::~REPL() {
+  stop_requests();
   cleanup();
   instance_ = nullptr;
 }
 
 void REPL::run() {
-  if (!llm_service_) {
+  if (!active_->service) {
     spdlog::error("LLM service was not created!");
     std::cerr << colorize_text("Error: LLM service was not created!", "red") << std::endl;
     return;
   }
 
   spdlog::debug("Checking if LLM service is available...");
-  if (!llm_service_->is_available()) {
+  if (!active_->service->is_available()) {
     spdlog::error("Service availability check failed!");
     std::cerr << colorize_text("Error: LLM service is not available. Please "
                                "check your configuration and "
@@ -79,39 +175,145 @@ void REPL::run() {
   running_ = true;
   print_welcome();
 
-  while (running_) {
-    try {
-      std::string input = read_input();
+  // From here on the worker prints through the editor, which keeps its
+  // output and the line being typed apart.
+  EditorOutput out(editor_);
+  EditorOutput err(editor_);
+  auto *saved_out = std::cout.rdbuf(&out);
+  auto *saved_err = std::cerr.rdbuf(&err);
 
-      if (input.empty()) {
-        continue;
-      }
+  std::thread renderer(&REPL::render_loop, this);
+  std::thread worker(&REPL::work_loop, this);
+  input_loop();
+  jobs_.push(Job{{}, false, true});
+  worker.join();
+  stop_requests();
+  render_queue_.push(RenderEvent{RenderEvent::Kind::Stop, {}});
+  renderer.join();
 
-      add_to_history(input);
+  std::cout.flush();
+  std::cerr.flush();
+  std::cout.rdbuf(saved_out);
+  std::cerr.rdbuf(saved_err);
+  cleanup();
+}
 
-      if (!process_command(input)) {
-        break;
+void REPL::input_loop() {
+  while (running_) {
+    std::string input = read_input();
+    if (input.empty()) {
+      continue;
+    }
+
+    add_to_history(input);
+    std::istringstream iss(input);
+    std::string cmd;
+    iss >> cmd;
+    jobs_.push(Job{input, jobs_in_flight_.fetch_add(1) > 0});
+    if (cmd == "/exit") {
+      break;
+    }
+  }
+}
+
+void REPL::work_loop() {
+  while (true) {
+    Job job = jobs_.pop();
+    if (job.stop) {
+      break;
+    }
+    try {
+      std::istringstream iss(job.input);
+      std::string cmd;
+      iss >> cmd;
+      // Only leaving the active session may overtake its reply, which then
+      // goes on in the background.
+      if (cmd == "/new" || cmd == "/switch" || cmd == "/exit") {
+        detach(*active_);
+      } else {
+        wait_for_request(*active_);
+      }
+      if (job.echo) {
+        std::cout << colorize_text(config_->get_repl_config().prompt_prefix,
+                                   "blue")
+                  << job.input << std::endl;
+      }
+      std::lock_guard lock(state_mutex_);
+      if (!process_command(job.input)) {
+        running_ = false;
       }
     } catch (const std::exception &e) {
       std::cerr << colorize_text("Error: " + std::string(e.what()), "red")
                 << std::endl;
     }
+    std::cout.flush();
+    jobs_in_flight_.fetch_sub(1);
   }
+}
 
-  cleanup();
+void REPL::render_loop() {
+  FrameRenderer frame([this](std::string_view text) { editor_.print(text); },
+                      config_->get_repl_config().render_fps);
+  std::optional<RenderEvent> next;
+  while (true) {
+    if (!next) {
+      next = frame.empty() ? render_queue_.pop() : render_queue_.try_pop();
+    }
+    if (!next) {
+      // Nothing more yet: wait out the frame, then take everything that
+      // came meanwhile.
+      std::this_thread::sleep_until(frame.deadline());
+      while ((next = render_queue_.try_pop()) &&
+             next->kind == RenderEvent::Kind::Text) {
+        frame.append(next->text);
+      }
+      frame.flush();
+      continue;
+    }
+
+    RenderEvent event = std::move(*next);
+    next.reset();
+    if (event.kind == RenderEvent::Kind::Text) {
+      frame.append(event.text);
+      if (frame.due()) {
+        frame.flush();
+      }
+      continue;
+    }
+    frame.flush();
+    if (event.kind == RenderEvent::Kind::Barrier) {
+      barriers_rendered_.fetch_add(1);
+      barriers_rendered_.notify_all();
+    } else {
+      return;
+    }
+  }
+}
+
+void REPL::wait_for_render() {
+  const uint64_t target = ++barriers_sent_;
+  {
+    std::lock_guard lock(render_mutex_);
+    render_queue_.push(RenderEvent{RenderEvent::Kind::Barrier, {}});
+  }
+  uint64_t rendered;
+  while ((rendered = barriers_rendered_.load()) < target) {
+    barriers_rendered_.wait(rendered);
+  }
 }
 
 void REPL::stop() { running_ = false; }
 
 void REPL::set_llm_service(std::unique_ptr<LLMService> service) {
-  llm_service_ = std::move(service);
+  active_->service = std::move(service);
+  apply_model_tokenizer(*active_);
 }
 
 void REPL::print_welcome() {
   std::cout << colorize_text("LLM REPL v1.0.0", "cyan") << std::endl;
   std::cout << colorize_text("Provider: " + config_->get_provider(), "yellow")
             << std::endl;
-  std::cout << colorize_text("Model: " + llm_service_->get_current_model(),
+  std::cout << colorize_text("Model: " + active_->service->get_current_model(),
                              "yellow")
             << std::endl;
   std::cout << colorize_text("Type '/help' for commands or '/exit' to quit.",
@@ -125,34 +327,34 @@ void REPL::print_help() {
   std::cout << "  /help           - Show this help message" << std::endl;
   std::cout << "  /clear          - Clear conversation history" << std::endl;
   std::cout << "  /history        - Show conversation history" << std::endl;
-  std::cout << "  /save [file]    - Save conversation to file" << std::endl;
-  std::cout << "  /load [file]    - Load conversation from file" << std::endl;
+  std::cout << "  /save [file]    - Save conversation to file or named session" << std::endl;
+  std::cout << "  /load [file]    - Load conversation from file or named session" << std::endl;
   std::cout << "  /model [name]   - Switch to different model" << std::endl;
   std::cout << "  /system [prompt]- Set system prompt" << std::endl;
+  std::cout << "  /fork <name> [turns] - Branch off the first turns (default: all)"
+            << std::endl;
+  std::cout << "  /checkout <name>- Switch to another branch" << std::endl;
+  std::cout << "  /branches       - List branches" << std::endl;
+  std::cout << "  /search <query> - Search saved conversations and past sessions"
+            << std::endl;
+  std::cout << "  /new <name> [model] - Start a session and switch to it"
+            << std::endl;
+  std::cout << "  /switch <name>  - Switch to another session" << std::endl;
+  std::cout << "  /sessions       - List sessions" << std::endl;
   std::cout << "  /exit           - Exit the REPL" << std::endl;
   std::cout << std::endl;
 }
 
 std::string REPL::read_input() {
-  std::cout << colorize_text(config_->get_repl_config().prompt_prefix, "blue");
-  std::cout.flush();
-
-  std::string input;
-  if (!std::getline(std::cin, input)) {
-    // Check if we've reached EOF or if cin is in a bad state
-    if (std::cin.eof()) {
-      std::cout << std::endl << colorize_text("EOF detected. Exiting...", "yellow") << std::endl;
-      running_ = false;
-      return "";
-    }
-
-    // Clear error flags and try again
-    std::cin.clear();
-    std::cin.ignore((std::numeric_limits<std::streamsize>::max)(), '\n');
+  auto input = editor_.read_line(
+      colorize_text(config_->get_repl_config().prompt_prefix, "blue"));
+  if (!input) {
+    // std::cout belongs to the worker thread.
+    editor_.print(colorize_text("EOF detected. Exiting...", "yellow") + "\n");
+    running_ = false;
     return "";
   }
-
-  return input;
+  return std::move(*input);
 }
 
 bool REPL::process_command(const std::string &input) {
@@ -165,37 +367,195 @@ bool REPL::process_command(const std::string &input) {
 }
 
 void REPL::process_user_input(const std::string &input) {
-  if (processing_) {
-    std::cout << colorize_text(
-                     "Please wait for the current request to complete.",
-                     "yellow")
+  LiveSession &session = *active_;
+  try {
+    if (session.compactor &&
+        session.compactor->apply_ready(session.conversation)) {
+      journal_checkpoint();
+    }
+    session.conversation.add_user(input);
+    record_message(MessageRole::User, input);
+
+    // The full history stays in the conversation; only the request is
+    // packed. Either way the request gets an O(1) snapshot, so the
+    // conversation may change while it runs.
+    auto packed = pack_context(session);
+    start_request(session, packed ? std::move(*packed) : session.conversation);
+  } catch (const std::exception &e) {
+    std::cerr << colorize_text("Error processing request: " +
+                                   std::string(e.what()),
+                               "red")
               << std::endl;
-    return;
   }
+}
 
-  processing_ = true;
+std::unique_ptr<REPL::LiveSession>
+REPL::make_session(const std::string &name) {
+  const auto &repl_config = config_->get_repl_config();
+  auto session = std::make_unique<LiveSession>();
+  session->name = name;
+  session->conversation.set_system_prompt(repl_config.system_prompt);
+  const auto &cold_dir = repl_config.cold_dir;
+  session->conversation.set_resident_budget(
+      repl_config.resident_budget_mb << 20,
+      cold_dir.empty() ? cold_dir : config_->expand_path(cold_dir));
 
-  try {
-    conversation_.add_user(input);
+  if (!http_pool_) {
+    return session;
+  }
+  auto provider_config = config_->get_provider_config(config_->get_provider());
+  session->service = std::make_unique<GroqService>(http_pool_, response_cache_,
+                                                   rate_limiter_);
+  session->service->set_model(provider_config.model);
+  session->service->set_temperature(provider_config.temperature);
+  session->service->set_max_tokens(provider_config.max_tokens);
+  apply_model_tokenizer(*session);
 
-    if (config_->get_repl_config().streaming) {
-      print_streaming_response(input);
-    } else {
-      auto response = llm_service_->complete(conversation_);
-      print_response(response);
+  // Summaries go through the pool too, so they never wait for the
+  // connection of an interactive request.
+  auto summarizer =
+      std::make_shared<GroqService>(http_pool_, nullptr, rate_limiter_);
+  summarizer->set_model(repl_config.compaction_model);
+  summarizer->set_temperature(0.2f);
+  session->compactor = std::make_unique<ContextCompactor>(
+      std::move(summarizer), repl_config.compaction_threshold);
+  return session;
+}
+
+void REPL::start_request(LiveSession &session, Conversation context) {
+  if (session.request.joinable()) {
+    session.request.join();
+  }
+  // A Ctrl-C from before this request does not count.
+  session.cancel.reset();
+  session.busy = true;
+  session.request =
+      std::thread([this, &session, context = std::move(context)] {
+        run_request(session, context);
+      });
+}
 
+void REPL::run_request(LiveSession &session, const Conversation &context) {
+  const auto &repl_config = config_->get_repl_config();
+  MarkdownRenderer markdown;
+  // Chunks go to the render thread. While its queue is full they pile up
+  // in `pending` instead, so reading the response never waits for the
+  // terminal.
+  RenderEvent pending;
+  std::string reply;
+  try {
+    if (repl_config.streaming) {
+      pending.text = colorize_text(repl_config.ai_prefix, "green");
+      emit(session, pending, false);
+      session.service->stream_complete(
+          context,
+          [this, &session, &markdown, &pending,
+           &reply](const std::string &chunk, bool is_done) {
+            if (!is_done) {
+              reply += chunk;
+              render_markdown(markdown, chunk, pending.text);
+              // Markdown may hold the chunk back until the next one.
+              if (!pending.text.empty()) {
+                emit(session, pending, false);
+              }
+            }
+          },
+          session.cancel);
+      finish_markdown(markdown, pending.text);
+      if (session.cancel.cancelled()) {
+        // What arrived so far is kept as the answer.
+        pending.text += "\n" + colorize_text("[interrupted]", "yellow");
+      }
+      pending.text += "\n\n";
+    } else {
+      auto response = session.service->complete(context);
       if (response.success) {
-        conversation_.add_assistant(response.content);
+        reply = std::move(response.content);
+        pending.text = colorize_text(repl_config.ai_prefix, "green");
+        render_markdown(markdown, reply, pending.text);
+        finish_markdown(markdown, pending.text);
+        pending.text += "\n\n";
+      } else {
+        pending.text = colorize_text("Error: " + response.error, "red") + "\n";
       }
     }
   } catch (const std::exception &e) {
-    std::cerr << colorize_text("Error processing request: " +
-                                   std::string(e.what()),
-                               "red")
-              << std::endl;
+    pending.text += "\n" +
+                    colorize_text("Error processing request: " +
+                                      std::string(e.what()),
+                                  "red") +
+                    "\n";
   }
+  emit(session, pending, true);
 
-  processing_ = false;
+  {
+    std::lock_guard lock(state_mutex_);
+    if (!reply.empty()) {
+      session.conversation.add_assistant(reply);
+      if (&session == active_) {
+        record_message(MessageRole::Assistant, reply);
+      } else if (search_) {
+        search_->add_turn(search_source(session), MessageRole::Assistant,
+                          reply);
+      }
+    }
+    start_compaction(session);
+  }
+  session.busy = false;
+  session.busy.notify_all();
+}
+
+void REPL::wait_for_request(LiveSession &session) {
+  session.busy.wait(true);
+  // Whatever the worker prints next must come after the response.
+  wait_for_render();
+}
+
+void REPL::emit(LiveSession &session, RenderEvent &event, bool wait) {
+  std::lock_guard lock(render_mutex_);
+  if (!session.attached) {
+    session.backlog += event.text;
+    event.text.clear();
+  } else if (wait) {
+    render_queue_.push(std::move(event));
+    event.text.clear();
+  } else if (render_queue_.try_push(event)) {
+    event.text.clear();
+  }
+}
+
+void REPL::detach(LiveSession &session) {
+  {
+    std::lock_guard lock(render_mutex_);
+    if (session.attached && session.busy) {
+      // Ends the reply's partial line; the rest is kept for later.
+      render_queue_.push(RenderEvent{RenderEvent::Kind::Text, "\n"});
+    }
+    session.attached = false;
+  }
+  wait_for_render();
+}
+
+void REPL::attach(LiveSession &session) {
+  active_ = &session;
+  interrupt_target_ = &session.cancel;
+  std::lock_guard lock(render_mutex_);
+  session.attached = true;
+  if (!session.backlog.empty()) {
+    render_queue_.push(RenderEvent{
+        RenderEvent::Kind::Text,
+        colorize_text("[" + session.name + "] ", "cyan") +
+            std::exchange(session.backlog, {})});
+  }
+}
+
+void REPL::stop_requests() {
+  for (auto &[name, session] : live_sessions_) {
+    if (session->request.joinable()) {
+      session->cancel.cancel();
+      session->request.join();
+    }
+  }
 }
 
 bool REPL::handle_slash_command(const std::string &command) {
@@ -229,7 +589,7 @@ bool REPL::handle_slash_command(const std::string &command) {
     std::string model_name;
     iss >> model_name;
     if (model_name.empty()) {
-      auto models = llm_service_->get_available_models();
+      auto models = active_->service->get_available_models();
       std::cout << colorize_text("Available models:", "cyan") << std::endl;
       for (const auto &model : models) {
         std::cout << "  " << model.id << " - " << model.name << std::endl;
@@ -249,6 +609,63 @@ bool REPL::handle_slash_command(const std::string &command) {
     } else {
       handle_system_command(prompt);
     }
+  } else if (cmd == "/fork") {
+    std::string name;
+    iss >> name;
+    std::optional<size_t> turns;
+    size_t value = 0;
+    if (iss >> value) {
+      turns = value;
+    }
+    if (name.empty()) {
+      std::cout << colorize_text("Usage: /fork <name> [turns]", "yellow")
+                << std::endl;
+    } else {
+      handle_fork_command(name, turns);
+    }
+  } else if (cmd == "/checkout") {
+    std::string name;
+    iss >> name;
+    if (name.empty()) {
+      std::cout << colorize_text("Usage: /checkout <name>", "yellow")
+                << std::endl;
+    } else {
+      handle_checkout_command(name);
+    }
+  } else if (cmd == "/branches") {
+    handle_branches_command();
+  } else if (cmd == "/search") {
+    std::string query;
+    std::getline(iss, query);
+    if (!query.empty() && query[0] == ' ') {
+      query = query.substr(1);
+    }
+    if (query.empty()) {
+      std::cout << colorize_text("Usage: /search <query>", "yellow")
+                << std::endl;
+    } else {
+      handle_search_command(query);
+    }
+  } else if (cmd == "/new") {
+    std::string name, model;
+    iss >> name >> model;
+    if (name.empty()) {
+      std::cout << colorize_text("Usage: /new <name> [model]", "yellow")
+                << std::endl;
+    } else {
+      handle_new_command(name, model);
+    }
+  } else if (cmd == "/switch") {
+    std::string name;
+    iss >> name;
+    if (name.empty()) {
+      std::cout << colorize_text("Usage: /switch <name>", "yellow")
+                << std::endl;
+    } else {
+      handle_switch_command(name);
+    }
+  } else if (cmd == "/sessions") {
+    handle_sessions_command();
   } else if (cmd == "/exit") {
     handle_exit_command();
     return false;
@@ -264,26 +681,54 @@ bool REPL::handle_slash_command(const std::string &command) {
 void REPL::handle_help_command() { print_help(); }
 
 void REPL::handle_clear_command() {
-  conversation_.clear();
-  conversation_.set_system_prompt(config_->get_repl_config().system_prompt);
+  Conversation &conversation = active_->conversation;
+  conversation.clear();
+  conversation.set_system_prompt(config_->get_repl_config().system_prompt);
+  journal_checkpoint();
   std::cout << colorize_text("Conversation history cleared.", "green")
             << std::endl;
 }
 
 void REPL::handle_history_command() {
-  if (conversation_.empty()) {
+  if (active_->conversation.empty()) {
     std::cout << colorize_text("No conversation history.", "yellow")
               << std::endl;
     return;
   }
 
+  const auto archived = active_->conversation.archived();
+  if (!archived.empty()) {
+    std::cout << colorize_text("Summarized turns (" +
+                                   std::to_string(archived.size()) + "):",
+                               "cyan")
+              << std::endl;
+    std::cout << Conversation::to_string(archived);
+  }
+
   std::cout << colorize_text("Conversation History:", "cyan") << std::endl;
-  std::cout << conversation_.to_string() << std::endl;
+  std::cout << active_->conversation.to_string() << std::endl;
 }
 
 void REPL::handle_save_command(const std::string &filename) {
+  if (sessions_ && SessionStore::is_name(filename)) {
+    if (sessions_->save(filename, active_->conversation)) {
+      std::cout << colorize_text("Conversation saved as session: " + filename,
+                                 "green")
+                << std::endl;
+    } else {
+      std::cerr << colorize_text("Error saving session: " + filename, "red")
+                << std::endl;
+    }
+    return;
+  }
+
   try {
-    conversation_.save_to_file(config_->expand_path(filename));
+    active_->conversation.save_to_file(
+        config_->expand_path(filename),
+        config_->get_repl_config().compress_sessions);
+    if (search_) {
+      search_->index_file(config_->expand_path(filename));
+    }
     std::cout << colorize_text("Conversation saved to: " + filename, "green")
               << std::endl;
   } catch (const std::exception &e) {
@@ -295,8 +740,26 @@ void REPL::handle_save_command(const std::string &filename) {
 }
 
 void REPL::handle_load_command(const std::string &filename) {
+  if (sessions_ && sessions_->contains(filename)) {
+    if (sessions_->load(filename, active_->conversation)) {
+      journal_checkpoint();
+      std::cout << colorize_text("Conversation loaded from session: " +
+                                     filename,
+                                 "green")
+                << std::endl;
+    } else {
+      std::cerr << colorize_text("Error loading session: " + filename, "red")
+                << std::endl;
+    }
+    return;
+  }
+
   try {
-    conversation_.load_from_file(config_->expand_path(filename));
+    active_->conversation.load_from_file(config_->expand_path(filename));
+    journal_checkpoint();
+    if (search_) {
+      search_->index_file(config_->expand_path(filename));
+    }
     std::cout << colorize_text("Conversation loaded from: " + filename, "green")
               << std::endl;
   } catch (const std::exception &e) {
@@ -308,60 +771,411 @@ void REPL::handle_load_command(const std::string &filename) {
 }
 
 void REPL::handle_model_command(const std::string &model_name) {
-  llm_service_->set_model(model_name);
+  active_->service->set_model(model_name);
+  apply_model_tokenizer(*active_);
   std::cout << colorize_text("Switched to model: " + model_name, "green")
             << std::endl;
 }
 
 void REPL::handle_system_command(const std::string &prompt) {
-  conversation_.set_system_prompt(prompt);
+  active_->conversation.set_system_prompt(prompt);
+  if (journal_) {
+    journal_->record_system(prompt);
+  }
   std::cout << colorize_text("System prompt updated.", "green") << std::endl;
 }
 
+void REPL::handle_fork_command(const std::string &name,
+                               std::optional<size_t> turns) {
+  size_t kept = std::min(turns.value_or(active_->conversation.turn_count()),
+                         active_->conversation.turn_count());
+  if (!active_->branches.fork(active_->conversation, name, kept)) {
+    std::cout << colorize_text("Branch already exists: " + name, "red")
+              << std::endl;
+    return;
+  }
+  journal_checkpoint();
+  std::cout << colorize_text("Switched to new branch '" + name + "' with " +
+                                 std::to_string(kept) + " turns.",
+                             "green")
+            << std::endl;
+}
+
+void REPL::handle_checkout_command(const std::string &name) {
+  if (!active_->branches.checkout(active_->conversation, name)) {
+    std::cout << colorize_text("No such branch: " + name, "red") << std::endl;
+    return;
+  }
+  // The branch may have been stashed under a different model's tokenizer.
+  apply_model_tokenizer(*active_);
+  journal_checkpoint();
+  std::cout << colorize_text("Switched to branch '" + name + "'.", "green")
+            << std::endl;
+}
+
+void REPL::handle_branches_command() {
+  for (const auto &branch : active_->branches.branches(active_->conversation)) {
+    std::string line = (branch.current ? "* " : "  ") + branch.name + " (" +
+                       std::to_string(branch.messages) + " messages";
+    if (!branch.parent.empty()) {
+      line += ", forked from " + branch.parent + " at turn " +
+              std::to_string(branch.fork_turn);
+    }
+    line += ")";
+    std::cout << (branch.current ? colorize_text(line, "green") : line)
+              << std::endl;
+  }
+}
+
+void REPL::handle_search_command(const std::string &query) {
+  if (!search_) {
+    std::cout << colorize_text("Search is disabled (repl.search_index).",
+                               "yellow")
+              << std::endl;
+    return;
+  }
+  if (search_->loading()) {
+    std::cout << colorize_text("Search index still loading; results may be "
+                               "incomplete.",
+                               "yellow")
+              << std::endl;
+  }
+
+  auto started = std::chrono::steady_clock::now();
+  auto hits = search_->search(query);
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - started);
+  spdlog::debug("Search for '{}' took {} us", query, elapsed.count());
+
+  if (hits.empty()) {
+    std::cout << colorize_text("No matches.", "yellow") << std::endl;
+    return;
+  }
+  for (const auto &hit : hits) {
+    std::cout << colorize_text(hit.location(), "cyan") << std::endl;
+    std::cout << "  " << hit.snippet << std::endl;
+  }
+}
+
+void REPL::handle_new_command(const std::string &name,
+                              const std::string &model) {
+  if (live_sessions_.contains(name)) {
+    std::cout << colorize_text("Session already exists: " + name, "red")
+              << std::endl;
+    attach(*active_);
+    return;
+  }
+  auto session = make_session(name);
+  if (!session->service) {
+    std::cout << colorize_text("Sessions need the groq provider.", "red")
+              << std::endl;
+    attach(*active_);
+    return;
+  }
+  if (!model.empty()) {
+    session->service->set_model(model);
+    apply_model_tokenizer(*session);
+  }
+  const bool was_busy = active_->busy;
+  const std::string previous = active_->name;
+  auto &added = *live_sessions_.emplace(name, std::move(session)).first->second;
+  attach(added);
+  journal_checkpoint();
+  if (was_busy) {
+    std::cout << colorize_text("Session '" + previous +
+                                   "' keeps answering in the background.",
+                               "yellow")
+              << std::endl;
+  }
+  std::cout << colorize_text("Switched to new session '" + name + "' (" +
+                                 added.service->get_current_model() + ").",
+                             "green")
+            << std::endl;
+}
+
+void REPL::handle_switch_command(const std::string &name) {
+  auto it = live_sessions_.find(name);
+  if (it == live_sessions_.end()) {
+    std::cout << colorize_text("No such session: " + name, "red") << std::endl;
+    attach(*active_);
+    return;
+  }
+  if (active_->busy && it->second.get() != active_) {
+    std::cout << colorize_text("Session '" + active_->name +
+                                   "' keeps answering in the background.",
+                               "yellow")
+              << std::endl;
+  }
+  std::cout << colorize_text("Switched to session '" + name + "'.", "green")
+            << std::endl;
+  attach(*it->second);
+  journal_checkpoint();
+}
+
+void REPL::handle_sessions_command() {
+  for (const auto &[name, session] : live_sessions_) {
+    const bool current = session.get() == active_;
+    std::string line =
+        (current ? "* " : "  ") + name + " (" +
+        (session->service ? session->service->get_current_model() + ", "
+                          : "") +
+        std::to_string(session->conversation.size()) + " messages";
+    if (session->busy) {
+      line += ", answering";
+    }
+    {
+      std::lock_guard lock(render_mutex_);
+      if (!session->backlog.empty()) {
+        line += ", unread output";
+      }
+    }
+    line += ")";
+    std::cout << (current ? colorize_text(line, "green") : line) << std::endl;
+  }
+}
+
 void REPL::handle_exit_command() {
   std::cout << colorize_text("Goodbye!", "cyan") << std::endl;
 }
 
-void REPL::load_history() {
-  try {
-    std::string history_file =
-        config_->expand_path(config_->get_repl_config().history_file);
-    std::ifstream file(history_file);
-    if (file.is_open()) {
-      std::string line;
-      while (std::getline(file, line)) {
-        command_history_.push_back(line);
+std::optional<ModelInfo>
+REPL::current_model_info(const LiveSession &session) const {
+  if (!session.service) {
+    return std::nullopt;
+  }
+
+  std::string model_id = session.service->get_current_model();
+  for (const auto &model : session.service->get_available_models()) {
+    if (model.id == model_id) {
+      return model;
+    }
+  }
+  return std::nullopt;
+}
+
+void REPL::apply_model_tokenizer(LiveSession &session) {
+  if (!session.service) {
+    return;
+  }
+
+  auto model = current_model_info(session);
+  if (!model) {
+    model = ModelInfo{session.service->get_current_model(), "", 0, true};
+  }
+
+  session.conversation.set_tokenizer(tokenizers_.for_model(*model));
+  spdlog::debug("Using tokenizer '{}' for model {}",
+                session.conversation.tokenizer().name(), model->id);
+}
+
+std::optional<size_t> REPL::context_budget(const LiveSession &session) const {
+  auto model = current_model_info(session);
+  if (!model || model->context_length == 0) {
+    return std::nullopt;
+  }
+
+  // Leave room for the reply so the request never exceeds the window.
+  size_t reply_tokens =
+      config_->get_provider_config(config_->get_provider()).max_tokens;
+  return model->context_length > reply_tokens
+             ? model->context_length - reply_tokens
+             : model->context_length / 2;
+}
+
+void REPL::start_compaction(LiveSession &session) {
+  auto budget = context_budget(session);
+  if (session.compactor && budget) {
+    session.compactor->maybe_start(session.conversation, *budget);
+  }
+}
+
+void REPL::open_journal() {
+  const std::string &configured = config_->get_repl_config().session_journal;
+  if (configured.empty()) {
+    return;
+  }
+
+  std::string path = config_->expand_path(configured);
+  std::error_code ec;
+  std::filesystem::create_directories(
+      std::filesystem::path(path).parent_path(), ec);
+  BlobStore *blobs = sessions_ ? &sessions_->blobs() : nullptr;
+
+  // Journals locked by another process belong to a REPL that is still
+  // running. Of the others, prefer one with something to recover: the
+  // shared journal, or the per-process one of a REPL that crashed while
+  // another held it.
+  std::unique_ptr<SessionJournal> idle;
+  for (const auto &candidate : SessionJournal::candidates(path)) {
+    auto journal = std::make_unique<SessionJournal>(candidate, blobs);
+    if (!journal->acquire()) {
+      continue;
+    }
+    std::error_code size_ec;
+    auto size = std::filesystem::file_size(candidate, size_ec);
+    if (!size_ec && size > 0) {
+      journal_ = std::move(journal);
+      break;
+    }
+    if (!idle) {
+      idle = std::move(journal);
+    } else {
+      journal->remove();
+    }
+  }
+  if (journal_ && idle) {
+    idle->remove();
+  } else if (idle) {
+    journal_ = std::move(idle);
+  } else if (!journal_) {
+    journal_ = std::make_unique<SessionJournal>(process_journal_path(path),
+                                                blobs);
+    if (!journal_->acquire()) {
+      spdlog::warn("Session journal {} is in use; journaling disabled",
+                   journal_->path());
+      journal_.reset();
+      return;
+    }
+  }
+
+  // The journal follows the active session, so a crash brings back the
+  // one in use at the time.
+  Conversation &conversation = active_->conversation;
+  // A journal left behind means the last session did not exit cleanly.
+  auto recovered = journal_->recover(conversation);
+  if (recovered && !conversation.empty()) {
+    std::cout << colorize_text("Recovered " +
+                                   std::to_string(conversation.size()) +
+                                   " messages from an interrupted session.",
+                               "yellow")
+              << std::endl;
+    // Turns the crashed session had not yet persisted to the search index.
+    if (search_) {
+      for (const auto &message : conversation.messages()) {
+        if (message.role != MessageRole::System) {
+          search_->add_turn(session_name_, message.role,
+                            std::string(message.content));
+        }
       }
     }
-  } catch (const std::exception &e) {
-    std::cout << "[DEBUG] Failed to load history: " << e.what() << "\n";
+  } else {
+    conversation.clear();
+    conversation.set_system_prompt(config_->get_repl_config().system_prompt);
   }
+  // Start from a compact journal either way.
+  journal_checkpoint();
 }
 
-void REPL::save_history() {
-  try {
-    std::string history_file =
-        config_->expand_path(config_->get_repl_config().history_file);
-    std::ofstream file(history_file);
-    if (file.is_open()) {
-      size_t max_history = config_->get_repl_config().max_history;
-      size_t start = command_history_.size() > max_history
-                         ? command_history_.size() - max_history
-                         : 0;
-
-      for (size_t i = start; i < command_history_.size(); ++i) {
-        file << command_history_[i] << std::endl;
+void REPL::open_session_store() {
+  const std::string &configured = config_->get_repl_config().session_dir;
+  if (configured.empty()) {
+    return;
+  }
+  sessions_ = std::make_unique<SessionStore>(config_->expand_path(configured));
+}
+
+void REPL::collect_garbage() {
+  if (!sessions_) {
+    return;
+  }
+  // Besides the manifests, blobs are referenced by this REPL's journal, by
+  // those of other REPLs still running and by crashed ones not yet
+  // recovered; recovery stops at the first blob that is missing.
+  std::vector<ContentHash> pinned;
+  const std::string &configured = config_->get_repl_config().session_journal;
+  if (!configured.empty()) {
+    for (const auto &candidate :
+         SessionJournal::candidates(config_->expand_path(configured))) {
+      auto hashes = SessionJournal::blob_references(candidate);
+      if (!hashes) {
+        spdlog::warn("Cannot read session journal {}; not collecting blobs",
+                     candidate);
+        return;
       }
+      pinned.insert(pinned.end(), hashes->begin(), hashes->end());
     }
-  } catch (const std::exception &e) {
-    std::cout << "[DEBUG] Failed to save history: " << e.what() << "\n";
+  }
+  sessions_->collect_garbage(pinned);
+}
+
+void REPL::open_search_index() {
+  const std::string &configured = config_->get_repl_config().search_index;
+  if (configured.empty()) {
+    return;
+  }
+
+  std::string path = config_->expand_path(configured);
+  std::error_code ec;
+  std::filesystem::create_directories(
+      std::filesystem::path(path).parent_path(), ec);
+  search_ = std::make_unique<SearchIndexer>(path);
+
+  auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+  char stamp[32];
+  std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+  session_name_ = std::string("session ") + stamp;
+}
+
+std::string REPL::search_source(const LiveSession &session) const {
+  return session.name == "default" ? session_name_
+                                   : session_name_ + " (" + session.name + ")";
+}
+
+void REPL::record_message(MessageRole role, const std::string &content) {
+  if (journal_) {
+    journal_->record_message(role, content);
+  }
+  if (search_) {
+    search_->add_turn(search_source(*active_), role, content);
+  }
+}
+
+void REPL::journal_checkpoint() {
+  if (journal_) {
+    journal_->checkpoint(active_->conversation);
+  }
+}
+
+std::optional<Conversation>
+REPL::pack_context(const LiveSession &session) const {
+  auto budget = context_budget(session);
+  if (!budget || session.conversation.estimate_tokens() <= *budget) {
+    return std::nullopt;
+  }
+
+  auto packed = session.conversation.select_context(*budget);
+  spdlog::debug("Context packed from {} to {} messages to fit {} tokens",
+                session.conversation.size(), packed.size(), *budget);
+  return packed;
+}
+
+void REPL::load_history() {
+  const auto &repl_config = config_->get_repl_config();
+  if (repl_config.history_file.empty()) {
+    return;
+  }
+
+  std::string path = config_->expand_path(repl_config.history_file);
+  std::error_code ec;
+  std::filesystem::create_directories(
+      std::filesystem::path(path).parent_path(), ec);
+  history_log_ = std::make_unique<HistoryLog>(path, repl_config.max_history);
+  if (!history_log_->load(command_history_)) {
+    spdlog::warn("Failed to load history from {}", path);
   }
 }
 
 void REPL::add_to_history(const std::string &command) {
-  if (!command.empty() &&
-      (command_history_.empty() || command_history_.back() != command)) {
-    command_history_.push_back(command);
+  if (command.empty() ||
+      (!command_history_.empty() && command_history_.back() == command)) {
+    return;
+  }
+  // An earlier use of the command moves to the front.
+  command_history_.add(command);
+  if (history_log_ &&
+      !history_log_->append(command, command_history_.count())) {
+    spdlog::debug("Failed to append to history file {}",
+                  history_log_->path());
   }
 }
 
@@ -370,64 +1184,60 @@ void REPL::setup_signal_handlers() {
   std::signal(SIGTERM, signal_handler);
 }
 
-void REPL::cleanup() { save_history(); }
+void REPL::cleanup() {
+  if (journal_) {
+    journal_->remove();
+  }
+}
 
 std::string REPL::colorize_text(const std::string &text,
                                 const std::string &color) const {
 #ifdef _WIN32
   return text;
 #else
-  std::map<std::string, std::string> colors = {
-      {"red", "\033[31m"},   {"green", "\033[32m"},   {"yellow", "\033[33m"},
-      {"blue", "\033[34m"},  {"magenta", "\033[35m"}, {"cyan", "\033[36m"},
-      {"white", "\033[37m"}, {"reset", "\033[0m"}};
-
-  auto it = colors.find(color);
-  if (it != colors.end()) {
-    return it->second + text + colors["reset"];
+  for (const auto &[name, code] : ANSI_COLORS) {
+    if (name == color) {
+      std::string out;
+      out.reserve(code.size() + text.size() + ANSI_RESET.size());
+      out.append(code).append(text).append(ANSI_RESET);
+      return out;
+    }
   }
   return text;
 #endif
 }
 
-void REPL::print_streaming_response(const std::string &prompt) {
-  std::cout << colorize_text(config_->get_repl_config().ai_prefix, "green");
-  std::cout.flush();
-
-  std::string full_response;
-  llm_service_->stream_complete(
-      conversation_,
-      [this, &full_response](const std::string &chunk, bool is_done) {
-        if (!is_done) {
-          std::cout << chunk << std::flush;
-          full_response += chunk;
-        } else {
-          std::cout << std::endl << std::endl;
-        }
-      });
-
-  if (!full_response.empty()) {
-    conversation_.add_assistant(full_response);
+void REPL::render_markdown(MarkdownRenderer &markdown, std::string_view text,
+                           std::string &out) {
+#ifdef _WIN32
+  // Colours are off on Windows, as in colorize_text().
+  out += text;
+#else
+  if (config_->get_repl_config().markdown_rendering) {
+    markdown.feed(text, out);
+  } else {
+    out += text;
   }
+#endif
 }
 
-void REPL::print_response(const CompletionResponse &response) {
-  if (response.success) {
-    std::cout << colorize_text(config_->get_repl_config().ai_prefix, "green")
-              << response.content << std::endl
-              << std::endl;
-  } else {
-    std::cerr << colorize_text("Error: " + response.error, "red") << std::endl;
+void REPL::finish_markdown(MarkdownRenderer &markdown, std::string &out) {
+#ifdef _WIN32
+  (void)markdown;
+  (void)out;
+#else
+  if (config_->get_repl_config().markdown_rendering) {
+    markdown.finish(out);
   }
+#endif
 }
 
-void REPL::signal_handler(int signal) {
+void REPL::signal_handler(int) {
+  // Only async-signal-safe work here; the request notices the cancel.
   if (instance_) {
-    std::cout << std::endl
-              << instance_->colorize_text(
-                     "Interrupt received. Type '/exit' to quit.", "yellow")
-              << std::endl;
-    instance_->processing_ = false;
+    if (auto *target = instance_->interrupt_target_.load()) {
+      target->cancel();
+    }
   }
 }
 
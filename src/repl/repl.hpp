@@ -1,13 +1,33 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "http/http_client_pool.hpp"
+#include "llm/context_compactor.hpp"
 #include "llm/llm_service.hpp"
+#include "llm/rate_limiter.hpp"
+#include "llm/response_cache.hpp"
 #include "models/conversation.hpp"
+#include "models/conversation_tree.hpp"
+#include "models/session_journal.hpp"
+#include "models/session_store.hpp"
+#include "repl/history_index.hpp"
+#include "repl/history_log.hpp"
+#include "repl/line_editor.hpp"
+#include "repl/markdown_renderer.hpp"
+#include "search/search_indexer.hpp"
+#include "tokenizer/tokenizer_registry.hpp"
+#include "utils/cancellation.hpp"
 #include "utils/config.hpp"
+#include "utils/spsc_queue.hpp"
 
 namespace llm {
 
@@ -22,21 +42,128 @@ public:
   void set_llm_service(std::unique_ptr<LLMService> service);
 
 private:
+  // A named conversation with its own model and settings. Its requests run
+  // on a thread of their own, so a long reply in one session does not hold
+  // up questions in another.
+  struct LiveSession {
+    std::string name;
+    std::unique_ptr<LLMService> service;
+    std::unique_ptr<ContextCompactor> compactor;
+    Conversation conversation;
+    // Branches other than the one in conversation.
+    ConversationTree branches;
+    // Stops the session's request; Ctrl-C fires the active session's.
+    CancellationToken cancel;
+    std::thread request;
+    // Set while `request` runs.
+    std::atomic<bool> busy{false};
+    // Whether the session's output goes to the terminal, and what it wrote
+    // while it did not, shown when it is switched to. Guarded by
+    // render_mutex_.
+    bool attached = false;
+    std::string backlog;
+  };
+
   std::unique_ptr<Config> config_;
-  std::unique_ptr<LLMService> llm_service_;
-  Conversation conversation_;
+  // Connections, cached replies and the request rate, shared by the
+  // services of all sessions. Null unless the provider is Groq.
+  std::shared_ptr<HttpClientPool> http_pool_;
+  std::shared_ptr<ResponseCache> response_cache_;
+  std::shared_ptr<RateLimiter> rate_limiter_;
+  // Sessions by name; never removed while the REPL runs.
+  std::map<std::string, std::unique_ptr<LiveSession>> live_sessions_;
+  // The session that input goes to. Changed only by the worker.
+  LiveSession *active_ = nullptr;
+  // Held by the worker while it handles a line and by a request thread
+  // while it adds the reply, so that conversations, the journal and the
+  // search index have one writer at a time.
+  std::mutex state_mutex_;
+  // Null when repl.session_dir is empty. Declared before journal_, which
+  // stores blobs in it.
+  std::unique_ptr<SessionStore> sessions_;
+  // Null when journaling is disabled.
+  std::unique_ptr<SessionJournal> journal_;
+  // Null when search is disabled.
+  std::unique_ptr<SearchIndexer> search_;
+  // Source name of this session's turns in the search index.
+  std::string session_name_;
+  TokenizerRegistry tokenizers_;
   std::atomic<bool> running_{false};
-  std::atomic<bool> processing_{false};
+  // The active session's token, fired by Ctrl-C from either the line
+  // editor or the SIGINT handler when input is not a terminal.
+  std::atomic<CancellationToken *> interrupt_target_{nullptr};
+
+  // A line read by the input thread for the worker thread.
+  struct Job {
+    std::string input;
+    // Entered while an earlier line was being handled, so it is shown
+    // again when its turn comes.
+    bool echo = false;
+    bool stop = false;
+  };
+
+  // Output of a streamed response for the render thread.
+  struct RenderEvent {
+    enum class Kind { Text, Barrier, Stop };
+    Kind kind = Kind::Text;
+    std::string text;
+  };
+
+  // The input thread reads lines into jobs_. The worker thread handles
+  // them in order and starts requests, whose threads queue the replies of
+  // the active session for the render thread, which alone writes them to
+  // the terminal.
+  SpscQueue<Job, 64> jobs_;
+  SpscQueue<RenderEvent, 256> render_queue_;
+  // Lets the worker and request threads take turns as the producer of
+  // render_queue_.
+  std::mutex render_mutex_;
+  // Lines queued and not yet handled.
+  std::atomic<size_t> jobs_in_flight_{0};
+  // Barriers sent by the worker and passed by the render thread.
+  uint64_t barriers_sent_ = 0;
+  std::atomic<uint64_t> barriers_rendered_{0};
 
-  std::vector<std::string> command_history_;
-  size_t history_index_ = 0;
+  HistoryIndex command_history_;
+  LineEditor editor_{command_history_};
+  // Null when repl.history_file is empty.
+  std::unique_ptr<HistoryLog> history_log_;
 
   void print_welcome();
   void print_help();
   std::string read_input();
+  void input_loop();
+  void work_loop();
+  void render_loop();
+  // Blocks the worker until the render thread has written everything
+  // queued so far.
+  void wait_for_render();
+  // Appends `text` to `out`, through `markdown` if rendering is on.
+  void render_markdown(MarkdownRenderer &markdown, std::string_view text,
+                       std::string &out);
+  void finish_markdown(MarkdownRenderer &markdown, std::string &out);
   bool process_command(const std::string &input);
   void process_user_input(const std::string &input);
 
+  // A session named `name` with the configured model and system prompt;
+  // its service is null unless the provider is Groq.
+  std::unique_ptr<LiveSession> make_session(const std::string &name);
+  // Runs the reply to `context` on the session's request thread.
+  void start_request(LiveSession &session, Conversation context);
+  void run_request(LiveSession &session, const Conversation &context);
+  // Blocks the worker until the session's request has finished.
+  void wait_for_request(LiveSession &session);
+  // Sends the text of `event` to the terminal if the session is attached,
+  // to its backlog otherwise. Unless `wait`, a full render queue leaves the
+  // text in `event` to go with the next chunk.
+  void emit(LiveSession &session, RenderEvent &event, bool wait);
+  // Routes the session's output to its backlog from now on.
+  void detach(LiveSession &session);
+  // Makes `session` active and writes what it did while detached.
+  void attach(LiveSession &session);
+  // Cancels requests still running at exit and waits for them.
+  void stop_requests();
+
   bool handle_slash_command(const std::string &command);
   void handle_help_command();
   void handle_clear_command();
@@ -45,10 +172,36 @@ private:
   void handle_load_command(const std::string &filename);
   void handle_model_command(const std::string &model_name);
   void handle_system_command(const std::string &prompt);
+  void handle_fork_command(const std::string &name,
+                           std::optional<size_t> turns);
+  void handle_checkout_command(const std::string &name);
+  void handle_branches_command();
+  void handle_search_command(const std::string &query);
+  void handle_new_command(const std::string &name, const std::string &model);
+  void handle_switch_command(const std::string &name);
+  void handle_sessions_command();
   void handle_exit_command();
 
+  std::optional<ModelInfo> current_model_info(const LiveSession &session) const;
+  void apply_model_tokenizer(LiveSession &session);
+  std::optional<size_t> context_budget(const LiveSession &session) const;
+  std::optional<Conversation> pack_context(const LiveSession &session) const;
+  void start_compaction(LiveSession &session);
+
+  void open_session_store();
+  void open_journal();
+  // Deletes blobs referenced by neither a saved session nor the journal.
+  void collect_garbage();
+  void open_search_index();
+  // Source name of a session's turns in the search index.
+  std::string search_source(const LiveSession &session) const;
+  // Journals and indexes a message appended to the active conversation.
+  // The journal follows the active session only.
+  void record_message(MessageRole role, const std::string &content);
+  // Journals a change to the active conversation that is not an append.
+  void journal_checkpoint();
+
   void load_history();
-  void save_history();
   void add_to_history(const std::string &command);
 
   void setup_signal_handlers();
@@ -56,8 +209,6 @@ private:
 
   std::string colorize_text(const std::string &text,
                             const std::string &color) const;
-  void print_streaming_response(const std::string &prompt);
-  void print_response(const CompletionResponse &response);
 
   static void signal_handler(int signal);
   static REPL *instance_;
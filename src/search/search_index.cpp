@@ -0,0 +1,976 @@
+#include "search/search_index.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "models/blob_store.hpp"
+#include "models/conversation_importer.hpp"
+#include "models/relevance_index.hpp"
+#include "models/session_file.hpp"
+#include "utils/durable_file.hpp"
+#include "utils/logger.hpp"
+
+namespace llm {
+
+namespace {
+
+constexpr char SNAPSHOT_RECORD = 'S';
+constexpr char TURN_RECORD = 'T';
+// A file was re-indexed: its earlier turns are tombstoned.
+constexpr char FILE_RECORD = 'F';
+// Attempts to open the file that the last snapshot left in place.
+constexpr int OPEN_ATTEMPTS = 8;
+
+#ifdef _WIN32
+int open_index(const std::string &path, bool append) {
+  return ::_open(path.c_str(),
+                 (append ? _O_WRONLY | _O_APPEND : _O_RDONLY) | _O_CREAT |
+                     _O_BINARY,
+                 _S_IREAD | _S_IWRITE);
+}
+void close_index(int fd) { ::_close(fd); }
+int write_some(int fd, const char *data, size_t size) {
+  return ::_write(fd, data, static_cast<unsigned>(size));
+}
+bool lock(int fd, bool exclusive) {
+  OVERLAPPED overlapped{};
+  return LockFileEx(reinterpret_cast<HANDLE>(::_get_osfhandle(fd)),
+                    exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, MAXDWORD,
+                    MAXDWORD, &overlapped) != 0;
+}
+bool is_empty(int fd) { return ::_filelengthi64(fd) == 0; }
+// Windows cannot rename over a file others have open, so a locked file is
+// never replaced.
+bool still_current(int, const std::string &) { return true; }
+#else
+int open_index(const std::string &path, bool append) {
+  return ::open(path.c_str(),
+                (append ? O_WRONLY | O_APPEND : O_RDONLY) | O_CREAT | O_CLOEXEC,
+                0600);
+}
+void close_index(int fd) { ::close(fd); }
+ssize_t write_some(int fd, const char *data, size_t size) {
+  return ::write(fd, data, size);
+}
+bool lock(int fd, bool exclusive) {
+  int result;
+  do {
+    result = ::flock(fd, exclusive ? LOCK_EX : LOCK_SH);
+  } while (result != 0 && errno == EINTR);
+  return result == 0;
+}
+bool is_empty(int fd) {
+  struct stat info {};
+  return ::fstat(fd, &info) == 0 && info.st_size == 0;
+}
+// Whether `fd` is still the file at `path`, not one a snapshot replaced.
+bool still_current(int fd, const std::string &path) {
+  struct stat opened {};
+  struct stat current {};
+  return ::fstat(fd, &opened) == 0 && ::stat(path.c_str(), &current) == 0 &&
+         opened.st_dev == current.st_dev && opened.st_ino == current.st_ino;
+}
+#endif
+
+// Opens the index file at `path`, creating it empty if missing, and locks
+// it, reopening if a snapshot renames a new file over it meanwhile.
+// Returns -1 on failure; closing the descriptor releases the lock.
+int open_locked(const std::string &path, bool append, bool exclusive) {
+  for (int attempt = 0; attempt < OPEN_ATTEMPTS; ++attempt) {
+    int fd = open_index(path, append);
+    if (fd < 0) {
+      return -1;
+    }
+    if (!lock(fd, exclusive)) {
+      close_index(fd);
+      return -1;
+    }
+    if (still_current(fd, path)) {
+      return fd;
+    }
+    close_index(fd);
+  }
+  return -1;
+}
+
+bool write_all(int fd, std::string_view bytes) {
+  while (!bytes.empty()) {
+    auto written = write_some(fd, bytes.data(), bytes.size());
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes.remove_prefix(static_cast<size_t>(written));
+  }
+  return true;
+}
+
+void put_varint(std::string &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+void put_string(std::string &out, std::string_view text) {
+  put_varint(out, text.size());
+  out.append(text);
+}
+
+// Bounds-checked reader; every getter returns false once the input is
+// exhausted or malformed.
+class Reader {
+public:
+  explicit Reader(std::string_view bytes) : bytes_(bytes) {}
+
+  bool empty() const { return bytes_.empty(); }
+
+  bool varint(uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (bytes_.empty()) {
+        return false;
+      }
+      auto byte = static_cast<unsigned char>(bytes_.front());
+      bytes_.remove_prefix(1);
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <typename T> bool varint_as(T &value) {
+    uint64_t raw = 0;
+    if (!varint(raw) || raw > std::numeric_limits<T>::max()) {
+      return false;
+    }
+    value = static_cast<T>(raw);
+    return true;
+  }
+
+  bool byte(uint8_t &value) {
+    if (bytes_.empty()) {
+      return false;
+    }
+    value = static_cast<uint8_t>(bytes_.front());
+    bytes_.remove_prefix(1);
+    return true;
+  }
+
+  bool string(std::string_view &value) {
+    uint64_t length = 0;
+    if (!varint(length) || length > bytes_.size()) {
+      return false;
+    }
+    value = bytes_.substr(0, length);
+    bytes_.remove_prefix(length);
+    return true;
+  }
+
+private:
+  std::string_view bytes_;
+};
+
+// Calls `fn(doc, frequency, positions)` for each entry of encoded postings.
+template <typename Fn> void for_each_posting(std::string_view bytes, Fn &&fn) {
+  Reader reader(bytes);
+  std::vector<uint32_t> positions;
+  uint64_t doc = 0;
+  while (!reader.empty()) {
+    uint64_t delta = 0;
+    uint32_t frequency = 0;
+    if (!reader.varint(delta) || !reader.varint_as(frequency)) {
+      return;
+    }
+    doc += delta;
+    positions.clear();
+    uint64_t position = 0;
+    for (uint32_t i = 0; i < frequency; ++i) {
+      uint64_t step = 0;
+      if (!reader.varint(step)) {
+        return;
+      }
+      position += step;
+      positions.push_back(static_cast<uint32_t>(position));
+    }
+    fn(doc, frequency, positions);
+  }
+}
+
+void encode_posting(std::string &out, uint64_t delta,
+                    const std::vector<uint32_t> &positions) {
+  put_varint(out, delta);
+  put_varint(out, positions.size());
+  uint32_t previous = 0;
+  for (uint32_t position : positions) {
+    put_varint(out, position - previous);
+    previous = position;
+  }
+}
+
+std::string file_header() {
+  std::string header(SearchIndex::MAGIC, sizeof(SearchIndex::MAGIC));
+  header.push_back(static_cast<char>(SearchIndex::VERSION & 0xFF));
+  header.push_back(static_cast<char>(SearchIndex::VERSION >> 8));
+  header.append(2, '\0');
+  return header;
+}
+
+// Appends one record to the index file at `path` in a single write, so
+// that records of other processes never land inside it.
+bool append_record(const std::string &path, char tag,
+                   std::string_view payload) {
+  std::string record;
+  record.push_back(tag);
+  put_string(record, payload);
+
+  int fd = open_locked(path, true, false);
+  if (fd < 0) {
+    return false;
+  }
+  if (is_empty(fd)) {
+    record.insert(0, file_header());
+  }
+  bool ok = write_all(fd, record);
+  close_index(fd);
+  return ok;
+}
+
+// The contents of `turns` of the conversation file at `path`; turns it no
+// longer has, or all of them if it cannot be read, are missing.
+std::unordered_map<size_t, std::string>
+read_turns(const std::string &path, const std::unordered_set<size_t> &turns) {
+  std::unordered_map<size_t, std::string> contents;
+  try {
+    if (SessionFile::is_session_file(path)) {
+      SessionFile file;
+      if (!file.open(path)) {
+        return contents;
+      }
+      for (size_t turn : turns) {
+        if (turn < file.size()) {
+          contents.emplace(turn, file.content(turn));
+        }
+      }
+    } else {
+      MappedFile file;
+      if (!file.open(path)) {
+        return contents;
+      }
+      size_t turn = 0;
+      ConversationImporter().import(file.view(), [&](Message &&message) {
+        if (turns.contains(turn++)) {
+          contents.emplace(turn - 1, std::move(message.content));
+        }
+      });
+    }
+  } catch (const std::exception &e) {
+    spdlog::debug("Cannot read {}: {}", path, e.what());
+  }
+  return contents;
+}
+
+// In file_clock ticks, which may be negative.
+std::optional<int64_t> modification_time(const std::string &path) {
+  std::error_code ec;
+  auto time = std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    return std::nullopt;
+  }
+  return static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+std::string lower_ascii(std::string_view text) {
+  std::string lower(text);
+  for (char &ch : lower) {
+    if (ch >= 'A' && ch <= 'Z') {
+      ch = static_cast<char>(ch - 'A' + 'a');
+    }
+  }
+  return lower;
+}
+
+// A window of `text` around the first query term it contains.
+std::string make_snippet(std::string_view text,
+                         const std::vector<std::string> &terms) {
+  std::string lower = lower_ascii(text);
+  size_t hit = std::string::npos;
+  for (const auto &term : terms) {
+    hit = std::min(hit, lower.find(term));
+  }
+  size_t start = 0;
+  if (hit != std::string::npos && hit > SearchIndex::SNIPPET_BYTES / 4) {
+    start = hit - SearchIndex::SNIPPET_BYTES / 4;
+  }
+  size_t end = std::min(text.size(), start + SearchIndex::SNIPPET_BYTES);
+  // Do not cut UTF-8 sequences.
+  while (start > 0 && (static_cast<unsigned char>(text[start]) & 0xC0) == 0x80) {
+    --start;
+  }
+  while (end < text.size() &&
+         (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) {
+    ++end;
+  }
+
+  std::string snippet = start > 0 ? "..." : "";
+  for (char ch : text.substr(start, end - start)) {
+    snippet.push_back(ch == '\n' || ch == '\r' || ch == '\t' ? ' ' : ch);
+  }
+  if (end < text.size()) {
+    snippet += "...";
+  }
+  return snippet;
+}
+
+} // namespace
+
+SearchIndex::Prepared SearchIndex::prepare(MessageRole role,
+                                           std::string_view text) {
+  Prepared doc{role, ContentHash::of(text).low, 0, {}};
+  std::unordered_map<std::string, size_t> slots;
+  RelevanceIndex::for_each_term(text, [&](std::string_view term) {
+    auto [it, inserted] = slots.try_emplace(std::string(term), doc.terms.size());
+    if (inserted) {
+      doc.terms.emplace_back(it->first, std::vector<uint32_t>());
+    }
+    doc.terms[it->second].second.push_back(doc.length++);
+  });
+  return doc;
+}
+
+uint32_t SearchIndex::source_id(const std::string &name, bool file) {
+  auto [it, inserted] =
+      source_ids_.try_emplace(name, static_cast<uint32_t>(sources_.size()));
+  if (inserted) {
+    Source source;
+    source.name = name;
+    source.file = file;
+    sources_.push_back(std::move(source));
+  }
+  return it->second;
+}
+
+void SearchIndex::insert(uint32_t source, Prepared &&doc,
+                         std::string_view text) {
+  const auto id = static_cast<uint32_t>(docs_.size());
+  for (const auto &[term, positions] : doc.terms) {
+    Postings &postings = postings_[term];
+    encode_posting(postings.bytes, id - postings.last_doc, positions);
+    postings.last_doc = id;
+    ++postings.count;
+  }
+  docs_.push_back(Doc{source, static_cast<uint32_t>(sources_[source].turns++),
+                      doc.role, false, doc.length,
+                      static_cast<uint32_t>(doc.terms.size()), doc.hash,
+                      text});
+  ++live_docs_;
+  total_length_ += doc.length;
+  live_postings_ += doc.terms.size();
+}
+
+void SearchIndex::remove_source_turns(uint32_t source) {
+  for (auto &doc : docs_) {
+    if (doc.source != source || doc.deleted) {
+      continue;
+    }
+    doc.deleted = true;
+    doc.text = {};
+    --live_docs_;
+    total_length_ -= doc.length;
+    live_postings_ -= doc.distinct;
+    stale_postings_ += doc.distinct;
+  }
+  sources_[source].turns = 0;
+  if (stale_postings_ > live_postings_) {
+    compact();
+  }
+}
+
+void SearchIndex::compact() {
+  for (auto it = postings_.begin(); it != postings_.end();) {
+    Postings kept;
+    for_each_posting(it->second.bytes, [&](uint64_t doc, uint32_t,
+                                           const std::vector<uint32_t> &positions) {
+      if (doc < docs_.size() && !docs_[doc].deleted) {
+        encode_posting(kept.bytes, doc - kept.last_doc, positions);
+        kept.last_doc = static_cast<uint32_t>(doc);
+        ++kept.count;
+      }
+    });
+    if (kept.count == 0) {
+      it = postings_.erase(it);
+    } else {
+      it->second = std::move(kept);
+      ++it;
+    }
+  }
+  stale_postings_ = 0;
+}
+
+void SearchIndex::clear() {
+  sources_.clear();
+  source_ids_.clear();
+  docs_.clear();
+  postings_.clear();
+  live_docs_ = 0;
+  total_length_ = 0;
+  live_postings_ = 0;
+  stale_postings_ = 0;
+  file_.close();
+  texts_.clear();
+  records_ = 0;
+}
+
+void SearchIndex::add_turn(const std::string &source, MessageRole role,
+                           std::string_view text) {
+  Prepared doc = prepare(role, text);
+  std::unique_lock lock(mutex_);
+  insert(source_id(source, false), std::move(doc), texts_.emplace_back(text));
+}
+
+bool SearchIndex::index_file(const std::string &path) {
+  const auto mtime = modification_time(path);
+  if (!mtime) {
+    return false;
+  }
+  {
+    std::shared_lock lock(mutex_);
+    auto it = source_ids_.find(path);
+    if (it != source_ids_.end() && sources_[it->second].mtime == *mtime) {
+      return true;
+    }
+  }
+
+  std::vector<Prepared> turns;
+  try {
+    if (SessionFile::is_session_file(path)) {
+      SessionFile file;
+      if (!file.open(path)) {
+        return false;
+      }
+      for (size_t i = 0; i < file.size(); ++i) {
+        turns.push_back(prepare(file.role(i), file.content(i)));
+      }
+    } else {
+      MappedFile file;
+      if (!file.open(path)) {
+        return false;
+      }
+      ConversationImporter().import(file.view(), [&turns](Message &&message) {
+        turns.push_back(prepare(message.role, message.content));
+      });
+    }
+  } catch (const std::exception &e) {
+    spdlog::debug("Not indexing {}: {}", path, e.what());
+    return false;
+  }
+
+  std::unique_lock lock(mutex_);
+  uint32_t source = source_id(path, true);
+  remove_source_turns(source);
+  for (auto &turn : turns) {
+    insert(source, std::move(turn), {});
+  }
+  sources_[source].mtime = *mtime;
+  return true;
+}
+
+size_t SearchIndex::refresh() {
+  std::vector<std::string> changed;
+  {
+    std::shared_lock lock(mutex_);
+    for (const auto &source : sources_) {
+      if (source.file) {
+        auto mtime = modification_time(source.name);
+        if (mtime && *mtime != source.mtime) {
+          changed.push_back(source.name);
+        }
+      }
+    }
+  }
+  size_t updated = 0;
+  for (const auto &path : changed) {
+    updated += index_file(path) ? 1 : 0;
+  }
+  return updated;
+}
+
+std::vector<SearchIndex::Hit> SearchIndex::search(std::string_view query,
+                                                  size_t limit) const {
+  // Split into bare terms and quoted phrases.
+  std::vector<std::string> terms;
+  std::vector<std::vector<std::string>> phrases;
+  auto add_term = [&terms](std::string_view term) {
+    if (std::find(terms.begin(), terms.end(), term) == terms.end()) {
+      terms.emplace_back(term);
+    }
+  };
+  bool quoted = false;
+  size_t start = 0;
+  for (size_t i = 0; i <= query.size(); ++i) {
+    if (i < query.size() && query[i] != '"') {
+      continue;
+    }
+    std::string_view part = query.substr(start, i - start);
+    if (quoted) {
+      std::vector<std::string> phrase;
+      RelevanceIndex::for_each_term(part, [&](std::string_view term) {
+        phrase.emplace_back(term);
+        add_term(term);
+      });
+      if (!phrase.empty()) {
+        phrases.push_back(std::move(phrase));
+      }
+    } else {
+      RelevanceIndex::for_each_term(part, add_term);
+    }
+    quoted = !quoted;
+    start = i + 1;
+  }
+
+  std::shared_lock lock(mutex_);
+  std::vector<Hit> hits;
+  if (live_docs_ == 0 || terms.empty()) {
+    return hits;
+  }
+
+  const double n = static_cast<double>(live_docs_);
+  const double average_length =
+      std::max(1.0, static_cast<double>(total_length_) / n);
+  auto live = [this](uint64_t doc) {
+    return doc < docs_.size() && !docs_[doc].deleted;
+  };
+
+  std::vector<double> scores(docs_.size(), 0.0);
+  std::vector<uint32_t> matched;
+  std::vector<std::pair<uint32_t, uint32_t>> entries;
+  for (const auto &term : terms) {
+    auto it = postings_.find(term);
+    if (it == postings_.end()) {
+      continue;
+    }
+    entries.clear();
+    for_each_posting(it->second.bytes,
+                     [&](uint64_t doc, uint32_t frequency,
+                         const std::vector<uint32_t> &) {
+                       if (live(doc)) {
+                         entries.emplace_back(static_cast<uint32_t>(doc),
+                                              frequency);
+                       }
+                     });
+    const double df = static_cast<double>(entries.size());
+    const double idf = std::log(1.0 + (n - df + 0.5) / (df + 0.5));
+    for (auto [doc, frequency] : entries) {
+      double tf = frequency;
+      double norm = K1 * (1.0 - B + B * docs_[doc].length / average_length);
+      if (scores[doc] == 0.0) {
+        matched.push_back(doc);
+      }
+      scores[doc] += idf * tf * (K1 + 1.0) / (tf + norm);
+    }
+  }
+
+  // Every phrase must occur. Postings are in doc order, so each further
+  // phrase term is merged against the docs still matching, keeping the
+  // positions at which the phrase read so far starts.
+  struct Candidates {
+    std::vector<uint32_t> docs;
+    std::vector<size_t> begin{0}; // into starts, one past each doc's last
+    std::vector<uint32_t> starts;
+  };
+  std::vector<bool> in_phrases(docs_.size(), true);
+  for (const auto &phrase : phrases) {
+    Candidates candidates;
+    for (size_t i = 0; i < phrase.size(); ++i) {
+      auto it = postings_.find(phrase[i]);
+      if (it == postings_.end()) {
+        candidates = Candidates();
+        break;
+      }
+      Candidates next;
+      size_t j = 0;
+      for_each_posting(
+          it->second.bytes, [&](uint64_t doc, uint32_t,
+                                const std::vector<uint32_t> &positions) {
+            if (!live(doc)) {
+              return;
+            }
+            if (i == 0) {
+              next.starts.insert(next.starts.end(), positions.begin(),
+                                 positions.end());
+            } else {
+              while (j < candidates.docs.size() && candidates.docs[j] < doc) {
+                ++j;
+              }
+              if (j == candidates.docs.size() || candidates.docs[j] != doc) {
+                return;
+              }
+              for (size_t k = candidates.begin[j]; k < candidates.begin[j + 1];
+                   ++k) {
+                uint32_t start = candidates.starts[k];
+                if (std::binary_search(positions.begin(), positions.end(),
+                                       static_cast<uint32_t>(start + i))) {
+                  next.starts.push_back(start);
+                }
+              }
+              if (next.starts.size() == next.begin.back()) {
+                return;
+              }
+            }
+            next.docs.push_back(static_cast<uint32_t>(doc));
+            next.begin.push_back(next.starts.size());
+          });
+      candidates = std::move(next);
+    }
+    std::vector<bool> found(docs_.size(), false);
+    for (uint32_t doc : candidates.docs) {
+      found[doc] = true;
+    }
+    for (uint32_t doc : matched) {
+      in_phrases[doc] = in_phrases[doc] && found[doc];
+    }
+  }
+  for (uint32_t doc : matched) {
+    if (!in_phrases[doc]) {
+      scores[doc] = 0.0;
+    }
+  }
+
+  matched.erase(std::remove_if(matched.begin(), matched.end(),
+                               [&](uint32_t doc) { return scores[doc] <= 0.0; }),
+                matched.end());
+  // Only the best few need ordering; the rest is sorted only if duplicate
+  // texts use up that prefix.
+  auto better = [&](uint32_t a, uint32_t b) {
+    return scores[a] != scores[b] ? scores[a] > scores[b] : a > b;
+  };
+  size_t sorted = std::min(matched.size(), std::max<size_t>(4 * limit, 64));
+  std::partial_sort(matched.begin(), matched.begin() + sorted, matched.end(),
+                    better);
+
+  std::unordered_set<uint64_t> seen;
+  // Hits in files, by file, whose snippets are read once the lock is
+  // released.
+  std::unordered_map<std::string, std::vector<size_t>> in_files;
+  for (size_t i = 0; i < matched.size() && hits.size() < limit; ++i) {
+    if (i == sorted) {
+      std::sort(matched.begin() + i, matched.end(), better);
+      sorted = matched.size();
+    }
+    const Doc &doc = docs_[matched[i]];
+    if (!seen.insert(doc.hash).second) {
+      continue;
+    }
+    const Source &source = sources_[doc.source];
+    if (source.file) {
+      in_files[source.name].push_back(hits.size());
+    }
+    hits.push_back(Hit{source.name, doc.turn, doc.role, scores[matched[i]],
+                       source.file ? std::string()
+                                   : make_snippet(doc.text, terms)});
+  }
+  lock.unlock();
+
+  for (const auto &[path, indexes] : in_files) {
+    std::unordered_set<size_t> turns;
+    for (size_t index : indexes) {
+      turns.insert(hits[index].turn);
+    }
+    auto contents = read_turns(path, turns);
+    for (size_t index : indexes) {
+      auto it = contents.find(hits[index].turn);
+      if (it != contents.end()) {
+        hits[index].snippet = make_snippet(it->second, terms);
+      }
+    }
+  }
+  return hits;
+}
+
+size_t SearchIndex::size() const {
+  std::shared_lock lock(mutex_);
+  return live_docs_;
+}
+
+size_t SearchIndex::source_count() const {
+  std::shared_lock lock(mutex_);
+  return sources_.size();
+}
+
+std::string SearchIndex::encode_snapshot() const {
+  std::string out;
+  put_varint(out, sources_.size());
+  for (const auto &source : sources_) {
+    put_string(out, source.name);
+    put_varint(out, static_cast<uint64_t>(source.mtime));
+    out.push_back(source.file ? 1 : 0);
+    put_varint(out, source.turns);
+  }
+  put_varint(out, docs_.size());
+  for (const auto &doc : docs_) {
+    put_varint(out, doc.source);
+    put_varint(out, doc.turn);
+    out.push_back(static_cast<char>(doc.role));
+    out.push_back(doc.deleted ? 1 : 0);
+    put_varint(out, doc.length);
+    put_varint(out, doc.distinct);
+    put_varint(out, doc.hash);
+    // Turns of files are read back from the file.
+    if (!sources_[doc.source].file) {
+      put_string(out, doc.text);
+    }
+  }
+  put_varint(out, postings_.size());
+  for (const auto &[term, postings] : postings_) {
+    put_string(out, term);
+    put_varint(out, postings.last_doc);
+    put_varint(out, postings.count);
+    put_string(out, postings.bytes);
+  }
+  return out;
+}
+
+bool SearchIndex::decode_snapshot(std::string_view bytes, uint16_t version) {
+  Reader reader(bytes);
+  uint64_t count = 0;
+  if (!reader.varint(count)) {
+    return false;
+  }
+  for (uint64_t i = 0; i < count; ++i) {
+    Source source;
+    std::string_view name;
+    uint64_t mtime = 0;
+    uint8_t file = 0;
+    if (!reader.string(name) || !reader.varint(mtime) || !reader.byte(file) ||
+        !reader.varint_as(source.turns)) {
+      return false;
+    }
+    source.name = std::string(name);
+    source.mtime = static_cast<int64_t>(mtime);
+    source.file = file != 0;
+    source_ids_.emplace(source.name, static_cast<uint32_t>(sources_.size()));
+    sources_.push_back(std::move(source));
+  }
+
+  if (!reader.varint(count)) {
+    return false;
+  }
+  for (uint64_t i = 0; i < count; ++i) {
+    Doc doc{};
+    uint8_t role = 0;
+    uint8_t deleted = 0;
+    std::string_view text;
+    if (!reader.varint_as(doc.source) || !reader.varint_as(doc.turn) ||
+        !reader.byte(role) || !reader.byte(deleted) ||
+        !reader.varint_as(doc.length) || !reader.varint_as(doc.distinct) ||
+        doc.source >= sources_.size() ||
+        role > static_cast<uint8_t>(MessageRole::Assistant)) {
+      return false;
+    }
+    const bool file = sources_[doc.source].file;
+    // Version 1 kept the text of every turn and no hash.
+    if (version < 2) {
+      if (!reader.string(text)) {
+        return false;
+      }
+      doc.hash = ContentHash::of(text).low;
+    } else if (!reader.varint(doc.hash) || (!file && !reader.string(text))) {
+      return false;
+    }
+    doc.role = static_cast<MessageRole>(role);
+    doc.deleted = deleted != 0;
+    if (!file && !doc.deleted) {
+      doc.text = text;
+    }
+    if (!doc.deleted) {
+      ++live_docs_;
+      total_length_ += doc.length;
+      live_postings_ += doc.distinct;
+    }
+    docs_.push_back(doc);
+  }
+
+  if (!reader.varint(count)) {
+    return false;
+  }
+  size_t entries = 0;
+  for (uint64_t i = 0; i < count; ++i) {
+    std::string_view term;
+    std::string_view encoded;
+    Postings postings;
+    if (!reader.string(term) || !reader.varint_as(postings.last_doc) ||
+        !reader.varint_as(postings.count) || !reader.string(encoded)) {
+      return false;
+    }
+    postings.bytes = std::string(encoded);
+    entries += postings.count;
+    postings_.emplace(std::string(term), std::move(postings));
+  }
+  stale_postings_ = entries > live_postings_ ? entries - live_postings_ : 0;
+  return reader.empty();
+}
+
+bool SearchIndex::load(const std::string &path) {
+  std::unique_lock lock(mutex_);
+  return replay(path);
+}
+
+bool SearchIndex::replay(const std::string &path) {
+  clear();
+
+  MappedFile file;
+  if (!file.open(path)) {
+    return false;
+  }
+  const std::string header = file_header();
+  std::string_view bytes = file.view();
+  if (bytes.size() < header.size() ||
+      std::memcmp(bytes.data(), MAGIC, sizeof(MAGIC)) != 0) {
+    spdlog::warn("Not a search index: {}", path);
+    return false;
+  }
+  auto version = static_cast<uint16_t>(static_cast<unsigned char>(bytes[4]) |
+                                       static_cast<unsigned char>(bytes[5]) << 8);
+  if (version > VERSION) {
+    spdlog::warn("Search index {} has unsupported version {}", path, version);
+    return false;
+  }
+
+  Reader reader(bytes.substr(header.size()));
+  bool first = true;
+  uint8_t tag = 0;
+  std::string_view record;
+  while (reader.byte(tag) && reader.string(record)) {
+    if (tag == SNAPSHOT_RECORD && first) {
+      if (!decode_snapshot(record, version)) {
+        spdlog::warn("Corrupt search index: {}", path);
+        clear();
+        return false;
+      }
+    } else if (tag == TURN_RECORD) {
+      Reader turn(record);
+      std::string_view source;
+      uint8_t role = 0;
+      std::string_view text;
+      if (!turn.string(source) || !turn.byte(role) || !turn.string(text) ||
+          role > static_cast<uint8_t>(MessageRole::Assistant)) {
+        break;
+      }
+      insert(source_id(std::string(source), false),
+             prepare(static_cast<MessageRole>(role), text), text);
+      ++records_;
+    } else if (tag == FILE_RECORD) {
+      // Re-indexed by refresh(), which reads its current contents.
+      uint32_t source = source_id(std::string(record), true);
+      remove_source_turns(source);
+      sources_[source].mtime = 0;
+      ++records_;
+    } else {
+      break;
+    }
+    first = false;
+  }
+  // The texts of live turns point into the mapping.
+  file_ = std::move(file);
+  return true;
+}
+
+bool SearchIndex::save(const std::string &path) const {
+  std::string bytes = file_header();
+  {
+    std::shared_lock lock(mutex_);
+    bytes.push_back(SNAPSHOT_RECORD);
+    put_string(bytes, encode_snapshot());
+  }
+
+  // Waits for appends in progress and keeps new ones out until the
+  // snapshot is in place.
+  int fd = open_locked(path, false, true);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = write_file_durably(path, bytes);
+  close_index(fd);
+  return ok;
+}
+
+bool SearchIndex::checkpoint(const std::string &path, size_t max_records) {
+  int fd = open_locked(path, false, true);
+  if (fd < 0) {
+    return false;
+  }
+  bool valid = true;
+  {
+    std::unique_lock lock(mutex_);
+    // A file just created is empty, not corrupt.
+    if (is_empty(fd)) {
+      clear();
+    } else {
+      valid = replay(path);
+    }
+  }
+  const bool changed = refresh() > 0;
+
+  bool ok = true;
+  if (!valid || changed || records() > max_records) {
+    std::string bytes = file_header();
+    {
+      std::shared_lock lock(mutex_);
+      bytes.push_back(SNAPSHOT_RECORD);
+      put_string(bytes, encode_snapshot());
+    }
+    ok = write_file_durably(path, bytes);
+    if (ok) {
+      std::unique_lock lock(mutex_);
+      records_ = 0;
+    }
+  }
+  close_index(fd);
+  return ok;
+}
+
+size_t SearchIndex::records() const {
+  std::shared_lock lock(mutex_);
+  return records_;
+}
+
+bool SearchIndex::append_turn(const std::string &path,
+                              const std::string &source, MessageRole role,
+                              std::string_view text) {
+  std::string payload;
+  put_string(payload, source);
+  payload.push_back(static_cast<char>(role));
+  put_string(payload, text);
+  return append_record(path, TURN_RECORD, payload);
+}
+
+bool SearchIndex::append_file(const std::string &path,
+                              const std::string &file) {
+  return append_record(path, FILE_RECORD, file);
+}
+
+} // namespace llm
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "models/message.hpp"
+#include "utils/mapped_file.hpp"
+
+namespace llm {
+
+// Full-text index over the turns of saved conversations and live sessions.
+//
+// Each term's postings are one byte string of varints: per document the
+// doc-id delta, the term frequency and the delta-coded term positions. New
+// turns get increasing ids, so indexing one only appends to the postings of
+// its terms. Queries decode the postings of their terms, rank with BM25 and
+// check positions for "quoted phrases".
+//
+// Turns of a file that is re-indexed are tombstoned and skipped at query
+// time; their postings are rewritten without them once stale postings
+// outnumber the live ones, as in RelevanceIndex.
+//
+// Turns of files are kept as (file, turn) and the snippets of hits are read
+// back from the file. Turns of live sessions have no other copy, so their
+// text stays in the index file and is read through its mapping; only turns
+// added since the file was loaded are held in memory.
+//
+// The index file is shared by every REPL process. Records are appended
+// with a single O_APPEND write under a shared flock; a snapshot replaces
+// the file by rename under an exclusive one, after reloading it so that
+// records other processes appended are kept, as in HistoryLog.
+//
+// Thread-safe: queries share a lock, updates take it exclusively, and
+// documents are tokenized before the lock is taken.
+class SearchIndex {
+public:
+  static constexpr double K1 = 1.2;
+  static constexpr double B = 0.75;
+  static constexpr char MAGIC[4] = {'L', 'L', 'M', 'X'};
+  static constexpr uint16_t VERSION = 2;
+  static constexpr size_t SNIPPET_BYTES = 160;
+
+  struct Hit {
+    std::string source; // file path, or the name of a live session
+    size_t turn = 0;    // message index within the source
+    MessageRole role = MessageRole::User;
+    double score = 0.0;
+    std::string snippet;
+
+    // "<source> #<turn> (<role>)"
+    std::string location() const {
+      return source + " #" + std::to_string(turn) + " (" +
+             std::string(Message::role_name(role)) + ")";
+    }
+  };
+
+  // Replaces the contents with the index file at `path`: a snapshot
+  // followed by records appended since. Files named by a record are left
+  // for refresh() to re-index. Returns false, leaving the index empty, if
+  // the file is missing or corrupt; a torn final record is ignored.
+  bool load(const std::string &path);
+
+  // Writes a snapshot of this index alone to `path`, replacing the file
+  // atomically.
+  bool save(const std::string &path) const;
+
+  // Reloads the index file at `path`, re-indexes files that changed and,
+  // if any did, if the file was corrupt or if more than `max_records`
+  // records follow its snapshot, replaces it with a snapshot. The file is
+  // locked exclusively throughout. Returns false on I/O errors.
+  bool checkpoint(const std::string &path, size_t max_records);
+
+  // Records after the snapshot, as of the last load or checkpoint.
+  size_t records() const;
+
+  // Appends a turn to the index file at `path` without rewriting it.
+  static bool append_turn(const std::string &path, const std::string &source,
+                          MessageRole role, std::string_view text);
+
+  // Appends a record that `file` was re-indexed, replacing its turns, to
+  // the index file at `path`.
+  static bool append_file(const std::string &path, const std::string &file);
+
+  // Indexes the conversation in file `path` (a .session file or anything
+  // ConversationImporter reads), replacing its previous turns if it was
+  // modified since. Returns false if it cannot be read.
+  bool index_file(const std::string &path);
+
+  // Appends a turn to `source`, creating it as a live session if new.
+  void add_turn(const std::string &source, MessageRole role,
+                std::string_view text);
+
+  // Re-indexes indexed files that changed on disk; returns how many did.
+  size_t refresh();
+
+  // Turns matching `query`, best first, with identical texts reported once.
+  // Bare words are ranked with BM25 and any may match; every "quoted
+  // phrase" must appear.
+  std::vector<Hit> search(std::string_view query, size_t limit = 10) const;
+
+  size_t size() const;
+  size_t source_count() const;
+
+private:
+  struct Source {
+    std::string name;
+    int64_t mtime = 0; // of the file when indexed; 0 for live sessions
+    bool file = false;
+    size_t turns = 0;
+  };
+
+  struct Doc {
+    uint32_t source;
+    uint32_t turn;
+    MessageRole role;
+    bool deleted;
+    uint32_t length;       // terms in the turn
+    uint32_t distinct;     // postings it owns
+    uint64_t hash;         // of the text, to report identical turns once
+    std::string_view text; // live sessions only, into file_ or texts_
+  };
+
+  struct Postings {
+    std::string bytes;
+    uint32_t last_doc = 0;
+    uint32_t count = 0; // entries, including those of deleted docs
+  };
+
+  // A turn tokenized outside the lock.
+  struct Prepared {
+    MessageRole role;
+    uint64_t hash = 0;
+    uint32_t length = 0;
+    std::vector<std::pair<std::string, std::vector<uint32_t>>> terms;
+  };
+
+  mutable std::shared_mutex mutex_;
+  std::vector<Source> sources_;
+  std::unordered_map<std::string, uint32_t> source_ids_;
+  std::vector<Doc> docs_;
+  std::unordered_map<std::string, Postings> postings_;
+  size_t live_docs_ = 0;
+  size_t total_length_ = 0; // of live docs
+  size_t live_postings_ = 0;
+  size_t stale_postings_ = 0;
+  // The loaded index file, which the texts of its live turns point into.
+  MappedFile file_;
+  // Texts of live turns added since.
+  std::deque<std::string> texts_;
+  size_t records_ = 0;
+
+  static Prepared prepare(MessageRole role, std::string_view text);
+  uint32_t source_id(const std::string &name, bool file);
+  void insert(uint32_t source, Prepared &&doc, std::string_view text);
+  void remove_source_turns(uint32_t source);
+  void compact();
+  void clear();
+  // load() with mutex_ held.
+  bool replay(const std::string &path);
+  std::string encode_snapshot() const;
+  bool decode_snapshot(std::string_view bytes, uint16_t version);
+};
+
+} // namespace llm
@@ -0,0 +1,91 @@
+#include "search/search_indexer.hpp"
+
+#include "utils/logger.hpp"
+
+namespace llm {
+
+SearchIndexer::SearchIndexer(std::string path)
+    : path_(std::move(path)), worker_([this] { run(); }) {
+  post([this] {
+    checkpoint(COMPACT_AFTER_RECORDS);
+    spdlog::debug("Search index ready: {} turns from {} sources",
+                  index_.size(), index_.source_count());
+    loading_ = false;
+  });
+}
+
+SearchIndexer::~SearchIndexer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  worker_.join();
+}
+
+void SearchIndexer::index_file(std::string path) {
+  post([this, path = std::move(path)] {
+    if (index_.index_file(path)) {
+      appended(SearchIndex::append_file(path_, path));
+    }
+  });
+}
+
+void SearchIndexer::add_turn(std::string source, MessageRole role,
+                             std::string text) {
+  post([this, source = std::move(source), role, text = std::move(text)] {
+    index_.add_turn(source, role, text);
+    appended(SearchIndex::append_turn(path_, source, role, text));
+  });
+}
+
+void SearchIndexer::wait_idle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] { return tasks_.empty() && !busy_; });
+}
+
+void SearchIndexer::post(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  wake_.notify_one();
+}
+
+void SearchIndexer::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+    if (tasks_.empty()) {
+      break;
+    }
+    auto task = std::move(tasks_.front());
+    tasks_.pop_front();
+    busy_ = true;
+    lock.unlock();
+    task();
+    lock.lock();
+    busy_ = false;
+    if (tasks_.empty()) {
+      idle_.notify_all();
+    }
+  }
+}
+
+void SearchIndexer::appended(bool ok) {
+  if (!ok) {
+    spdlog::warn("Failed to append to search index: {}", path_);
+  }
+  if (++records_ > COMPACT_AFTER_RECORDS) {
+    checkpoint(0);
+  }
+}
+
+void SearchIndexer::checkpoint(size_t max_records) {
+  if (!index_.checkpoint(path_, max_records)) {
+    spdlog::warn("Failed to write search index: {}", path_);
+  }
+  records_ = index_.records();
+}
+
+} // namespace llm
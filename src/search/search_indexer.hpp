@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "search/search_index.hpp"
+
+namespace llm {
+
+// Keeps a SearchIndex up to date on a worker thread so that indexing never
+// delays the REPL. On start the worker loads the index file and re-indexes
+// saved conversations that changed since. New turns and re-indexed files
+// are appended to the file as single records; once COMPACT_AFTER_RECORDS
+// records follow its snapshot, it is rewritten as a new one. Queries run on
+// the caller's thread against whatever has been indexed so far.
+class SearchIndexer {
+public:
+  static constexpr size_t COMPACT_AFTER_RECORDS = 1024;
+
+  explicit SearchIndexer(std::string path);
+  // Finishes queued work and stops the worker.
+  ~SearchIndexer();
+
+  SearchIndexer(const SearchIndexer &) = delete;
+  SearchIndexer &operator=(const SearchIndexer &) = delete;
+
+  void index_file(std::string path);
+  void add_turn(std::string source, MessageRole role, std::string text);
+
+  std::vector<SearchIndex::Hit> search(std::string_view query,
+                                       size_t limit = 10) const {
+    return index_.search(query, limit);
+  }
+
+  // True until the index file has been loaded and refreshed.
+  bool loading() const { return loading_; }
+
+  // Blocks until every queued update has been applied.
+  void wait_idle();
+
+  const SearchIndex &index() const { return index_; }
+
+private:
+  std::string path_;
+  SearchIndex index_;
+  std::atomic<bool> loading_{true};
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  std::deque<std::function<void()>> tasks_;
+  bool busy_ = false;
+  bool stopping_ = false;
+  // Worker thread only.
+  size_t records_ = 0;
+  std::thread worker_;
+
+  void post(std::function<void()> task);
+  void run();
+  // Counts a record appended to the file, or one that failed to be.
+  void appended(bool ok);
+  void checkpoint(size_t max_records);
+};
+
+} // namespace llm
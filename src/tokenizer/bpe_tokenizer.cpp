@@ -0,0 +1,350 @@
+#include "tokenizer/bpe_tokenizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <functional>
+#include <future>
+#include <limits>
+#include <thread>
+
+#include "tokenizer/pre_tokenizer.hpp"
+#include "utils/logger.hpp"
+#include "utils/mapped_file.hpp"
+
+namespace llm {
+
+namespace {
+
+constexpr std::array<int8_t, 256> make_base64_table() {
+  std::array<int8_t, 256> table{};
+  for (auto &v : table)
+    v = -1;
+  constexpr std::string_view alphabet =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  for (size_t i = 0; i < alphabet.size(); ++i)
+    table[static_cast<unsigned char>(alphabet[i])] = static_cast<int8_t>(i);
+  return table;
+}
+
+constexpr auto BASE64_TABLE = make_base64_table();
+
+bool base64_decode(std::string_view in, std::string &out) {
+  uint32_t buffer = 0;
+  int bits = 0;
+  for (char ch : in) {
+    if (ch == '=')
+      break;
+    int8_t v = BASE64_TABLE[static_cast<unsigned char>(ch)];
+    if (v < 0)
+      return false;
+    buffer = (buffer << 6) | static_cast<uint32_t>(v);
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      out.push_back(static_cast<char>((buffer >> bits) & 0xFF));
+    }
+  }
+  return true;
+}
+
+struct MergeCandidate {
+  TokenId rank;
+  uint32_t start;
+  uint32_t end;
+
+  bool operator>(const MergeCandidate &other) const {
+    return rank != other.rank ? rank > other.rank : start > other.start;
+  }
+};
+
+} // namespace
+
+std::shared_ptr<BpeTokenizer> BpeTokenizer::load(const std::string &path,
+                                                 const std::string &name) {
+  MappedFile file(path);
+  if (!file.is_open()) {
+    spdlog::debug("Tokenizer vocabulary not found: {}", path);
+    return nullptr;
+  }
+
+  auto tokenizer = from_ranks(file.view(), name);
+  if (tokenizer) {
+    spdlog::debug("Loaded tokenizer '{}' ({} tokens) from {}", name,
+                  tokenizer->vocab_size(), path);
+  }
+  return tokenizer;
+}
+
+std::shared_ptr<BpeTokenizer>
+BpeTokenizer::from_ranks(std::string_view data, const std::string &name) {
+  std::shared_ptr<BpeTokenizer> tokenizer(new BpeTokenizer(name));
+
+  struct Entry {
+    size_t offset;
+    size_t length;
+    TokenId rank;
+  };
+  std::vector<Entry> entries;
+  entries.reserve(data.size() / 12);
+  tokenizer->token_bytes_.reserve(data.size() * 3 / 4);
+
+  size_t pos = 0;
+  while (pos < data.size()) {
+    size_t eol = data.find('\n', pos);
+    if (eol == std::string_view::npos)
+      eol = data.size();
+    std::string_view line = data.substr(pos, eol - pos);
+    pos = eol + 1;
+
+    if (!line.empty() && line.back() == '\r')
+      line.remove_suffix(1);
+    size_t space = line.find(' ');
+    if (line.empty() || space == std::string_view::npos)
+      continue;
+
+    TokenId rank = 0;
+    std::string_view rank_str = line.substr(space + 1);
+    auto [ptr, ec] = std::from_chars(rank_str.data(),
+                                     rank_str.data() + rank_str.size(), rank);
+    if (ec != std::errc()) {
+      continue;
+    }
+
+    size_t offset = tokenizer->token_bytes_.size();
+    if (!base64_decode(line.substr(0, space), tokenizer->token_bytes_)) {
+      tokenizer->token_bytes_.resize(offset);
+      continue;
+    }
+
+    entries.push_back({offset, tokenizer->token_bytes_.size() - offset, rank});
+  }
+
+  // Real vocabularies are (nearly) dense in rank, so the decoder is a flat
+  // table. Ranks far beyond the entry count come from a corrupt file and
+  // would otherwise size that table arbitrarily large.
+  const TokenId rank_limit =
+      static_cast<TokenId>(std::min<size_t>(entries.size() * 2 + 1024,
+                                            std::numeric_limits<TokenId>::max()));
+  size_t rejected = 0;
+  std::erase_if(entries, [&](const Entry &entry) {
+    bool out_of_range = entry.rank >= rank_limit;
+    rejected += out_of_range;
+    return out_of_range;
+  });
+  if (rejected > 0) {
+    spdlog::warn("Tokenizer vocabulary '{}': ignored {} entries with rank >= {}",
+                 name, rejected, rank_limit);
+  }
+
+  if (entries.empty()) {
+    spdlog::error("Tokenizer vocabulary '{}' contains no valid entries", name);
+    return nullptr;
+  }
+
+  TokenId max_rank = 0;
+  for (const auto &entry : entries) {
+    max_rank = std::max(max_rank, entry.rank);
+  }
+
+  // Views are created only after token_bytes_ has stopped growing.
+  tokenizer->ranks_.reserve(entries.size());
+  tokenizer->decoder_.resize(static_cast<size_t>(max_rank) + 1);
+  for (const auto &entry : entries) {
+    std::string_view bytes(tokenizer->token_bytes_.data() + entry.offset,
+                           entry.length);
+    tokenizer->ranks_.emplace(bytes, entry.rank);
+    tokenizer->decoder_[entry.rank] = bytes;
+  }
+
+  return tokenizer;
+}
+
+size_t BpeTokenizer::count_tokens(std::string_view text) const {
+  if (text.size() < PARALLEL_THRESHOLD) {
+    std::vector<TokenId> scratch;
+    size_t count = 0;
+    PreTokenizer::split(text, [&](std::string_view piece) {
+      scratch.clear();
+      count += encode_piece(piece, scratch);
+      count += scratch.size();
+    });
+    return count;
+  }
+  size_t unmapped = 0;
+  return encode(text, unmapped).size() + unmapped;
+}
+
+std::vector<TokenId> BpeTokenizer::encode(std::string_view text) const {
+  size_t unmapped = 0;
+  auto tokens = encode(text, unmapped);
+  if (unmapped > 0) {
+    spdlog::warn("Tokenizer vocabulary '{}' has no token for {} bytes of the "
+                 "input; they were left out",
+                 name_, unmapped);
+  }
+  return tokens;
+}
+
+std::vector<TokenId> BpeTokenizer::encode(std::string_view text,
+                                          size_t &unmapped) const {
+  std::vector<TokenId> tokens;
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+  if (text.size() < PARALLEL_THRESHOLD || threads == 1) {
+    tokens.reserve(text.size() / 3);
+    unmapped += encode_serial(text, tokens);
+    return tokens;
+  }
+
+  size_t parts = std::min<size_t>(threads, text.size() / (PARALLEL_THRESHOLD / 4));
+  auto chunks = split_for_threads(text, parts);
+
+  std::vector<std::future<std::pair<std::vector<TokenId>, size_t>>> futures;
+  futures.reserve(chunks.size());
+  for (size_t i = 1; i < chunks.size(); ++i) {
+    futures.push_back(std::async(std::launch::async, [this, chunk = chunks[i]]() {
+      std::vector<TokenId> part;
+      part.reserve(chunk.size() / 3);
+      size_t missing = encode_serial(chunk, part);
+      return std::make_pair(std::move(part), missing);
+    }));
+  }
+
+  tokens.reserve(text.size() / 3);
+  unmapped += encode_serial(chunks[0], tokens);
+  for (auto &future : futures) {
+    auto [part, missing] = future.get();
+    tokens.insert(tokens.end(), part.begin(), part.end());
+    unmapped += missing;
+  }
+  return tokens;
+}
+
+std::string BpeTokenizer::decode(const std::vector<TokenId> &tokens) const {
+  std::string text;
+  for (TokenId token : tokens) {
+    if (token < decoder_.size()) {
+      text.append(decoder_[token]);
+    }
+  }
+  return text;
+}
+
+size_t BpeTokenizer::encode_serial(std::string_view text,
+                                   std::vector<TokenId> &out) const {
+  size_t unmapped = 0;
+  PreTokenizer::split(text, [&](std::string_view piece) {
+    unmapped += encode_piece(piece, out);
+  });
+  return unmapped;
+}
+
+size_t BpeTokenizer::encode_piece(std::string_view piece,
+                                  std::vector<TokenId> &out) const {
+  // Most pieces are whole vocabulary entries (common words with their
+  // leading space), so try the single lookup before merging.
+  if (auto it = ranks_.find(piece); it != ranks_.end()) {
+    out.push_back(it->second);
+    return 0;
+  }
+
+  auto rank_of = [this](std::string_view bytes) -> const TokenId * {
+    auto it = ranks_.find(bytes);
+    return it != ranks_.end() ? &it->second : nullptr;
+  };
+
+  // Each live part is the span [i, next[i]). Candidate merges sit in a
+  // min-heap ordered by (rank, position); entries made stale by an earlier
+  // merge are detected on pop and skipped, so every byte is merged at most
+  // once and no pass rescans the whole piece.
+  const auto n = static_cast<uint32_t>(piece.size());
+  thread_local std::vector<uint32_t> next;
+  thread_local std::vector<uint32_t> prev;
+  thread_local std::vector<char> dead;
+  thread_local std::vector<MergeCandidate> heap;
+  next.resize(n);
+  prev.resize(n);
+  dead.assign(n, 0);
+  heap.clear();
+  for (uint32_t i = 0; i < n; ++i) {
+    next[i] = i + 1;
+    prev[i] = i == 0 ? n : i - 1;
+  }
+
+  auto push_pair = [&](uint32_t start) {
+    if (start >= n || next[start] >= n)
+      return;
+    uint32_t end = next[next[start]];
+    if (const TokenId *rank = rank_of(piece.substr(start, end - start))) {
+      heap.push_back({*rank, start, end});
+      std::push_heap(heap.begin(), heap.end(), std::greater<>{});
+    }
+  };
+
+  for (uint32_t i = 0; i + 1 < n; ++i)
+    push_pair(i);
+
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), std::greater<>{});
+    MergeCandidate candidate = heap.back();
+    heap.pop_back();
+
+    uint32_t s = candidate.start;
+    if (dead[s] || next[s] >= n || next[next[s]] != candidate.end)
+      continue;
+
+    uint32_t middle = next[s];
+    dead[middle] = 1;
+    next[s] = next[middle];
+    if (next[s] < n)
+      prev[next[s]] = s;
+
+    if (prev[s] < n)
+      push_pair(prev[s]);
+    push_pair(s);
+  }
+
+  // Merged parts are always in the table, so only single bytes can be
+  // missing. Vocabularies normally cover all 256; a byte that is not has no
+  // token id at all, and is reported rather than given a made-up one.
+  size_t unmapped = 0;
+  for (uint32_t i = 0; i < n; i = next[i]) {
+    std::string_view part = piece.substr(i, next[i] - i);
+    if (const TokenId *rank = rank_of(part)) {
+      out.push_back(*rank);
+    } else {
+      unmapped += part.size();
+    }
+  }
+  return unmapped;
+}
+
+std::vector<std::string_view>
+BpeTokenizer::split_for_threads(std::string_view text, size_t parts) const {
+  std::vector<std::string_view> chunks;
+  size_t target = text.size() / std::max<size_t>(parts, 1);
+  size_t start = 0;
+
+  for (size_t i = 1; i < parts; ++i) {
+    size_t pos = std::max(start + 1, i * target);
+    // A space between a word character and a letter always starts a new
+    // " word" piece, so cutting there yields the same tokens as a serial run.
+    while (pos + 1 < text.size() &&
+           !(text[pos] == ' ' &&
+             PreTokenizer::is_letter(static_cast<unsigned char>(text[pos + 1])) &&
+             !PreTokenizer::is_space(static_cast<unsigned char>(text[pos - 1])) &&
+             !PreTokenizer::is_punct(static_cast<unsigned char>(text[pos - 1])))) {
+      ++pos;
+    }
+    if (pos + 1 >= text.size())
+      break;
+    chunks.push_back(text.substr(start, pos - start));
+    start = pos;
+  }
+
+  chunks.push_back(text.substr(start));
+  return chunks;
+}
+
+} // namespace llm
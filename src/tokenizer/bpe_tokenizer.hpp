@@ -0,0 +1,60 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "tokenizer/tokenizer.hpp"
+
+namespace llm {
+
+// Byte-level BPE engine compatible with tiktoken rank files (one
+// "<base64 token> <rank>" pair per line, as shipped for cl100k and llama3).
+// The rank of a byte sequence doubles as its merge priority, so the file
+// carries both the vocabulary and the merge table.
+class BpeTokenizer : public Tokenizer {
+public:
+  // Inputs at least this large are split on piece boundaries and encoded on
+  // several threads.
+  static constexpr size_t PARALLEL_THRESHOLD = 1 << 20;
+
+  // Memory-maps `path` and builds the rank table from it. Returns nullptr if
+  // the file cannot be opened or contains no valid entries.
+  static std::shared_ptr<BpeTokenizer> load(const std::string &path,
+                                            const std::string &name);
+
+  // Builds the rank table from an in-memory rank file.
+  static std::shared_ptr<BpeTokenizer> from_ranks(std::string_view data,
+                                                  const std::string &name);
+
+  std::string name() const override { return name_; }
+
+  size_t count_tokens(std::string_view text) const override;
+
+  // Bytes the vocabulary has no single-byte token for are left out with a
+  // warning; count_tokens() counts each of them as one token.
+  std::vector<TokenId> encode(std::string_view text) const;
+  std::string decode(const std::vector<TokenId> &tokens) const;
+
+  size_t vocab_size() const { return ranks_.size(); }
+
+private:
+  explicit BpeTokenizer(std::string name) : name_(std::move(name)) {}
+
+  // Bytes with no token are left out; the overload of encode() adds their
+  // number to `unmapped` and the others return it.
+  std::vector<TokenId> encode(std::string_view text, size_t &unmapped) const;
+  size_t encode_serial(std::string_view text, std::vector<TokenId> &out) const;
+  size_t encode_piece(std::string_view piece, std::vector<TokenId> &out) const;
+  std::vector<std::string_view> split_for_threads(std::string_view text,
+                                                  size_t parts) const;
+
+  std::string name_;
+  std::string token_bytes_;
+  std::unordered_map<std::string_view, TokenId> ranks_;
+  std::vector<std::string_view> decoder_;
+};
+
+} // namespace llm
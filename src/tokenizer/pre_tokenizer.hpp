@@ -0,0 +1,179 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define LLM_PRETOKENIZER_SSE2 1
+#endif
+
+namespace llm {
+
+// Splits text into the pieces BPE merges operate on. This is a hand-written
+// equivalent of the cl100k/llama3 split regex:
+//
+//   's|'t|'re|'ve|'m|'ll|'d | [^\r\n\p{L}\p{N}]?\p{L}+ | \p{N}{1,3} |
+//    ?[^\s\p{L}\p{N}]+[\r\n]* | \s*[\r\n]+ | \s+(?!\S) | \s+
+//
+// Every byte >= 0x80 is treated as a letter, so multi-byte UTF-8 sequences
+// (accented Latin, CJK, ...) group the same way \p{L}+ does. Long letter and
+// space runs are scanned 16 bytes at a time with SSE2 where available.
+class PreTokenizer {
+public:
+  template <typename Fn> static void split(std::string_view text, Fn &&emit) {
+    const char *const begin = text.data();
+    const char *const end = begin + text.size();
+    const char *p = begin;
+
+    while (p < end) {
+      const unsigned char c = static_cast<unsigned char>(*p);
+
+      if (c == '\'' && p + 1 < end) {
+        size_t len = contraction_length(p + 1, end);
+        if (len > 0) {
+          emit(std::string_view(p, len + 1));
+          p += len + 1;
+          continue;
+        }
+      }
+
+      if (is_letter(c)) {
+        const char *q = scan_letters(p + 1, end);
+        emit(std::string_view(p, static_cast<size_t>(q - p)));
+        p = q;
+        continue;
+      }
+
+      if (is_digit(c)) {
+        const char *q = p + 1;
+        while (q < end && q - p < 3 && is_digit(static_cast<unsigned char>(*q)))
+          ++q;
+        emit(std::string_view(p, static_cast<size_t>(q - p)));
+        p = q;
+        continue;
+      }
+
+      const bool next_is_letter =
+          p + 1 < end && is_letter(static_cast<unsigned char>(p[1]));
+
+      if (!is_newline(c) && next_is_letter) {
+        const char *q = scan_letters(p + 2, end);
+        emit(std::string_view(p, static_cast<size_t>(q - p)));
+        p = q;
+        continue;
+      }
+
+      if (is_punct(c) ||
+          (c == ' ' && p + 1 < end &&
+           is_punct(static_cast<unsigned char>(p[1])))) {
+        const char *q = p + 1;
+        while (q < end && is_punct(static_cast<unsigned char>(*q)))
+          ++q;
+        while (q < end && is_newline(static_cast<unsigned char>(*q)))
+          ++q;
+        emit(std::string_view(p, static_cast<size_t>(q - p)));
+        p = q;
+        continue;
+      }
+
+      // Whitespace run.
+      const char *q = scan_spaces(p, end);
+      const char *last_newline = nullptr;
+      for (const char *r = p; r < q; ++r) {
+        if (is_newline(static_cast<unsigned char>(*r)))
+          last_newline = r;
+      }
+
+      if (last_newline) {
+        q = last_newline + 1;
+      } else if (q < end && q - p > 1) {
+        // Leave the final space to prefix the following word.
+        --q;
+      }
+
+      emit(std::string_view(p, static_cast<size_t>(q - p)));
+      p = q;
+    }
+  }
+
+  static bool is_letter(unsigned char c) {
+    return static_cast<unsigned char>((c | 0x20) - 'a') < 26 || c >= 0x80;
+  }
+  static bool is_digit(unsigned char c) {
+    return static_cast<unsigned char>(c - '0') < 10;
+  }
+  static bool is_newline(unsigned char c) { return c == '\n' || c == '\r'; }
+  static bool is_space(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' ||
+           c == '\f';
+  }
+  static bool is_punct(unsigned char c) {
+    return !is_letter(c) && !is_digit(c) && !is_space(c);
+  }
+
+  // Returns the first position at or after p that is not a letter.
+  static const char *scan_letters(const char *p, const char *end) {
+#ifdef LLM_PRETOKENIZER_SSE2
+    const __m128i lower_bit = _mm_set1_epi8(0x20);
+    const __m128i a = _mm_set1_epi8('a');
+    const __m128i span = _mm_set1_epi8(25);
+    while (end - p >= 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      __m128i offset = _mm_sub_epi8(_mm_or_si128(v, lower_bit), a);
+      __m128i ascii_alpha =
+          _mm_cmpeq_epi8(_mm_min_epu8(offset, span), offset);
+      unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(ascii_alpha)) |
+                      static_cast<unsigned>(_mm_movemask_epi8(v));
+      if (mask != 0xFFFF) {
+        return p + std::countr_one(mask);
+      }
+      p += 16;
+    }
+#endif
+    while (p < end && is_letter(static_cast<unsigned char>(*p)))
+      ++p;
+    return p;
+  }
+
+  // Returns the first position at or after p that is not whitespace.
+  static const char *scan_spaces(const char *p, const char *end) {
+#ifdef LLM_PRETOKENIZER_SSE2
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, space),
+                                 _mm_cmpeq_epi8(v, newline));
+      unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+      if (mask != 0xFFFF) {
+        p += std::countr_one(mask);
+        break;
+      }
+      p += 16;
+    }
+#endif
+    while (p < end && is_space(static_cast<unsigned char>(*p)))
+      ++p;
+    return p;
+  }
+
+private:
+  static size_t contraction_length(const char *p, const char *end) {
+    auto lower = [](char ch) { return static_cast<char>(ch | 0x20); };
+    char c0 = lower(*p);
+    if (c0 == 's' || c0 == 't' || c0 == 'm' || c0 == 'd')
+      return 1;
+    if (p + 1 < end) {
+      char c1 = lower(p[1]);
+      if ((c0 == 'r' && c1 == 'e') || (c0 == 'v' && c1 == 'e') ||
+          (c0 == 'l' && c1 == 'l'))
+        return 2;
+    }
+    return 0;
+  }
+};
+
+} // namespace llm
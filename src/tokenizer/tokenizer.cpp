@@ -0,0 +1,43 @@
+#include "tokenizer/tokenizer.hpp"
+
+#include "tokenizer/pre_tokenizer.hpp"
+
+namespace llm {
+
+size_t ApproximateTokenizer::count_tokens(std::string_view text) const {
+  size_t tokens = 0;
+  PreTokenizer::split(text, [&tokens](std::string_view piece) {
+    size_t ascii_letters = 0;
+    size_t code_points = 0;
+    size_t punct = 0;
+    for (char ch : piece) {
+      auto c = static_cast<unsigned char>(ch);
+      if (c >= 0x80) {
+        // Count UTF-8 lead bytes: CJK and other non-Latin scripts come out
+        // at roughly one token per character.
+        if ((c & 0xC0) != 0x80)
+          ++code_points;
+      } else if (PreTokenizer::is_letter(c)) {
+        ++ascii_letters;
+      } else if (PreTokenizer::is_punct(c)) {
+        ++punct;
+      }
+    }
+
+    size_t estimate = code_points + (punct + 1) / 2;
+    if (ascii_letters > 0) {
+      // Common English words are a single token; long identifiers split
+      // roughly every eight characters.
+      estimate += 1 + ascii_letters / 8;
+    }
+    tokens += estimate > 0 ? estimate : 1;
+  });
+  return tokens;
+}
+
+std::shared_ptr<const Tokenizer> ApproximateTokenizer::shared() {
+  static const auto instance = std::make_shared<const ApproximateTokenizer>();
+  return instance;
+}
+
+} // namespace llm
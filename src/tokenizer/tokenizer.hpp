@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace llm {
+
+using TokenId = uint32_t;
+
+class Tokenizer {
+public:
+  virtual ~Tokenizer() = default;
+
+  // Stable identifier of the vocabulary, e.g. "llama3". Token counts computed
+  // with one tokenizer are only comparable with counts from the same name.
+  virtual std::string name() const = 0;
+
+  virtual size_t count_tokens(std::string_view text) const = 0;
+};
+
+// Fallback used when no vocabulary file is available for a model. Walks the
+// same pre-tokenizer as the BPE engine and estimates tokens per piece, which
+// tracks code, JSON and CJK text far better than a flat bytes/4 ratio.
+class ApproximateTokenizer : public Tokenizer {
+public:
+  std::string name() const override { return "approximate"; }
+
+  size_t count_tokens(std::string_view text) const override;
+
+  static std::shared_ptr<const Tokenizer> shared();
+};
+
+} // namespace llm
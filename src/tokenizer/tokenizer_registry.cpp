@@ -0,0 +1,78 @@
+#include "tokenizer/tokenizer_registry.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+
+#include "tokenizer/bpe_tokenizer.hpp"
+#include "utils/logger.hpp"
+
+namespace llm {
+
+TokenizerRegistry::TokenizerRegistry(std::string vocab_dir)
+    : vocab_dir_(std::move(vocab_dir)) {}
+
+std::shared_ptr<const Tokenizer>
+TokenizerRegistry::for_model(const ModelInfo &model) {
+  return for_family(family_for(model));
+}
+
+std::shared_ptr<const Tokenizer>
+TokenizerRegistry::for_family(const std::string &family) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = cache_.find(family);
+  if (it != cache_.end()) {
+    return it->second;
+  }
+
+  std::shared_ptr<const Tokenizer> tokenizer;
+  if (!vocab_dir_.empty()) {
+    auto path = std::filesystem::path(vocab_dir_) / (family + ".tiktoken");
+    tokenizer = BpeTokenizer::load(path.string(), family);
+  }
+
+  if (!tokenizer) {
+    spdlog::debug("No vocabulary for tokenizer '{}', using approximation",
+                  family);
+    tokenizer = ApproximateTokenizer::shared();
+  }
+
+  cache_[family] = tokenizer;
+  return tokenizer;
+}
+
+std::string TokenizerRegistry::family_for(const ModelInfo &model) {
+  if (!model.tokenizer.empty()) {
+    return model.tokenizer;
+  }
+
+  std::string id = model.id;
+  std::transform(id.begin(), id.end(), id.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+
+  if (id.find("llama-3") != std::string::npos ||
+      id.find("llama3") != std::string::npos) {
+    return "llama3";
+  }
+  if (id.find("mixtral") != std::string::npos ||
+      id.find("mistral") != std::string::npos) {
+    return "mistral";
+  }
+  if (id.find("gemma") != std::string::npos) {
+    return "gemma";
+  }
+  if (id.find("gpt-4") != std::string::npos ||
+      id.find("gpt-3.5") != std::string::npos) {
+    return "cl100k";
+  }
+  return "default";
+}
+
+void TokenizerRegistry::set_vocab_dir(const std::string &vocab_dir) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  vocab_dir_ = vocab_dir;
+  cache_.clear();
+}
+
+} // namespace llm
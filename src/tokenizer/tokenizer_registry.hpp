@@ -0,0 +1,36 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "llm/llm_service.hpp"
+#include "tokenizer/tokenizer.hpp"
+
+namespace llm {
+
+// Resolves the tokenizer for a model. Vocabularies are looked up as
+// "<vocab_dir>/<family>.tiktoken", loaded once and shared by every
+// conversation; models without a vocabulary file fall back to
+// ApproximateTokenizer.
+class TokenizerRegistry {
+public:
+  explicit TokenizerRegistry(std::string vocab_dir = "");
+
+  std::shared_ptr<const Tokenizer> for_model(const ModelInfo &model);
+  std::shared_ptr<const Tokenizer> for_family(const std::string &family);
+
+  // Uses ModelInfo::tokenizer when set, otherwise infers the family from the
+  // model id.
+  static std::string family_for(const ModelInfo &model);
+
+  void set_vocab_dir(const std::string &vocab_dir);
+
+private:
+  std::string vocab_dir_;
+  std::mutex mutex_;
+  std::map<std::string, std::shared_ptr<const Tokenizer>> cache_;
+};
+
+} // namespace llm
@@ -0,0 +1,134 @@
+#include "utils/cancellation.hpp"
+
+#include <cerrno>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace llm {
+
+namespace {
+
+#ifndef _WIN32
+// Both ends non-blocking: cancel() must never block in a signal handler,
+// and reset() drains without waiting.
+bool open_pipe(int fds[2]) {
+  if (::pipe(fds) != 0) {
+    fds[0] = fds[1] = -1;
+    return false;
+  }
+  for (int i = 0; i < 2; ++i) {
+    ::fcntl(fds[i], F_SETFL, ::fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+    ::fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+  }
+  return true;
+}
+
+void close_pipe(int fds[2]) {
+  for (int i = 0; i < 2; ++i) {
+    if (fds[i] >= 0) {
+      ::close(fds[i]);
+    }
+  }
+}
+
+// Runs inside the SIGINT handler, so it must leave errno as it found it
+// for whatever syscall the interrupted thread is about to check.
+void signal_pipe(int fd) {
+  const int saved_errno = errno;
+  const char byte = 1;
+  while (::write(fd, &byte, 1) < 0 && errno == EINTR) {
+  }
+  errno = saved_errno;
+}
+#endif
+
+} // namespace
+
+#ifdef _WIN32
+CancellationToken::CancellationToken() = default;
+CancellationToken::~CancellationToken() = default;
+
+void CancellationToken::cancel() noexcept { cancelled_ = true; }
+
+void CancellationToken::reset() { cancelled_ = false; }
+
+bool CancellationToken::wait_for(std::chrono::milliseconds timeout) const {
+  if (!cancelled()) {
+    std::this_thread::sleep_for(timeout);
+  }
+  return cancelled();
+}
+
+CancelWatch::CancelWatch(const CancellationToken &, std::function<void()>) {}
+CancelWatch::~CancelWatch() = default;
+#else
+CancellationToken::CancellationToken() { open_pipe(fds_); }
+
+CancellationToken::~CancellationToken() { close_pipe(fds_); }
+
+void CancellationToken::cancel() noexcept {
+  if (!cancelled_.exchange(true) && fds_[1] >= 0) {
+    signal_pipe(fds_[1]);
+  }
+}
+
+void CancellationToken::reset() {
+  cancelled_ = false;
+  if (fds_[0] >= 0) {
+    char buffer[64];
+    while (::read(fds_[0], buffer, sizeof(buffer)) > 0) {
+    }
+  }
+}
+
+bool CancellationToken::wait_for(std::chrono::milliseconds timeout) const {
+  if (fds_[0] < 0) {
+    if (!cancelled()) {
+      std::this_thread::sleep_for(timeout);
+    }
+    return cancelled();
+  }
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  pollfd fds = {fds_[0], POLLIN, 0};
+  while (!cancelled()) {
+    auto left = std::chrono::ceil<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (left.count() <= 0 ||
+        (::poll(&fds, 1, static_cast<int>(left.count())) < 0 &&
+         errno != EINTR)) {
+      break;
+    }
+  }
+  return cancelled();
+}
+
+CancelWatch::CancelWatch(const CancellationToken &token,
+                         std::function<void()> action) {
+  if (token.fd() < 0 || !open_pipe(wake_)) {
+    return;
+  }
+  thread_ = std::thread([this, fd = token.fd(), action = std::move(action)] {
+    pollfd fds[2] = {{fd, POLLIN, 0}, {wake_[0], POLLIN, 0}};
+    while (::poll(fds, 2, -1) < 0 && errno == EINTR) {
+    }
+    if (fds[0].revents & POLLIN) {
+      action();
+    }
+  });
+}
+
+CancelWatch::~CancelWatch() {
+  if (thread_.joinable()) {
+    signal_pipe(wake_[1]);
+    thread_.join();
+  }
+  close_pipe(wake_);
+}
+#endif
+
+} // namespace llm
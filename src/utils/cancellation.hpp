@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+namespace llm {
+
+// A flag that asks a running operation to stop, backed by a self-pipe so
+// that it can be set from a signal handler and waited for with poll().
+// Operations check cancelled() between steps; a CancelWatch reacts at once
+// to abort one that is blocked, e.g. in a socket read.
+class CancellationToken {
+public:
+  CancellationToken();
+  ~CancellationToken();
+
+  CancellationToken(const CancellationToken &) = delete;
+  CancellationToken &operator=(const CancellationToken &) = delete;
+
+  // Async-signal-safe; later calls do nothing until reset().
+  void cancel() noexcept;
+  bool cancelled() const noexcept { return cancelled_.load(); }
+
+  // Sleeps for `timeout` or until cancelled, whichever comes first, and
+  // returns cancelled().
+  bool wait_for(std::chrono::milliseconds timeout) const;
+
+  // Clears the flag before the next operation. Must not race with a
+  // CancelWatch on this token.
+  void reset();
+
+  // Readable while cancelled; -1 if there is no pipe (Windows, or pipe()
+  // failed), in which case only cancelled() reports it.
+  int fd() const { return fds_[0]; }
+
+private:
+  std::atomic<bool> cancelled_{false};
+  int fds_[2] = {-1, -1};
+};
+
+// Runs `action` on a helper thread as soon as `token` is cancelled, or at
+// once if it already is, unless the watch is destroyed first. The
+// destructor waits for `action` to return.
+class CancelWatch {
+public:
+  CancelWatch(const CancellationToken &token, std::function<void()> action);
+  ~CancelWatch();
+
+  CancelWatch(const CancelWatch &) = delete;
+  CancelWatch &operator=(const CancelWatch &) = delete;
+
+private:
+  int wake_[2] = {-1, -1};
+  std::thread thread_;
+};
+
+} // namespace llm
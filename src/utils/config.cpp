@@ -167,8 +167,22 @@ nlohmann::json Config::to_json() const {
   repl_json["system_prompt"] = repl_config_.system_prompt;
   repl_json["streaming"] = repl_config_.streaming;
   repl_json["markdown_rendering"] = repl_config_.markdown_rendering;
+  repl_json["render_fps"] = repl_config_.render_fps;
   repl_json["prompt_prefix"] = repl_config_.prompt_prefix;
   repl_json["ai_prefix"] = repl_config_.ai_prefix;
+  repl_json["tokenizer_dir"] = repl_config_.tokenizer_dir;
+  repl_json["compaction_threshold"] = repl_config_.compaction_threshold;
+  repl_json["compaction_model"] = repl_config_.compaction_model;
+  repl_json["session_journal"] = repl_config_.session_journal;
+  repl_json["search_index"] = repl_config_.search_index;
+  repl_json["session_dir"] = repl_config_.session_dir;
+  repl_json["compress_sessions"] = repl_config_.compress_sessions;
+  repl_json["resident_budget_mb"] = repl_config_.resident_budget_mb;
+  repl_json["cold_dir"] = repl_config_.cold_dir;
+  repl_json["requests_per_minute"] = repl_config_.requests_per_minute;
+  repl_json["response_cache_entries"] = repl_config_.response_cache_entries;
+  repl_json["daemon_socket"] = repl_config_.daemon_socket;
+  repl_json["gateway_port"] = repl_config_.gateway_port;
 
   j["repl"] = repl_json;
 
@@ -226,12 +240,55 @@ void Config::from_json(const nlohmann::json &j) {
     if (repl_json.contains("markdown_rendering")) {
       repl_config_.markdown_rendering = repl_json["markdown_rendering"];
     }
+    if (repl_json.contains("render_fps")) {
+      repl_config_.render_fps = repl_json["render_fps"];
+    }
     if (repl_json.contains("prompt_prefix")) {
       repl_config_.prompt_prefix = repl_json["prompt_prefix"];
     }
     if (repl_json.contains("ai_prefix")) {
       repl_config_.ai_prefix = repl_json["ai_prefix"];
     }
+    if (repl_json.contains("tokenizer_dir")) {
+      repl_config_.tokenizer_dir = repl_json["tokenizer_dir"];
+    }
+    if (repl_json.contains("compaction_threshold")) {
+      repl_config_.compaction_threshold = repl_json["compaction_threshold"];
+    }
+    if (repl_json.contains("compaction_model")) {
+      repl_config_.compaction_model = repl_json["compaction_model"];
+    }
+    if (repl_json.contains("session_journal")) {
+      repl_config_.session_journal = repl_json["session_journal"];
+    }
+    if (repl_json.contains("search_index")) {
+      repl_config_.search_index = repl_json["search_index"];
+    }
+    if (repl_json.contains("session_dir")) {
+      repl_config_.session_dir = repl_json["session_dir"];
+    }
+    if (repl_json.contains("compress_sessions")) {
+      repl_config_.compress_sessions = repl_json["compress_sessions"];
+    }
+    if (repl_json.contains("resident_budget_mb")) {
+      repl_config_.resident_budget_mb = repl_json["resident_budget_mb"];
+    }
+    if (repl_json.contains("cold_dir")) {
+      repl_config_.cold_dir = repl_json["cold_dir"];
+    }
+    if (repl_json.contains("requests_per_minute")) {
+      repl_config_.requests_per_minute = repl_json["requests_per_minute"];
+    }
+    if (repl_json.contains("response_cache_entries")) {
+      repl_config_.response_cache_entries =
+          repl_json["response_cache_entries"];
+    }
+    if (repl_json.contains("daemon_socket")) {
+      repl_config_.daemon_socket = repl_json["daemon_socket"];
+    }
+    if (repl_json.contains("gateway_port")) {
+      repl_config_.gateway_port = repl_json["gateway_port"];
+    }
   }
 }
 
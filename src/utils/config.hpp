@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <map>
 #include <nlohmann/json.hpp>
 #include <optional>
@@ -16,13 +17,54 @@ struct ProviderConfig {
 };
 
 struct ReplConfig {
+  // Command history shared by concurrent REPLs, appended to as commands
+  // are entered; empty disables it. Compaction keeps the newest
+  // max_history distinct commands.
   std::string history_file = "~/.llm_repl_history";
   size_t max_history = 100;
   std::string system_prompt = "You are a helpful AI assistant.";
   bool streaming = true;
+  // Streamed text is written to the terminal at most this many times a
+  // second, and whenever a line is finished; 0 writes every chunk at once.
+  unsigned render_fps = 30;
   bool markdown_rendering = true;
   std::string prompt_prefix = "> ";
   std::string ai_prefix = "AI: ";
+  std::string tokenizer_dir = "~/.llm_repl/tokenizers";
+  // Fraction of the context budget at which old turns are summarized in
+  // the background; 0 disables compaction.
+  double compaction_threshold = 0.75;
+  std::string compaction_model = "llama-3.1-8b-instant";
+  // Journal of the live conversation, replayed on the next start if the
+  // REPL did not exit cleanly; empty disables journaling. A REPL started
+  // while another holds it journals to "<name>.<pid><ext>" alongside.
+  std::string session_journal = "~/.llm_repl/session.journal";
+  // Full-text index of saved conversations and past sessions for /search;
+  // empty disables it.
+  std::string search_index = "~/.llm_repl/search.index";
+  // Directory of sessions saved by name with /save, whose messages share
+  // deduplicated blobs; empty disables it.
+  std::string session_dir = "~/.llm_repl/sessions";
+  // Compress .session files written by /save with zstd, if built with it.
+  // Compressed files are smaller but are inflated in memory on /load
+  // instead of being read lazily through a mapping.
+  bool compress_sessions = false;
+  // Memory for message contents of the conversation; older turns beyond it
+  // are spilled to a cold file in cold_dir (the system temporary directory
+  // if empty). 0 keeps everything in memory.
+  size_t resident_budget_mb = 256;
+  std::string cold_dir = "";
+  // Requests sent per minute by all sessions together, at most; 0 lifts
+  // the limit.
+  unsigned requests_per_minute = 30;
+  // Replies kept to answer identical requests at temperature 0 without a
+  // round trip; 0 disables the cache.
+  size_t response_cache_entries = 32;
+  // Unix socket of the daemon started with --daemon, which --ask uses when
+  // it is running; empty disables the daemon.
+  std::string daemon_socket = "~/.llm_repl/daemon.sock";
+  // Local port of the OpenAI-compatible gateway started with --serve.
+  uint16_t gateway_port = 8400;
 };
 
 class Config {
@@ -0,0 +1,99 @@
+#include "utils/durable_file.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace llm {
+
+namespace {
+
+#ifdef _WIN32
+int open_new(const std::string &path) {
+  return ::_open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+                 _S_IREAD | _S_IWRITE);
+}
+int write_some(int fd, const char *data, size_t size) {
+  return ::_write(fd, data, static_cast<unsigned>(size));
+}
+bool sync_and_close(int fd) {
+  bool ok = ::_commit(fd) == 0;
+  return ::_close(fd) == 0 && ok;
+}
+// Windows commits the rename with the file's metadata.
+void sync_parent_dir(const std::string &) {}
+#else
+int open_new(const std::string &path) {
+  return ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+}
+ssize_t write_some(int fd, const char *data, size_t size) {
+  return ::write(fd, data, size);
+}
+bool sync_and_close(int fd) {
+  bool ok = ::fdatasync(fd) == 0;
+  return ::close(fd) == 0 && ok;
+}
+void sync_parent_dir(const std::string &path) {
+  auto parent = std::filesystem::path(path).parent_path();
+  int dir = ::open(parent.empty() ? "." : parent.c_str(),
+                   O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir >= 0) {
+    ::fsync(dir);
+    ::close(dir);
+  }
+}
+#endif
+
+} // namespace
+
+bool write_file_durably(const std::string &path, std::string_view bytes) {
+  // Unique per call, so concurrent writers of the same path never share a
+  // temporary file.
+  static std::atomic<uint64_t> counter{0};
+  const std::string temp =
+      path + ".tmp" +
+      std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) +
+      "-" + std::to_string(counter++);
+
+  int fd = open_new(temp);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = true;
+  while (ok && !bytes.empty()) {
+    auto written = write_some(fd, bytes.data(), bytes.size());
+    if (written < 0) {
+      ok = errno == EINTR;
+      continue;
+    }
+    bytes.remove_prefix(static_cast<size_t>(written));
+  }
+  ok = sync_and_close(fd) && ok;
+
+  std::error_code ec;
+  if (ok) {
+    std::filesystem::rename(temp, path, ec);
+    ok = !ec;
+  }
+  if (!ok) {
+    std::filesystem::remove(temp, ec);
+    return false;
+  }
+  sync_parent_dir(path);
+  return true;
+}
+
+} // namespace llm
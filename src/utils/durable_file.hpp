@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace llm {
+
+// Replaces `path` with `bytes` so that after a crash it holds either the old
+// or the new contents: the bytes go to a uniquely named temporary file that
+// is synced and renamed over `path`, and the directory entry is synced too.
+bool write_file_durably(const std::string &path, std::string_view bytes);
+
+} // namespace llm
@@ -0,0 +1,154 @@
+#include "utils/mapped_file.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "utils/logger.hpp"
+
+namespace llm {
+
+MappedFile::MappedFile(const std::string &path) { open(path); }
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      is_empty_file_(std::exchange(other.is_empty_file_, false)) {
+#ifdef _WIN32
+  file_handle_ = std::exchange(other.file_handle_, nullptr);
+  mapping_handle_ = std::exchange(other.mapping_handle_, nullptr);
+#endif
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    close();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    is_empty_file_ = std::exchange(other.is_empty_file_, false);
+#ifdef _WIN32
+    file_handle_ = std::exchange(other.file_handle_, nullptr);
+    mapping_handle_ = std::exchange(other.mapping_handle_, nullptr);
+#endif
+  }
+  return *this;
+}
+
+bool MappedFile::open(const std::string &path) {
+  close();
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    spdlog::debug("Failed to open file for mapping: {}", path);
+    return false;
+  }
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size)) {
+    CloseHandle(file);
+    return false;
+  }
+
+  if (file_size.QuadPart == 0) {
+    CloseHandle(file);
+    is_empty_file_ = true;
+    return true;
+  }
+
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    CloseHandle(file);
+    return false;
+  }
+
+  void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!view) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  file_handle_ = file;
+  mapping_handle_ = mapping;
+  data_ = static_cast<const char *>(view);
+  size_ = static_cast<size_t>(file_size.QuadPart);
+#else
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    spdlog::debug("Failed to open file for mapping: {}", path);
+    return false;
+  }
+  bool ok = open(fd);
+  ::close(fd);
+  if (!ok) {
+    spdlog::debug("mmap failed for: {}", path);
+    return false;
+  }
+#endif
+
+  return true;
+}
+
+#ifndef _WIN32
+bool MappedFile::open(int fd) {
+  close();
+
+  struct stat st {};
+  if (::fstat(fd, &st) != 0) {
+    return false;
+  }
+
+  if (st.st_size == 0) {
+    is_empty_file_ = true;
+    return true;
+  }
+
+  void *addr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                      MAP_PRIVATE, fd, 0);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+
+  data_ = static_cast<const char *>(addr);
+  size_ = static_cast<size_t>(st.st_size);
+  return true;
+}
+#endif
+
+void MappedFile::close() {
+#ifdef _WIN32
+  if (data_) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_handle_) {
+    CloseHandle(static_cast<HANDLE>(mapping_handle_));
+  }
+  if (file_handle_) {
+    CloseHandle(static_cast<HANDLE>(file_handle_));
+  }
+  file_handle_ = nullptr;
+  mapping_handle_ = nullptr;
+#else
+  if (data_) {
+    ::munmap(const_cast<char *>(data_), size_);
+  }
+#endif
+  data_ = nullptr;
+  size_ = 0;
+  is_empty_file_ = false;
+}
+
+} // namespace llm
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace llm {
+
+// Read-only memory mapping of a whole file. Pages are faulted in lazily by the
+// OS, so opening a large file is cheap and only the touched ranges become
+// resident.
+class MappedFile {
+public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+
+  bool open(const std::string &path);
+#ifndef _WIN32
+  // Maps the file open as `fd`, which stays the caller's to close.
+  bool open(int fd);
+#endif
+  void close();
+
+  bool is_open() const { return data_ != nullptr || is_empty_file_; }
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+  std::string_view view() const { return {data_, size_}; }
+
+private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  bool is_empty_file_ = false;
+
+#ifdef _WIN32
+  void *file_handle_ = nullptr;
+  void *mapping_handle_ = nullptr;
+#endif
+};
+
+} // namespace llm
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+namespace llm {
+
+// Bounded lock-free queue between one producer thread and one consumer
+// thread. Each side owns one index and only reads the other's, so pushes
+// and pops never take a lock. The blocking calls sleep on the other side's
+// index with std::atomic::wait rather than spinning.
+template <typename T, size_t Capacity> class SpscQueue {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+public:
+  // Producer: moves `value` in unless the queue is full. `value` is left
+  // untouched on failure, so the caller can keep adding to it.
+  bool try_push(T &value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    publish(tail, std::move(value));
+    return true;
+  }
+
+  // Producer: waits while the queue is full.
+  void push(T value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head;
+    while (tail - (head = head_.load(std::memory_order_acquire)) == Capacity) {
+      head_.wait(head, std::memory_order_acquire);
+    }
+    publish(tail, std::move(value));
+  }
+
+  // Consumer: the oldest value, if any.
+  std::optional<T> try_pop() {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (tail_.load(std::memory_order_acquire) == head) {
+      return std::nullopt;
+    }
+    return take(head);
+  }
+
+  // Consumer: waits for a value.
+  T pop() {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    while (tail_.load(std::memory_order_acquire) == head) {
+      tail_.wait(head, std::memory_order_acquire);
+    }
+    return take(head);
+  }
+
+  // Approximate unless called from one of the two threads while the other
+  // is idle.
+  bool empty() const {
+    return tail_.load(std::memory_order_acquire) ==
+           head_.load(std::memory_order_acquire);
+  }
+
+private:
+  static constexpr size_t MASK = Capacity - 1;
+
+  std::array<T, Capacity> slots_{};
+  // Next slot to pop, written by the consumer.
+  alignas(64) std::atomic<size_t> head_{0};
+  // Next slot to push, written by the producer.
+  alignas(64) std::atomic<size_t> tail_{0};
+
+  void publish(size_t tail, T &&value) {
+    slots_[tail & MASK] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    tail_.notify_one();
+  }
+
+  T take(size_t head) {
+    T value = std::move(slots_[head & MASK]);
+    head_.store(head + 1, std::memory_order_release);
+    head_.notify_one();
+    return value;
+  }
+};
+
+} // namespace llm
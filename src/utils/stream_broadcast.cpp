@@ -0,0 +1,108 @@
+#include "utils/stream_broadcast.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace llm {
+
+StreamBroadcast::StreamBroadcast()
+    : head_(new Segment(SEGMENT_BYTES, 0)), tail_(head_) {}
+
+StreamBroadcast::~StreamBroadcast() {
+  Segment *segment = head_;
+  while (segment) {
+    delete std::exchange(segment, segment->next.load(std::memory_order_relaxed));
+  }
+}
+
+void StreamBroadcast::publish(std::string_view delta) {
+  if (delta.empty()) {
+    return;
+  }
+  if (tail_->capacity - tail_->size < delta.size()) {
+    auto *next =
+        new Segment(std::max(SEGMENT_BYTES, delta.size()), written_);
+    tail_->next.store(next, std::memory_order_release);
+    tail_ = next;
+  }
+  std::memcpy(tail_->data.get() + tail_->size, delta.data(), delta.size());
+  tail_->size += delta.size();
+  written_ += delta.size();
+  state_.store(static_cast<uint64_t>(written_) << 1, std::memory_order_release);
+  state_.notify_all();
+}
+
+void StreamBroadcast::close() {
+  state_.store((static_cast<uint64_t>(written_) << 1) | 1,
+               std::memory_order_release);
+  state_.notify_all();
+}
+
+std::string StreamBroadcast::str() const {
+  std::string message;
+  message.reserve(size());
+  Reader reader(*this);
+  for (auto run = reader.try_read(); !run.empty(); run = reader.try_read()) {
+    message += run;
+  }
+  return message;
+}
+
+StreamBroadcast::Reader::Reader(const StreamBroadcast &broadcast,
+                                size_t max_lag)
+    : broadcast_(&broadcast), segment_(broadcast.head_), max_lag_(max_lag) {}
+
+std::string_view StreamBroadcast::Reader::try_read() {
+  return take(broadcast_->state_.load(std::memory_order_acquire) >> 1);
+}
+
+std::string_view StreamBroadcast::Reader::read() {
+  uint64_t state;
+  while (((state = broadcast_->state_.load(std::memory_order_acquire)) >> 1) ==
+             position_ &&
+         !(state & 1)) {
+    broadcast_->state_.wait(state, std::memory_order_acquire);
+  }
+  return take(state >> 1);
+}
+
+bool StreamBroadcast::Reader::done() const {
+  const uint64_t state = broadcast_->state_.load(std::memory_order_acquire);
+  return (state & 1) && (state >> 1) == position_;
+}
+
+std::string_view StreamBroadcast::Reader::take(size_t committed) {
+  // The state is loaded before any `next`, so every segment holding
+  // committed bytes is visible; a later link may be too, and is ignored
+  // until the bytes before it are committed.
+  while (max_lag_ > 0 && committed - position_ > max_lag_) {
+    const Segment *next = segment_->next.load(std::memory_order_acquire);
+    if (!next || next->start > committed) {
+      break;
+    }
+    dropped_ += next->start - position_;
+    position_ = next->start;
+    segment_ = next;
+    offset_ = 0;
+  }
+
+  while (true) {
+    const Segment *next = segment_->next.load(std::memory_order_acquire);
+    const size_t available = committed - segment_->start;
+    const size_t end = next ? std::min(segment_->size, available) : available;
+    if (offset_ < end) {
+      std::string_view run(segment_->data.get() + offset_, end - offset_);
+      offset_ = end;
+      position_ += run.size();
+      return run;
+    }
+    if (!next || end < segment_->size) {
+      return {};
+    }
+    segment_ = next;
+    offset_ = 0;
+  }
+}
+
+} // namespace llm
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace llm {
+
+// One streamed message, written by one producer and read by any number of
+// readers. Deltas are copied once, into segments that never move until the
+// broadcast is destroyed, and readers get views of them, so adding a
+// reader costs no copies. Publishing never waits for readers: each keeps
+// its own position, and one that joins mid-stream starts from the first
+// byte. A reader may instead bound its lag, skipping whole segments when
+// it falls too far behind.
+//
+// Readers need no lock. The producer publishes the number of bytes
+// written with a release store; segments are linked before the bytes in
+// them are published.
+class StreamBroadcast {
+  struct Segment;
+
+public:
+  // Deltas are packed into segments of at least this many bytes; a delta
+  // is never split across two.
+  static constexpr size_t SEGMENT_BYTES = 16 << 10;
+
+  StreamBroadcast();
+  ~StreamBroadcast();
+
+  StreamBroadcast(const StreamBroadcast &) = delete;
+  StreamBroadcast &operator=(const StreamBroadcast &) = delete;
+
+  // Producer: appends `delta` and wakes waiting readers.
+  void publish(std::string_view delta);
+  // Producer: ends the message. Nothing may be published after.
+  void close();
+
+  // Bytes published so far.
+  size_t size() const { return state_.load(std::memory_order_acquire) >> 1; }
+  bool closed() const { return state_.load(std::memory_order_acquire) & 1; }
+
+  // The message so far, in one string.
+  std::string str() const;
+
+  class Reader {
+  public:
+    // Reads from the first byte. With a `max_lag`, whenever more than
+    // that many bytes are unread the oldest segments are skipped, so the
+    // lag stays within about max_lag + SEGMENT_BYTES. The broadcast must
+    // outlive the reader.
+    explicit Reader(const StreamBroadcast &broadcast, size_t max_lag = 0);
+
+    // The next run of unread bytes, which may hold several deltas; empty
+    // if there is none yet. Views stay valid as long as the broadcast.
+    std::string_view try_read();
+    // Waits for unread bytes; empty only once the message is closed and
+    // fully read.
+    std::string_view read();
+
+    bool done() const;
+    // Bytes skipped to bound the lag.
+    size_t dropped() const { return dropped_; }
+
+  private:
+    const StreamBroadcast *broadcast_;
+    const Segment *segment_;
+    size_t offset_ = 0;
+    size_t position_ = 0;
+    size_t max_lag_;
+    size_t dropped_ = 0;
+
+    std::string_view take(size_t committed);
+  };
+
+private:
+  struct Segment {
+    explicit Segment(size_t capacity, size_t start)
+        : data(new char[capacity]), capacity(capacity), start(start) {}
+
+    std::unique_ptr<char[]> data;
+    size_t capacity;
+    // Offset of the first byte in the message.
+    size_t start;
+    // Final once `next` is set; until then readers go by state_.
+    size_t size = 0;
+    std::atomic<Segment *> next{nullptr};
+  };
+
+  Segment *head_;
+  Segment *tail_;      // producer only
+  size_t written_ = 0; // producer only
+  // Bytes published, shifted left once; the low bit is set once closed.
+  // One word so that a reader never misses the wake-up for either.
+  std::atomic<uint64_t> state_{0};
+};
+
+} // namespace llm
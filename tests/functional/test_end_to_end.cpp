@@ -310,7 +310,7 @@ TEST_F(EndToEndTest, UnicodeAndSpecialCharacterHandling) {
         auto json = msg.to_json();
         auto reconstructed = Message::from_json(json);
 
-        EXPECT_EQ(reconstructed.content, test_str);
+        EXPECT_EQ(reconstructed.content, std::string_view(test_str));
     }
 }
 
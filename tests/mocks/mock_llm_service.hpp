@@ -41,7 +41,9 @@ public:
         response.model = "test-model";
         response.tokens_used = 100;
 
-        EXPECT_CALL(*this, complete(testing::_))
+        EXPECT_CALL(*this, complete(testing::An<const Conversation&>()))
+            .WillRepeatedly(testing::Return(response));
+        EXPECT_CALL(*this, complete(testing::An<const std::string&>()))
             .WillRepeatedly(testing::Return(response));
     }
 
@@ -50,18 +52,23 @@ public:
         response.success = false;
         response.error = error_message;
 
-        EXPECT_CALL(*this, complete(testing::_))
+        EXPECT_CALL(*this, complete(testing::An<const Conversation&>()))
+            .WillRepeatedly(testing::Return(response));
+        EXPECT_CALL(*this, complete(testing::An<const std::string&>()))
             .WillRepeatedly(testing::Return(response));
     }
 
     void SetupStreamingCompletion(const std::vector<std::string>& chunks) {
-        EXPECT_CALL(*this, stream_complete(testing::_, testing::_))
-            .WillOnce(testing::Invoke([chunks](const auto&, StreamCallback callback) {
-                for (const auto& chunk : chunks) {
-                    callback(chunk, false);
-                }
-                callback("", true); // Signal completion
-            }));
+        auto stream = [chunks](const auto&, StreamCallback callback) {
+            for (const auto& chunk : chunks) {
+                callback(chunk, false);
+            }
+            callback("", true); // Signal completion
+        };
+        EXPECT_CALL(*this, stream_complete(testing::An<const Conversation&>(), testing::_))
+            .WillRepeatedly(testing::Invoke(stream));
+        EXPECT_CALL(*this, stream_complete(testing::An<const std::string&>(), testing::_))
+            .WillRepeatedly(testing::Invoke(stream));
     }
 
     void SetupAvailableModels(const std::vector<ModelInfo>& models) {
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <thread>
+#include <poll.h>
+#include "utils/cancellation.hpp"
+
+using namespace llm;
+
+namespace {
+
+bool Readable(int fd) {
+    pollfd pfd{fd, POLLIN, 0};
+    return ::poll(&pfd, 1, 0) == 1;
+}
+
+CancellationToken* signal_token = nullptr;
+
+void CancelOnSignal(int) {
+    signal_token->cancel();
+}
+
+} // namespace
+
+TEST(CancellationTest, CancelIsVisibleThroughFlagAndFd) {
+    CancellationToken token;
+    ASSERT_GE(token.fd(), 0);
+    EXPECT_FALSE(token.cancelled());
+    EXPECT_FALSE(Readable(token.fd()));
+
+    token.cancel();
+    token.cancel();
+    EXPECT_TRUE(token.cancelled());
+    EXPECT_TRUE(Readable(token.fd()));
+
+    token.reset();
+    EXPECT_FALSE(token.cancelled());
+    EXPECT_FALSE(Readable(token.fd()));
+}
+
+TEST(CancellationTest, CancelsFromSignalHandler) {
+    CancellationToken token;
+    signal_token = &token;
+    auto previous = std::signal(SIGUSR1, CancelOnSignal);
+    std::raise(SIGUSR1);
+    std::signal(SIGUSR1, previous);
+    signal_token = nullptr;
+
+    EXPECT_TRUE(token.cancelled());
+    EXPECT_TRUE(Readable(token.fd()));
+}
+
+TEST(CancellationTest, CancelPreservesErrno) {
+    CancellationToken token;
+    errno = EAGAIN;
+    token.cancel();
+    EXPECT_EQ(errno, EAGAIN);
+}
+
+TEST(CancellationTest, WatchRunsActionOnCancel) {
+    CancellationToken token;
+    std::atomic<bool> fired{false};
+    {
+        CancelWatch watch(token, [&fired] {
+            fired = true;
+            fired.notify_all();
+        });
+        std::thread canceller([&token] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            token.cancel();
+        });
+        fired.wait(false);
+        canceller.join();
+    }
+    EXPECT_TRUE(fired);
+}
+
+TEST(CancellationTest, WatchDestroyedFirstNeverRunsAction) {
+    CancellationToken token;
+    bool fired = false;
+    {
+        CancelWatch watch(token, [&fired] { fired = true; });
+    }
+    token.cancel();
+    EXPECT_FALSE(fired);
+
+    // An already cancelled token fires at once.
+    {
+        CancelWatch watch(token, [&fired] { fired = true; });
+    }
+    EXPECT_TRUE(fired);
+}
+
+TEST(CancellationTest, WaitForEndsEarlyOnCancel) {
+    CancellationToken token;
+    EXPECT_FALSE(token.wait_for(std::chrono::milliseconds(5)));
+
+    std::thread canceller([&token] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        token.cancel();
+    });
+    auto started = std::chrono::steady_clock::now();
+    EXPECT_TRUE(token.wait_for(std::chrono::seconds(10)));
+    EXPECT_LT(std::chrono::steady_clock::now() - started,
+              std::chrono::seconds(5));
+    canceller.join();
+}
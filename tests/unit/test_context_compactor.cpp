@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include "llm/context_compactor.hpp"
+#include "mocks/mock_llm_service.hpp"
+
+using ::testing::_;
+using ::testing::An;
+using ::testing::HasSubstr;
+using ::testing::NiceMock;
+using ::testing::Return;
+
+using namespace llm;
+
+namespace {
+
+CompletionResponse Summary(const std::string& content) {
+    CompletionResponse response;
+    response.success = true;
+    response.content = content;
+    return response;
+}
+
+Conversation LongConversation(int exchanges) {
+    Conversation conversation;
+    conversation.set_system_prompt("You are helpful.");
+    for (int i = 0; i < exchanges; ++i) {
+        conversation.add_user("Question " + std::to_string(i) + " with some padding text");
+        conversation.add_assistant("Answer " + std::to_string(i) + " with some more padding text");
+    }
+    return conversation;
+}
+
+} // namespace
+
+TEST(ContextCompactorTest, ReplaceWithSummaryArchivesOriginals) {
+    auto conversation = LongConversation(4);
+    size_t before = conversation.estimate_tokens();
+
+    auto span = conversation.oldest_turns(4);
+    ASSERT_EQ(span.messages.size(), 4u);
+    EXPECT_EQ(span.messages[0].content, "Question 0 with some padding text");
+
+    ASSERT_TRUE(conversation.replace_with_summary(span, "Q0 and Q1 answered."));
+    EXPECT_EQ(conversation.size(), 6u);
+    EXPECT_EQ(conversation.messages()[0].content, "You are helpful.");
+    EXPECT_THAT(conversation.messages()[1].content, HasSubstr("Q0 and Q1 answered."));
+    EXPECT_EQ(conversation.messages()[2].content, "Question 2 with some padding text");
+    EXPECT_LT(conversation.estimate_tokens(), before);
+    ASSERT_EQ(conversation.archived().size(), 4u);
+    EXPECT_EQ(conversation.archived()[3].content, "Answer 1 with some more padding text");
+
+    // The same span cannot be applied twice.
+    EXPECT_FALSE(conversation.replace_with_summary(span, "again"));
+
+    // A second compaction folds the first summary in without archiving it.
+    ASSERT_TRUE(conversation.replace_with_summary(conversation.oldest_turns(3), "Everything so far."));
+    EXPECT_EQ(conversation.archived().size(), 6u);
+    EXPECT_EQ(conversation.size(), 4u);
+}
+
+TEST(ContextCompactorTest, StaleSpanIsRejectedAfterClear) {
+    auto conversation = LongConversation(4);
+    auto span = conversation.oldest_turns(4);
+
+    conversation.clear();
+    conversation.add_user("fresh start");
+    EXPECT_FALSE(conversation.replace_with_summary(span, "summary"));
+    EXPECT_EQ(conversation.size(), 1u);
+}
+
+TEST(ContextCompactorTest, SummarizesInBackgroundAboveThreshold) {
+    auto service = std::make_shared<NiceMock<MockLLMService>>();
+    EXPECT_CALL(*service, complete(An<const Conversation&>()))
+        .WillOnce([](const Conversation& request) {
+            EXPECT_THAT(request.messages()[1].content, HasSubstr("User: Question 0"));
+            return Summary("The user asked several questions.");
+        });
+
+    ContextCompactor compactor(service, 0.5);
+    auto conversation = LongConversation(10);
+    size_t tokens = conversation.estimate_tokens();
+
+    // Below the threshold nothing happens.
+    EXPECT_FALSE(compactor.maybe_start(conversation, tokens * 4));
+
+    ASSERT_TRUE(compactor.maybe_start(conversation, tokens));
+    EXPECT_FALSE(compactor.maybe_start(conversation, tokens));
+
+    // The conversation may keep growing while the summary is in flight.
+    conversation.add_user("Another question");
+    compactor.wait();
+    ASSERT_TRUE(compactor.apply_ready(conversation));
+    EXPECT_FALSE(compactor.busy());
+
+    EXPECT_EQ(conversation.archived().size(), 10u);
+    EXPECT_EQ(conversation.size(), 1u + 1u + 11u);
+    EXPECT_LT(conversation.estimate_tokens(), tokens);
+    EXPECT_EQ(conversation.messages().back().content, "Another question");
+}
+
+TEST(ContextCompactorTest, FailedSummaryLeavesConversationIntact) {
+    auto service = std::make_shared<NiceMock<MockLLMService>>();
+    CompletionResponse failure;
+    failure.success = false;
+    failure.error = "rate limited";
+    EXPECT_CALL(*service, complete(An<const Conversation&>())).WillOnce(Return(failure));
+
+    ContextCompactor compactor(service, 0.5);
+    auto conversation = LongConversation(10);
+    size_t tokens = conversation.estimate_tokens();
+
+    ASSERT_TRUE(compactor.maybe_start(conversation, tokens));
+    compactor.wait();
+    EXPECT_FALSE(compactor.apply_ready(conversation));
+    EXPECT_EQ(conversation.size(), 21u);
+    EXPECT_TRUE(conversation.archived().empty());
+
+    // Retries only after the conversation has grown.
+    EXPECT_FALSE(compactor.maybe_start(conversation, tokens));
+}
+
+TEST(ContextCompactorTest, DisabledByZeroThreshold) {
+    auto service = std::make_shared<NiceMock<MockLLMService>>();
+    EXPECT_CALL(*service, complete(An<const Conversation&>())).Times(0);
+
+    ContextCompactor compactor(service, 0.0);
+    auto conversation = LongConversation(10);
+    EXPECT_FALSE(compactor.maybe_start(conversation, 1));
+}
@@ -0,0 +1,276 @@
+#include <gtest/gtest.h>
+#include "models/context_store.hpp"
+#include "models/conversation.hpp"
+#include "utils/test_helpers.hpp"
+
+#include <filesystem>
+
+using namespace llm;
+
+namespace {
+
+ContextStore::Entry MakeEntry(MessageRole role, const std::string& content, uint64_t seq) {
+    return ContextStore::Entry(Message(role, content), seq, content.size());
+}
+
+} // namespace
+
+TEST(ContextStoreTest, SystemSlotStaysPinned) {
+    ContextStore store;
+    store.push_back(MakeEntry(MessageRole::User, "first", 0));
+    EXPECT_FALSE(store.has_system());
+
+    auto previous = store.set_system(MakeEntry(MessageRole::System, "sys", 1));
+    EXPECT_EQ(previous, nullptr);
+    EXPECT_EQ(store.size(), 2u);
+    EXPECT_EQ(store.turn_count(), 1u);
+    EXPECT_EQ(store.view().front().content, "sys");
+
+    previous = store.set_system(MakeEntry(MessageRole::System, "sys2", 2));
+    ASSERT_NE(previous, nullptr);
+    EXPECT_EQ(previous->message.content, "sys");
+    EXPECT_EQ(store.view().front().content, "sys2");
+}
+
+TEST(ContextStoreTest, PopFrontEvictsOldestTurnOnly) {
+    ContextStore store;
+    store.set_system(MakeEntry(MessageRole::System, "sys", 0));
+    for (int i = 0; i < 5; ++i) {
+        store.push_back(MakeEntry(MessageRole::User, "turn " + std::to_string(i), i + 1));
+    }
+
+    auto evicted = store.pop_front();
+    EXPECT_EQ(evicted->message.content, "turn 0");
+    EXPECT_EQ(store.turn_count(), 4u);
+    EXPECT_EQ(store.oldest_turn().message.content, "turn 1");
+    EXPECT_EQ(store.view()[0].content, "sys");
+    EXPECT_EQ(store.view().back().content, "turn 4");
+}
+
+TEST(ContextStoreTest, ViewIteratesInOrder) {
+    ContextStore store;
+    store.push_back(MakeEntry(MessageRole::User, "a", 0));
+    store.push_back(MakeEntry(MessageRole::Assistant, "b", 1));
+    store.set_system(MakeEntry(MessageRole::System, "s", 2));
+
+    std::string order;
+    for (const auto& msg : store.view()) {
+        order += msg.content;
+    }
+    EXPECT_EQ(order, "sab");
+
+    auto view = store.view();
+    EXPECT_EQ(view.end() - view.begin(), 3);
+    EXPECT_EQ(view.begin()[2].content, "b");
+}
+
+TEST(ContextStoreTest, SerializeMatchesJsonAcrossEvictions) {
+    ContextStore store;
+    store.set_system(MakeEntry(MessageRole::System, "Be \"brief\"", 0));
+    for (int i = 0; i < 4; ++i) {
+        store.push_back(MakeEntry(MessageRole::User, "line\n" + std::to_string(i), i + 1));
+    }
+
+    auto expected = [&store]() {
+        nlohmann::json j = nlohmann::json::array();
+        for (const auto& msg : store.view()) {
+            j.push_back(msg.to_json());
+        }
+        return j.dump();
+    };
+
+    EXPECT_EQ(store.serialize(), expected());
+    const auto* cached = &store.entry(2).serialized();
+
+    store.pop_front();
+    EXPECT_EQ(store.serialize(), expected());
+    // The surviving entries keep their cached fragments.
+    EXPECT_EQ(&store.entry(1).serialized(), cached);
+
+    store.clear();
+    EXPECT_EQ(store.serialize(), "[]");
+}
+
+TEST(ContextStoreTest, CopiesShareEntriesAndDivergeSafely) {
+    ContextStore store;
+    const size_t count = ContextStore::CHUNK_SIZE + 5;
+    for (size_t i = 0; i < count; ++i) {
+        store.push_back(MakeEntry(MessageRole::User, "turn " + std::to_string(i), i));
+    }
+
+    ContextStore copy = store;
+    EXPECT_EQ(&copy.entry(count - 1), &store.entry(count - 1));
+
+    // Both append into the same partly filled chunk.
+    store.push_back(MakeEntry(MessageRole::User, "original", count));
+    copy.push_back(MakeEntry(MessageRole::Assistant, "copy", count));
+    EXPECT_EQ(store.view().back().content, "original");
+    EXPECT_EQ(copy.view().back().content, "copy");
+    EXPECT_EQ(copy.view()[count - 1].content, std::string_view("turn " + std::to_string(count - 1)));
+
+    // Evicting from one leaves the other intact.
+    for (size_t i = 0; i < count; ++i) {
+        store.pop_front();
+    }
+    EXPECT_EQ(store.turn_count(), 1u);
+    EXPECT_EQ(copy.turn_count(), count + 1);
+    EXPECT_EQ(copy.oldest_turn().message.content, "turn 0");
+
+    // Updating entries never shows through to the other store.
+    copy.update_each([](ContextStore::Entry& entry) { entry.tokens = 0; });
+    EXPECT_EQ(store.entry(0).tokens, std::string("original").size());
+    EXPECT_EQ(copy.entry(0).tokens, 0u);
+}
+
+TEST(ContextStoreTest, PushFrontKeepsOrder) {
+    ContextStore store;
+    store.set_system(MakeEntry(MessageRole::System, "s", 0));
+    store.push_back(MakeEntry(MessageRole::User, "c", 1));
+    store.push_front(MakeEntry(MessageRole::User, "b", 2));
+    store.push_front(MakeEntry(MessageRole::User, "a", 3));
+
+    std::string order;
+    for (const auto& msg : store.view()) {
+        order += msg.content;
+    }
+    EXPECT_EQ(order, "sabc");
+    EXPECT_EQ(store.pop_front()->message.content, "a");
+    EXPECT_EQ(store.oldest_turn().message.content, "b");
+}
+
+TEST(ContextStoreTest, PopBackThenAppendLeavesCopiesIntact) {
+    ContextStore store;
+    for (size_t i = 0; i < ContextStore::CHUNK_SIZE + 2; ++i) {
+        store.push_back(MakeEntry(MessageRole::User, "turn " + std::to_string(i), i));
+    }
+    ContextStore copy = store;
+
+    for (int i = 0; i < 4; ++i) {
+        store.pop_back();
+    }
+    store.push_back(MakeEntry(MessageRole::Assistant, "replacement", 100));
+
+    EXPECT_EQ(store.turn_count(), ContextStore::CHUNK_SIZE - 1);
+    EXPECT_EQ(store.view().back().content, "replacement");
+    EXPECT_EQ(copy.turn_count(), ContextStore::CHUNK_SIZE + 2);
+    EXPECT_EQ(copy.view()[ContextStore::CHUNK_SIZE - 2].content,
+              std::string_view("turn " + std::to_string(ContextStore::CHUNK_SIZE - 2)));
+}
+
+TEST(ContextStoreTest, TrimmedCopySharesPrefixFragments) {
+    ContextStore store;
+    for (size_t i = 0; i < 2 * ContextStore::CHUNK_SIZE + 2; ++i) {
+        store.push_back(MakeEntry(MessageRole::User, "turn " + std::to_string(i), i));
+    }
+    ContextStore branch = store;
+    for (int i = 0; i < 4; ++i) {
+        branch.pop_back();
+    }
+    branch.push_back(MakeEntry(MessageRole::Assistant, "branch reply", 100));
+
+    EXPECT_EQ(&branch.entry(0).serialized(), &store.entry(0).serialized());
+    EXPECT_EQ(&branch.entry(ContextStore::CHUNK_SIZE - 1).serialized(),
+              &store.entry(ContextStore::CHUNK_SIZE - 1).serialized());
+    EXPECT_EQ(branch.serialize().substr(0, 20), store.serialize().substr(0, 20));
+}
+
+TEST(ContextStoreTest, ConversationTruncationKeepsRunningTotal) {
+    Conversation conversation;
+    conversation.set_system_prompt("system");
+    for (int i = 0; i < 50; ++i) {
+        conversation.add_user("message number " + std::to_string(i));
+        conversation.truncate_to_token_limit(60, 10);
+    }
+
+    EXPECT_EQ(conversation.messages()[0].role, MessageRole::System);
+    EXPECT_EQ(conversation.messages().back().content, "message number 49");
+    EXPECT_LE(conversation.estimate_tokens(), 60u);
+
+    size_t sum = 0;
+    for (size_t i = 0; i < conversation.size(); ++i) {
+        sum += conversation.message_tokens(i);
+    }
+    EXPECT_EQ(sum, conversation.estimate_tokens());
+    EXPECT_EQ(conversation.serialize_messages(), conversation.to_json().dump());
+}
+
+TEST(ContextStoreTest, ResidentBytesCountContentsAndFragments) {
+    ContextStore store;
+    store.push_back(MakeEntry(MessageRole::User, "hello", 0));
+    store.push_back(MakeEntry(MessageRole::Assistant, "hi there", 1));
+    const size_t second = 8 + store.entry(1).json.size();
+    EXPECT_EQ(store.resident_bytes(), 5 + store.entry(0).json.size() + second);
+    store.pop_front();
+    EXPECT_EQ(store.resident_bytes(), second);
+}
+
+TEST(ContextStoreTest, SpillsOldChunksOverResidentBudget) {
+    const std::string dir = test::TestHelpers::CreateTempDir();
+    ContextStore store;
+    store.set_resident_budget(4096, dir);
+    store.set_system(MakeEntry(MessageRole::System, "sys", 0));
+
+    const size_t count = ContextStore::CHUNK_SIZE * 4 + 3;
+    const std::string padding(100, 'x');
+    for (size_t i = 0; i < count; ++i) {
+        store.push_back(MakeEntry(i % 2 ? MessageRole::Assistant : MessageRole::User,
+                                  "turn " + std::to_string(i) + padding, i + 1));
+    }
+    EXPECT_GT(store.cold_turns(), 0u);
+    EXPECT_EQ(store.cold_turns() % ContextStore::CHUNK_SIZE, 0u);
+    EXPECT_LE(store.resident_bytes(), 4096u + ContextStore::CHUNK_SIZE * 200);
+    // The cold file was unlinked as soon as it was created.
+    EXPECT_TRUE(std::filesystem::is_empty(dir));
+
+    // Counts and sequence numbers are kept; contents are paged back in.
+    EXPECT_EQ(store.tokens(1), std::string("turn 0" + padding).size());
+    EXPECT_EQ(store.seq(1), 1u);
+    EXPECT_EQ(store.entry(1).message.role, MessageRole::User);
+    size_t i = 0;
+    for (const auto& msg : store.view()) {
+        if (i > 0) {
+            EXPECT_EQ(msg.content, std::string_view("turn " + std::to_string(i - 1) + padding));
+        }
+        ++i;
+    }
+    EXPECT_EQ(i, count + 1);
+
+    // Copies read the same cold file; modifying one pages its turns in.
+    ContextStore copy = store;
+    copy.update_each([](ContextStore::Entry& entry) { entry.tokens = 0; });
+    EXPECT_EQ(copy.entry(1).tokens, 0u);
+    EXPECT_EQ(store.tokens(1), std::string("turn 0" + padding).size());
+    EXPECT_EQ(store.pop_front()->message.content, std::string_view("turn 0" + padding));
+    EXPECT_EQ(copy.oldest_turn().message.content, std::string_view("turn 0" + padding));
+
+    store.clear();
+    copy.clear();
+    EXPECT_TRUE(std::filesystem::is_empty(dir));
+    test::TestHelpers::CleanupTempPath(dir);
+}
+
+TEST(ContextStoreTest, ConversationWithResidentBudgetRoundTrips) {
+    Conversation conversation;
+    conversation.set_resident_budget(2048);
+    conversation.set_system_prompt("system");
+    for (int i = 0; i < 200; ++i) {
+        conversation.add_user("question " + std::to_string(i) + std::string(64, 'q'));
+        conversation.add_assistant("answer " + std::to_string(i) + std::string(64, 'a'));
+    }
+    EXPECT_GT(conversation.spilled_turns(), 0u);
+    EXPECT_LT(conversation.resident_bytes(), 2048u + ContextStore::CHUNK_SIZE * 200);
+
+    Conversation unspilled;
+    unspilled.set_system_prompt("system");
+    for (const auto& msg : conversation.messages()) {
+        if (msg.role != MessageRole::System) {
+            unspilled.add_message(Message(msg.role, std::string(msg.content)));
+        }
+    }
+    EXPECT_EQ(conversation.serialize_messages(), unspilled.serialize_messages());
+    EXPECT_EQ(conversation.estimate_tokens(), unspilled.estimate_tokens());
+
+    // Context selection only pages in what it sends.
+    auto context = conversation.select_context(200, 2);
+    EXPECT_EQ(context.messages().back().content, std::string_view("answer 199" + std::string(64, 'a')));
+}
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <future>
 #include <gmock/gmock.h>
 #include "models/conversation.hpp"
 #include "utils/test_helpers.hpp"
@@ -63,6 +64,62 @@ TEST_F(ConversationTest, Clear) {
     EXPECT_EQ(conversation_->size(), 0);
 }
 
+TEST_F(ConversationTest, ContentsLiveInArena) {
+    std::string long_text(1000, 'a');
+    conversation_->set_system_prompt(long_text);
+    conversation_->add_user(long_text);
+
+    auto* arena = conversation_->messages()[0].content.get_allocator().resource();
+    EXPECT_NE(arena, std::pmr::get_default_resource());
+    EXPECT_EQ(conversation_->messages()[1].content.get_allocator().resource(), arena);
+
+    // Moving hands the arena over along with the messages.
+    Conversation moved = std::move(*conversation_);
+    EXPECT_EQ(moved.messages()[1].content.get_allocator().resource(), arena);
+    moved.clear();
+    moved.add_assistant(long_text);
+    EXPECT_EQ(moved.messages()[0].content, std::string_view(long_text));
+
+    Conversation assigned;
+    assigned.add_user("replaced");
+    assigned = std::move(moved);
+    EXPECT_EQ(assigned.size(), 1u);
+    EXPECT_EQ(assigned.messages()[0].content, std::string_view(long_text));
+}
+
+TEST_F(ConversationTest, CopiesAreSharedSnapshots) {
+    conversation_->set_system_prompt("system");
+    for (int i = 0; i < 100; ++i) {
+        conversation_->add_user("question " + std::to_string(i));
+    }
+
+    Conversation snapshot = *conversation_;
+    EXPECT_EQ(snapshot.messages()[50].content.data(),
+              conversation_->messages()[50].content.data());
+    const std::string expected = snapshot.serialize_messages();
+
+    // The snapshot is read on another thread while the original keeps
+    // changing, including a /clear that must not free the shared messages.
+    auto reader = std::async(std::launch::async, [&snapshot]() {
+        std::string last;
+        for (int i = 0; i < 50; ++i) {
+            last = snapshot.serialize_messages();
+        }
+        return last;
+    });
+    for (int i = 0; i < 200; ++i) {
+        conversation_->add_assistant("answer " + std::to_string(i));
+        conversation_->truncate_to_token_limit(400, 20);
+    }
+    conversation_->clear();
+    conversation_->add_user("after clear");
+
+    EXPECT_EQ(reader.get(), expected);
+    EXPECT_EQ(snapshot.size(), 101u);
+    EXPECT_EQ(conversation_->size(), 1u);
+    EXPECT_EQ(conversation_->messages()[0].content, "after clear");
+}
+
 TEST_F(ConversationTest, SetSystemPrompt) {
     // Setting system prompt on empty conversation
     conversation_->set_system_prompt("Initial system prompt");
@@ -195,6 +252,86 @@ TEST_F(ConversationTest, TruncateToTokenLimit) {
     EXPECT_LE(conversation_->size(), 6); // system + 5 recent
 }
 
+TEST_F(ConversationTest, RunningTokenTotalTracksMutations) {
+    auto recount = [this]() {
+        size_t total = 0;
+        for (const auto& msg : conversation_->messages()) {
+            total += conversation_->count_message_tokens(msg);
+        }
+        return total;
+    };
+
+    conversation_->add_user("Hello there");
+    conversation_->add_assistant("General Kenobi! {\"json\": [1, 2, 3]}");
+    EXPECT_EQ(conversation_->estimate_tokens(), recount());
+
+    conversation_->set_system_prompt("Be brief.");
+    EXPECT_EQ(conversation_->estimate_tokens(), recount());
+
+    conversation_->set_system_prompt("Be very, very brief and precise.");
+    EXPECT_EQ(conversation_->estimate_tokens(), recount());
+    EXPECT_EQ(conversation_->message_tokens(0),
+              conversation_->count_message_tokens(conversation_->messages()[0]));
+
+    for (int i = 0; i < 20; ++i) {
+        conversation_->add_user("Question number " + std::to_string(i));
+    }
+    conversation_->truncate_to_token_limit(40, 5);
+    EXPECT_EQ(conversation_->estimate_tokens(), recount());
+
+    conversation_->clear();
+    EXPECT_EQ(conversation_->estimate_tokens(), 0);
+}
+
+namespace {
+
+class ByteTokenizer : public Tokenizer {
+public:
+    std::string name() const override { return "bytes"; }
+    size_t count_tokens(std::string_view text) const override { return text.size(); }
+};
+
+} // namespace
+
+TEST_F(ConversationTest, TokenizerSwitchRecountsInBackground) {
+    std::string big(Conversation::BACKGROUND_RECOUNT_BYTES, 'x');
+    conversation_->add_user(big);
+    conversation_->add_assistant("ok");
+
+    conversation_->set_tokenizer(std::make_shared<ByteTokenizer>());
+    // Messages added while the recount runs are counted immediately.
+    conversation_->add_user("abc");
+
+    conversation_->wait_for_token_counts();
+    EXPECT_FALSE(conversation_->token_counts_pending());
+
+    size_t expected = big.size() + 2 + 3 + 3 * Conversation::MESSAGE_OVERHEAD_TOKENS;
+    EXPECT_EQ(conversation_->estimate_tokens(), expected);
+
+    // Switching again to the same vocabulary keeps the cached counts.
+    conversation_->set_tokenizer(std::make_shared<ByteTokenizer>());
+    EXPECT_FALSE(conversation_->token_counts_pending());
+    EXPECT_EQ(conversation_->estimate_tokens(), expected);
+}
+
+TEST_F(ConversationTest, SummarizedOriginalsGoToTheColdFile) {
+    TempDir dir;
+    conversation_->set_resident_budget(1 << 20, dir.path());
+    for (int i = 0; i < 40; ++i) {
+        conversation_->add_user("Question " + std::to_string(i));
+        conversation_->add_assistant("Answer " + std::to_string(i));
+    }
+    ASSERT_TRUE(conversation_->replace_with_summary(conversation_->oldest_turns(70), "Earlier turns."));
+    EXPECT_EQ(conversation_->spilled_turns(), 0u);
+    EXPECT_EQ(conversation_->spilled_archived_turns(), 64u);
+
+    auto archived = conversation_->archived();
+    ASSERT_EQ(archived.size(), 70u);
+    EXPECT_EQ(archived[0].content, "Question 0");
+    EXPECT_EQ(archived[69].content, "Answer 34");
+    EXPECT_THAT(Conversation::to_string(archived), HasSubstr("[User] Question 34"));
+}
+
 TEST_F(ConversationTest, ToString) {
     conversation_->add_system("System prompt");
     conversation_->add_user("Hello");
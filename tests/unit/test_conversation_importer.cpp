@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "models/conversation.hpp"
+#include "models/conversation_importer.hpp"
+#include "utils/test_helpers.hpp"
+
+using namespace llm;
+using namespace llm::test;
+
+namespace {
+
+std::vector<Message> Import(const std::string& text, size_t threads = 0) {
+    std::vector<Message> messages;
+    ConversationImporter(threads).import(text, [&messages](Message&& message) {
+        messages.push_back(std::move(message));
+    });
+    return messages;
+}
+
+} // namespace
+
+TEST(ConversationImporterTest, ReadsOwnFormat) {
+    Conversation original = TestHelpers::CreateTestConversation();
+    auto messages = Import(original.to_json().dump(2));
+
+    ASSERT_EQ(messages.size(), original.size());
+    for (size_t i = 0; i < messages.size(); ++i) {
+        EXPECT_EQ(messages[i].role, original.messages()[i].role);
+        EXPECT_EQ(messages[i].content, original.messages()[i].content);
+    }
+}
+
+TEST(ConversationImporterTest, ReadsOpenAIRequestsWithContentParts) {
+    auto messages = Import(R"({"model": "x", "messages": [
+        {"role": "developer", "content": "Be brief."},
+        {"role": "user", "content": [{"type": "text", "text": "Hi"},
+                                     {"type": "image_url", "image_url": {"url": "u"}}]},
+        {"role": "assistant", "content": null, "tool_calls": []},
+        {"role": "tool", "content": "42"},
+        {"role": "assistant", "content": "Hello"}]})");
+
+    ASSERT_EQ(messages.size(), 3u);
+    EXPECT_EQ(messages[0].role, MessageRole::System);
+    EXPECT_EQ(messages[1].content, "Hi");
+    EXPECT_EQ(messages[2].content, "Hello");
+}
+
+TEST(ConversationImporterTest, ReadsChatGPTExport) {
+    auto messages = Import(R"([{"title": "t", "mapping": {
+        "a": {"id": "a", "message": {"author": {"role": "user", "metadata": {}},
+              "content": {"content_type": "text", "parts": ["Question"]}}, "children": ["b"]},
+        "b": {"id": "b", "message": {"author": {"role": "assistant"},
+              "content": {"content_type": "text", "parts": ["Answer"]}}, "parent": "a"}}}])");
+
+    ASSERT_EQ(messages.size(), 2u);
+    EXPECT_EQ(messages[0].role, MessageRole::User);
+    EXPECT_EQ(messages[0].content, "Question");
+    EXPECT_EQ(messages[1].role, MessageRole::Assistant);
+    EXPECT_EQ(messages[1].content, "Answer");
+}
+
+TEST(ConversationImporterTest, ReadsClaudeExport) {
+    auto messages = Import(R"([{"name": "chat", "chat_messages": [
+        {"sender": "human", "text": "Ping"},
+        {"sender": "assistant", "text": "ignored",
+         "content": [{"type": "text", "text": "Pong"}]}]}])");
+
+    ASSERT_EQ(messages.size(), 2u);
+    EXPECT_EQ(messages[0].content, "Ping");
+    EXPECT_EQ(messages[1].role, MessageRole::Assistant);
+    EXPECT_EQ(messages[1].content, "Pong");
+}
+
+TEST(ConversationImporterTest, ReadsJsonLinesInOrderAcrossChunks) {
+    std::string text;
+    const size_t count = 3 * (ConversationImporter::CHUNK_BYTES / 64);
+    for (size_t i = 0; i < count; ++i) {
+        text += R"({"messages": [{"role": "user", "content": ")" +
+                std::to_string(i) + "\"}]}\n";
+    }
+    ASSERT_TRUE(ConversationImporter::is_json_lines(text));
+    ASSERT_GT(text.size(), 2 * ConversationImporter::CHUNK_BYTES);
+
+    auto messages = Import(text, 2);
+    ASSERT_EQ(messages.size(), count);
+    for (size_t i = 0; i < count; i += 997) {
+        EXPECT_EQ(std::string_view(messages[i].content), std::to_string(i));
+    }
+    EXPECT_EQ(std::string_view(messages.back().content), std::to_string(count - 1));
+}
+
+TEST(ConversationImporterTest, ThrowsOnMalformedInput) {
+    EXPECT_THROW(Import(R"([{"role": "user", "content": "x"})"), std::runtime_error);
+    EXPECT_THROW(Import("{\"role\": \"user\"}\n{broken\n"), std::runtime_error);
+}
+
+TEST(ConversationImporterTest, FailedLoadKeepsConversation) {
+    TempDir dir;
+    std::string path = dir.create_file("bad.json", R"([{"role": "user", "content": )");
+    Conversation conversation;
+    conversation.add_user("kept");
+    conversation.load_from_file(path);
+    ASSERT_EQ(conversation.size(), 1u);
+    EXPECT_EQ(conversation.messages()[0].content, "kept");
+}
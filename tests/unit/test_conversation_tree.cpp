@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+#include "models/conversation_tree.hpp"
+
+using namespace llm;
+
+namespace {
+
+Conversation MakeConversation(int turns) {
+    Conversation conversation;
+    conversation.set_system_prompt("system");
+    for (int i = 0; i < turns; ++i) {
+        conversation.add_user("turn " + std::to_string(i));
+    }
+    return conversation;
+}
+
+} // namespace
+
+TEST(ConversationTreeTest, ForkSharesPrefixAndDiverges) {
+    Conversation main = MakeConversation(50);
+    Conversation variant = main.fork(40);
+
+    EXPECT_EQ(variant.size(), 41u);
+    EXPECT_EQ(variant.messages()[40].content.data(), main.messages()[40].content.data());
+
+    variant.add_assistant("variant reply");
+    main.add_assistant("main reply");
+    EXPECT_EQ(variant.messages().back().content, "variant reply");
+    EXPECT_EQ(variant.messages()[40].content, "turn 39");
+    EXPECT_EQ(main.size(), 52u);
+    EXPECT_EQ(main.messages()[41].content, "turn 40");
+    EXPECT_EQ(variant.serialize_messages(), variant.to_json().dump());
+
+    size_t sum = 0;
+    for (size_t i = 0; i < variant.size(); ++i) {
+        sum += variant.message_tokens(i);
+    }
+    EXPECT_EQ(sum, variant.estimate_tokens());
+}
+
+TEST(ConversationTreeTest, ForkAndCheckoutSwapBranches) {
+    ConversationTree tree;
+    Conversation active = MakeConversation(3);
+    EXPECT_EQ(tree.current(), ConversationTree::ROOT_BRANCH);
+
+    ASSERT_TRUE(tree.fork(active, "short", 1));
+    EXPECT_FALSE(tree.fork(active, "short", 1));
+    EXPECT_EQ(tree.current(), "short");
+    EXPECT_EQ(active.size(), 2u);
+    active.add_user("short only");
+
+    ASSERT_TRUE(tree.checkout(active, "main"));
+    EXPECT_EQ(active.size(), 4u);
+    EXPECT_EQ(active.messages().back().content, "turn 2");
+    EXPECT_FALSE(tree.checkout(active, "missing"));
+
+    auto branches = tree.branches(active);
+    ASSERT_EQ(branches.size(), 2u);
+    EXPECT_EQ(branches[0].name, "main");
+    EXPECT_TRUE(branches[0].current);
+    EXPECT_EQ(branches[1].name, "short");
+    EXPECT_EQ(branches[1].parent, "main");
+    EXPECT_EQ(branches[1].fork_turn, 1u);
+    EXPECT_EQ(branches[1].messages, 3u);
+
+    ASSERT_TRUE(tree.checkout(active, "short"));
+    EXPECT_EQ(active.messages().back().content, "short only");
+}
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include "daemon/protocol.hpp"
+#include "daemon/unix_socket.hpp"
+#include "utils/test_helpers.hpp"
+
+using namespace llm;
+using namespace llm::test;
+
+TEST(DaemonProtocolTest, AskRoundTrips) {
+    AskRequest request{"work", "llama-3.1-8b-instant",
+                       std::string("multi\nline \0 prompt", 19)};
+    auto decoded = decode_ask(encode_ask(request));
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(decoded->session, "work");
+    EXPECT_EQ(decoded->model, "llama-3.1-8b-instant");
+    EXPECT_EQ(decoded->prompt, request.prompt);
+}
+
+TEST(DaemonProtocolTest, RejectsMalformedAsk) {
+    std::string payload = encode_ask({"", "", "hello"});
+    EXPECT_FALSE(decode_ask("").has_value());
+    EXPECT_FALSE(decode_ask(payload.substr(0, payload.size() - 1)).has_value());
+    EXPECT_FALSE(decode_ask(payload + "x").has_value());
+
+    payload[0] = static_cast<char>(PROTOCOL_VERSION + 1);
+    EXPECT_FALSE(decode_ask(payload).has_value());
+}
+
+TEST(DaemonProtocolTest, ReaderReassemblesSplitFrames) {
+    std::string stream;
+    append_frame(stream, FrameType::Delta, "Hello");
+    append_frame(stream, FrameType::Delta, ", world");
+    append_frame(stream, FrameType::Done, "");
+
+    // One byte at a time, the worst case for a socket.
+    FrameReader reader;
+    std::vector<Frame> frames;
+    for (char c : stream) {
+        reader.feed(std::string_view(&c, 1));
+        while (auto frame = reader.next()) {
+            frames.push_back(std::move(*frame));
+        }
+    }
+    ASSERT_EQ(frames.size(), 3u);
+    EXPECT_EQ(frames[0].type, FrameType::Delta);
+    EXPECT_EQ(frames[0].payload, "Hello");
+    EXPECT_EQ(frames[1].payload, ", world");
+    EXPECT_EQ(frames[2].type, FrameType::Done);
+    EXPECT_TRUE(frames[2].payload.empty());
+    EXPECT_FALSE(reader.failed());
+}
+
+TEST(DaemonProtocolTest, ReaderFailsOnGarbage) {
+    FrameReader reader;
+    reader.feed(std::string("\x7f\x01\x00\x00\x00x", 6));
+    EXPECT_FALSE(reader.next().has_value());
+    EXPECT_TRUE(reader.failed());
+
+    // Oversized frames are refused before their payload arrives.
+    FrameReader oversized;
+    oversized.feed(std::string("\x02\xff\xff\xff\xff", 5));
+    EXPECT_FALSE(oversized.next().has_value());
+    EXPECT_TRUE(oversized.failed());
+}
+
+TEST(DaemonProtocolTest, FramesCrossAUnixSocket) {
+    std::string dir = TestHelpers::CreateTempDir();
+    std::string path = dir + "/daemon.sock";
+
+    int listener = listen_unix(path);
+    ASSERT_GE(listener, 0);
+
+    std::thread server([listener] {
+        int fd = accept_client(listener);
+        ASSERT_GE(fd, 0);
+        FrameReader reader;
+        char buffer[256];
+        std::optional<Frame> frame;
+        while (!(frame = reader.next())) {
+            long received = receive_some(fd, buffer, sizeof(buffer));
+            ASSERT_GT(received, 0);
+            reader.feed(std::string_view(buffer, received));
+        }
+        auto request = decode_ask(frame->payload);
+        ASSERT_TRUE(request.has_value());
+        std::string out;
+        append_frame(out, FrameType::Delta, "echo: " + request->prompt);
+        append_frame(out, FrameType::Done, "");
+        EXPECT_TRUE(send_all(fd, out));
+        close_socket(fd);
+    });
+
+    int client = connect_unix(path);
+    ASSERT_GE(client, 0);
+    std::string out;
+    append_frame(out, FrameType::Ask, encode_ask({"", "", "ping"}));
+    ASSERT_TRUE(send_all(client, out));
+
+    FrameReader reader;
+    std::string reply;
+    bool done = false;
+    char buffer[256];
+    long received;
+    while (!done && (received = receive_some(client, buffer, sizeof(buffer))) > 0) {
+        reader.feed(std::string_view(buffer, received));
+        while (auto frame = reader.next()) {
+            if (frame->type == FrameType::Delta) {
+                reply += frame->payload;
+            }
+            done = frame->type == FrameType::Done;
+        }
+    }
+    server.join();
+    close_socket(client);
+    // A second daemon must not take over a live socket.
+    EXPECT_LT(listen_unix(path), 0);
+    close_socket(listener);
+
+    EXPECT_TRUE(done);
+    EXPECT_EQ(reply, "echo: ping");
+
+    // Nobody listens any more, so the stale socket file is replaced.
+    int relisten = listen_unix(path);
+    EXPECT_GE(relisten, 0);
+    close_socket(relisten);
+    TestHelpers::CleanupTempPath(dir);
+}
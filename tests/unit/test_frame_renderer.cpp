@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "repl/frame_renderer.hpp"
+
+using namespace llm;
+using namespace std::chrono_literals;
+
+namespace {
+
+class FrameRendererTest : public ::testing::Test {
+protected:
+    FrameRenderer::Writer Writer() {
+        return [this](std::string_view text) { writes_.emplace_back(text); };
+    }
+
+    std::vector<std::string> writes_;
+    FrameRenderer::Clock::time_point start_ = FrameRenderer::Clock::now();
+};
+
+} // namespace
+
+TEST_F(FrameRendererTest, CoalescesChunksWithinAFrame) {
+    FrameRenderer frame(Writer(), 10);  // 100 ms frames
+
+    frame.append("first");
+    ASSERT_TRUE(frame.due(start_));
+    frame.flush(start_);
+
+    frame.append("a");
+    frame.append("b");
+    EXPECT_FALSE(frame.due(start_ + 50ms));
+    frame.append("c");
+    EXPECT_EQ(frame.deadline(), start_ + 100ms);
+    EXPECT_TRUE(frame.due(start_ + 100ms));
+    frame.flush(start_ + 100ms);
+
+    EXPECT_EQ(writes_, (std::vector<std::string>{"first", "abc"}));
+    EXPECT_TRUE(frame.empty());
+    EXPECT_FALSE(frame.due(start_ + 1s));
+}
+
+TEST_F(FrameRendererTest, FinishedLineIsDueAtOnce) {
+    FrameRenderer frame(Writer(), 10);
+    frame.append("x");
+    frame.flush(start_);
+
+    frame.append("end of line\nnext");
+    EXPECT_TRUE(frame.due(start_ + 1ms));
+    frame.flush(start_ + 1ms);
+    frame.append(" part");
+    EXPECT_FALSE(frame.due(start_ + 2ms));
+
+    EXPECT_EQ(writes_, (std::vector<std::string>{"x", "end of line\nnext"}));
+}
+
+TEST_F(FrameRendererTest, ZeroFpsWritesEveryChunk) {
+    FrameRenderer frame(Writer(), 0);
+    frame.append("a");
+    frame.flush(start_);
+    frame.append("b");
+    EXPECT_TRUE(frame.due(start_));
+}
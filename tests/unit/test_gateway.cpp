@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include <string>
+#include "gateway/http_request_parser.hpp"
+#include "gateway/openai_format.hpp"
+
+using namespace llm;
+
+namespace {
+
+nlohmann::json event_json(const std::string &event) {
+    EXPECT_EQ(event.rfind("data: ", 0), 0u);
+    EXPECT_EQ(event.substr(event.size() - 2), "\n\n");
+    return nlohmann::json::parse(event.substr(6, event.size() - 8));
+}
+
+} // namespace
+
+TEST(HttpRequestParserTest, ParsesRequestFedByteByByte) {
+    const std::string request =
+        "POST /v1/chat/completions?x=1 HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 13\r\n"
+        "\r\n"
+        "{\"a\": \"body\"}";
+
+    HttpRequestParser parser;
+    for (size_t i = 0; i + 1 < request.size(); ++i) {
+        ASSERT_EQ(parser.feed(request.substr(i, 1)),
+                  HttpRequestParser::State::Incomplete);
+    }
+    ASSERT_EQ(parser.feed(request.substr(request.size() - 1)),
+              HttpRequestParser::State::Complete);
+    EXPECT_EQ(parser.method(), "POST");
+    EXPECT_EQ(parser.path(), "/v1/chat/completions");
+    EXPECT_EQ(parser.header("content-type"), "application/json");
+    EXPECT_EQ(parser.header("CONTENT-TYPE"), "application/json");
+    EXPECT_EQ(parser.header("missing"), "");
+    EXPECT_EQ(parser.body(), "{\"a\": \"body\"}");
+}
+
+TEST(HttpRequestParserTest, CompletesWithoutBody) {
+    HttpRequestParser parser;
+    EXPECT_EQ(parser.feed("GET /v1/models HTTP/1.1\r\nHost: x\r\n\r\n"),
+              HttpRequestParser::State::Complete);
+    EXPECT_EQ(parser.method(), "GET");
+    EXPECT_EQ(parser.body(), "");
+}
+
+TEST(HttpRequestParserTest, RejectsMalformedAndOversizedRequests) {
+    HttpRequestParser garbage;
+    EXPECT_EQ(garbage.feed("nonsense\r\n\r\n"),
+              HttpRequestParser::State::Invalid);
+
+    HttpRequestParser chunked;
+    EXPECT_EQ(chunked.feed("POST / HTTP/1.1\r\n"
+                           "Transfer-Encoding: chunked\r\n\r\n"),
+              HttpRequestParser::State::Invalid);
+
+    HttpRequestParser huge_body;
+    EXPECT_EQ(huge_body.feed("POST / HTTP/1.1\r\nContent-Length: " +
+                             std::to_string(HttpRequestParser::MAX_BODY_BYTES + 1) +
+                             "\r\n\r\n"),
+              HttpRequestParser::State::TooLarge);
+
+    HttpRequestParser huge_head;
+    EXPECT_EQ(huge_head.feed("GET / HTTP/1.1\r\nX: " +
+                             std::string(HttpRequestParser::MAX_HEAD_BYTES, 'a')),
+              HttpRequestParser::State::TooLarge);
+}
+
+TEST(OpenAiFormatTest, ParsesChatRequest) {
+    std::string error;
+    auto request = parse_chat_request(R"({
+        "model": "llama-3.1-8b-instant",
+        "temperature": 0.2,
+        "max_tokens": 64,
+        "stream": true,
+        "messages": [
+            {"role": "system", "content": "Be brief."},
+            {"role": "user", "content": [{"type": "text", "text": "Hi"},
+                                         {"type": "text", "text": " there"}]},
+            {"role": "assistant", "content": "Hello."},
+            {"role": "user", "content": "Bye"}
+        ]})", error);
+    ASSERT_TRUE(request.has_value()) << error;
+    EXPECT_EQ(request->model, "llama-3.1-8b-instant");
+    ASSERT_TRUE(request->temperature.has_value());
+    EXPECT_FLOAT_EQ(*request->temperature, 0.2f);
+    EXPECT_EQ(request->max_tokens, 64u);
+    EXPECT_TRUE(request->stream);
+
+    auto messages = request->conversation.to_json();
+    ASSERT_EQ(messages.size(), 4u);
+    EXPECT_EQ(messages[0]["role"], "system");
+    EXPECT_EQ(messages[1]["content"], "Hi there");
+    EXPECT_EQ(messages[2]["role"], "assistant");
+    EXPECT_EQ(messages[3]["content"], "Bye");
+}
+
+TEST(OpenAiFormatTest, LeavesUnsetFieldsToTheGateway) {
+    std::string error;
+    auto request = parse_chat_request(
+        R"({"messages": [{"role": "user", "content": "Hi"}]})", error);
+    ASSERT_TRUE(request.has_value()) << error;
+    EXPECT_TRUE(request->model.empty());
+    EXPECT_FALSE(request->temperature.has_value());
+    EXPECT_FALSE(request->max_tokens.has_value());
+    EXPECT_FALSE(request->stream);
+}
+
+TEST(OpenAiFormatTest, RejectsInvalidChatRequests) {
+    for (const char *body : {
+             "not json",
+             "[]",
+             R"({"messages": []})",
+             R"({"messages": [{"role": "user"}]})",
+             R"({"messages": [{"role": "tool", "content": "x"}]})",
+             R"({"messages": [{"role": "user", "content": [{"type": "image_url"}]}]})",
+             R"({"messages": [{"role": "user", "content": "x"}], "stream": "yes"})",
+         }) {
+        std::string error;
+        EXPECT_FALSE(parse_chat_request(body, error).has_value()) << body;
+        EXPECT_FALSE(error.empty()) << body;
+    }
+}
+
+TEST(OpenAiFormatTest, FormatsStreamChunks) {
+    CompletionId id{"chatcmpl-7", "llama-3.1-8b-instant", 1700000000};
+
+    auto delta = event_json(chunk_event(id, "Hel\"lo"));
+    EXPECT_EQ(delta["id"], "chatcmpl-7");
+    EXPECT_EQ(delta["object"], "chat.completion.chunk");
+    EXPECT_EQ(delta["created"], 1700000000);
+    EXPECT_EQ(delta["choices"][0]["delta"]["content"], "Hel\"lo");
+    EXPECT_TRUE(delta["choices"][0]["finish_reason"].is_null());
+
+    auto last = event_json(chunk_event(id, std::nullopt));
+    EXPECT_TRUE(last["choices"][0]["delta"].empty());
+    EXPECT_EQ(last["choices"][0]["finish_reason"], "stop");
+}
+
+TEST(OpenAiFormatTest, FormatsResponses) {
+    CompletionId id{"chatcmpl-1", "m", 1};
+    CompletionResponse response;
+    response.success = true;
+    response.content = "Answer";
+    response.tokens_used = 12;
+    auto body = nlohmann::json::parse(completion_body(id, response));
+    EXPECT_EQ(body["object"], "chat.completion");
+    EXPECT_EQ(body["choices"][0]["message"]["content"], "Answer");
+    EXPECT_EQ(body["usage"]["total_tokens"], 12);
+
+    auto error = nlohmann::json::parse(error_body("Nope", "upstream_error"));
+    EXPECT_EQ(error["error"]["message"], "Nope");
+    EXPECT_EQ(error["error"]["type"], "upstream_error");
+}
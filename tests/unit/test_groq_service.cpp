@@ -241,4 +241,29 @@ TEST_F(GroqServiceMockTest, EmptyApiKey) {
     auto response = service.complete("test");
     EXPECT_FALSE(response.success);
     EXPECT_FALSE(response.error.empty());
-}
\ No newline at end of file
+}
+TEST(GroqServiceCacheTest, OnlyDeterministicRequestsUseTheCache) {
+    auto cache = std::make_shared<ResponseCache>(4);
+    GroqService service(std::make_shared<HttpClientPool>("http://127.0.0.1:1", "key"), cache);
+    Conversation conversation;
+    conversation.add_user("Pick a number");
+
+    nlohmann::json settings;
+    settings["model"] = service.get_current_model();
+    settings["temperature"] = 0.0f;
+    settings["max_tokens"] = 2048;
+    std::string key = settings.dump();
+    key.pop_back();
+    key += R"(,"messages":)" + conversation.serialize_messages() + "}";
+    cache->insert(key, "4");
+
+    std::string reply;
+    service.set_temperature(0.0f);
+    EXPECT_TRUE(service.stream_to(conversation, [](std::string_view) {}, reply));
+    EXPECT_EQ(reply, "4");
+
+    // Sampled replies are neither served from nor added to the cache.
+    service.set_temperature(0.7f);
+    EXPECT_FALSE(service.stream_to(conversation, [](std::string_view) {}, reply));
+    EXPECT_EQ(cache->size(), 1u);
+}
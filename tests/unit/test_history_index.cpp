@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <string>
+#include "repl/history_index.hpp"
+
+using namespace llm;
+
+TEST(HistoryIndexTest, FindsNewestEntryContainingQuery) {
+    HistoryIndex history;
+    history.add("git status");
+    history.add("make test");
+    history.add("git commit -m wip");
+    history.add("ls");
+
+    EXPECT_EQ(history.search("git", history.size()), 2u);
+    EXPECT_EQ(history.search("git", 2), 0u);
+    EXPECT_EQ(history.search("git", 0), std::nullopt);
+    EXPECT_EQ(history.search("tes", history.size()), 1u);
+    EXPECT_EQ(history.search("svn", history.size()), std::nullopt);
+}
+
+TEST(HistoryIndexTest, TrigramsMustAppearInOrder) {
+    HistoryIndex history;
+    // Shares every trigram of "abcab" without containing it.
+    history.add("cabc");
+    EXPECT_EQ(history.search("abcab", history.size()), std::nullopt);
+    history.add("xabcabx");
+    EXPECT_EQ(history.search("abcab", history.size()), 1u);
+}
+
+TEST(HistoryIndexTest, ShortQueriesAndLongEntries) {
+    HistoryIndex history;
+    history.add("a");
+    std::string paste(HistoryIndex::INDEXED_BYTES * 2, 'p');
+    paste += "needle";
+    history.add(paste);
+    history.add("needle in a short one");
+    history.add("zz");
+
+    EXPECT_EQ(history.search("", history.size()), 3u);
+    EXPECT_EQ(history.search("a", history.size()), 2u);
+    EXPECT_EQ(history.search("z", 3), std::nullopt);
+    EXPECT_EQ(history.search("needle", history.size()), 2u);
+    EXPECT_EQ(history.search("needle", 2), 1u);
+    EXPECT_EQ(history.search("pneedle", history.size()), 1u);
+
+    history.clear();
+    EXPECT_TRUE(history.empty());
+    EXPECT_EQ(history.search("needle", 10), std::nullopt);
+}
+
+TEST(HistoryIndexTest, SearchStaysFastWithManyEntries) {
+    HistoryIndex history;
+    for (int i = 0; i < 100000; ++i) {
+        history.add("echo command number " + std::to_string(i) + " --flag");
+    }
+    history.add("curl https://example.com/unique");
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(history.search("example.com", history.size()), 100000u);
+        EXPECT_EQ(history.search("number 4242 ", history.size()), 4242u);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_LT(elapsed, std::chrono::seconds(2));
+}
+
+TEST(HistoryIndexTest, RepeatedCommandsMoveToFront) {
+    HistoryIndex history;
+    history.add("ls");
+    history.add("make");
+    history.add("git log");
+    EXPECT_EQ(history.add("ls"), 3u);
+
+    EXPECT_EQ(history.count(), 3u);
+    EXPECT_TRUE(history.removed(0));
+    EXPECT_EQ(history.find("ls"), 3u);
+    EXPECT_EQ(history.search("l", history.size()), 3u);
+    EXPECT_EQ(history.search("l", 3), 2u);
+    EXPECT_EQ(history.search("", 1), std::nullopt);
+
+    // Renumbered once removed entries outnumber live ones.
+    history.add("make");
+    history.add("git log");
+    history.add("make");
+    EXPECT_EQ(history.count(), 3u);
+    EXPECT_LE(history.size(), 2 * history.count() + 1);
+    std::vector<std::string> live;
+    for (size_t i = 0; i < history.size(); ++i) {
+        if (!history.removed(i)) {
+            live.push_back(history.at(i));
+        }
+    }
+    EXPECT_EQ(live, (std::vector<std::string>{"ls", "git log", "make"}));
+    EXPECT_EQ(history.search("git", history.size()), history.find("git log"));
+}
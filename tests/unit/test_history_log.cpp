@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include "repl/history_log.hpp"
+#include "utils/test_helpers.hpp"
+
+using namespace llm;
+using namespace llm::test;
+
+namespace {
+
+std::vector<std::string> Commands(const HistoryIndex& history) {
+    std::vector<std::string> commands;
+    for (size_t i = 0; i < history.size(); ++i) {
+        if (!history.removed(i)) {
+            commands.push_back(history.at(i));
+        }
+    }
+    return commands;
+}
+
+} // namespace
+
+TEST(HistoryLogTest, AppendsAndReloadsNewestCopies) {
+    TempDir dir;
+    std::string path = dir.path() + "/history";
+    {
+        HistoryLog log(path, 100);
+        HistoryIndex history;
+        ASSERT_TRUE(log.load(history));
+        EXPECT_TRUE(history.empty());
+        for (const char* command : {"ls", "make", "ls", "multi\nline \\n paste"}) {
+            history.add(command);
+            ASSERT_TRUE(log.append(command, history.count()));
+        }
+    }
+
+    std::string contents = TestHelpers::ReadFile(path);
+    EXPECT_EQ(contents.find(HistoryLog::HEADER), 0u);
+
+    HistoryLog log(path, 100);
+    HistoryIndex history;
+    ASSERT_TRUE(log.load(history));
+    EXPECT_EQ(Commands(history),
+              (std::vector<std::string>{"make", "ls", "multi\nline \\n paste"}));
+}
+
+TEST(HistoryLogTest, ConvertsPlainHistoryFiles) {
+    TempDir dir;
+    std::string path = dir.path() + "/history";
+    TestHelpers::WriteFile(path, "one\ntwo\\n\none\nthree\n");
+
+    HistoryLog log(path, 2);
+    HistoryIndex history;
+    ASSERT_TRUE(log.load(history));
+    EXPECT_EQ(Commands(history), (std::vector<std::string>{"one", "three"}));
+    EXPECT_EQ(TestHelpers::ReadFile(path),
+              std::string(HistoryLog::HEADER) + "one\nthree\n");
+}
+
+TEST(HistoryLogTest, IgnoresTornFinalRecord) {
+    TempDir dir;
+    std::string path = dir.path() + "/history";
+    TestHelpers::WriteFile(path, std::string(HistoryLog::HEADER) + "done\nhalf-writ");
+
+    HistoryLog log(path, 100);
+    HistoryIndex history;
+    ASSERT_TRUE(log.load(history));
+    EXPECT_EQ(Commands(history), (std::vector<std::string>{"done"}));
+}
+
+TEST(HistoryLogTest, CompactsOnceStaleRecordsOutnumberLiveOnes) {
+    TempDir dir;
+    std::string path = dir.path() + "/history";
+    HistoryLog log(path, 1000);
+    HistoryIndex history;
+    ASSERT_TRUE(log.load(history));
+    for (int i = 0; i < 500; ++i) {
+        std::string command = "command " + std::to_string(i % 10);
+        history.add(command);
+        ASSERT_TRUE(log.append(command, history.count()));
+    }
+    log.wait();
+
+    auto lines = TestHelpers::SplitString(TestHelpers::ReadFile(path), "\n");
+    EXPECT_LT(lines.size(), 100u);
+
+    HistoryIndex reloaded;
+    ASSERT_TRUE(log.load(reloaded));
+    EXPECT_EQ(Commands(reloaded), Commands(history));
+}
+
+TEST(HistoryLogTest, ConcurrentWritersLoseNothing) {
+    TempDir dir;
+    std::string path = dir.path() + "/history";
+    constexpr int WRITERS = 4;
+    constexpr int COMMANDS = 300;
+
+    // Separate logs stand in for separate processes sharing the file.
+    std::vector<std::thread> writers;
+    for (int w = 0; w < WRITERS; ++w) {
+        writers.emplace_back([&path, w] {
+            HistoryLog log(path, 10000);
+            for (int i = 0; i < COMMANDS; ++i) {
+                // Repeats make compactions run while others append.
+                std::string command = "writer " + std::to_string(w) + " command " +
+                                      std::to_string(i % 50 == 0 ? i : i % 7);
+                ASSERT_TRUE(log.append(command, 10));
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+
+    HistoryLog log(path, 10000);
+    HistoryIndex history;
+    ASSERT_TRUE(log.load(history));
+    for (int w = 0; w < WRITERS; ++w) {
+        for (int i = 0; i < COMMANDS; ++i) {
+            std::string command = "writer " + std::to_string(w) + " command " +
+                                  std::to_string(i % 50 == 0 ? i : i % 7);
+            EXPECT_TRUE(history.find(command).has_value()) << command;
+        }
+    }
+}
@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <fcntl.h>
+#include <future>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "repl/line_editor.hpp"
+
+using namespace llm;
+
+namespace {
+
+// Feeds keystrokes to a LineEditor through a pipe, discarding its output.
+class LineEditorTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(pipe(fds_), 0);
+        null_ = open("/dev/null", O_WRONLY);
+        ASSERT_GE(null_, 0);
+    }
+
+    void TearDown() override {
+        if (fds_[1] >= 0) {
+            close(fds_[1]);
+        }
+        close(fds_[0]);
+        close(null_);
+    }
+
+    void Type(const std::string& keys) {
+        ASSERT_EQ(write(fds_[1], keys.data(), keys.size()),
+                  static_cast<ssize_t>(keys.size()));
+    }
+
+    void EndInput() {
+        close(fds_[1]);
+        fds_[1] = -1;
+    }
+
+    HistoryIndex history_;
+    int fds_[2] = {-1, -1};
+    int null_ = -1;
+};
+
+} // namespace
+
+TEST_F(LineEditorTest, EditsWithCursorKeys) {
+    LineEditor editor(history_, fds_[0], null_);
+    editor.set_interactive(true);
+    Type("helo\x1b[D" "l\r");
+    EXPECT_EQ(editor.read_line("> "), "hello");
+
+    Type("world\x01" "hello \x05!\r");
+    EXPECT_EQ(editor.read_line("> "), "hello world!");
+
+    Type("one two three\x17\x17" "2\x7f" "four\r");
+    EXPECT_EQ(editor.read_line("> "), "one four");
+
+    Type("abc\x03");
+    EXPECT_EQ(editor.read_line("> "), "");
+}
+
+TEST_F(LineEditorTest, CtrlCCallsInterruptHandler) {
+    LineEditor editor(history_, fds_[0], null_);
+    editor.set_interactive(true);
+    int interrupts = 0;
+    editor.set_interrupt_handler([&interrupts] { ++interrupts; });
+
+    Type("abc\x03" "def\r");
+    EXPECT_EQ(editor.read_line("> "), "");
+    EXPECT_EQ(interrupts, 1);
+    EXPECT_EQ(editor.read_line("> "), "def");
+    EXPECT_EQ(interrupts, 1);
+}
+
+TEST_F(LineEditorTest, WalksHistoryWithArrows) {
+    history_.add("first");
+    history_.add("second");
+    LineEditor editor(history_, fds_[0], null_);
+    editor.set_interactive(true);
+
+    Type("draft\x1b[A\x1b[A\r");
+    EXPECT_EQ(editor.read_line("> "), "first");
+
+    Type("draft\x1b[A\x1b[A\x1b[A\x1b[B\x1b[B\x1b[B\r");
+    EXPECT_EQ(editor.read_line("> "), "draft");
+}
+
+TEST_F(LineEditorTest, ReverseSearch) {
+    history_.add("git status");
+    history_.add("make test");
+    history_.add("git commit");
+    LineEditor editor(history_, fds_[0], null_);
+    editor.set_interactive(true);
+
+    Type("\x12git\r");
+    EXPECT_EQ(editor.read_line("> "), "git commit");
+
+    // Ctrl-R again finds the next older match; an arrow accepts it.
+    Type("\x12git\x12\x1b[F!\r");
+    EXPECT_EQ(editor.read_line("> "), "git status!");
+
+    // Ctrl-G restores the line being typed.
+    Type("keep\x12mak\x07\r");
+    EXPECT_EQ(editor.read_line("> "), "keep");
+
+    // Up from an accepted match continues from there.
+    Type("\x12" "commit\x1b[A\r");
+    EXPECT_EQ(editor.read_line("> "), "make test");
+}
+
+TEST_F(LineEditorTest, BracketedPasteIsOneInsertion) {
+    LineEditor editor(history_, fds_[0], null_);
+    editor.set_interactive(true);
+
+    std::string pasted;
+    for (int i = 0; i < 2000; ++i) {
+        pasted += "line " + std::to_string(i) + "\r\n";
+    }
+    Type("say: \x1b[200~" + pasted + "\x1b[201~\r");
+    std::string expected;
+    for (int i = 0; i < 2000; ++i) {
+        expected += "line " + std::to_string(i) + "\n";
+    }
+    EXPECT_EQ(editor.read_line("> "), "say: " + expected);
+}
+
+TEST_F(LineEditorTest, PrintDoesNotWaitForAPasteInProgress) {
+    LineEditor editor(history_, fds_[0], null_);
+    editor.set_interactive(true);
+    auto line = std::async(std::launch::async, [&editor] { return editor.read_line("> "); });
+
+    Type("\x1b[200~first half");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto printed = std::async(std::launch::async, [&editor] { editor.print("note\n"); });
+    EXPECT_EQ(printed.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+
+    Type(" second half\x1b[201~\r");
+    EXPECT_EQ(line.get(), "first half second half");
+}
+
+TEST_F(LineEditorTest, EndOfInput) {
+    LineEditor editor(history_, fds_[0], null_);
+    editor.set_interactive(true);
+    Type("\x04");
+    EXPECT_EQ(editor.read_line("> "), std::nullopt);
+
+    Type("partial");
+    EndInput();
+    EXPECT_EQ(editor.read_line("> "), "partial");
+    EXPECT_EQ(editor.read_line("> "), std::nullopt);
+}
+
+TEST_F(LineEditorTest, ReadsPlainLinesWhenNotInteractive) {
+    LineEditor editor(history_, fds_[0], null_);
+    editor.set_interactive(false);
+    Type("first\nsecond\r\nlast");
+    EndInput();
+    EXPECT_EQ(editor.read_line("> "), "first");
+    EXPECT_EQ(editor.read_line("> "), "second");
+    EXPECT_EQ(editor.read_line("> "), "last");
+    EXPECT_EQ(editor.read_line("> "), std::nullopt);
+}
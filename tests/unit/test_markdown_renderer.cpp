@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "repl/markdown_renderer.hpp"
+
+using namespace llm;
+
+namespace {
+
+std::string Render(std::string_view markdown, size_t chunk = 0) {
+    MarkdownRenderer renderer;
+    std::string out;
+    if (chunk == 0) {
+        renderer.feed(markdown, out);
+    } else {
+        for (size_t i = 0; i < markdown.size(); i += chunk) {
+            renderer.feed(markdown.substr(i, chunk), out);
+        }
+    }
+    renderer.finish(out);
+    return out;
+}
+
+// Drops SGR escape sequences, leaving the visible text.
+std::string StripAnsi(const std::string& text) {
+    std::string plain;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\033') {
+            i = text.find('m', i);
+            continue;
+        }
+        plain += text[i];
+    }
+    return plain;
+}
+
+const char* const DOCUMENT =
+    "# Title\n"
+    "Some **bold**, *italic* and `code` in snake_case_text.\n"
+    "- item one\n"
+    "  * nested item\n"
+    "> quoted\n"
+    "---\n"
+    "| a | b |\n"
+    "|---|---|\n"
+    "| 1 | **2** |\n"
+    "```python\n"
+    "def f(x):  # comment\n"
+    "    return \"s\\\"q\" + 42\n"
+    "```\n"
+    "2 * 3 and a_b_c\n";
+
+} // namespace
+
+TEST(MarkdownRendererTest, RendersBlocksAndInlineStyles) {
+    std::string plain = StripAnsi(Render(DOCUMENT));
+    EXPECT_EQ(plain,
+              "Title\n"
+              "Some bold, italic and code in snake_case_text.\n"
+              "\xe2\x80\xa2 item one\n"
+              "  \xe2\x80\xa2 nested item\n"
+              "\xe2\x94\x82 quoted\n" +
+                  [] {
+                      std::string rule;
+                      for (int i = 0; i < 40; ++i) rule += "\xe2\x94\x80";
+                      return rule;
+                  }() +
+                  "\n"
+                  "\xe2\x94\x82 a \xe2\x94\x82 b \xe2\x94\x82\n"
+                  "\xe2\x94\x9c\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80"
+                  "\xe2\x94\xbc\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80\xe2\x94\xa4\n"
+                  "\xe2\x94\x82 1 \xe2\x94\x82 2 \xe2\x94\x82\n"
+                  "```python\n"
+                  "def f(x):  # comment\n"
+                  "    return \"s\\\"q\" + 42\n"
+                  "```\n"
+                  "2 * 3 and a_b_c\n");
+}
+
+TEST(MarkdownRendererTest, StylesEmphasisAndCode) {
+    std::string out = Render("a **b** *c* `d`");
+    EXPECT_NE(out.find("\033[1mb\033[0m"), std::string::npos);
+    EXPECT_NE(out.find("\033[3mc\033[0m"), std::string::npos);
+    EXPECT_NE(out.find("\033[33md\033[0m"), std::string::npos);
+
+    // Underscores inside words and lone stars are left alone.
+    EXPECT_EQ(Render("snake_case_name and 2 * 3"), "snake_case_name and 2 * 3");
+}
+
+TEST(MarkdownRendererTest, HighlightsCodeBlocks) {
+    std::string out = Render("```cpp\nreturn 42; // done\n```\n");
+    EXPECT_NE(out.find("\033[35mreturn\033[0m"), std::string::npos);
+    EXPECT_NE(out.find("\033[36m42\033[0m"), std::string::npos);
+    EXPECT_NE(out.find("\033[2;3m// done"), std::string::npos);
+
+    // Markdown markers inside code are code.
+    EXPECT_EQ(StripAnsi(Render("```\n# not a heading *x*\n```\n")),
+              "```\n# not a heading *x*\n```\n");
+}
+
+TEST(MarkdownRendererTest, OutputDoesNotDependOnChunking) {
+    const std::string whole = Render(DOCUMENT);
+    for (size_t chunk : {1, 2, 3, 7, 13}) {
+        EXPECT_EQ(Render(DOCUMENT, chunk), whole) << "chunk " << chunk;
+    }
+}
+
+TEST(MarkdownRendererTest, FinishFlushesHeldTextAndResets) {
+    MarkdownRenderer renderer;
+    std::string out;
+    renderer.feed("**unclosed", out);
+    renderer.feed("\n##", out);
+    EXPECT_EQ(StripAnsi(out), "unclosed\n");
+
+    renderer.finish(out);
+    EXPECT_EQ(StripAnsi(out), "unclosed\n##");
+
+    out.clear();
+    renderer.feed("plain", out);
+    renderer.finish(out);
+    EXPECT_EQ(out, "plain");
+}
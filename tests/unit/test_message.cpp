@@ -92,6 +92,27 @@ TEST_F(MessageTest, UnknownRoleDefaultsToUser) {
     EXPECT_EQ(message.content, "Test content");
 }
 
+TEST_F(MessageTest, RoleNamesAreStatic) {
+    static_assert(Message::role_name(MessageRole::System) == "system");
+    EXPECT_EQ(Message::role_name(MessageRole::Assistant), "assistant");
+    EXPECT_EQ(Message::role_from_name("assistant"), MessageRole::Assistant);
+}
+
+TEST_F(MessageTest, RehomingMovesWithinSameResource) {
+    std::pmr::unsynchronized_pool_resource pool;
+    std::string text(100, 'x');
+    Message original(MessageRole::User, text, &pool);
+    const char* data = original.content.data();
+
+    Message moved(std::move(original), &pool);
+    EXPECT_EQ(moved.content.data(), data);
+
+    Message copied(std::move(moved), std::pmr::get_default_resource());
+    EXPECT_NE(copied.content.data(), data);
+    EXPECT_EQ(copied.content, std::string_view(text));
+    EXPECT_EQ(copied.content.get_allocator().resource(), std::pmr::get_default_resource());
+}
+
 TEST_F(MessageTest, EmptyContent) {
     Message empty_message(MessageRole::User, "");
 
@@ -113,7 +134,7 @@ TEST_F(MessageTest, LongContent) {
     EXPECT_EQ(json["content"], long_content);
 
     auto reconstructed = Message::from_json(json);
-    EXPECT_EQ(reconstructed.content, long_content);
+    EXPECT_EQ(reconstructed.content, std::string_view(long_content));
 }
 
 TEST_F(MessageTest, SpecialCharacters) {
@@ -123,7 +144,7 @@ TEST_F(MessageTest, SpecialCharacters) {
     auto json = special_message.to_json();
     auto reconstructed = Message::from_json(json);
 
-    EXPECT_EQ(reconstructed.content, special_content);
+    EXPECT_EQ(reconstructed.content, std::string_view(special_content));
 }
 
 TEST_F(MessageTest, UnicodeContent) {
@@ -133,5 +154,5 @@ TEST_F(MessageTest, UnicodeContent) {
     auto json = unicode_message.to_json();
     auto reconstructed = Message::from_json(json);
 
-    EXPECT_EQ(reconstructed.content, unicode_content);
+    EXPECT_EQ(reconstructed.content, std::string_view(unicode_content));
 }
\ No newline at end of file
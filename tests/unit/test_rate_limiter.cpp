@@ -0,0 +1,42 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include "llm/rate_limiter.hpp"
+
+using namespace llm;
+using namespace std::chrono_literals;
+
+namespace {
+
+std::chrono::milliseconds TimeAcquire(RateLimiter& limiter) {
+    auto started = std::chrono::steady_clock::now();
+    EXPECT_TRUE(limiter.acquire());
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started);
+}
+
+} // namespace
+
+TEST(RateLimiterTest, SpacesRequestsOut) {
+    RateLimiter limiter(1200);  // one every 50ms
+    EXPECT_LT(TimeAcquire(limiter), 25ms);
+    EXPECT_GE(TimeAcquire(limiter), 40ms);
+}
+
+TEST(RateLimiterTest, LetsABurstThrough) {
+    RateLimiter limiter(1200, 3);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_LT(TimeAcquire(limiter), 25ms);
+    }
+    EXPECT_GE(TimeAcquire(limiter), 40ms);
+}
+
+TEST(RateLimiterTest, CancelEndsTheWait) {
+    RateLimiter limiter(1);
+    CancellationToken cancel;
+    EXPECT_TRUE(limiter.acquire(&cancel));
+
+    cancel.cancel();
+    auto started = std::chrono::steady_clock::now();
+    EXPECT_FALSE(limiter.acquire(&cancel));
+    EXPECT_LT(std::chrono::steady_clock::now() - started, 1s);
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include "models/conversation.hpp"
+#include "models/relevance_index.hpp"
+
+using namespace llm;
+
+TEST(RelevanceIndexTest, SplitsLowercaseTerms) {
+    std::vector<std::string> terms;
+    RelevanceIndex::for_each_term("Hello, CMake-3 world! a x86_64", [&terms](std::string_view term) {
+        terms.emplace_back(term);
+    });
+    EXPECT_EQ(terms, (std::vector<std::string>{"hello", "cmake", "world", "x86", "64"}));
+}
+
+TEST(RelevanceIndexTest, RanksMatchingTurnsFirst) {
+    RelevanceIndex index;
+    index.add(1, "How do I configure the CMake build for tests?");
+    index.add(2, "The weather in Paris is sunny today.");
+    index.add(3, "CMake needs enable_testing before add_test.");
+
+    auto scores = index.score("cmake tests");
+    EXPECT_EQ(scores.count(2), 0u);
+    ASSERT_EQ(scores.count(1), 1u);
+    ASSERT_EQ(scores.count(3), 1u);
+    // Turn 1 matches both query terms.
+    EXPECT_GT(scores[1], scores[3]);
+}
+
+TEST(RelevanceIndexTest, RemovedTurnsAreNotScored) {
+    RelevanceIndex index;
+    for (uint64_t seq = 0; seq < 10; ++seq) {
+        index.add(seq, "shared term number " + std::to_string(seq));
+    }
+    for (uint64_t seq = 0; seq < 8; ++seq) {
+        index.remove(seq);
+    }
+
+    EXPECT_EQ(index.size(), 2u);
+    auto scores = index.score("shared");
+    EXPECT_EQ(scores.size(), 2u);
+    EXPECT_EQ(scores.count(8), 1u);
+    EXPECT_EQ(scores.count(9), 1u);
+
+    index.add(9, "replaced content");
+    EXPECT_EQ(index.score("shared").size(), 1u);
+    EXPECT_EQ(index.score("replaced").size(), 1u);
+}
+
+TEST(RelevanceIndexTest, SelectContextPacksRelevantTurns) {
+    Conversation conversation;
+    conversation.set_system_prompt("You are helpful.");
+    conversation.add_user("Tell me about the quokka, a small marsupial.");
+    conversation.add_assistant("The quokka lives on Rottnest Island.");
+    for (int i = 0; i < 40; ++i) {
+        conversation.add_user("Unrelated filler question " + std::to_string(i) + " about cooking pasta");
+        conversation.add_assistant("Boil water, add salt, cook for ten minutes.");
+    }
+    conversation.add_user("Where does the quokka live?");
+
+    size_t budget = 80;
+    auto context = conversation.select_context(budget);
+
+    EXPECT_LE(context.estimate_tokens(), budget);
+    EXPECT_LT(context.size(), conversation.size());
+    EXPECT_EQ(context.messages()[0].role, MessageRole::System);
+    EXPECT_EQ(context.messages().back().content, "Where does the quokka live?");
+
+    bool found = false;
+    for (const auto& msg : context.messages()) {
+        found = found || msg.content == "The quokka lives on Rottnest Island.";
+    }
+    EXPECT_TRUE(found);
+
+    // The source conversation is untouched.
+    EXPECT_EQ(conversation.size(), 84u);
+}
+
+TEST(RelevanceIndexTest, SelectContextReturnsEverythingWhenItFits) {
+    Conversation conversation;
+    conversation.add_user("one");
+    conversation.add_assistant("two");
+    auto context = conversation.select_context(1000);
+    EXPECT_EQ(context.size(), 2u);
+    EXPECT_EQ(context.serialize_messages(), conversation.serialize_messages());
+}
+
+TEST(RelevanceIndexTest, SelectionScalesToLongSessions) {
+    Conversation conversation;
+    for (int i = 0; i < 10000; ++i) {
+        conversation.add_user("turn " + std::to_string(i) + " discussing topic" + std::to_string(i % 97));
+    }
+    conversation.add_user("what did we say about topic42?");
+
+    auto start = std::chrono::steady_clock::now();
+    auto context = conversation.select_context(2000);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_LE(context.estimate_tokens(), 2000u);
+    // Generous bound for unoptimized and sanitizer builds.
+    EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), 200);
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "llm/response_cache.hpp"
+
+using namespace llm;
+
+TEST(ResponseCacheTest, FindsWhatWasInserted) {
+    ResponseCache cache(4);
+    EXPECT_FALSE(cache.find("request").has_value());
+
+    cache.insert("request", "reply");
+    ASSERT_TRUE(cache.find("request").has_value());
+    EXPECT_EQ(*cache.find("request"), "reply");
+    EXPECT_FALSE(cache.find("other request").has_value());
+
+    cache.insert("request", "newer reply");
+    EXPECT_EQ(*cache.find("request"), "newer reply");
+    EXPECT_EQ(cache.size(), 1u);
+}
+
+TEST(ResponseCacheTest, DropsLeastRecentlyUsed) {
+    ResponseCache cache(2);
+    cache.insert("a", "1");
+    cache.insert("b", "2");
+    // Using "a" makes "b" the oldest.
+    EXPECT_TRUE(cache.find("a").has_value());
+    cache.insert("c", "3");
+
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_TRUE(cache.find("a").has_value());
+    EXPECT_FALSE(cache.find("b").has_value());
+    EXPECT_TRUE(cache.find("c").has_value());
+}
+
+TEST(ResponseCacheTest, ZeroCapacityKeepsNothing) {
+    ResponseCache cache(0);
+    cache.insert("request", "reply");
+    EXPECT_FALSE(cache.find("request").has_value());
+    EXPECT_EQ(cache.size(), 0u);
+}
+
+TEST(ResponseCacheTest, SharedBetweenThreads) {
+    ResponseCache cache(16);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&cache, t] {
+            for (int i = 0; i < 1000; ++i) {
+                std::string key = std::to_string((t * 1000 + i) % 32);
+                if (!cache.find(key)) {
+                    cache.insert(key, "reply " + key);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(cache.size(), 16u);
+    for (int i = 0; i < 32; ++i) {
+        auto reply = cache.find(std::to_string(i));
+        if (reply) {
+            EXPECT_EQ(*reply, "reply " + std::to_string(i));
+        }
+    }
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include "models/conversation.hpp"
+#include "search/search_index.hpp"
+#include "search/search_indexer.hpp"
+#include "utils/test_helpers.hpp"
+
+using namespace llm;
+using namespace llm::test;
+
+TEST(SearchIndexTest, RanksMatchingTurns) {
+    SearchIndex index;
+    index.add_turn("s", MessageRole::User, "How do I reverse a linked list?");
+    index.add_turn("s", MessageRole::Assistant, "Walk the list and flip each next pointer.");
+    index.add_turn("s", MessageRole::User, "Thanks! Now explain quicksort.");
+
+    auto hits = index.search("linked list");
+    ASSERT_EQ(hits.size(), 2u);
+    EXPECT_EQ(hits[0].turn, 0u);
+    EXPECT_EQ(hits[0].role, MessageRole::User);
+    EXPECT_EQ(hits[1].turn, 1u);
+    EXPECT_TRUE(index.search("mergesort").empty());
+}
+
+TEST(SearchIndexTest, PhrasesMustAppearInOrder) {
+    SearchIndex index;
+    index.add_turn("s", MessageRole::User, "the quick brown fox");
+    index.add_turn("s", MessageRole::User, "brown and quick, not a fox");
+
+    auto hits = index.search("\"quick brown\"");
+    ASSERT_EQ(hits.size(), 1u);
+    EXPECT_EQ(hits[0].turn, 0u);
+    EXPECT_EQ(index.search("fox \"brown quick\"").size(), 0u);
+}
+
+TEST(SearchIndexTest, ReportsIdenticalTurnsOnce) {
+    SearchIndex index;
+    index.add_turn("a", MessageRole::User, "duplicate question");
+    index.add_turn("b", MessageRole::User, "duplicate question");
+    EXPECT_EQ(index.search("duplicate").size(), 1u);
+}
+
+TEST(SearchIndexTest, PersistsSnapshotAndAppendedTurns) {
+    TempDir dir;
+    std::string path = dir.path() + "/search.index";
+    {
+        SearchIndex index;
+        index.add_turn("s", MessageRole::User, "alpha beta gamma");
+        ASSERT_TRUE(index.save(path));
+        ASSERT_TRUE(SearchIndex::append_turn(path, "s", MessageRole::Assistant, "delta epsilon"));
+    }
+
+    SearchIndex loaded;
+    ASSERT_TRUE(loaded.load(path));
+    EXPECT_EQ(loaded.size(), 2u);
+    EXPECT_EQ(loaded.search("\"beta gamma\"").size(), 1u);
+    auto hits = loaded.search("epsilon");
+    ASSERT_EQ(hits.size(), 1u);
+    EXPECT_EQ(hits[0].turn, 1u);
+}
+
+TEST(SearchIndexTest, ReindexesChangedFiles) {
+    TempDir dir;
+    std::string path = dir.path() + "/chat.json";
+    Conversation conversation;
+    conversation.add_user("first draft about penguins");
+    conversation.save_to_file(path);
+
+    SearchIndex index;
+    ASSERT_TRUE(index.index_file(path));
+    EXPECT_EQ(index.search("penguins").size(), 1u);
+
+    conversation.clear();
+    conversation.add_user("second draft about walruses");
+    conversation.save_to_file(path);
+    std::filesystem::last_write_time(
+        path, std::filesystem::last_write_time(path) + std::chrono::seconds(5));
+    EXPECT_EQ(index.refresh(), 1u);
+
+    EXPECT_TRUE(index.search("penguins").empty());
+    ASSERT_EQ(index.search("walruses").size(), 1u);
+    EXPECT_EQ(index.search("walruses")[0].source, path);
+    EXPECT_EQ(index.size(), 1u);
+}
+
+TEST(SearchIndexTest, IndexerUpdatesInBackground) {
+    TempDir dir;
+    std::string path = dir.path() + "/search.index";
+    {
+        SearchIndexer indexer(path);
+        indexer.add_turn("session", MessageRole::User, "background indexing works");
+        indexer.wait_idle();
+        EXPECT_FALSE(indexer.loading());
+        EXPECT_EQ(indexer.search("indexing").size(), 1u);
+    }
+
+    SearchIndexer reopened(path);
+    reopened.wait_idle();
+    EXPECT_EQ(reopened.search("background").size(), 1u);
+}
+
+TEST(SearchIndexTest, KeepsFileTurnsOutOfTheIndexFile) {
+    TempDir dir;
+    std::string chat = dir.path() + "/chat.json";
+    std::string path = dir.path() + "/search.index";
+    Conversation conversation;
+    conversation.add_user("notes about narwhals and their tusks");
+    conversation.save_to_file(chat);
+    {
+        SearchIndex index;
+        ASSERT_TRUE(index.index_file(chat));
+        ASSERT_TRUE(index.save(path));
+    }
+    std::ifstream file(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(file)), {});
+    EXPECT_EQ(bytes.find("narwhals and their"), std::string::npos);
+
+    SearchIndex loaded;
+    ASSERT_TRUE(loaded.load(path));
+    auto hits = loaded.search("narwhals");
+    ASSERT_EQ(hits.size(), 1u);
+    EXPECT_EQ(hits[0].snippet, "notes about narwhals and their tusks");
+
+    // A re-indexed file is recorded, not snapshotted, and read again on
+    // refresh.
+    ASSERT_TRUE(SearchIndex::append_file(path, chat));
+    ASSERT_TRUE(loaded.load(path));
+    EXPECT_EQ(loaded.records(), 1u);
+    EXPECT_TRUE(loaded.search("narwhals").empty());
+    EXPECT_EQ(loaded.refresh(), 1u);
+    EXPECT_EQ(loaded.search("narwhals").size(), 1u);
+}
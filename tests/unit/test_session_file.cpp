@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include "models/conversation.hpp"
+#include "models/session_file.hpp"
+#include "utils/test_helpers.hpp"
+
+using namespace llm;
+using namespace llm::test;
+
+namespace {
+
+Conversation MakeConversation() {
+    Conversation conversation;
+    conversation.set_system_prompt("You are terse.");
+    conversation.add_user("Unicode: 你好 \"quoted\"\n");
+    conversation.add_assistant(std::string(5000, 'x'));
+    conversation.add_user("");
+    return conversation;
+}
+
+} // namespace
+
+TEST(SessionFileTest, RoundTripsThroughConversation) {
+    TempDir dir;
+    std::string path = dir.path() + "/chat" + SessionFile::EXTENSION;
+    Conversation original = MakeConversation();
+    original.save_to_file(path);
+
+    EXPECT_TRUE(SessionFile::is_session_file(path));
+    Conversation loaded;
+    loaded.load_from_file(path);
+
+    EXPECT_EQ(loaded.serialize_messages(), original.serialize_messages());
+    EXPECT_EQ(loaded.estimate_tokens(), original.estimate_tokens());
+}
+
+TEST(SessionFileTest, ReadsMessagesLazilyWithStoredCounts) {
+    TempDir dir;
+    std::string path = dir.path() + "/chat.session";
+    Conversation original = MakeConversation();
+    ASSERT_TRUE(SessionFile::write(path, original));
+
+    SessionFile file;
+    ASSERT_TRUE(file.open(path));
+    ASSERT_EQ(file.size(), 4u);
+    EXPECT_EQ(file.tokenizer(), original.tokenizer().name());
+    EXPECT_EQ(file.role(2), MessageRole::Assistant);
+    EXPECT_EQ(file.content(1), "Unicode: 你好 \"quoted\"\n");
+    EXPECT_EQ(file.content(3), "");
+    EXPECT_EQ(file.tokens(2), original.message_tokens(2));
+}
+
+TEST(SessionFileTest, JsonStillUsedForOtherExtensions) {
+    TempDir dir;
+    std::string path = dir.path() + "/chat.json";
+    MakeConversation().save_to_file(path);
+
+    EXPECT_FALSE(SessionFile::is_session_file(path));
+    Conversation loaded;
+    loaded.load_from_file(path);
+    EXPECT_EQ(loaded.size(), 4u);
+}
+
+TEST(SessionFileTest, RejectsTruncatedFiles) {
+    TempDir dir;
+    std::string path = dir.path() + "/chat.session";
+    ASSERT_TRUE(SessionFile::write(path, MakeConversation()));
+
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    for (size_t cut : {size_t{10}, SessionFile::HEADER_SIZE + 8, bytes.size() - 100}) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), cut);
+        SessionFile file;
+        EXPECT_FALSE(file.open(path)) << "cut at " << cut;
+    }
+}
+
+TEST(SessionFileTest, LoadLeavesOlderTurnsInTheFile) {
+    TempDir dir;
+    std::string path = dir.path() + "/long.session";
+    Conversation original;
+    original.set_system_prompt("system");
+    for (int i = 0; i < 50; ++i) {
+        original.add_user("question " + std::to_string(i));
+        original.add_assistant("answer " + std::to_string(i));
+    }
+    original.save_to_file(path);
+
+    Conversation loaded;
+    loaded.load_from_file(path);
+    EXPECT_EQ(loaded.spilled_turns(), 3 * ContextStore::CHUNK_SIZE);
+    EXPECT_LT(loaded.resident_bytes(), 300u);
+    EXPECT_EQ(loaded.estimate_tokens(), original.estimate_tokens());
+
+    // Saving over the file replaces it; the loaded turns still read the old one.
+    Conversation other;
+    other.add_user("other");
+    other.save_to_file(path);
+    EXPECT_EQ(loaded.messages()[1].content, "question 0");
+    loaded.add_user("more");
+    EXPECT_EQ(loaded.messages()[100].content, "answer 49");
+    original.add_user("more");
+    EXPECT_EQ(loaded.serialize_messages(), original.serialize_messages());
+}
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include "models/conversation.hpp"
+#include "models/session_journal.hpp"
+#include "models/session_store.hpp"
+#include "utils/test_helpers.hpp"
+
+using namespace llm;
+using namespace llm::test;
+
+TEST(SessionJournalTest, RecoversRecordedMessages) {
+    TempDir dir;
+    std::string path = dir.path() + "/session.journal";
+    {
+        SessionJournal journal(path);
+        journal.record_system("Be brief.");
+        journal.record_message(MessageRole::User, "Hello");
+        journal.record_message(MessageRole::Assistant, "Hi 你好");
+        journal.record_system("Be verbose.");
+        EXPECT_TRUE(journal.flush());
+    }
+
+    SessionJournal journal(path);
+    Conversation recovered;
+    EXPECT_EQ(journal.recover(recovered), 4u);
+    ASSERT_EQ(recovered.size(), 3u);
+    EXPECT_EQ(recovered.messages()[0].content, "Be verbose.");
+    EXPECT_EQ(recovered.messages()[2].content, "Hi 你好");
+}
+
+TEST(SessionJournalTest, NothingToRecoverWithoutJournal) {
+    TempDir dir;
+    SessionJournal journal(dir.path() + "/session.journal");
+    Conversation conversation;
+    EXPECT_FALSE(journal.recover(conversation).has_value());
+}
+
+TEST(SessionJournalTest, DropsTornTail) {
+    TempDir dir;
+    std::string path = dir.path() + "/session.journal";
+    {
+        SessionJournal journal(path);
+        journal.record_message(MessageRole::User, "first");
+        journal.record_message(MessageRole::User, "second");
+        journal.flush();
+    }
+    auto full = std::filesystem::file_size(path);
+    std::filesystem::resize_file(path, full - 3);
+
+    SessionJournal journal(path);
+    Conversation recovered;
+    EXPECT_EQ(journal.recover(recovered), 1u);
+    EXPECT_EQ(recovered.messages()[0].content, "first");
+
+    // New records go after the last intact one.
+    journal.record_message(MessageRole::Assistant, "third");
+    journal.flush();
+    SessionJournal reread(path);
+    Conversation again;
+    EXPECT_EQ(reread.recover(again), 2u);
+    EXPECT_EQ(again.messages()[1].content, "third");
+}
+
+TEST(SessionJournalTest, CheckpointReplacesHistory) {
+    TempDir dir;
+    std::string path = dir.path() + "/session.journal";
+    Conversation live;
+    live.set_system_prompt("System");
+    live.add_user("kept");
+    {
+        SessionJournal journal(path);
+        for (int i = 0; i < 100; ++i) {
+            journal.record_message(MessageRole::User, "superseded");
+        }
+        journal.checkpoint(live);
+        journal.record_message(MessageRole::Assistant, "after");
+        EXPECT_TRUE(journal.flush());
+    }
+
+    SessionJournal journal(path);
+    Conversation recovered;
+    EXPECT_EQ(journal.recover(recovered), 3u);
+    EXPECT_EQ(recovered.to_string(), "[System] System\n\n[User] kept\n\n[Assistant] after\n\n");
+    EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+}
+
+TEST(SessionJournalTest, RemoveDeletesJournal) {
+    TempDir dir;
+    std::string path = dir.path() + "/session.journal";
+    SessionJournal journal(path);
+    journal.record_message(MessageRole::User, "Hello");
+    journal.flush();
+    ASSERT_TRUE(std::filesystem::exists(path));
+
+    journal.remove();
+    journal.record_message(MessageRole::User, "ignored");
+    EXPECT_TRUE(journal.flush());
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
+
+TEST(SessionJournalTest, AcquireIsExclusiveAcrossCheckpoints) {
+    TempDir dir;
+    std::string path = dir.path() + "/session.journal";
+    Conversation live;
+    live.add_user("mine");
+
+    SessionJournal owner(path);
+    ASSERT_TRUE(owner.acquire());
+    Conversation nothing;
+    EXPECT_FALSE(owner.recover(nothing).has_value());
+
+    SessionJournal other(path);
+    EXPECT_FALSE(other.acquire());
+    owner.checkpoint(live);
+    owner.record_message(MessageRole::Assistant, "reply");
+    ASSERT_TRUE(owner.flush());
+    EXPECT_FALSE(other.acquire());
+
+    owner.remove();
+    EXPECT_FALSE(std::filesystem::exists(path));
+    EXPECT_TRUE(other.acquire());
+}
+
+TEST(SessionJournalTest, LargeMessagesAreJournaledAsBlobs) {
+    TempDir dir;
+    std::string path = dir.path() + "/session.journal";
+    BlobStore blobs(dir.path() + "/blobs");
+    std::string document(BlobStore::MIN_BLOB_BYTES * 8, 'd');
+    Conversation live;
+    live.add_user(document);
+    {
+        SessionJournal journal(path, &blobs);
+        journal.record_message(MessageRole::User, document);
+        journal.record_message(MessageRole::User, "small");
+        journal.checkpoint(live);
+        journal.record_message(MessageRole::Assistant, document);
+        EXPECT_TRUE(journal.flush());
+    }
+    EXPECT_EQ(blobs.blobs_written(), 1u);
+    EXPECT_LT(std::filesystem::file_size(path), document.size());
+
+    SessionJournal journal(path, &blobs);
+    Conversation recovered;
+    EXPECT_EQ(journal.recover(recovered), 2u);
+    ASSERT_EQ(recovered.size(), 2u);
+    EXPECT_EQ(std::string_view(recovered.messages()[1].content), document);
+
+    // Without the blob the record is treated as a corrupt tail.
+    blobs.erase(ContentHash::of(document));
+    SessionJournal orphaned(path, &blobs);
+    EXPECT_EQ(orphaned.recover(recovered), 0u);
+}
+
+TEST(SessionJournalTest, CollectionKeepsBlobsOfEveryJournal) {
+    TempDir dir;
+    SessionStore store(dir.path() + "/sessions");
+    std::string shared = dir.path() + "/session.journal";
+    std::string crashed = dir.path() + "/session.4242.journal";
+    std::string live_doc(BlobStore::MIN_BLOB_BYTES * 2, 'l');
+    std::string crashed_doc(BlobStore::MIN_BLOB_BYTES * 2, 'c');
+    std::string orphan(BlobStore::MIN_BLOB_BYTES * 2, 'o');
+    ASSERT_TRUE(store.blobs().put(orphan));
+
+    // A REPL still running holds the shared journal; another crashed while
+    // using its per-process one.
+    SessionJournal live(shared, &store.blobs());
+    ASSERT_TRUE(live.acquire());
+    live.record_message(MessageRole::User, live_doc);
+    ASSERT_TRUE(live.flush());
+    {
+        SessionJournal journal(crashed, &store.blobs());
+        journal.record_message(MessageRole::User, crashed_doc);
+        ASSERT_TRUE(journal.flush());
+    }
+
+    auto candidates = SessionJournal::candidates(shared);
+    ASSERT_EQ(candidates.size(), 2u);
+    std::vector<ContentHash> pinned;
+    for (const auto &candidate : candidates) {
+        auto hashes = SessionJournal::blob_references(candidate);
+        ASSERT_TRUE(hashes.has_value());
+        pinned.insert(pinned.end(), hashes->begin(), hashes->end());
+    }
+    EXPECT_EQ(store.collect_garbage(pinned), 1u);
+    EXPECT_FALSE(store.blobs().contains(ContentHash::of(orphan)));
+
+    SessionJournal journal(crashed, &store.blobs());
+    Conversation recovered;
+    EXPECT_EQ(journal.recover(recovered), 1u);
+    ASSERT_EQ(recovered.size(), 1u);
+    EXPECT_EQ(std::string_view(recovered.messages()[0].content), crashed_doc);
+    EXPECT_TRUE(store.blobs().contains(ContentHash::of(live_doc)));
+}
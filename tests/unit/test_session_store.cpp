@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <string>
+#include "models/blob_store.hpp"
+#include "models/conversation.hpp"
+#include "models/session_store.hpp"
+#include "utils/test_helpers.hpp"
+
+using namespace llm;
+using namespace llm::test;
+
+namespace {
+
+std::string large(char fill) {
+    return std::string(BlobStore::MIN_BLOB_BYTES * 4, fill);
+}
+
+} // namespace
+
+TEST(ContentHashTest, MatchesMurmurHash3) {
+    EXPECT_EQ(ContentHash::of("").hex(), std::string(32, '0'));
+    EXPECT_EQ(ContentHash::of("hello").hex(),
+              "cbd8a7b341bd9b025b1e906a48ae1d19");
+    EXPECT_NE(ContentHash::of("hello"), ContentHash::of("hellp"));
+}
+
+TEST(ContentHashTest, HexRoundTrip) {
+    auto hash = ContentHash::of("The quick brown fox jumps over the lazy dog");
+    EXPECT_EQ(ContentHash::from_hex(hash.hex()), hash);
+    EXPECT_FALSE(ContentHash::from_hex("xyz").has_value());
+    EXPECT_FALSE(ContentHash::from_hex(std::string(32, 'G')).has_value());
+}
+
+TEST(BlobStoreTest, WritesEachContentOnce) {
+    TempDir dir;
+    BlobStore blobs(dir.path());
+    auto first = blobs.put(large('a'));
+    auto again = blobs.put(large('a'));
+    ASSERT_TRUE(first.has_value());
+    EXPECT_EQ(first, again);
+    EXPECT_EQ(blobs.blobs_written(), 1u);
+    EXPECT_EQ(blobs.get(*first), large('a'));
+
+    // A second instance finds the blob on disk.
+    BlobStore reopened(dir.path());
+    EXPECT_TRUE(reopened.put(large('a')).has_value());
+    EXPECT_EQ(reopened.blobs_written(), 0u);
+    EXPECT_EQ(reopened.list().size(), 1u);
+
+    EXPECT_TRUE(reopened.erase(*first));
+    EXPECT_FALSE(reopened.contains(*first));
+    EXPECT_FALSE(reopened.get(*first).has_value());
+}
+
+TEST(SessionStoreTest, SaveAndLoadRoundTrip) {
+    TempDir dir;
+    SessionStore store(dir.path());
+    Conversation conversation;
+    conversation.set_system_prompt(large('s'));
+    conversation.add_user("short question");
+    conversation.add_assistant(large('x'));
+    ASSERT_TRUE(store.save("chat-1", conversation));
+
+    SessionStore reopened(dir.path());
+    EXPECT_EQ(reopened.names(), std::vector<std::string>{"chat-1"});
+    Conversation loaded;
+    loaded.add_user("replaced");
+    ASSERT_TRUE(reopened.load("chat-1", loaded));
+    ASSERT_EQ(loaded.size(), 3u);
+    EXPECT_EQ(loaded.messages()[0].role, MessageRole::System);
+    EXPECT_EQ(std::string_view(loaded.messages()[0].content), large('s'));
+    EXPECT_EQ(std::string_view(loaded.messages()[1].content), "short question");
+    EXPECT_EQ(std::string_view(loaded.messages()[2].content), large('x'));
+    EXPECT_EQ(loaded.estimate_tokens(), conversation.estimate_tokens());
+}
+
+TEST(SessionStoreTest, SharedContentIsStoredOnce) {
+    TempDir dir;
+    SessionStore store(dir.path());
+    Conversation first;
+    first.set_system_prompt(large('s'));
+    first.add_user(large('d'));
+    ASSERT_TRUE(store.save("first", first));
+    EXPECT_EQ(store.blobs().blobs_written(), 2u);
+
+    Conversation second = first;
+    second.add_assistant(large('a'));
+    ASSERT_TRUE(store.save("second", second));
+    EXPECT_EQ(store.blobs().blobs_written(), 3u);
+    EXPECT_EQ(store.ref_count(ContentHash::of(large('s'))), 2u);
+    EXPECT_EQ(store.ref_count(ContentHash::of(large('a'))), 1u);
+}
+
+TEST(SessionStoreTest, GarbageCollectsUnreferencedBlobs) {
+    TempDir dir;
+    {
+        SessionStore store(dir.path());
+        Conversation conversation;
+        conversation.add_user(large('k'));
+        conversation.add_assistant(large('g'));
+        ASSERT_TRUE(store.save("doomed", conversation));
+        Conversation kept;
+        kept.add_user(large('k'));
+        ASSERT_TRUE(store.save("kept", kept));
+        store.blobs().put(large('p'));
+
+        EXPECT_TRUE(store.remove("doomed"));
+        EXPECT_EQ(store.ref_count(ContentHash::of(large('g'))), 0u);
+        EXPECT_EQ(store.collect_garbage({ContentHash::of(large('p'))}), 1u);
+    }
+
+    // Counts are rebuilt from the manifests.
+    SessionStore store(dir.path());
+    EXPECT_EQ(store.ref_count(ContentHash::of(large('k'))), 1u);
+    EXPECT_EQ(store.collect_garbage(), 1u);
+    Conversation loaded;
+    EXPECT_TRUE(store.load("kept", loaded));
+    EXPECT_FALSE(store.load("doomed", loaded));
+}
+
+TEST(SessionStoreTest, PutRewritesBlobsCollectedElsewhere) {
+    TempDir dir;
+    BlobStore writer(dir.path());
+    BlobStore collector(dir.path());
+    auto hash = writer.put(large('c'));
+    ASSERT_TRUE(hash);
+
+    EXPECT_EQ(collector.collect([](const ContentHash&) { return false; }), 1u);
+    EXPECT_FALSE(writer.contains(*hash));
+    ASSERT_TRUE(writer.put(large('c')));
+    EXPECT_EQ(writer.get(*hash), large('c'));
+    EXPECT_EQ(writer.blobs_written(), 2u);
+}
+
+TEST(SessionStoreTest, OverwriteReleasesOldReferences) {
+    TempDir dir;
+    SessionStore store(dir.path());
+    Conversation conversation;
+    conversation.add_user(large('1'));
+    ASSERT_TRUE(store.save("chat", conversation));
+    conversation.clear();
+    conversation.add_user(large('2'));
+    ASSERT_TRUE(store.save("chat", conversation));
+
+    EXPECT_EQ(store.ref_count(ContentHash::of(large('1'))), 0u);
+    EXPECT_EQ(store.ref_count(ContentHash::of(large('2'))), 1u);
+    EXPECT_EQ(store.collect_garbage(), 1u);
+}
+
+TEST(SessionStoreTest, MissingBlobLeavesConversationUnchanged) {
+    TempDir dir;
+    SessionStore store(dir.path());
+    Conversation conversation;
+    conversation.add_user(large('m'));
+    ASSERT_TRUE(store.save("chat", conversation));
+    store.blobs().erase(ContentHash::of(large('m')));
+
+    Conversation target;
+    target.add_user("untouched");
+    EXPECT_FALSE(store.load("chat", target));
+    ASSERT_EQ(target.size(), 1u);
+    EXPECT_EQ(std::string_view(target.messages()[0].content), "untouched");
+}
+
+TEST(SessionStoreTest, NamesExcludePaths) {
+    EXPECT_TRUE(SessionStore::is_name("project_notes-2"));
+    EXPECT_FALSE(SessionStore::is_name(""));
+    EXPECT_FALSE(SessionStore::is_name("conversation.json"));
+    EXPECT_FALSE(SessionStore::is_name("../escape"));
+    EXPECT_FALSE(SessionStore::is_name("~/chat"));
+}
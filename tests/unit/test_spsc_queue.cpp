@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include "utils/spsc_queue.hpp"
+
+using namespace llm;
+
+TEST(SpscQueueTest, PopsInPushOrder) {
+    SpscQueue<std::string, 4> queue;
+    EXPECT_TRUE(queue.empty());
+    EXPECT_FALSE(queue.try_pop());
+
+    queue.push("a");
+    queue.push("b");
+    EXPECT_FALSE(queue.empty());
+    EXPECT_EQ(queue.pop(), "a");
+    queue.push("c");
+    EXPECT_EQ(queue.try_pop(), "b");
+    EXPECT_EQ(queue.pop(), "c");
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(SpscQueueTest, TryPushKeepsValueWhenFull) {
+    SpscQueue<std::string, 2> queue;
+    std::string value = "one";
+    EXPECT_TRUE(queue.try_push(value));
+    value = "two";
+    EXPECT_TRUE(queue.try_push(value));
+
+    value = "three";
+    EXPECT_FALSE(queue.try_push(value));
+    EXPECT_EQ(value, "three");
+
+    EXPECT_EQ(queue.pop(), "one");
+    EXPECT_TRUE(queue.try_push(value));
+    EXPECT_EQ(queue.pop(), "two");
+    EXPECT_EQ(queue.pop(), "three");
+}
+
+TEST(SpscQueueTest, BlockingCallsHandOverAcrossThreads) {
+    constexpr int COUNT = 100000;
+    SpscQueue<int, 8> queue;
+
+    std::thread producer([&queue] {
+        for (int i = 0; i < COUNT; ++i) {
+            queue.push(i);
+        }
+    });
+
+    int expected = 0;
+    bool in_order = true;
+    while (expected < COUNT) {
+        in_order = in_order && queue.pop() == expected;
+        ++expected;
+    }
+    producer.join();
+
+    EXPECT_TRUE(in_order);
+    EXPECT_TRUE(queue.empty());
+}
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "http/sse_decoder.hpp"
+
+using namespace llm;
+
+namespace {
+
+std::string event(const std::string &content_json) {
+    return "data: {\"id\":\"c1\",\"object\":\"chat.completion.chunk\","
+           "\"choices\":[{\"index\":0,\"delta\":{\"content\":" +
+           content_json + "},\"finish_reason\":null}]}\n\n";
+}
+
+std::vector<std::string> decode(const std::string &stream, size_t piece) {
+    SseDecoder decoder;
+    std::vector<std::string> deltas;
+    auto sink = [&deltas](std::string_view delta) {
+        deltas.emplace_back(delta);
+    };
+    for (size_t i = 0; i < stream.size() && !decoder.done(); i += piece) {
+        decoder.feed(std::string_view(stream).substr(i, piece), sink);
+    }
+    decoder.finish(sink);
+    return deltas;
+}
+
+} // namespace
+
+TEST(SseDecoderTest, DecodesDeltasSplitAnywhere) {
+    const std::string stream = event("\"Hel\"") + event("\"lo\"") +
+                               "data: [DONE]\n\n" + event("\"ignored\"");
+    for (size_t piece : {1, 2, 7, 64, 4096}) {
+        auto deltas = decode(stream, piece);
+        ASSERT_EQ(deltas.size(), 2u) << piece;
+        EXPECT_EQ(deltas[0], "Hel");
+        EXPECT_EQ(deltas[1], "lo");
+    }
+
+    SseDecoder decoder;
+    EXPECT_TRUE(decoder.feed(stream, [](std::string_view) {}));
+    EXPECT_TRUE(decoder.done());
+}
+
+TEST(SseDecoderTest, UnescapesContent) {
+    auto deltas = decode(
+        event(R"("line\nbreak \"quoted\" back\\slash \/ \t tab")") +
+            event(R"("caf\u00e9 \u4f60 \ud83d\ude00")"),
+        5);
+    ASSERT_EQ(deltas.size(), 2u);
+    EXPECT_EQ(deltas[0], "line\nbreak \"quoted\" back\\slash / \t tab");
+    EXPECT_EQ(deltas[1], "caf\xc3\xa9 \xe4\xbd\xa0 \xf0\x9f\x98\x80");
+}
+
+TEST(SseDecoderTest, SkipsEventsWithoutText) {
+    const std::string stream =
+        ": keep-alive comment\n"
+        "event: ping\n"
+        "data: {\"choices\":[{\"delta\":{\"role\":\"assistant\"}}]}\n"
+        "data: {\"choices\":[{\"delta\":{\"content\":null}}]}\n"
+        "data: {\"choices\":[{\"delta\":{},\"finish_reason\":\"stop\"}]}\n"
+        "data: {\"choices\":[]}\n"
+        "data: {\"choices\":[{\"delta\":{\"content\":\"cut\n"
+        "data: {\"choices\":[{\"delta\":{\"content\":\"\\x\"}}]}\n"
+        "data: {\"usage\":{\"total_tokens\":5},\"choices\":[{\"logprobs\":"
+        "{\"a\":[1,2.5e3,true,{\"b\":\"}\"}]},\"delta\":{\"content\":\"ok\"}}]}"
+        "\r\n";
+    auto deltas = decode(stream, 3);
+    ASSERT_EQ(deltas.size(), 1u);
+    EXPECT_EQ(deltas[0], "ok");
+}
+
+TEST(SseDecoderTest, FinishDecodesLastLineWithoutNewline) {
+    SseDecoder decoder;
+    std::string received;
+    auto sink = [&received](std::string_view delta) { received += delta; };
+    EXPECT_FALSE(decoder.feed(
+        "data: {\"choices\":[{\"delta\":{\"content\":\"tail\"}}]}", sink));
+    EXPECT_TRUE(received.empty());
+    EXPECT_FALSE(decoder.finish(sink));
+    EXPECT_EQ(received, "tail");
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "utils/stream_broadcast.hpp"
+
+using namespace llm;
+
+namespace {
+
+std::string read_all(StreamBroadcast::Reader &reader) {
+    std::string text;
+    for (auto run = reader.read(); !run.empty(); run = reader.read()) {
+        text += run;
+    }
+    return text;
+}
+
+} // namespace
+
+TEST(StreamBroadcastTest, ReadersShareTheSameBytes) {
+    StreamBroadcast broadcast;
+    StreamBroadcast::Reader first(broadcast);
+    EXPECT_TRUE(first.try_read().empty());
+    EXPECT_FALSE(first.done());
+
+    broadcast.publish("Hello");
+    broadcast.publish(", world");
+    StreamBroadcast::Reader second(broadcast);
+    auto a = first.try_read();
+    auto b = second.try_read();
+    EXPECT_EQ(a, "Hello, world");
+    // Views of one copy, not copies per reader.
+    EXPECT_EQ(a.data(), b.data());
+    EXPECT_TRUE(first.try_read().empty());
+
+    broadcast.close();
+    EXPECT_TRUE(first.done());
+    EXPECT_TRUE(first.read().empty());
+    EXPECT_EQ(broadcast.str(), "Hello, world");
+    EXPECT_EQ(broadcast.size(), 12u);
+}
+
+TEST(StreamBroadcastTest, LateReaderReplaysFromTheStart) {
+    StreamBroadcast broadcast;
+    std::string expected;
+    // Enough to fill several segments, with deltas that do not fit the
+    // space left in one.
+    for (int i = 0; i < 2000; ++i) {
+        std::string delta = "delta " + std::to_string(i) + ";";
+        broadcast.publish(delta);
+        expected += delta;
+    }
+    broadcast.publish(std::string(StreamBroadcast::SEGMENT_BYTES * 2, 'x'));
+    expected += std::string(StreamBroadcast::SEGMENT_BYTES * 2, 'x');
+
+    StreamBroadcast::Reader late(broadcast);
+    broadcast.publish("end");
+    broadcast.close();
+    expected += "end";
+    EXPECT_EQ(read_all(late), expected);
+    EXPECT_EQ(late.dropped(), 0u);
+    EXPECT_EQ(broadcast.str(), expected);
+}
+
+TEST(StreamBroadcastTest, LaggingReaderSkipsSegments) {
+    StreamBroadcast broadcast;
+    StreamBroadcast::Reader bounded(broadcast, 1024);
+    StreamBroadcast::Reader unbounded(broadcast);
+    const std::string delta(1000, 'a');
+    for (int i = 0; i < 100; ++i) {
+        broadcast.publish(delta);
+    }
+    broadcast.close();
+
+    std::string text = read_all(bounded);
+    EXPECT_GT(bounded.dropped(), 0u);
+    EXPECT_EQ(text.size() + bounded.dropped(), broadcast.size());
+    EXPECT_LE(text.size(), 1024 + StreamBroadcast::SEGMENT_BYTES);
+    // Skipping is per reader.
+    EXPECT_EQ(read_all(unbounded).size(), broadcast.size());
+}
+
+TEST(StreamBroadcastTest, ConcurrentReadersSeeEveryDelta) {
+    StreamBroadcast broadcast;
+    std::string expected;
+    for (int i = 0; i < 20000; ++i) {
+        expected += std::to_string(i) + ",";
+    }
+
+    std::vector<std::string> received(4);
+    std::vector<std::thread> readers;
+    for (auto &text : received) {
+        readers.emplace_back([&broadcast, &text] {
+            StreamBroadcast::Reader reader(broadcast);
+            text = read_all(reader);
+        });
+    }
+    for (int i = 0; i < 20000; ++i) {
+        broadcast.publish(std::to_string(i) + ",");
+    }
+    broadcast.close();
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    for (const auto &text : received) {
+        EXPECT_EQ(text, expected);
+    }
+}
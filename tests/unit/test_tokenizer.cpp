@@ -0,0 +1,201 @@
+#include <gtest/gtest.h>
+#include "models/conversation.hpp"
+#include "tokenizer/bpe_tokenizer.hpp"
+#include "tokenizer/pre_tokenizer.hpp"
+#include "tokenizer/tokenizer_registry.hpp"
+#include "utils/test_helpers.hpp"
+
+using namespace llm;
+using namespace llm::test;
+
+namespace {
+
+std::string Base64(const std::string& in) {
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (unsigned char c : in) {
+        buffer = (buffer << 8) | c;
+        bits += 8;
+        while (bits >= 6) {
+            bits -= 6;
+            out.push_back(alphabet[(buffer >> bits) & 0x3F]);
+        }
+    }
+    if (bits > 0) {
+        out.push_back(alphabet[(buffer << (6 - bits)) & 0x3F]);
+    }
+    while (out.size() % 4 != 0) {
+        out.push_back('=');
+    }
+    return out;
+}
+
+// All single bytes, then the given tokens in priority order.
+std::string MakeRanks(const std::vector<std::string>& merged) {
+    std::string ranks;
+    size_t rank = 0;
+    for (int b = 0; b < 256; ++b) {
+        ranks += Base64(std::string(1, static_cast<char>(b))) + " " + std::to_string(rank++) + "\n";
+    }
+    for (const auto& token : merged) {
+        ranks += Base64(token) + " " + std::to_string(rank++) + "\n";
+    }
+    return ranks;
+}
+
+std::vector<std::string> Split(const std::string& text) {
+    std::vector<std::string> pieces;
+    PreTokenizer::split(text, [&pieces](std::string_view piece) {
+        pieces.emplace_back(piece);
+    });
+    return pieces;
+}
+
+} // namespace
+
+TEST(PreTokenizerTest, SplitsWordsWithLeadingSpace) {
+    EXPECT_EQ(Split("Hello world"), (std::vector<std::string>{"Hello", " world"}));
+}
+
+TEST(PreTokenizerTest, SplitsDigitsInGroupsOfThree) {
+    EXPECT_EQ(Split("12345"), (std::vector<std::string>{"123", "45"}));
+}
+
+TEST(PreTokenizerTest, SplitsContractions) {
+    EXPECT_EQ(Split("don't"), (std::vector<std::string>{"don", "'t"}));
+}
+
+TEST(PreTokenizerTest, WhitespaceRunsLeaveLastSpaceForNextWord) {
+    EXPECT_EQ(Split("a   b"), (std::vector<std::string>{"a", "  ", " b"}));
+    EXPECT_EQ(Split("a\n\nb"), (std::vector<std::string>{"a", "\n\n", "b"}));
+}
+
+TEST(PreTokenizerTest, PunctuationAndCode) {
+    EXPECT_EQ(Split("f(x);\n"), (std::vector<std::string>{"f", "(x", ");\n"}));
+}
+
+TEST(PreTokenizerTest, LongRunsMatchScalarScan) {
+    std::string letters(100, 'a');
+    letters += "\xc3\xa9z!";
+    EXPECT_EQ(Split(letters), (std::vector<std::string>{letters.substr(0, 103), "!"}));
+
+    std::string spaces(40, ' ');
+    EXPECT_EQ(Split(spaces + "x"), (std::vector<std::string>{spaces.substr(1), " x"}));
+}
+
+TEST(BpeTokenizerTest, EmptyVocabularyIsRejected) {
+    EXPECT_EQ(BpeTokenizer::from_ranks("not a rank file", "bad"), nullptr);
+}
+
+TEST(BpeTokenizerTest, OutOfRangeRanksAreIgnored) {
+    auto tokenizer = BpeTokenizer::from_ranks(MakeRanks({"ab"}) + Base64("zz") + " 4000000000\n", "test");
+    ASSERT_NE(tokenizer, nullptr);
+    EXPECT_EQ(tokenizer->vocab_size(), 257u);
+    EXPECT_EQ(tokenizer->decode(tokenizer->encode("abzz")), "abzz");
+}
+
+TEST(BpeTokenizerTest, MergesByRankPriority) {
+    auto tokenizer = BpeTokenizer::from_ranks(MakeRanks({"ab", "abab", "ba"}), "test");
+    ASSERT_NE(tokenizer, nullptr);
+    EXPECT_EQ(tokenizer->vocab_size(), 259u);
+
+    // "abab" is a whole-vocabulary hit.
+    EXPECT_EQ(tokenizer->encode("abab"), (std::vector<TokenId>{257}));
+    // "ab" (rank 256) merges before "ba" (rank 258): ab|ab|a.
+    EXPECT_EQ(tokenizer->encode("ababa"), (std::vector<TokenId>{257, 'a'}));
+    EXPECT_EQ(tokenizer->encode("bab"), (std::vector<TokenId>{'b', 256}));
+}
+
+TEST(BpeTokenizerTest, DecodeRoundTrip) {
+    auto tokenizer = BpeTokenizer::from_ranks(MakeRanks({"he", "ll", "hell", "hello", " w"}), "test");
+    ASSERT_NE(tokenizer, nullptr);
+
+    std::string text = "hello world, \xe4\xbd\xa0\xe5\xa5\xbd {\"k\": 42}\n";
+    auto tokens = tokenizer->encode(text);
+    EXPECT_EQ(tokenizer->decode(tokens), text);
+    EXPECT_EQ(tokenizer->count_tokens(text), tokens.size());
+}
+
+TEST(BpeTokenizerTest, ParallelEncodeMatchesSerial) {
+    auto tokenizer = BpeTokenizer::from_ranks(MakeRanks({"he", "ll", "hello", " w", "or", " world"}), "test");
+    ASSERT_NE(tokenizer, nullptr);
+
+    const std::string unit = "hello world\n";
+    std::string text;
+    while (text.size() < BpeTokenizer::PARALLEL_THRESHOLD * 2) {
+        text += unit;
+    }
+
+    size_t units = text.size() / unit.size();
+    auto tokens = tokenizer->encode(text);
+    EXPECT_EQ(tokens.size(), units * tokenizer->encode(unit).size());
+    EXPECT_EQ(tokenizer->decode(tokens), text);
+}
+
+TEST(BpeTokenizerTest, LoadFromMappedFile) {
+    TempFile file(MakeRanks({"ab"}));
+    auto tokenizer = BpeTokenizer::load(file.path(), "mapped");
+    ASSERT_NE(tokenizer, nullptr);
+    EXPECT_EQ(tokenizer->name(), "mapped");
+    EXPECT_EQ(tokenizer->encode("ab"), (std::vector<TokenId>{256}));
+
+    EXPECT_EQ(BpeTokenizer::load("/nonexistent/vocab.tiktoken", "missing"), nullptr);
+}
+
+TEST(BpeTokenizerTest, BytesMissingFromVocabularyGetNoTokenId) {
+    // Only 'a' and 'b', ranked well above their byte values.
+    std::string ranks = Base64("a") + " 300\n" + Base64("b") + " 301\n";
+    auto tokenizer = BpeTokenizer::from_ranks(ranks, "partial");
+    ASSERT_NE(tokenizer, nullptr);
+    EXPECT_EQ(tokenizer->encode("acb"), (std::vector<TokenId>{300, 301}));
+    EXPECT_EQ(tokenizer->count_tokens("acb"), 3u);
+}
+
+TEST(ApproximateTokenizerTest, CountsScriptsDifferently) {
+    ApproximateTokenizer tokenizer;
+    EXPECT_EQ(tokenizer.count_tokens(""), 0u);
+    EXPECT_EQ(tokenizer.count_tokens("Hello world"), 2u);
+
+    // Eight CJK characters are far more than 24 bytes / 4.
+    std::string cjk = "\xe4\xbd\xa0\xe5\xa5\xbd\xe4\xb8\x96\xe7\x95\x8c"
+                      "\xe4\xbd\xa0\xe5\xa5\xbd\xe4\xb8\x96\xe7\x95\x8c";
+    EXPECT_GE(tokenizer.count_tokens(cjk), 8u);
+
+    std::string json = "{\"a\":1,\"b\":[2,3]}";
+    EXPECT_GT(tokenizer.count_tokens(json), json.size() / 4);
+}
+
+TEST(TokenizerRegistryTest, FamilyFromModelInfo) {
+    EXPECT_EQ(TokenizerRegistry::family_for({"llama-3.1-8b-instant", "", 0, true}), "llama3");
+    EXPECT_EQ(TokenizerRegistry::family_for({"mixtral-8x7b-32768", "", 0, true}), "mistral");
+    EXPECT_EQ(TokenizerRegistry::family_for({"custom", "", 0, true, "cl100k"}), "cl100k");
+    EXPECT_EQ(TokenizerRegistry::family_for({"unknown", "", 0, true}), "default");
+}
+
+TEST(TokenizerRegistryTest, LoadsVocabularyFromDirectory) {
+    TempDir dir;
+    dir.create_file("llama3.tiktoken", MakeRanks({"ab"}));
+
+    TokenizerRegistry registry(dir.path());
+    auto llama = registry.for_model({"llama-3.3-70b-versatile", "", 131072, true, "llama3"});
+    EXPECT_EQ(llama->name(), "llama3");
+    EXPECT_EQ(llama, registry.for_family("llama3"));
+
+    auto gemma = registry.for_family("gemma");
+    EXPECT_EQ(gemma->name(), "approximate");
+}
+
+TEST(TokenizerRegistryTest, ConversationUsesSelectedTokenizer) {
+    Conversation conversation;
+    conversation.add_user("abababab");
+    size_t approximate = conversation.estimate_tokens();
+
+    conversation.set_tokenizer(BpeTokenizer::from_ranks(MakeRanks({"ab", "abab", "abababab"}), "test"));
+    EXPECT_EQ(conversation.estimate_tokens(), 1 + Conversation::MESSAGE_OVERHEAD_TOKENS);
+
+    conversation.set_tokenizer(nullptr);
+    EXPECT_EQ(conversation.estimate_tokens(), approximate);
+}
@@ -28,6 +28,9 @@ std::unique_ptr<Config> TestHelpers::CreateTestConfig() {
     repl_config.max_history = 50;
     repl_config.system_prompt = "You are a test assistant.";
     repl_config.streaming = true;
+    repl_config.session_journal = "";
+    repl_config.search_index = "";
+    repl_config.session_dir = "";
     config->set_repl_config(repl_config);
 
     return config;